@@ -14,6 +14,7 @@
 #include "TLM.h"
 #include "TLMSetup.h"
 #include "TLMOutput.h"
+#include "TLMPool.h"
 
 
 // Type Definitions
@@ -37,6 +38,7 @@ static HANDLE hMutexA;
 static HANDLE hMutexB;
 static HANDLE hMutexFlag;
 static flag_t fFlag = UNFINISHED;
+static NodePool *Pools;
 
 extern Node ***Grid;
 extern int xSize, ySize, zSize;
@@ -56,9 +58,9 @@ void ScatterB(void);
 void ConnectA(void);
 void ConnectB(void);
 void EvaluateSource(int Iteration);
-ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active);
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode);
-ActiveNode *CopyNodeAdditions(ActiveNode *Head, ActiveNode **pAdditionsHead, int *nActive);
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z, bool Active);
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode);
+ActiveNode *CopyNodeAdditions(NodePool *Pool, ActiveNode *Head, ActiveNode **pAdditionsHead, int *nActive);
 
 
 
@@ -75,16 +77,19 @@ void MainLoop(void)
 	AbsoluteThreshold = SQUARE(4*M_PI*GridSpacing/KAPPA*Frequency/SPEED_OF_LIGHT)*pow(10, MaxPathLoss/10.0);
 	RelativeThreshold *= RelativeThreshold;
 
+	// Give each thread its own active junction records
+	Pools = CreateNodePools(2);
+
 	// Add the impulse junction to the active set
 	if (ImpulseSource.X < xSize/2) {
 		ActiveJunctionsA = 1;
 		ActiveJunctionsB = 0;
-		ActiveSetA = AddJunctionToSet(ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
+		ActiveSetA = AddJunctionToSet(&Pools[0], ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
 	}
 	else {
 		ActiveJunctionsA = 0;
 		ActiveJunctionsB = 1;
-		ActiveSetB = AddJunctionToSet(ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
+		ActiveSetB = AddJunctionToSet(&Pools[1], ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
 	}
 
 	// Create the mutex objects, initially own mutex A
@@ -136,10 +141,11 @@ void MainLoop(void)
 		}
 
 		// Add nodes on boundaries to lists
-		ActiveSetA = CopyNodeAdditions(ActiveSetA, &NodeAdditionsA, &ActiveJunctionsA);
+		ActiveSetA = CopyNodeAdditions(&Pools[0], ActiveSetA, &NodeAdditionsA, &ActiveJunctionsA);
 
 		// Begin the connect phase
 		ConnectA();
+		FlushNodePool(&Pools[0]);
 
 		// Check the flag to see if B has finished yet
 		WaitForSingleObject(hMutexFlag, INFINITE);
@@ -166,6 +172,10 @@ void MainLoop(void)
 		printf("Completed %d iterations, %d active junctions in A, %d in B, %d total\n", nIterations, ActiveJunctionsA, ActiveJunctionsB, ActiveJunctionsA+ActiveJunctionsB);
 	}
 
+	// Both active sets are empty, so thread B holds no records
+	PrintNodePoolStats();
+	FreeNodePools();
+
 	printf("Algorithm complete, took %d iterations\n", nIterations);
 }
 
@@ -203,10 +213,11 @@ DWORD WINAPI SecondaryThread(LPVOID *lpParam)
 		}
 		
 		// Add nodes to the main active list
-		ActiveSetB = CopyNodeAdditions(ActiveSetB, &NodeAdditionsB, &ActiveJunctionsB);
+		ActiveSetB = CopyNodeAdditions(&Pools[1], ActiveSetB, &NodeAdditionsB, &ActiveJunctionsB);
 		
 		// Connect phase
 		ConnectB();
+		FlushNodePool(&Pools[1]);
 		
 		// Check the flag to see if A has finished yet
 		WaitForSingleObject(hMutexFlag, INFINITE);
@@ -237,6 +248,7 @@ void ScatterA(void)
 	double Value;			// Temporary node value
 	Node *NodeReference;	// Temporary node reference
 	ActiveNode *CurrentNode;
+	NodePool *Pool = &Pools[0];
 	int x, y, z;
 	int xMax = xSize/2-1;
 
@@ -264,7 +276,7 @@ void ScatterA(void)
 			if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x+1,y,z, true);
+				NewNode = AddJunctionToSet(Pool, x+1,y,z, true);
 				NewNode->NextActiveNode = ActiveSetA;
 				ActiveSetA = NewNode;
 				ActiveJunctionsA++;
@@ -275,7 +287,7 @@ void ScatterA(void)
 			if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x+1,y,z, false);
+				NewNode = AddJunctionToSet(Pool, x+1,y,z, false);
 				NewNode->NextActiveNode = NodeAdditionsB;
 				NodeAdditionsB = NewNode;
 			}
@@ -285,7 +297,7 @@ void ScatterA(void)
 			if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x-1,y,z, true);
+				NewNode = AddJunctionToSet(Pool, x-1,y,z, true);
 				NewNode->NextActiveNode = ActiveSetA;
 				ActiveSetA = NewNode;
 				ActiveJunctionsA++;
@@ -296,7 +308,7 @@ void ScatterA(void)
 			if (Grid[x][y+1][z].Active == false && Grid[x][y+1][z].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x,y+1,z, true);
+				NewNode = AddJunctionToSet(Pool, x,y+1,z, true);
 				NewNode->NextActiveNode = ActiveSetA;
 				ActiveSetA = NewNode;
 				ActiveJunctionsA++;
@@ -307,7 +319,7 @@ void ScatterA(void)
 			if (Grid[x][y-1][z].Active == false && Grid[x][y-1][z].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x,y-1,z, true);
+				NewNode = AddJunctionToSet(Pool, x,y-1,z, true);
 				NewNode->NextActiveNode = ActiveSetA;
 				ActiveSetA = NewNode;
 				ActiveJunctionsA++;
@@ -318,7 +330,7 @@ void ScatterA(void)
 			if (Grid[x][y][z+1].Active == false && Grid[x][y][z+1].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x,y,z+1, true);
+				NewNode = AddJunctionToSet(Pool, x,y,z+1, true);
 				NewNode->NextActiveNode = ActiveSetA;
 				ActiveSetA = NewNode;
 				ActiveJunctionsA++;
@@ -329,7 +341,7 @@ void ScatterA(void)
 			if (Grid[x][y][z-1].Active == false && Grid[x][y][z-1].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x,y,z-1, true);
+				NewNode = AddJunctionToSet(Pool, x,y,z-1, true);
 				NewNode->NextActiveNode = ActiveSetA;
 				ActiveSetA = NewNode;
 				ActiveJunctionsA++;
@@ -457,7 +469,7 @@ void ConnectA(void)
 		Grid[x][y][z].V = Value;
 
 		if (AvgEnergy < AbsoluteThreshold || AvgEnergy < NodeReference->Emax*RelativeThreshold) {
-			CurrentNode = RemoveJunctionFromSet(x,y,z,CurrentNode);
+			CurrentNode = RemoveJunctionFromSet(&Pools[0], x,y,z,CurrentNode);
 			ActiveJunctionsA--;
 			if (PreviousNode != NULL) {
 				PreviousNode->NextActiveNode = CurrentNode;
@@ -482,6 +494,7 @@ void ScatterB(void)
 	double Value;			// Temporary node value
 	Node *NodeReference;	// Temporary node reference
 	ActiveNode *CurrentNode;
+	NodePool *Pool = &Pools[1];
 	int x, y, z;
 	int xMin = xSize/2;
 
@@ -509,7 +522,7 @@ void ScatterB(void)
 			if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x+1,y,z, true);
+				NewNode = AddJunctionToSet(Pool, x+1,y,z, true);
 				NewNode->NextActiveNode = ActiveSetB;
 				ActiveSetB = NewNode;
 				ActiveJunctionsB++;
@@ -520,7 +533,7 @@ void ScatterB(void)
 			if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x-1,y,z, true);
+				NewNode = AddJunctionToSet(Pool, x-1,y,z, true);
 				NewNode->NextActiveNode = ActiveSetB;
 				ActiveSetB = NewNode;
 				ActiveJunctionsB++;
@@ -531,7 +544,7 @@ void ScatterB(void)
 			if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x-1,y,z, false);
+				NewNode = AddJunctionToSet(Pool, x-1,y,z, false);
 				NewNode->NextActiveNode = NodeAdditionsA;
 				NodeAdditionsA = NewNode;
 			}
@@ -541,7 +554,7 @@ void ScatterB(void)
 			if (Grid[x][y+1][z].Active == false && Grid[x][y+1][z].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x,y+1,z, true);
+				NewNode = AddJunctionToSet(Pool, x,y+1,z, true);
 				NewNode->NextActiveNode = ActiveSetB;
 				ActiveSetB = NewNode;
 				ActiveJunctionsB++;
@@ -552,7 +565,7 @@ void ScatterB(void)
 			if (Grid[x][y-1][z].Active == false && Grid[x][y-1][z].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x,y-1,z, true);
+				NewNode = AddJunctionToSet(Pool, x,y-1,z, true);
 				NewNode->NextActiveNode = ActiveSetB;
 				ActiveSetB = NewNode;
 				ActiveJunctionsB++;
@@ -563,7 +576,7 @@ void ScatterB(void)
 			if (Grid[x][y][z+1].Active == false && Grid[x][y][z+1].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x,y,z+1, true);
+				NewNode = AddJunctionToSet(Pool, x,y,z+1, true);
 				NewNode->NextActiveNode = ActiveSetB;
 				ActiveSetB = NewNode;
 				ActiveJunctionsB++;
@@ -574,7 +587,7 @@ void ScatterB(void)
 			if (Grid[x][y][z-1].Active == false && Grid[x][y][z-1].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x,y,z-1, true);
+				NewNode = AddJunctionToSet(Pool, x,y,z-1, true);
 				NewNode->NextActiveNode = ActiveSetB;
 				ActiveSetB = NewNode;
 				ActiveJunctionsB++;
@@ -703,7 +716,7 @@ void ConnectB(void)
 		Grid[x][y][z].V = Value;
 
 		if (AvgEnergy < AbsoluteThreshold || AvgEnergy < NodeReference->Emax*RelativeThreshold) {
-			CurrentNode = RemoveJunctionFromSet(x,y,z,CurrentNode);
+			CurrentNode = RemoveJunctionFromSet(&Pools[1], x,y,z,CurrentNode);
 			ActiveJunctionsB--;
 			if (PreviousNode != NULL) {
 				PreviousNode->NextActiveNode = CurrentNode;
@@ -751,12 +764,12 @@ void EvaluateSource(int Iteration)
 	}
 }
 
-// Return a newly allocated ActiveNode structure with the coordinates given
-ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active)
+// Return an ActiveNode structure from the pool of the thread with the coordinates given
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z, bool Active)
 {
 	ActiveNode *NewNode;
 
-	NewNode = (ActiveNode*)malloc(sizeof(ActiveNode)); 
+	NewNode = AllocateActiveNode(Pool);
 
 
 	NewNode->X = x;
@@ -771,13 +784,13 @@ ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active)
 }
 
 
-// Remove a junction from the active set and free memory allocated to it, returns the a pointer to the rest of the list which should be appended to the first half
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode)
+// Remove a junction from the active set and return its record to the pool, returns the a pointer to the rest of the list which should be appended to the first half
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode)
 {
 	ActiveNode *NextNode;
 	
 	NextNode = InactiveNode->NextActiveNode;
-	free(InactiveNode);
+	FreeActiveNode(Pool, InactiveNode);
 	Grid[x][y][z].Active = false;
 	Grid[x][y][z].V = 0;
 	Grid[x][y][z].VxpIn = 0;
@@ -799,7 +812,7 @@ ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode)
 
 
 // Add boundary nodes to the active list, return the new list
-ActiveNode *CopyNodeAdditions(ActiveNode *Head, ActiveNode **pAdditionsHead, int *nActive)
+ActiveNode *CopyNodeAdditions(NodePool *Pool, ActiveNode *Head, ActiveNode **pAdditionsHead, int *nActive)
 {
 	ActiveNode *TempNode, *CurrentNode, *PreviousNode;
 
@@ -810,7 +823,7 @@ ActiveNode *CopyNodeAdditions(ActiveNode *Head, ActiveNode **pAdditionsHead, int
 			// Junction already added to active set, remove the node from the active set
 			TempNode = CurrentNode;
 			CurrentNode = CurrentNode->NextActiveNode;
-			free(TempNode);
+			FreeActiveNode(Pool, TempNode);
 			if (PreviousNode != NULL) {
 				PreviousNode->NextActiveNode = CurrentNode;
 			}
@@ -14,6 +14,7 @@
 #include "TLM.h"
 #include "TLMSetup.h"
 #include "TLMOutput.h"
+#include "TLMPool.h"
 
 
 // Type Definitions
@@ -38,6 +39,7 @@ static HANDLE *hMutexMsg;
 static Msg_t *Msg;
 static HANDLE *hWorkerThreads;
 static DWORD *dwWorkerThreadIDs;
+static NodePool *Pools;
 
 extern Node ***Grid;
 extern int xSize, ySize, zSize;
@@ -56,8 +58,8 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam);
 void Scatter(int ThreadNumber);
 void Connect(int ThreadNumber);
 void EvaluateSource(int Iteration);
-ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active);
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode);
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z, bool Active);
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode);
 void CopyNodeAdditions(int ThreadNumber);
 void CorrectActiveSet(void);
 void AllocateResources(void);
@@ -88,7 +90,7 @@ void MainLoop(void)
 		EvaluateSource(nIterations);
 	}
 	ActiveJunctions[0] = 1;
-	ActiveSet[0] = AddJunctionToSet(ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
+	ActiveSet[0] = AddJunctionToSet(&Pools[0], ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
 
 	// Wait for the workers to become ready
 	do {
@@ -164,6 +166,10 @@ void MainLoop(void)
 	// Wait for the worker threads to terminate
 	WaitForMultipleObjects(Threads, hWorkerThreads, true, INFINITE);
 
+	// The records still in the active sets go with the slabs of their pools
+	PrintNodePoolStats();
+	FreeNodePools();
+
 	// Free memory allocated to the synchronisation
 	FreeResources();
 
@@ -208,6 +214,7 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam)
 			case CONNECT:
 				CopyNodeAdditions(ThreadNumber);
 				Connect(ThreadNumber);
+				FlushNodePool(&Pools[ThreadNumber]);
 				break;
 			case DO_NOTHING:
 				break;
@@ -228,6 +235,7 @@ void Scatter(int ThreadNumber)
 	Node *NodeReference;	// Temporary node reference
 	ActiveNode *CurrentNode;
 	ActiveNode *NewNode;
+	NodePool *Pool = &Pools[ThreadNumber];
 	int AdditionIndex = (ThreadNumber+Threads/2)%Threads;
 	int x,y,z;
 
@@ -253,7 +261,7 @@ void Scatter(int ThreadNumber)
 		// Positive x direction
 		if (x < (xSize-1)) {
 			if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
-				NewNode = AddJunctionToSet(x+1,y,z, false);
+				NewNode = AddJunctionToSet(Pool, x+1,y,z, false);
 				NewNode->NextActiveNode = NodeAdditions[AdditionIndex][ThreadNumber];
 				NodeAdditions[AdditionIndex][ThreadNumber] = NewNode;
 				++AdditionIndex%=Threads;
@@ -264,7 +272,7 @@ void Scatter(int ThreadNumber)
 		// Negative x direction
 		if (x > 0) {
 			if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
-				NewNode = AddJunctionToSet(x-1,y,z, false);
+				NewNode = AddJunctionToSet(Pool, x-1,y,z, false);
 				NewNode->NextActiveNode = NodeAdditions[AdditionIndex][ThreadNumber];
 				NodeAdditions[AdditionIndex][ThreadNumber] = NewNode;
 				++AdditionIndex%=Threads;
@@ -274,7 +282,7 @@ void Scatter(int ThreadNumber)
 		// Positive y direction
 		if (y < (ySize - 1)) {
 			if (Grid[x][y+1][z].Active == false && Grid[x][y+1][z].PropagateFlag == true) {
-				NewNode = AddJunctionToSet(x,y+1,z, false);
+				NewNode = AddJunctionToSet(Pool, x,y+1,z, false);
 				NewNode->NextActiveNode = NodeAdditions[AdditionIndex][ThreadNumber];
 				NodeAdditions[AdditionIndex][ThreadNumber] = NewNode;
 				++AdditionIndex%=Threads;
@@ -284,7 +292,7 @@ void Scatter(int ThreadNumber)
 		// Negative y direction
 		if (y > 0) {
 			if (Grid[x][y-1][z].Active == false && Grid[x][y-1][z].PropagateFlag == true) {
-				NewNode = AddJunctionToSet(x,y-1,z, false);
+				NewNode = AddJunctionToSet(Pool, x,y-1,z, false);
 				NewNode->NextActiveNode = NodeAdditions[AdditionIndex][ThreadNumber];
 				NodeAdditions[AdditionIndex][ThreadNumber] = NewNode;
 				++AdditionIndex%=Threads;
@@ -293,7 +301,7 @@ void Scatter(int ThreadNumber)
 		// Positive z direction
 		if (z < (zSize - 1)) {
 			if (Grid[x][y][z+1].Active == false && Grid[x][y][z+1].PropagateFlag == true) {
-				NewNode = AddJunctionToSet(x,y,z+1, false);
+				NewNode = AddJunctionToSet(Pool, x,y,z+1, false);
 				NewNode->NextActiveNode = NodeAdditions[AdditionIndex][ThreadNumber];
 				NodeAdditions[AdditionIndex][ThreadNumber] = NewNode;
 				++AdditionIndex%=Threads;
@@ -302,7 +310,7 @@ void Scatter(int ThreadNumber)
 		// Negative y direction
 		if (z > 0) {
 			if (Grid[x][y][z-1].Active == false && Grid[x][y][z-1].PropagateFlag == true) {
-				NewNode = AddJunctionToSet(x,y,z-1, false);
+				NewNode = AddJunctionToSet(Pool, x,y,z-1, false);
 				NewNode->NextActiveNode = NodeAdditions[AdditionIndex][ThreadNumber];
 				NodeAdditions[AdditionIndex][ThreadNumber] = NewNode;
 				++AdditionIndex%=Threads;
@@ -435,7 +443,7 @@ void Connect(int ThreadNumber)
 		Grid[x][y][z].V = Value;
 
 		if (AvgEnergy < AbsoluteThreshold || AvgEnergy < NodeReference->Emax*RelativeThreshold) {
-			CurrentNode = RemoveJunctionFromSet(x,y,z,CurrentNode);
+			CurrentNode = RemoveJunctionFromSet(&Pools[ThreadNumber], x,y,z,CurrentNode);
 			ActiveJunctions[ThreadNumber]--;
 			if (PreviousNode != NULL) {
 				PreviousNode->NextActiveNode = CurrentNode;
@@ -484,12 +492,12 @@ void EvaluateSource(int Iteration)
 }
 
 
-// Return a newly allocated ActiveNode structure with the coordinates given
-ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active)
+// Return an ActiveNode structure from the pool of the thread with the coordinates given
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z, bool Active)
 {
 	ActiveNode *NewNode;
 
-	NewNode = (ActiveNode*)malloc(sizeof(ActiveNode)); 
+	NewNode = AllocateActiveNode(Pool);
 
 
 	NewNode->X = x;
@@ -504,13 +512,13 @@ ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active)
 }
 
 
-// Remove a junction from the active set and free memory allocated to it, returns the a pointer to the rest of the list which should be appended to the first half
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode)
+// Remove a junction from the active set and return its record to the pool, returns the a pointer to the rest of the list which should be appended to the first half
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode)
 {
 	ActiveNode *NextNode;
 	
 	NextNode = InactiveNode->NextActiveNode;
-	free(InactiveNode);
+	FreeActiveNode(Pool, InactiveNode);
 	Grid[x][y][z].Active = false;
 	Grid[x][y][z].V = 0;
 	Grid[x][y][z].VxpIn = 0;
@@ -545,7 +553,7 @@ void CopyNodeAdditions(int ThreadNumber)
 				// Junction already added to active set, remove the node from the active set
 				TempNode = CurrentNode;
 				CurrentNode = CurrentNode->NextActiveNode;
-				free(TempNode);
+				FreeActiveNode(&Pools[ThreadNumber], TempNode);
 				if (PreviousNode != NULL) {
 					PreviousNode->NextActiveNode = CurrentNode;
 				}
@@ -594,6 +602,9 @@ void AllocateResources(void)
 		hMutex[i] = (HANDLE*)malloc(Threads*sizeof(HANDLE));
 	}
 
+	// Give each worker thread its own active junction records
+	Pools = CreateNodePools(Threads);
+
 	for (int i=0; i<Threads; i++) {
 
 		// Initialise the active junctions
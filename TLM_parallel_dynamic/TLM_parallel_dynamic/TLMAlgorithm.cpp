@@ -14,6 +14,7 @@
 #include "TLM.h"
 #include "TLMSetup.h"
 #include "TLMOutput.h"
+#include "TLMPool.h"
 #include "TLMScene.h"
 
 
@@ -40,6 +41,7 @@ static HANDLE hMutexMsg[2];
 static Msg_t Msg[2] = {NO_MSG, NO_MSG};
 static int xMin[2];
 static int xMax[2];
+static NodePool *Pools;
 
 extern Node ***Grid;
 extern int xSize, ySize, zSize;
@@ -58,9 +60,9 @@ void Scatter(int ThreadNumber, int xMin, int xMax);
 void Connect(int ThreadNumber);
 void EvaluateSource(int Iteration);
 void CalculateBoundary(void);
-ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active);
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode);
-void CopyNodeAdditions(ActiveNode **pHead, ActiveNode **pAdditionsHead, int *nActive);
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z, bool Active);
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode);
+void CopyNodeAdditions(NodePool *Pool, ActiveNode **pHead, ActiveNode **pAdditionsHead, int *nActive);
 void CorrectActiveSet(int Set1);
 
 
@@ -78,9 +80,12 @@ void MainLoop(void)
 	AbsoluteThreshold = SQUARE(4*M_PI*GridSpacing/KAPPA*Frequency/SPEED_OF_LIGHT)*pow(10, MaxPathLoss/10.0);
 	RelativeThreshold *= RelativeThreshold;
 
+	// Give each worker thread its own active junction records
+	Pools = CreateNodePools(2);
+
 	// Add the impulse junction to the active set
 	ActiveJunctions[0] = 1;
-	ActiveSet[0] = AddJunctionToSet(ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
+	ActiveSet[0] = AddJunctionToSet(&Pools[0], ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
 
 	xMin[0] = 0;
 	xMax[0] = MAX(ImpulseSource.X,0);
@@ -197,6 +202,13 @@ void MainLoop(void)
 		ReleaseMutex(hMutexA[i]);
 	}
 
+	// Wait for the worker threads to terminate
+	WaitForMultipleObjects(2, hWorkerThreads, true, INFINITE);
+
+	// The records still in the active sets go with the slabs of their pools
+	PrintNodePoolStats();
+	FreeNodePools();
+
 	printf("Algorithm complete, took %d iterations\n", nIterations);
 }
 
@@ -232,8 +244,9 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam)
 				Scatter(ThreadNumber, xMin[ThreadNumber], xMax[ThreadNumber]);
 				break;
 			case CONNECT:
-				CopyNodeAdditions(&ActiveSet[ThreadNumber], &NodeAdditions[ThreadNumber], &ActiveJunctions[ThreadNumber]);
+				CopyNodeAdditions(&Pools[ThreadNumber], &ActiveSet[ThreadNumber], &NodeAdditions[ThreadNumber], &ActiveJunctions[ThreadNumber]);
 				Connect(ThreadNumber);
+				FlushNodePool(&Pools[ThreadNumber]);
 				break;
 			case END:
 				ExitThread(0);
@@ -255,6 +268,7 @@ void Scatter(int ThreadNumber, int xMin, int xMax)
 	double Value;			// Temporary node value
 	Node *NodeReference;	// Temporary node reference
 	ActiveNode *CurrentNode;
+	NodePool *Pool = &Pools[ThreadNumber];
 	int x, y, z;
 
 	// Setup the current node pointer
@@ -282,7 +296,7 @@ void Scatter(int ThreadNumber, int xMin, int xMax)
 				if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
 					ActiveNode *NewNode;
 
-					NewNode = AddJunctionToSet(x+1,y,z, false);
+					NewNode = AddJunctionToSet(Pool, x+1,y,z, false);
 					NewNode->NextActiveNode = NodeAdditions[1-ThreadNumber];
 					NodeAdditions[1-ThreadNumber] = NewNode;
 				}
@@ -291,7 +305,7 @@ void Scatter(int ThreadNumber, int xMin, int xMax)
 				if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
 					ActiveNode *NewNode;
 
-					NewNode = AddJunctionToSet(x+1,y,z, true);
+					NewNode = AddJunctionToSet(Pool, x+1,y,z, true);
 					NewNode->NextActiveNode = ActiveSet[ThreadNumber];
 					ActiveSet[ThreadNumber] = NewNode;
 					ActiveJunctions[ThreadNumber]++;
@@ -305,7 +319,7 @@ void Scatter(int ThreadNumber, int xMin, int xMax)
 				if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
 					ActiveNode *NewNode;
 
-					NewNode = AddJunctionToSet(x-1,y,z, false);
+					NewNode = AddJunctionToSet(Pool, x-1,y,z, false);
 					NewNode->NextActiveNode = NodeAdditions[1-ThreadNumber];
 					NodeAdditions[1-ThreadNumber] = NewNode;
 				}
@@ -314,7 +328,7 @@ void Scatter(int ThreadNumber, int xMin, int xMax)
 				if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
 					ActiveNode *NewNode;
 
-					NewNode = AddJunctionToSet(x-1,y,z, true);
+					NewNode = AddJunctionToSet(Pool, x-1,y,z, true);
 					NewNode->NextActiveNode = ActiveSet[ThreadNumber];
 					ActiveSet[ThreadNumber] = NewNode;
 					ActiveJunctions[ThreadNumber]++;
@@ -326,7 +340,7 @@ void Scatter(int ThreadNumber, int xMin, int xMax)
 			if (Grid[x][y+1][z].Active == false && Grid[x][y+1][z].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x,y+1,z, true);
+				NewNode = AddJunctionToSet(Pool, x,y+1,z, true);
 				NewNode->NextActiveNode = ActiveSet[ThreadNumber];
 				ActiveSet[ThreadNumber] = NewNode;
 				ActiveJunctions[ThreadNumber]++;
@@ -337,7 +351,7 @@ void Scatter(int ThreadNumber, int xMin, int xMax)
 			if (Grid[x][y-1][z].Active == false && Grid[x][y-1][z].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x,y-1,z, true);
+				NewNode = AddJunctionToSet(Pool, x,y-1,z, true);
 				NewNode->NextActiveNode = ActiveSet[ThreadNumber];
 				ActiveSet[ThreadNumber] = NewNode;
 				ActiveJunctions[ThreadNumber]++;
@@ -348,7 +362,7 @@ void Scatter(int ThreadNumber, int xMin, int xMax)
 			if (Grid[x][y][z+1].Active == false && Grid[x][y][z+1].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x,y,z+1, true);
+				NewNode = AddJunctionToSet(Pool, x,y,z+1, true);
 				NewNode->NextActiveNode = ActiveSet[ThreadNumber];
 				ActiveSet[ThreadNumber] = NewNode;
 				ActiveJunctions[ThreadNumber]++;
@@ -359,7 +373,7 @@ void Scatter(int ThreadNumber, int xMin, int xMax)
 			if (Grid[x][y][z-1].Active == false && Grid[x][y][z-1].PropagateFlag == true) {
 				ActiveNode *NewNode;
 
-				NewNode = AddJunctionToSet(x,y,z-1, true);
+				NewNode = AddJunctionToSet(Pool, x,y,z-1, true);
 				NewNode->NextActiveNode = ActiveSet[ThreadNumber];
 				ActiveSet[ThreadNumber] = NewNode;
 				ActiveJunctions[ThreadNumber]++;
@@ -491,7 +505,7 @@ void Connect(int ThreadNumber)
 		Grid[x][y][z].V = Value;
 
 		if (AvgEnergy < AbsoluteThreshold || AvgEnergy < NodeReference->Emax*RelativeThreshold) {
-			CurrentNode = RemoveJunctionFromSet(x,y,z,CurrentNode);
+			CurrentNode = RemoveJunctionFromSet(&Pools[ThreadNumber], x,y,z,CurrentNode);
 			ActiveJunctions[ThreadNumber]--;
 			if (PreviousNode != NULL) {
 				PreviousNode->NextActiveNode = CurrentNode;
@@ -563,12 +577,12 @@ void CalculateBoundary(void)
 }
 
 
-// Return a newly allocated ActiveNode structure with the coordinates given
-ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active)
+// Return an ActiveNode structure from the pool of the thread with the coordinates given
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z, bool Active)
 {
 	ActiveNode *NewNode;
 
-	NewNode = (ActiveNode*)malloc(sizeof(ActiveNode)); 
+	NewNode = AllocateActiveNode(Pool);
 
 
 	NewNode->X = x;
@@ -583,13 +597,13 @@ ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active)
 }
 
 
-// Remove a junction from the active set and free memory allocated to it, returns the a pointer to the rest of the list which should be appended to the first half
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode)
+// Remove a junction from the active set and return its record to the pool, returns the a pointer to the rest of the list which should be appended to the first half
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode)
 {
 	ActiveNode *NextNode;
 	
 	NextNode = InactiveNode->NextActiveNode;
-	free(InactiveNode);
+	FreeActiveNode(Pool, InactiveNode);
 	Grid[x][y][z].Active = false;
 	Grid[x][y][z].V = 0;
 	Grid[x][y][z].VxpIn = 0;
@@ -611,7 +625,7 @@ ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode)
 
 
 // Add boundary nodes to the active list, return the new list
-void CopyNodeAdditions(ActiveNode **pHead, ActiveNode **pAdditionsHead, int *nActive)
+void CopyNodeAdditions(NodePool *Pool, ActiveNode **pHead, ActiveNode **pAdditionsHead, int *nActive)
 {
 	ActiveNode *TempNode, *CurrentNode, *PreviousNode;
 
@@ -622,7 +636,7 @@ void CopyNodeAdditions(ActiveNode **pHead, ActiveNode **pAdditionsHead, int *nAc
 			// Junction already added to active set, remove the node from the active set
 			TempNode = CurrentNode;
 			CurrentNode = CurrentNode->NextActiveNode;
-			free(TempNode);
+			FreeActiveNode(Pool, TempNode);
 			if (PreviousNode != NULL) {
 				PreviousNode->NextActiveNode = CurrentNode;
 			}
@@ -14,6 +14,7 @@
 #include "TLM.h"
 #include "TLMSetup.h"
 #include "TLMOutput.h"
+#include "TLMPool.h"
 
 
 // Definitions
@@ -48,16 +49,17 @@ static HANDLE *hConnectEvent;
 static HANDLE *hEndEvent;
 static HANDLE *hWorkerThreads;
 static DWORD *dwWorkerThreadIDs;
+static NodePool *Pools;
 static int Sets;
 
 
 // Function prototypes
 DWORD WINAPI WorkerThread(LPVOID *lpParam);
-void Scatter(int SetNumber);
-void Connect(int SetNumber);
+void Scatter(NodePool *Pool, int SetNumber);
+void Connect(NodePool *Pool, int SetNumber);
 void EvaluateSource(int Iteration);
-ActiveNode *AddJunctionToSet(int x, int y, int z);
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode);
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z);
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode);
 void CopyNodeAdditions(int SetNumber);
 void SetupNodeAdditions(void);
 void AllocateResources(void);
@@ -83,7 +85,7 @@ void MainLoop(void)
 		EvaluateSource(nIterations);
 	}
 	ActiveJunctions[(ImpulseSource.X+ImpulseSource.Y+ImpulseSource.Z)%Threads] = 1;
-	ActiveSet[(ImpulseSource.X+ImpulseSource.Y+ImpulseSource.Z)%Threads] = AddJunctionToSet(ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z);
+	ActiveSet[(ImpulseSource.X+ImpulseSource.Y+ImpulseSource.Z)%Threads] = AddJunctionToSet(&Pools[0], ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z);
 
 	// Wait for the workers to become ready
 	WaitForMultipleObjects(Threads, hReadyEvent, true, INFINITE);
@@ -133,6 +135,10 @@ void MainLoop(void)
 	// Wait for the worker threads to terminate
 	WaitForMultipleObjects(Threads, hWorkerThreads, true, INFINITE);
 
+	// The records still in the active sets go with the slabs of their pools
+	PrintNodePoolStats();
+	FreeNodePools();
+
 	// Free memory allocated to the synchronisation
 	FreeResources();
 
@@ -146,6 +152,7 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam)
 	int ThreadNumber = (int)(long long int)lpParam;
 	int Set1 = 2*ThreadNumber-(ThreadNumber&0x01);
 	int Set2 = (Set1+2)%Sets;
+	NodePool *Pool = &Pools[ThreadNumber];
 	HANDLE hEventArray[3];
 	DWORD EventBuffer;
 	
@@ -164,17 +171,18 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam)
 
 		switch (EventBuffer) {
 			case SCATTER_EVENT:
-				Scatter(Set1);
+				Scatter(Pool, Set1);
 				SetEvent(hHalfScatterEvent[ThreadNumber]);
 				WaitForSingleObject(hHalfScatterEvent[(ThreadNumber+2)%Threads], INFINITE);
-				Scatter(Set2);
+				Scatter(Pool, Set2);
 				break;
 
 			case CONNECT_EVENT:
 				CopyNodeAdditions(Set1);
 				CopyNodeAdditions(Set2);
-				Connect(Set1);
-				Connect(Set2);
+				Connect(Pool, Set1);
+				Connect(Pool, Set2);
+				FlushNodePool(Pool);
 				break;
 
 			case END_EVENT:
@@ -193,7 +201,7 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam)
 
 
 // Single iteration of the TLM algorithm scatter sequence
-void Scatter(int SetNumber) 
+void Scatter(NodePool *Pool, int SetNumber) 
 {
 	double Value;			// Temporary node value
 	Node *NodeReference;	// Temporary node reference
@@ -225,7 +233,7 @@ void Scatter(int SetNumber)
 		// Positive x direction
 		if (x < (xSize-1)) {
 			if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
-				NewNode = AddJunctionToSet(x+1,y,z);
+				NewNode = AddJunctionToSet(Pool, x+1,y,z);
 				NewNode->NextActiveNode = NodeAdditions[NextSet];
 				NodeAdditions[NextSet] = NewNode;
 				ActiveJunctions[NextSet]++;
@@ -235,7 +243,7 @@ void Scatter(int SetNumber)
 		// Positive y direction
 		if (y < (ySize - 1)) {
 			if (Grid[x][y+1][z].Active == false && Grid[x][y+1][z].PropagateFlag == true) {
-				NewNode = AddJunctionToSet(x,y+1,z);
+				NewNode = AddJunctionToSet(Pool, x,y+1,z);
 				NewNode->NextActiveNode = NodeAdditions[NextSet];
 				NodeAdditions[NextSet] = NewNode;
 				ActiveJunctions[NextSet]++;
@@ -245,7 +253,7 @@ void Scatter(int SetNumber)
 		// Positive z direction
 		if (z < (zSize - 1)) {
 			if (Grid[x][y][z+1].Active == false && Grid[x][y][z+1].PropagateFlag == true) {
-				NewNode = AddJunctionToSet(x,y,z+1);
+				NewNode = AddJunctionToSet(Pool, x,y,z+1);
 				NewNode->NextActiveNode = NodeAdditions[NextSet];
 				NodeAdditions[NextSet] = NewNode;
 				ActiveJunctions[NextSet]++;
@@ -255,7 +263,7 @@ void Scatter(int SetNumber)
 		// Negative x direction
 		if (x > 0) {
 			if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
-				NewNode = AddJunctionToSet(x-1,y,z);
+				NewNode = AddJunctionToSet(Pool, x-1,y,z);
 				NewNode->NextActiveNode = NodeAdditions[PreviousSet];
 				NodeAdditions[PreviousSet] = NewNode;
 				ActiveJunctions[PreviousSet]++;
@@ -265,7 +273,7 @@ void Scatter(int SetNumber)
 		// Negative y direction
 		if (y > 0) {
 			if (Grid[x][y-1][z].Active == false && Grid[x][y-1][z].PropagateFlag == true) {
-				NewNode = AddJunctionToSet(x,y-1,z);
+				NewNode = AddJunctionToSet(Pool, x,y-1,z);
 				NewNode->NextActiveNode = NodeAdditions[PreviousSet];
 				NodeAdditions[PreviousSet] = NewNode;
 				ActiveJunctions[PreviousSet]++;
@@ -275,7 +283,7 @@ void Scatter(int SetNumber)
 		// Negative y direction
 		if (z > 0) {
 			if (Grid[x][y][z-1].Active == false && Grid[x][y][z-1].PropagateFlag == true) {
-				NewNode = AddJunctionToSet(x,y,z-1);
+				NewNode = AddJunctionToSet(Pool, x,y,z-1);
 				NewNode->NextActiveNode = NodeAdditions[PreviousSet];
 				NodeAdditions[PreviousSet] = NewNode;
 				ActiveJunctions[PreviousSet]++;
@@ -290,7 +298,7 @@ void Scatter(int SetNumber)
 
 
 // Single iteration of the TLM algorithm connent sequence
-void Connect(int SetNumber) 
+void Connect(NodePool *Pool, int SetNumber) 
 {
 	double Value;			// Temporary node value
 	double AvgEnergy;		// Average energy over two iterations
@@ -410,7 +418,7 @@ void Connect(int SetNumber)
 		Grid[x][y][z].V = Value;
 
 		if (AvgEnergy < AbsoluteThreshold || AvgEnergy < NodeReference->Emax*RelativeThreshold) {
-			CurrentNode = RemoveJunctionFromSet(x,y,z,CurrentNode);
+			CurrentNode = RemoveJunctionFromSet(Pool, x,y,z,CurrentNode);
 			ActiveJunctions[SetNumber]--;
 			if (PreviousNode != NULL) {
 				PreviousNode->NextActiveNode = CurrentNode;
@@ -459,12 +467,12 @@ void EvaluateSource(int Iteration)
 }
 
 
-// Return a newly allocated ActiveNode structure with the coordinates given
-ActiveNode *AddJunctionToSet(int x, int y, int z)
+// Return an ActiveNode structure from the pool of the thread with the coordinates given
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z)
 {
 	ActiveNode *NewNode;
 
-	NewNode = (ActiveNode*)malloc(sizeof(ActiveNode)); 
+	NewNode = AllocateActiveNode(Pool);
 
 
 	NewNode->X = x;
@@ -477,13 +485,13 @@ ActiveNode *AddJunctionToSet(int x, int y, int z)
 }
 
 
-// Remove a junction from the active set and free memory allocated to it, returns the a pointer to the rest of the list which should be appended to the first half
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode)
+// Remove a junction from the active set and return its record to the pool, returns the a pointer to the rest of the list which should be appended to the first half
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode)
 {
 	ActiveNode *NextNode;
 	
 	NextNode = InactiveNode->NextActiveNode;
-	free(InactiveNode);
+	FreeActiveNode(Pool, InactiveNode);
 	Grid[x][y][z].Active = false;
 	Grid[x][y][z].V = 0;
 	Grid[x][y][z].VxpIn = 0;
@@ -533,6 +541,9 @@ void AllocateResources(void)
 	hConnectEvent = (HANDLE*)malloc(Threads*sizeof(HANDLE));
 	hEndEvent = (HANDLE*)malloc(Threads*sizeof(HANDLE));
 
+	// Give each worker thread its own active junction records
+	Pools = CreateNodePools(Threads);
+
 	for (int i=0; i<Threads; i++) {
 
 		// Create the events
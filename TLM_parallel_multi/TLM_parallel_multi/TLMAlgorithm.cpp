@@ -14,6 +14,7 @@
 #include "TLM.h"
 #include "TLMSetup.h"
 #include "TLMOutput.h"
+#include "TLMPool.h"
 #include "TLMScene.h"
 
 
@@ -40,6 +41,7 @@ typedef struct {
 				int yMax;
 				int zMin;
 				int zMax;
+				NodePool *Pool;				// Active junction records of the section
 				} ThreadData_t;
 
 
@@ -77,8 +79,8 @@ void Scatter(ThreadData_t *Data);
 void Connect(ThreadData_t *Data);
 void EvaluateSource(int Iteration);
 void CalculateBoundary(void);
-ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active);
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode);
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z, bool Active);
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode);
 void CopyNodeAdditions(ThreadData_t *Data);
 void CorrectActiveSet(int Set1);
 void CalculateSectionIndices(void);
@@ -265,6 +267,10 @@ void MainLoop(void)
 	// Wait for the worker threads to terminate
 	WaitForMultipleObjects(nThreads, hWorkerThreadArray, true, INFINITE);
 
+	// The records still in the active sets go with the slabs of their pools
+	PrintNodePoolStats();
+	FreeNodePools();
+
 	// Free memory allocated to the synchronisation
 	FreeResources();
 
@@ -313,6 +319,7 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam)
 			case CONNECT:
 				CopyNodeAdditions(Data);
 				Connect(Data);
+				FlushNodePool(Data->Pool);
 				break;
 			case END:
 				ExitThread(0);
@@ -369,14 +376,14 @@ void Scatter(ThreadData_t *Data)
 		if (x < (xSize-1)) {
 			if (x == xMax) {
 				if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x+1,y,z, false);
+					NewNode = AddJunctionToSet(Data->Pool, x+1,y,z, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex+1][yIndex][zIndex][0];
 					NodeAdditions[xIndex+1][yIndex][zIndex][0] = NewNode;
 				}
 			}
 			else {
 				if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x+1,y,z, true);
+					NewNode = AddJunctionToSet(Data->Pool, x+1,y,z, true);
 					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
 					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
 					ActiveJunctions[xIndex][yIndex][zIndex]++;
@@ -389,14 +396,14 @@ void Scatter(ThreadData_t *Data)
 		if (x > 0) {
 			if (x == xMin) {
 				if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x-1,y,z, false);
+					NewNode = AddJunctionToSet(Data->Pool, x-1,y,z, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex-1][yIndex][zIndex][1];
 					NodeAdditions[xIndex-1][yIndex][zIndex][1] = NewNode;
 				}
 			}
 			else {
 				if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x-1,y,z, true);
+					NewNode = AddJunctionToSet(Data->Pool, x-1,y,z, true);
 					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
 					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
 					ActiveJunctions[xIndex][yIndex][zIndex]++;
@@ -408,14 +415,14 @@ void Scatter(ThreadData_t *Data)
 		if (y < (ySize - 1)) {
 			if (y == yMax) {
 				if (Grid[x][y+1][z].Active == false && Grid[x][y+1][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y+1,z,false);
+					NewNode = AddJunctionToSet(Data->Pool, x,y+1,z,false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex][yIndex+1][zIndex][2];
 					NodeAdditions[xIndex][yIndex+1][zIndex][2] = NewNode;
 				}				
 			}
 			else {
 				if (Grid[x][y+1][z].Active == false && Grid[x][y+1][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y+1,z, true);
+					NewNode = AddJunctionToSet(Data->Pool, x,y+1,z, true);
 					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
 					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
 					ActiveJunctions[xIndex][yIndex][zIndex]++;
@@ -427,14 +434,14 @@ void Scatter(ThreadData_t *Data)
 		if (y > 0) {
 			if (y == yMin) {
 				if (Grid[x][y-1][z].Active == false && Grid[x][y-1][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y-1,z, false);
+					NewNode = AddJunctionToSet(Data->Pool, x,y-1,z, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex][yIndex-1][zIndex][3];
 					NodeAdditions[xIndex][yIndex-1][zIndex][3] = NewNode;
 				}
 			}
 			else {
 				if (Grid[x][y-1][z].Active == false && Grid[x][y-1][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y-1,z, true);
+					NewNode = AddJunctionToSet(Data->Pool, x,y-1,z, true);
 					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
 					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
 					ActiveJunctions[xIndex][yIndex][zIndex]++;
@@ -445,14 +452,14 @@ void Scatter(ThreadData_t *Data)
 		if (z < (zSize - 1)) {
 			if (z == zMax) {
 				if (Grid[x][y][z+1].Active == false && Grid[x][y][z+1].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y,z+1, false);
+					NewNode = AddJunctionToSet(Data->Pool, x,y,z+1, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex][yIndex][zIndex+1][4];
 					NodeAdditions[xIndex][yIndex][zIndex+1][4] = NewNode;
 				}
 			}
 			else {
 				if (Grid[x][y][z+1].Active == false && Grid[x][y][z+1].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y,z+1, true);
+					NewNode = AddJunctionToSet(Data->Pool, x,y,z+1, true);
 					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
 					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
 					ActiveJunctions[xIndex][yIndex][zIndex]++;
@@ -463,14 +470,14 @@ void Scatter(ThreadData_t *Data)
 		if (z > 0) {
 			if (z == zMin) {
 				if (Grid[x][y][z-1].Active == false && Grid[x][y][z-1].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y,z-1, false);
+					NewNode = AddJunctionToSet(Data->Pool, x,y,z-1, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex][yIndex][zIndex-1][5];
 					NodeAdditions[xIndex][yIndex][zIndex-1][5] = NewNode;
 				}
 			}
 			else {
 				if (Grid[x][y][z-1].Active == false && Grid[x][y][z-1].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y,z-1, true);
+					NewNode = AddJunctionToSet(Data->Pool, x,y,z-1, true);
 					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
 					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
 					ActiveJunctions[xIndex][yIndex][zIndex]++;
@@ -607,7 +614,7 @@ void Connect(ThreadData_t *Data)
 		Grid[x][y][z].V = Value;
 
 		if (AvgEnergy < AbsoluteThreshold || AvgEnergy < NodeReference->Emax*RelativeThreshold) {
-			CurrentNode = RemoveJunctionFromSet(x,y,z,CurrentNode);
+			CurrentNode = RemoveJunctionFromSet(Data->Pool, x,y,z,CurrentNode);
 			ActiveJunctions[xIndex][yIndex][zIndex]--;
 			if (PreviousNode != NULL) {
 				PreviousNode->NextActiveNode = CurrentNode;
@@ -679,12 +686,12 @@ void CalculateBoundary(void)
 }
 
 
-// Return a newly allocated ActiveNode structure with the coordinates given
-ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active)
+// Return an ActiveNode structure from the pool of the section with the coordinates given
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z, bool Active)
 {
 	ActiveNode *NewNode;
 
-	NewNode = (ActiveNode*)malloc(sizeof(ActiveNode)); 
+	NewNode = AllocateActiveNode(Pool);
 
 
 	NewNode->X = x;
@@ -699,13 +706,13 @@ ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active)
 }
 
 
-// Remove a junction from the active set and free memory allocated to it, returns the a pointer to the rest of the list which should be appended to the first half
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode)
+// Remove a junction from the active set and return its record to the pool, returns the a pointer to the rest of the list which should be appended to the first half
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode)
 {
 	ActiveNode *NextNode;
 	
 	NextNode = InactiveNode->NextActiveNode;
-	free(InactiveNode);
+	FreeActiveNode(Pool, InactiveNode);
 	Grid[x][y][z].Active = false;
 	Grid[x][y][z].V = 0;
 	Grid[x][y][z].VxpIn = 0;
@@ -743,7 +750,7 @@ void CopyNodeAdditions(ThreadData_t *Data)
 				// Junction already added to active set, remove the node from the active set
 				TempNode = CurrentNode;
 				CurrentNode = CurrentNode->NextActiveNode;
-				free(TempNode);
+				FreeActiveNode(Data->Pool, TempNode);
 				if (PreviousNode != NULL) {
 					PreviousNode->NextActiveNode = CurrentNode;
 				}
@@ -931,6 +938,7 @@ void CalculateSectionIndices(void)
 void AllocateResources(void)
 {
 	ThreadData_t *pData;
+	NodePool *Pools = CreateNodePools(MaxThreadIndex.X*MaxThreadIndex.Y*MaxThreadIndex.Z);
 
 	hWorkerThreads = (HANDLE***)malloc(MaxThreadIndex.X*sizeof(HANDLE**));
 	dwWorkerThreadIDs = (DWORD***)malloc(MaxThreadIndex.X*sizeof(DWORD**));
@@ -1000,6 +1008,9 @@ void AllocateResources(void)
 				pData->Index.Y = j;
 				pData->Index.Z = k;
 
+				// Give the section its own active junction records
+				pData->Pool = &Pools[(i*MaxThreadIndex.Y + j)*MaxThreadIndex.Z + k];
+
 				hWorkerThreads[i][j][k] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)WorkerThread, (LPVOID)&ThreadData[i][j][k], 0, &dwWorkerThreadIDs[i][j][k]);
 				if (hWorkerThreads[i] == NULL) {
 					printf("Worker thread for block (%d,%d,%d) could not be started\n", i+1, j+1, k+1);
@@ -1075,7 +1086,7 @@ void CalculateInitialBoundaries(void)
 					ImpulseSource.Z >= ThreadData[i][j][k].zMin && ImpulseSource.Z <= ThreadData[i][j][k].zMax) 
 				{
 					ActiveJunctions[i][j][k] = 1;
-					ActiveSet[i][j][k] = AddJunctionToSet(ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
+					ActiveSet[i][j][k] = AddJunctionToSet(ThreadData[i][j][k].Pool, ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
 				}
 			}
 		}
@@ -11,6 +11,38 @@
 #ifndef TLM_H
 #define TLM_H
 
+// Definitions
+
+// Observers of the connect step, chosen when the model is built. Each adds its fields to every node and its update to the
+// connect step, so a build that only needs the path loss leaves them all off. They can also be defined for the project.
+// The forks they replace are built with
+//	TLM_delay_spread	OBSERVE_DELAY_SPREAD = DELAY_SPREAD_RUN, OBSERVE_ENERGY = 1, OBSERVE_REMOVAL = REMOVE_RUN_ENERGY
+//	TLM_energy			OBSERVE_ENERGY = 1, OBSERVE_REMOVAL = REMOVE_RUN_ENERGY
+//	TLM_average			OBSERVE_REMOVAL = REMOVE_PEAK_VOLTAGE
+// The delay is measured from the voltages a connect step gives for the next iteration, one time step later than the forks,
+// which leaves the spread unchanged
+#define DELAY_SPREAD_PULSE		1		// Arrival time moments of the pulse of peak energy
+#define DELAY_SPREAD_RUN		2		// Arrival time moments over the whole run, normalised by its energy
+#define REMOVE_PEAK_PULSE		0		// Junctions leave the active set relative to the energy of the peak pulse
+#define REMOVE_RUN_ENERGY		1		// Relative to the energy over the whole run
+#define REMOVE_PEAK_VOLTAGE		2		// Relative to the peak voltage magnitude, the sum of the last two magnitudes is compared
+
+#ifndef OBSERVE_DELAY_SPREAD
+#define OBSERVE_DELAY_SPREAD	0		// Arrival time moments for the mean delay and rms delay spread, of the peak pulse or the run
+#endif
+#ifndef OBSERVE_AVERAGE
+#define OBSERVE_AVERAGE			0		// Running average of the voltage magnitude and its peak
+#endif
+#ifndef OBSERVE_ENERGY
+#define OBSERVE_ENERGY			0		// Energy over the whole run rather than of the peak pulse
+#endif
+#ifndef OBSERVE_REMOVAL
+#define OBSERVE_REMOVAL			REMOVE_PEAK_PULSE	// Reference for removing a junction from the active set
+#endif
+#define OBSERVE_RUN_ENERGY		(OBSERVE_ENERGY || OBSERVE_DELAY_SPREAD == DELAY_SPREAD_RUN || OBSERVE_REMOVAL == REMOVE_RUN_ENERGY)
+#define OBSERVE_ANY				(OBSERVE_DELAY_SPREAD || OBSERVE_AVERAGE || OBSERVE_RUN_ENERGY || OBSERVE_REMOVAL != REMOVE_PEAK_PULSE)
+
+
 // Type definitions
 
 // The type of source required
@@ -58,6 +90,29 @@ typedef struct {	// Current state
 					// Node Energies
 					double Epulse;
 					double Emax;
+#if OBSERVE_DELAY_SPREAD
+					// Energy weighted moments of the arrival time, of the current pulse or of the run
+					double Em,
+						   Emm;
+#endif
+#if OBSERVE_DELAY_SPREAD == DELAY_SPREAD_PULSE
+					// Moments of the peak pulse
+					double Em_max,
+						   Emm_max;
+#endif
+#if OBSERVE_AVERAGE
+					// Running average of the voltage magnitude and its peak
+					double Vavg;
+					double Vmax;
+#endif
+#if OBSERVE_RUN_ENERGY
+					// Energy over the whole run
+					double Energy;
+#endif
+#if OBSERVE_REMOVAL == REMOVE_PEAK_VOLTAGE
+					// Peak voltage magnitude
+					double Vpeak;
+#endif
 					// Node properties
 					double Z;
 					// Reflection and transmission coefficients
@@ -65,6 +120,8 @@ typedef struct {	// Current state
 					// Reflection coefficients
 					bool PropagateFlag;
 					bool Active;
+					// Logged as leaving the active set since the last checkpoint
+					bool Reset;
 				} Node;
 
 
@@ -89,13 +146,6 @@ struct ActiveNode {
 					};
 
 
-// Structure to hold a set of time variation values
-struct TimeVariationSet {
-							double *V;
-							TimeVariationSet *NextSet;
-						};
-
-
 // Structure to hold a boolean input parameter
 typedef struct {
 				bool Flag;
@@ -106,9 +156,34 @@ typedef struct {
 				InputFlag DisplayPolygonInformation;
 				InputFlag PrintTimeVariation;
 				InputFlag PrintTimingInformation;
+				InputFlag PinThreads;
+				InputFlag NumaReport;
+				InputFlag OverlapHalo;
+				InputFlag SceneCache;
+				InputFlag CropGrid;
+				InputFlag ThinWalls;
+				InputFlag ResumeCheckpoint;
+				InputFlag CoverageMap;
+				InputFlag CoverageQuantise;
 				} InputFlags;
 
 
+// Enumeration to store the placement of the grid memory on NUMA systems
+typedef enum {
+				NUMA_NONE,
+				NUMA_FIRST_TOUCH,
+				NUMA_INTERLEAVE
+				} NumaPolicy;
+
+
+// Enumeration to store the division of the grid between the worker threads
+typedef enum {
+				DECOMPOSITION_BOX,
+				DECOMPOSITION_SCENE,
+				DECOMPOSITION_RADIAL
+				} DecompositionType;
+
+
 // Enumeration to store the type of path loss sweep required
 typedef enum {
 				NONE,
@@ -118,6 +193,28 @@ typedef enum {
 				CUBE
 				} PLType;
 
+// Formats of the path loss output
+typedef enum {
+				PL_TEXT,		// Columns of position and path loss
+				PL_BINARY		// Header describing the samples followed by the path loss of each as a float
+				} PLFormat;
+
+
+// Value of the nodes written to the snapshots
+typedef enum {
+				SNAPSHOT_V,			// Voltage at the end of the iteration
+				SNAPSHOT_EMAX		// Peak pulse energy so far
+				} SnapshotField;
+
+
+// Nodes written to the snapshots
+typedef enum {
+				SNAPSHOT_VOLUME,	// The whole grid
+				SNAPSHOT_SLICE_X,	// The plane of nodes nearest a position along an axis
+				SNAPSHOT_SLICE_Y,
+				SNAPSHOT_SLICE_Z
+				} SnapshotRegion;
+
 
 // Structure to hold path loss point, route or grid info
 typedef struct {
@@ -137,6 +234,9 @@ typedef struct {
 typedef struct {
 				clock_t StartTime;
 				clock_t SceneParsingStartTime;
+				clock_t SceneFileReadTime;
+				clock_t GridAllocatedTime;
+				clock_t GridRasterisedTime;
 				clock_t SceneParsingFinishTime;
 				clock_t AlgorithmStartTime;
 				clock_t AlgorithmFinishTime;
@@ -15,12 +15,30 @@
 #include "TLMSetup.h"
 #include "TLMOutput.h"
 #include "TLMScene.h"
+#include "TLMNuma.h"
+#include "TLMDomain.h"
+#include "TLMPool.h"
+#include "TLMProbe.h"
+#include "TLMCheckpoint.h"
+#include "TLMSnapshot.h"
+#include "TLMObserver.h"
 
 // Event definitions
 #define SCATTER_EVENT	WAIT_OBJECT_0
 #define CONNECT_EVENT	WAIT_OBJECT_0+1
 #define END_EVENT		WAIT_OBJECT_0+2
 
+// Halo overlap definitions
+#define NO_STOP_ITERATION	0x7fffffff	// Value of the stop iteration until the main thread detects the end of the algorithm
+
+// Temporal blocking definitions
+#define TEMPORAL_TILE	16		// Number of nodes along each side of a temporally blocked tile, excluding its halo
+#define BOUNDARY_WEIGHT	2.0		// Cost of a junction handed between sections relative to an interior junction
+#define COST_SMOOTHING	0.25	// Weight of the latest measurement in the cost per junction of a section
+
+// Scene decomposition definitions
+#define SCENE_CELL		4		// Number of nodes along each side of a cell of the coarse scene used to compare layouts
+
 
 // Type Definitions
 
@@ -30,6 +48,30 @@ typedef struct {
 				int Z;
 				} ThreadIndex_t;
 
+// A box of nodes in the grid
+typedef struct {
+				int xMin;
+				int xMax;
+				int yMin;
+				int yMax;
+				int zMin;
+				int zMax;
+				} Region_t;
+
+// The state of a node at the end of a temporally blocked pass
+typedef struct {
+				double V;
+				double VxpIn,
+					   VxnIn,
+					   VypIn,
+					   VynIn,
+					   VzpIn,
+					   VznIn;
+				double Epulse;
+				double Emax;
+				double AvgEnergy;
+				} BlockNode;
+
 typedef struct {
 				ThreadIndex_t Index;
 				int xMin;
@@ -38,23 +80,67 @@ typedef struct {
 				int yMax;
 				int zMin;
 				int zMax;
+				NumaTraffic Traffic;
+				NodePool *Pool;				// Active junction records of the section
+				Region_t ActiveRegion;		// Bounds of the active junctions of the section
+				Region_t BlockRegion;		// Nodes of the section advanced by the current temporally blocked pass
+				BlockNode *BlockResult;		// State of the block region at the end of the pass
+				SIZE_T BlockCapacity;		// Nodes the block result can hold, kept from pass to pass
+				bool BlockAdvanced;			// Whether the current pass advanced part of the section
+				Node *Tile;					// Working copy of a tile and its halo
+				volatile LONG ScatterCount;	// Iterations for which the boundary outputs have been published
+				volatile LONG ConnectCount;	// Iterations for which the boundary junctions have been connected
+				volatile LONG Completed;	// Iterations completed by the section
+				volatile LONG LastActive;	// Last iteration after which the section had active junctions
+				LONGLONG Ticks;				// Time spent on the section in the last iteration
+				int BoundaryJunctions;		// Junctions handed between the section and its neighbours in the last iteration
+				int Workload;				// Active junctions at the start of the last iteration
+				double CostPerNode;			// Smoothed time per weighted junction
+				double PredictedCost;		// Predicted time for the next iteration
 				} ThreadData_t;
 
+// A thread of the worker pool and the sections it runs in the current iteration
+typedef struct {
+				int Index;
+				int nSections;
+				ThreadData_t **Sections;
+				double Load;				// Predicted time of the assigned sections
+				HANDLE hReadyEvent;
+				HANDLE hScatterEvent;
+				HANDLE hConnectEvent;
+				HANDLE hEndEvent;
+				} WorkerData_t;
+
 
 // Global variables
 static int ***ActiveJunctions;
 double AbsoluteThreshold;
+static double RelativeEnergyThreshold;		// Square of the relative voltage threshold, the input is kept for another run
 
 static ActiveNode ****ActiveSet;
-static ActiveNode *****NodeAdditions;		// 6 element array [Xn, Xp, Yn, Yp, Zn, Zp]
-static HANDLE ***hReadyEvent;
-static HANDLE ***hScatterEvent;
-static HANDLE ***hConnectEvent;
-static HANDLE ***hEndEvent;
+static ActiveNode ****BoundarySet;			// Active junctions on the section faces, only used when the halo is overlapped
+static ActiveNode *****NodeAdditions;		// 6 element array [Xn, Xp, Yn, Yp, Zn, Zp], or one list per sending section with the radial decomposition
+static int nAdditionLists = 6;
+static int **SectorMap = NULL;				// Section owning each (x,y) column with the radial decomposition
+static HANDLE ***hWakeEvent;
+static HANDLE hProgressEvent;
+static volatile LONG StopIteration = NO_STOP_ITERATION;
 static ThreadData_t ***ThreadData;
+static ThreadData_t **Schedule;				// The sections in the order they are assigned to the workers
 static ThreadIndex_t MaxThreadIndex;
-static HANDLE ***hWorkerThreads;
-static DWORD ***dwWorkerThreadIDs;
+static WorkerData_t *WorkerData;
+static int nWorkers;
+static HANDLE *hWorkerThreads;
+static DWORD *dwWorkerThreadIDs;
+static bool BlockedPass = false;
+static Region_t BlockRegion;
+static OutputQueue *StatusQueue;			// Section status handed to the output thread
+static bool Probing = false;				// Whether the probes are recorded by this run
+static bool Snapshotting = false;			// Whether snapshots of the grid are written by this run
+static bool Checkpointing = false;			// Whether the run takes checkpoints, junctions leaving the active sets are logged
+static bool CheckpointIteration = false;	// Whether the sections copy their active junctions to a checkpoint once they have connected
+static int CurrentIteration = 0;			// Iteration being run, for the observers built in
+static bool WholeRowsReported = false;		// Whether the z split given up for first touch placement has been reported
 
 extern Node ***Grid;
 extern int xSize, ySize, zSize;
@@ -66,23 +152,57 @@ extern double MaxPathLoss;
 extern double RelativeThreshold;
 extern double GridSpacing;
 extern int Threads;
+extern int Workers;
+extern int TemporalBlock;
+extern double TemporalBlockDensity;
+extern DecompositionType Decomposition;
+extern NumaPolicy GridPlacement;
+extern double RadialShellWidth;
+extern int CheckpointIterations;
+extern double CheckpointMinutes;
+extern int SnapshotIterations;
 
 
 // Function prototypes
 DWORD WINAPI WorkerThread(LPVOID *lpParam);
 void Scatter(ThreadData_t *Data);
+void ScatterList(ThreadData_t *Data, ActiveNode *CurrentNode);
 void Connect(ThreadData_t *Data);
+void ConnectList(ThreadData_t *Data, ActiveNode **ListHead);
+void InsertActiveJunction(ThreadData_t *Data, ActiveNode *NewNode);
+void AddSectorJunction(ThreadData_t *Data, int x, int y, int z);
+void ActivateDomainJunction(int x, int y, int z);
+void ActivateCheckpointJunction(int x, int y, int z);
+void CopyCheckpointSection(ThreadData_t *Data);
+int RunOverlappedSections(HANDLE *hReadyEventArray);
+void RunOverlapped(ThreadData_t *Data);
+bool WaitForNeighbours(ThreadData_t *Data, ThreadData_t **Neighbours, int nNeighbours, bool ScatterPhase, LONG Iteration);
+void WakeNeighbours(ThreadData_t **Neighbours, int nNeighbours);
+void PrintSectionStatus(int nIterations);
+void BlockedScatter(ThreadData_t *Data);
+void BlockedConnect(ThreadData_t *Data);
+void AdvanceTile(ThreadData_t *Data, int x0, int x1, int y0, int y1, int z0, int z1);
+SIZE_T BlockResultIndex(Region_t *Region, int x, int y, int z);
+bool ChooseTemporalBlocking(void);
 void EvaluateSource(int Iteration);
 void CalculateBoundary(void);
-ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active);
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode);
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z, bool Active);
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode);
 void CopyNodeAdditions(ThreadData_t *Data);
 void CorrectActiveSet(int Set1);
-void CalculateSectionIndices(void);
 void AllocateResources(void);
 void FreeResources(void);
-void CalculateInitialBoundaries(void);
-int CompareActiveJunctions(const void *Thread1, const void *Thread2);
+void CalculateInitialBoundaries(bool InsertSource);
+void CalculateSectorMap(void);
+void FreeSectorMap(void);
+void ScheduleSections(void);
+void UpdateSectionCosts(void);
+int WorkerPoolSize(int nSections);
+int FactoriseThreads(int zMax, int *MaxSizes);
+void ChooseSceneDecomposition(int nSections);
+double PredictLayoutEfficiency(ThreadIndex_t *Layout, int *CellNodes, int *CellDistance, int nCells, int nBuckets);
+int BoxSection(ThreadIndex_t *Layout, int x, int y, int z);
+int CompareSectionCost(const void *Section1, const void *Section2);
 
 
 // Top level loop for TLM algorithm
@@ -90,120 +210,207 @@ void MainLoop(void)
 {
 	int nIterations = 0;
 	int n = 0;
-	int nThreads;
-	int nCores;
-	int *Priorities;
-	int **BusiestThreads;
+	int nSections;
 	bool Empty = false;
+	bool Blocked;
+	bool Resumed = false;
+	double TotalLoad = 0;
+	double PeakLoad = 0;
+	int MaxJunctions;
+	LONG ProcessJunctions;
+	LONGLONG WorkerTicks;
+	LONGLONG MaxWorkerTicks;
+	double BusyTicks = 0;
+	double MakespanTicks = 0;
 	HANDLE *hReadyEventArray;
-	HANDLE *hWorkerThreadArray;
 
 	// Calculate the absolute threshold from the path loss
 	AbsoluteThreshold = SQUARE(4*M_PI*GridSpacing/KAPPA*Frequency/SPEED_OF_LIGHT)*pow(10, MaxPathLoss/10.0);
-	RelativeThreshold *= RelativeThreshold;
+	RelativeEnergyThreshold = SQUARE(RelativeThreshold);
+
+	// The observers built in are only updated by the event based connect step. The delay spread also needs the sections to
+	// share the iteration they are running
+	if (OBSERVE_ANY) {
+		if (OBSERVE_DELAY_SPREAD && InputData.OverlapHalo.Flag == true) {
+			printf("Halo overlap is not available with the delay spread observer, using synchronised iterations\n");
+			InputData.OverlapHalo.Flag = false;
+		}
+		if (TemporalBlock > 1) {
+			printf("Temporal blocking is not available with observers built in\n");
+			TemporalBlock = 1;
+		}
+	}
+
+	// Overlapping the halo needs the sections to run freely, which temporal blocking does not allow
+	if (InputData.OverlapHalo.Flag == true && TemporalBlock > 1) {
+		printf("Halo overlap is not available with temporal blocking, using synchronised iterations\n");
+		InputData.OverlapHalo.Flag = false;
+	}
+
+	// The sectors of the radial decomposition are not boxes, so neither the halo nor temporal blocking apply
+	if (Decomposition == DECOMPOSITION_RADIAL) {
+		if (InputData.OverlapHalo.Flag == true) {
+			printf("Halo overlap is not available with the radial decomposition, using synchronised iterations\n");
+			InputData.OverlapHalo.Flag = false;
+		}
+		if (TemporalBlock > 1) {
+			printf("Temporal blocking is not available with the radial decomposition\n");
+			TemporalBlock = 1;
+		}
+	}
+
+	// A checkpoint is taken between iterations, when every section has completed the same number of them
+	Checkpointing = CheckpointIterations > 0 || CheckpointMinutes > 0;
+	if (Checkpointing == true) {
+		if (InputData.OverlapHalo.Flag == true) {
+			printf("Checkpoints are not taken with the halo overlapped, the sections are not at the same iteration\n");
+			Checkpointing = false;
+		}
+		else if (TemporalBlock > 1) {
+			printf("Checkpoints are not taken with temporal blocking\n");
+			Checkpointing = false;
+		}
+		else if (OBSERVE_ANY) {
+			printf("Checkpoints are not taken with observers built in, they do not hold the observed values\n");
+			Checkpointing = false;
+		}
+	}
 
 	// Calculate the boundaries
 	CalculateSectionIndices();
 	AllocateResources();
-	CalculateInitialBoundaries();
 
-	nThreads = MaxThreadIndex.X * MaxThreadIndex.Y * MaxThreadIndex.Z;
-	nCores = 2;
+	nSections = MaxThreadIndex.X * MaxThreadIndex.Y * MaxThreadIndex.Z;
+
+	// A resumed run starts from the junctions active at the checkpoint in place of the source
+	if (Checkpointing == true) {
+		Resumed = OpenCheckpoint(nSections, &nIterations, ActivateCheckpointJunction);
+	}
+	CalculateInitialBoundaries(Resumed == false);
+
+	// The status and the probes are written by the output thread, the iterations only copy them
+	StatusQueue = OpenOutputQueue(nSections);
+	Probing = false;
+	if (ProbesDefined() == true) {
+		if (InputData.OverlapHalo.Flag == true) {
+			printf("Probes are not recorded with the halo overlapped, the sections are not at the same iteration\n");
+		}
+		else {
+			Probing = StartProbes();
+		}
+	}
+	Snapshotting = false;
+	if (SnapshotIterations > 0) {
+		if (InputData.OverlapHalo.Flag == true) {
+			printf("Snapshots are not taken with the halo overlapped, the sections are not at the same iteration\n");
+		}
+		else {
+			Snapshotting = StartSnapshots();
+		}
+	}
 
-	// Evaluate source output
-	if (nIterations < ImpulseSource.Duration) {
+	// Evaluate source output, in the process owning the source when the grid is split
+	if (Resumed == false && nIterations < ImpulseSource.Duration && ImpulseSource.X >= FirstOwnedRow() && ImpulseSource.X <= LastOwnedRow()) {
 		EvaluateSource(nIterations);
 	}
 
-	// Allocate memory for the ready event array and worker threads
-	hReadyEventArray = (HANDLE*)malloc(nThreads * sizeof(HANDLE));
-	hWorkerThreadArray = (HANDLE*)malloc(nThreads * sizeof(HANDLE));
-	BusiestThreads = (int**)malloc(nThreads*sizeof(int*));
-	Priorities = (int*)malloc(nThreads*sizeof(int));
-	int CurrentPriority = 6;
-	for (int i=0; i<MaxThreadIndex.X; i++) {
-		for (int j=0; j<MaxThreadIndex.Y; j++) {
-			for (int k=0; k<MaxThreadIndex.Z; k++) {
-				hReadyEventArray[n] = hReadyEvent[i][j][k];
-				hWorkerThreadArray[n] = hWorkerThreads[i][j][k];
-				BusiestThreads[n] = (int*)malloc(3*sizeof(int));
-				BusiestThreads[n][0] = i;
-				BusiestThreads[n][1] = j;
-				BusiestThreads[n][2] = k;
-				Priorities[n] = CurrentPriority;
-				if (n%nCores == nCores-1 && CurrentPriority) {
-					CurrentPriority--;
-				}
-				printf("Priority %d = %d\n", n, Priorities[n]);
-				n++;
-			}
-		}
+	// Allocate memory for the ready event array
+	hReadyEventArray = (HANDLE*)malloc(nWorkers * sizeof(HANDLE));
+	for (int w=0; w<nWorkers; w++) {
+		hReadyEventArray[w] = WorkerData[w].hReadyEvent;
 	}
 
 	// Wait for the workers to become ready
-	WaitForMultipleObjects(nThreads, hReadyEventArray, true, INFINITE);
+	WaitForAllObjects(nWorkers, hReadyEventArray);
+
+	// With the halo overlapped the sections synchronise with their neighbours and run to completion on their own
+	if (InputData.OverlapHalo.Flag == true) {
+		nIterations = RunOverlappedSections(hReadyEventArray);
+		Empty = true;
+	}
 
 	// Repeat the algorithm while the active set is not empty
 	while (Empty == false) {
 
-		// Tell the worker threads to scatter
-		for (int i=0; i<MaxThreadIndex.X; i++) {
-			for (int j=0; j<MaxThreadIndex.Y; j++) {
-				for (int k=0; k<MaxThreadIndex.Z; k++) {
-					SetEvent(hScatterEvent[i][j][k]);
+		// Decide whether to advance several iterations in a single pass over the active region
+		if (TemporalBlock > 1) {
+			Blocked = ChooseTemporalBlocking();
+			if (Blocked != BlockedPass) {
+				if (Blocked == true) {
+					printf("Starting temporal blocking, %d iterations per pass\n", TemporalBlock);
+				}
+				else {
+					printf("Stopping temporal blocking\n");
 				}
 			}
+			BlockedPass = Blocked;
+		}
+
+		// Share the sections between the workers from their predicted cost
+		ScheduleSections();
+		CurrentIteration = nIterations;
+
+		// Decide whether the sections copy their active junctions to a checkpoint at the end of the iteration
+		CheckpointIteration = Checkpointing == true && CheckpointDue(nIterations+1) == true;
+		if (CheckpointIteration == true) {
+			BeginCheckpoint(nIterations+1);
+		}
+
+		// Tell the worker threads to scatter
+		for (int w=0; w<nWorkers; w++) {
+			SetEvent(WorkerData[w].hScatterEvent);
 		}
 
 		// Wait for the workers to acknowledge
-		WaitForMultipleObjects(nThreads, hReadyEventArray, true, INFINITE);
+		WaitForAllObjects(nWorkers, hReadyEventArray);
+
+		// Share the faces of the slab with the neighbouring processes before connecting
+		if (DomainMember() == true) {
+			ExchangeDomainFaces(nIterations+1, ActivateDomainJunction);
+		}
 
 		// Tell the worker threads to connect
-		for (int i=0; i<MaxThreadIndex.X; i++) {
-			for (int j=0; j<MaxThreadIndex.Y; j++) {
-				for (int k=0; k<MaxThreadIndex.Z; k++) {
-					SetEvent(hConnectEvent[i][j][k]);
-				}
-			}
+		for (int w=0; w<nWorkers; w++) {
+			SetEvent(WorkerData[w].hConnectEvent);
 		}
 
 		// Wait for the workers to acknowledge
-		WaitForMultipleObjects(nThreads, hReadyEventArray, true, INFINITE);
+		WaitForAllObjects(nWorkers, hReadyEventArray);
 
-		/*for (int i=0; i<MaxThreadIndex.X; i++) {
+		// Learn the cost of each section from the time it took
+		UpdateSectionCosts();
+
+		// Accumulate the time of the busiest worker against the total, to measure the schedule
+		MaxWorkerTicks = 0;
+		for (int w=0; w<nWorkers; w++) {
+			WorkerTicks = 0;
+			for (int s=0; s<WorkerData[w].nSections; s++) {
+				WorkerTicks += WorkerData[w].Sections[s]->Ticks;
+			}
+			BusyTicks += (double)WorkerTicks;
+			MaxWorkerTicks = MAX(MaxWorkerTicks, WorkerTicks);
+		}
+		MakespanTicks += (double)MaxWorkerTicks;
+
+		// Accumulate the work of the busiest section against the total, to measure the balance of the decomposition
+		MaxJunctions = 0;
+		for (int i=0; i<MaxThreadIndex.X; i++) {
 			for (int j=0; j<MaxThreadIndex.Y; j++) {
 				for (int k=0; k<MaxThreadIndex.Z; k++) {
-					ThreadPriority = 0;
-					for (int l=0; l<nCores; l++) {
-						if (ActiveJunctions[i][j][k] > ActiveJunctions[BusiestThreads[l][0]][BusiestThreads[l][1]][BusiestThreads[l][2]]) {
-							for (int m=nCores-1; m>l; m--) {
-								BusiestThreads[m][0] = BusiestThreads[m-1][0];
-								BusiestThreads[m][1] = BusiestThreads[m-1][1];
-								BusiestThreads[m][2] = BusiestThreads[m-1][2];
-							}
-							BusiestThreads[l][0] = i;
-							BusiestThreads[l][1] = j;
-							BusiestThreads[l][2] = k;
-							if (l<MAX(nCores/2,2)) {
-								ThreadPriority = 4;
-							}
-							else {
-								ThreadPriority = 2;
-							}
-						}
-					}
-					SetThreadPriority(hWorkerThreads[i][j][k], ThreadPriority);
+					TotalLoad += ActiveJunctions[i][j][k];
+					MaxJunctions = MAX(MaxJunctions, ActiveJunctions[i][j][k]);
 				}
 			}
-		}*/
-
-		qsort(BusiestThreads, nThreads, sizeof(int*), CompareActiveJunctions);
-		for (int i=0; i<nThreads; i++) {
-			SetThreadPriority(hWorkerThreads[BusiestThreads[i][0]][BusiestThreads[i][1]][BusiestThreads[i][2]], Priorities[i]);
 		}
+		PeakLoad += MaxJunctions;
 
 		// Increment the number of iterations completed
-		nIterations++;
+		if (BlockedPass == true) {
+			nIterations += TemporalBlock;
+		}
+		else {
+			nIterations++;
+		}
 
 		// Check for empty active sets
 		Empty = true;
@@ -217,51 +424,107 @@ void MainLoop(void)
 			}
 		}
 
-		printf("Completed %d iterations\n", nIterations);
-		for (int i=0; i<MaxThreadIndex.X; i++) {
-			for (int j=0; j<MaxThreadIndex.Y; j++) {
-				for (int k=0; k<MaxThreadIndex.Z; k++) {
-					printf("\tSection (%d,%d,%d):\t%d active junctions\n", i+1, j+1, k+1, ActiveJunctions[i][j][k]);
+		// The processes sharing a grid stop together, when the coordinator has found all of them empty
+		if (DomainMember() == true) {
+			ProcessJunctions = 0;
+			for (int i=0; i<MaxThreadIndex.X; i++) {
+				for (int j=0; j<MaxThreadIndex.Y; j++) {
+					for (int k=0; k<MaxThreadIndex.Z; k++) {
+						ProcessJunctions += ActiveJunctions[i][j][k];
+					}
 				}
 			}
+			Empty = DomainIterationComplete(nIterations, ProcessJunctions);
+		}
+		else {
+			PrintSectionStatus(nIterations);
+		}
+
+		if (Probing == true) {
+			RecordProbes(nIterations);
+		}
+
+		// Copy the sampled nodes for the output thread to write, the last iteration is always written
+		if (Snapshotting == true && (Empty == true || SnapshotDue(nIterations) == true)) {
+			TakeSnapshot(nIterations);
+		}
+
+		// Hand the active junctions copied by the sections to the output thread to write while the iterations continue
+		if (CheckpointIteration == true && Empty == false) {
+			EndCheckpoint();
 		}
 	}
 
 	// Tell the worker threads to finish
-	for (int i=0; i<MaxThreadIndex.X; i++) {
-		for (int j=0; j<MaxThreadIndex.Y; j++) {
-			for (int k=0; k<MaxThreadIndex.Z; k++) {
-				SetEvent(hEndEvent[i][j][k]);
-			}
-		}
+	for (int w=0; w<nWorkers; w++) {
+		SetEvent(WorkerData[w].hEndEvent);
 	}
 
 	// Wait for the worker threads to terminate
-	WaitForMultipleObjects(nThreads, hWorkerThreadArray, true, INFINITE);
+	WaitForAllObjects(nWorkers, hWorkerThreads);
+	free(hReadyEventArray);
+
+	// Report the memory traffic between NUMA nodes
+	if (InputData.NumaReport.Flag == true) {
+		NumaTraffic *Traffic = (NumaTraffic*)malloc(nSections*sizeof(NumaTraffic));
+		n = 0;
+		for (int i=0; i<MaxThreadIndex.X; i++) {
+			for (int j=0; j<MaxThreadIndex.Y; j++) {
+				for (int k=0; k<MaxThreadIndex.Z; k++) {
+					Traffic[n++] = ThreadData[i][j][k].Traffic;
+				}
+			}
+		}
+		PrintNumaReport(Traffic, nSections);
+		free(Traffic);
+	}
 
 	// Free memory allocated to the synchronisation
 	FreeResources();
+	FreeSectorMap();
+
+	// Let the output thread finish the section status, the probes and the snapshots before the summary
+	if (Probing == true) {
+		StopProbes();
+	}
+	if (Snapshotting == true) {
+		StopSnapshots();
+	}
+	if (Checkpointing == true) {
+		CloseCheckpoint();
+		Checkpointing = false;
+	}
+	FlushOutput();
 
 	printf("Algorithm complete, took %d iterations\n", nIterations);
+	if (PeakLoad > 0) {
+		printf("Load balance across %d sections: %.1f%% parallel efficiency\n", nSections, 100*TotalLoad/(nSections*PeakLoad));
+	}
+	if (MakespanTicks > 0) {
+		printf("Schedule across %d workers: %.1f%% parallel efficiency\n", nWorkers, 100*BusyTicks/(nWorkers*MakespanTicks));
+	}
+
+	// The records still in the active sets go with the slabs of their pools
+	PrintNodePoolStats();
+	FreeNodePools();
 }
 
 
-// Secondary Thread Function
+// Secondary Thread Function, runs the sections assigned to a worker of the pool
 DWORD WINAPI WorkerThread(LPVOID *lpParam)
 {
-	ThreadData_t *Data = (ThreadData_t*)lpParam;
-	int x = Data->Index.X;
-	int y = Data->Index.Y;
-	int z = Data->Index.Z;
+	WorkerData_t *Worker = (WorkerData_t*)lpParam;
+	ThreadData_t *Data;
 	HANDLE hEventArray[3];
 	DWORD EventBuffer;
+	LARGE_INTEGER Start, Finish;
 
-	hEventArray[0] = hScatterEvent[x][y][z];
-	hEventArray[1] = hConnectEvent[x][y][z];
-	hEventArray[2] = hEndEvent[x][y][z];
+	hEventArray[0] = Worker->hScatterEvent;
+	hEventArray[1] = Worker->hConnectEvent;
+	hEventArray[2] = Worker->hEndEvent;
 
 	// Tell the main thread the worker is ready
-	SetEvent(hReadyEvent[x][y][z]);
+	SetEvent(Worker->hReadyEvent);
 
 	while (1) {
 		// Wait until a message has been posted
@@ -269,12 +532,45 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam)
 
 		switch (EventBuffer) {
 			case SCATTER_EVENT:
-				Scatter(Data);
+				// With the halo overlapped each worker runs a single section to completion
+				if (InputData.OverlapHalo.Flag == true) {
+					RunOverlapped(Worker->Sections[0]);
+				}
+				else {
+					for (int s=0; s<Worker->nSections; s++) {
+						Data = Worker->Sections[s];
+						Data->BoundaryJunctions = 0;
+						QueryPerformanceCounter(&Start);
+						if (BlockedPass == true) {
+							BlockedScatter(Data);
+						}
+						else {
+							Scatter(Data);
+						}
+						QueryPerformanceCounter(&Finish);
+						Data->Ticks = Finish.QuadPart - Start.QuadPart;
+					}
+				}
 				break;
 
 			case CONNECT_EVENT:
-				CopyNodeAdditions(Data);
-				Connect(Data);
+				for (int s=0; s<Worker->nSections; s++) {
+					Data = Worker->Sections[s];
+					QueryPerformanceCounter(&Start);
+					if (BlockedPass == true) {
+						BlockedConnect(Data);
+					}
+					else {
+						CopyNodeAdditions(Data);
+						Connect(Data);
+					}
+					FlushNodePool(Data->Pool);
+					QueryPerformanceCounter(&Finish);
+					Data->Ticks += Finish.QuadPart - Start.QuadPart;
+					if (CheckpointIteration == true) {
+						CopyCheckpointSection(Data);
+					}
+				}
 				break;
 
 			case END_EVENT:
@@ -282,21 +578,412 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam)
 				break;
 
 			default:
-				printf("Thread %d received error",x);
+				printf("Worker %d received error", Worker->Index+1);
 				Sleep(2000);
 				exit(1);
 		}
-		SetEvent(hReadyEvent[x][y][z]);
+		SetEvent(Worker->hReadyEvent);
+	}
+}
+
+
+// Predict the cost of each section for the next iteration and assign the sections to the workers, longest first to the least loaded worker.
+// A pinned section stays on the workers of the NUMA node its rows were placed on, unless that node has no worker
+void ScheduleSections(void)
+{
+	ThreadData_t *Data;
+	WorkerData_t *Target;
+	double MeanCost = 0;
+	int nMeasured = 0;
+	int n = 0;
+	int nSections = SectionWorkerCount();
+	int Section;
+
+	// Sections without a measurement yet are assumed to cost the same per junction as the others
+	for (int i=0; i<MaxThreadIndex.X; i++) {
+		for (int j=0; j<MaxThreadIndex.Y; j++) {
+			for (int k=0; k<MaxThreadIndex.Z; k++) {
+				if (ThreadData[i][j][k].CostPerNode > 0) {
+					MeanCost += ThreadData[i][j][k].CostPerNode;
+					nMeasured++;
+				}
+			}
+		}
+	}
+	MeanCost = nMeasured > 0 ? MeanCost/nMeasured : 1.0;
+
+	for (int i=0; i<MaxThreadIndex.X; i++) {
+		for (int j=0; j<MaxThreadIndex.Y; j++) {
+			for (int k=0; k<MaxThreadIndex.Z; k++) {
+				Data = &ThreadData[i][j][k];
+				Data->Workload = ActiveJunctions[i][j][k];
+				Data->PredictedCost = (Data->CostPerNode > 0 ? Data->CostPerNode : MeanCost)*(Data->Workload + BOUNDARY_WEIGHT*Data->BoundaryJunctions);
+				Schedule[n++] = Data;
+			}
+		}
+	}
+	qsort(Schedule, n, sizeof(ThreadData_t*), CompareSectionCost);
+
+	for (int w=0; w<nWorkers; w++) {
+		WorkerData[w].nSections = 0;
+		WorkerData[w].Load = 0;
+	}
+	for (int s=0; s<n; s++) {
+		Section = (Schedule[s]->Index.X*MaxThreadIndex.Y + Schedule[s]->Index.Y)*MaxThreadIndex.Z + Schedule[s]->Index.Z;
+		Target = NULL;
+		if (InputData.PinThreads.Flag == true) {
+			for (int w=0; w<nWorkers; w++) {
+				if (SameNumaNode(Section, nSections, w, nWorkers) == true && (Target == NULL || WorkerData[w].Load < Target->Load)) {
+					Target = &WorkerData[w];
+				}
+			}
+		}
+		if (Target == NULL) {
+			Target = &WorkerData[0];
+			for (int w=1; w<nWorkers; w++) {
+				if (WorkerData[w].Load < Target->Load) {
+					Target = &WorkerData[w];
+				}
+			}
+		}
+		Target->Sections[Target->nSections++] = Schedule[s];
+		Target->Load += Schedule[s]->PredictedCost;
+
+		// The traffic of the section is counted against the node of the worker running it
+		Schedule[s]->Traffic.NumaNode = WorkerNumaNode(Target->Index, nWorkers);
+	}
+}
+
+
+// Update the smoothed cost per junction of each section from the time taken by the last iteration
+void UpdateSectionCosts(void)
+{
+	ThreadData_t *Data;
+	double Work;
+	double Cost;
+
+	for (int i=0; i<MaxThreadIndex.X; i++) {
+		for (int j=0; j<MaxThreadIndex.Y; j++) {
+			for (int k=0; k<MaxThreadIndex.Z; k++) {
+				Data = &ThreadData[i][j][k];
+				Work = Data->Workload + BOUNDARY_WEIGHT*Data->BoundaryJunctions;
+				if (Work > 0) {
+					Cost = (double)Data->Ticks/Work;
+					if (Data->CostPerNode > 0) {
+						Data->CostPerNode = COST_SMOOTHING*Cost + (1-COST_SMOOTHING)*Data->CostPerNode;
+					}
+					else {
+						Data->CostPerNode = Cost;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+// Choose the number of threads in the worker pool
+int WorkerPoolSize(int nSections)
+{
+	SYSTEM_INFO SystemInfo;
+	int Size = Workers;
+
+	// Overlapped sections wait on their neighbours, so each needs a thread of its own
+	if (InputData.OverlapHalo.Flag == true) {
+		return nSections;
+	}
+
+	if (Size <= 0) {
+		GetSystemInfo(&SystemInfo);
+		Size = SystemInfo.dwNumberOfProcessors;
+	}
+
+	return MIN(Size, nSections);
+}
+
+
+// Drive the sections while they run with overlapped halos, detecting when every section has emptied. Returns the number of iterations taken
+int RunOverlappedSections(HANDLE *hReadyEventArray)
+{
+	int nIterations = 0;
+	LONG MinCompleted;
+	LONG MaxLastActive;
+	LONG Completed;
+
+	hProgressEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	StopIteration = NO_STOP_ITERATION;
+
+	// Start the sections
+	for (int w=0; w<nWorkers; w++) {
+		SetEvent(WorkerData[w].hScatterEvent);
+	}
+
+	while (StopIteration == NO_STOP_ITERATION) {
+		WaitForSingleObject(hProgressEvent, INFINITE);
+
+		// Read the iterations completed before the last active iteration, so that a section can only appear busier than it is
+		MinCompleted = NO_STOP_ITERATION;
+		MaxLastActive = -1;
+		for (int i=0; i<MaxThreadIndex.X; i++) {
+			for (int j=0; j<MaxThreadIndex.Y; j++) {
+				for (int k=0; k<MaxThreadIndex.Z; k++) {
+					Completed = ThreadData[i][j][k].Completed;
+					MinCompleted = MIN(MinCompleted, Completed);
+					MaxLastActive = MAX(MaxLastActive, ThreadData[i][j][k].LastActive);
+				}
+			}
+		}
+
+		if (MinCompleted > nIterations) {
+			nIterations = MinCompleted;
+			PrintSectionStatus(nIterations);
+		}
+
+		// Every section was empty after the slowest section's last iteration, no junction can become active again
+		if (MaxLastActive < MinCompleted) {
+			InterlockedExchange(&StopIteration, MinCompleted);
+			for (int i=0; i<MaxThreadIndex.X; i++) {
+				for (int j=0; j<MaxThreadIndex.Y; j++) {
+					for (int k=0; k<MaxThreadIndex.Z; k++) {
+						SetEvent(hWakeEvent[i][j][k]);
+					}
+				}
+			}
+		}
 	}
+
+	// Wait for the sections to stop
+	WaitForAllObjects(nWorkers, hReadyEventArray);
+	CloseHandle(hProgressEvent);
+
+	return StopIteration;
+}
+
+
+// Run the algorithm on a section until the main thread stops it, synchronising only with the face neighbours. Boundary junctions are scattered and connected first, so the neighbours can use them while the interior is processed
+void RunOverlapped(ThreadData_t *Data)
+{
+	ThreadData_t *Neighbours[6];
+	ActiveNode *InteriorHead;
+	int nNeighbours = 0;
+	int x = Data->Index.X;
+	int y = Data->Index.Y;
+	int z = Data->Index.Z;
+
+	if (x > 0) {
+		Neighbours[nNeighbours++] = &ThreadData[x-1][y][z];
+	}
+	if (x < MaxThreadIndex.X-1) {
+		Neighbours[nNeighbours++] = &ThreadData[x+1][y][z];
+	}
+	if (y > 0) {
+		Neighbours[nNeighbours++] = &ThreadData[x][y-1][z];
+	}
+	if (y < MaxThreadIndex.Y-1) {
+		Neighbours[nNeighbours++] = &ThreadData[x][y+1][z];
+	}
+	if (z > 0) {
+		Neighbours[nNeighbours++] = &ThreadData[x][y][z-1];
+	}
+	if (z < MaxThreadIndex.Z-1) {
+		Neighbours[nNeighbours++] = &ThreadData[x][y][z+1];
+	}
+
+	for (LONG Iteration = 1; ; Iteration++) {
+		Data->BoundaryJunctions = 0;
+
+		// The neighbours must have connected to the boundary outputs of the previous iteration before they are overwritten
+		if (WaitForNeighbours(Data, Neighbours, nNeighbours, false, Iteration-1) == false) {
+			break;
+		}
+
+		// Scatter and publish the boundary junctions, then scatter the interior. Interior junctions added by the boundary are not scattered this iteration
+		InteriorHead = ActiveSet[x][y][z];
+		ScatterList(Data, BoundarySet[x][y][z]);
+		InterlockedExchange(&Data->ScatterCount, Iteration);
+		WakeNeighbours(Neighbours, nNeighbours);
+		ScatterList(Data, InteriorHead);
+
+		// Connect the boundary junctions once the neighbours have published theirs, then connect the interior
+		if (WaitForNeighbours(Data, Neighbours, nNeighbours, true, Iteration) == false) {
+			break;
+		}
+		CopyNodeAdditions(Data);
+		ConnectList(Data, &BoundarySet[x][y][z]);
+		InterlockedExchange(&Data->ConnectCount, Iteration);
+		WakeNeighbours(Neighbours, nNeighbours);
+		ConnectList(Data, &ActiveSet[x][y][z]);
+		FlushNodePool(Data->Pool);
+
+		// Report the progress to the main thread
+		if (ActiveSet[x][y][z] != NULL || BoundarySet[x][y][z] != NULL) {
+			InterlockedExchange(&Data->LastActive, Iteration);
+		}
+		InterlockedExchange(&Data->Completed, Iteration);
+		SetEvent(hProgressEvent);
+
+		if (Iteration >= StopIteration) {
+			break;
+		}
+	}
+}
+
+
+// Wait until every face neighbour of a section has reached an iteration of the scatter or connect phase. Returns false if the algorithm has stopped
+bool WaitForNeighbours(ThreadData_t *Data, ThreadData_t **Neighbours, int nNeighbours, bool ScatterPhase, LONG Iteration)
+{
+	bool Ready;
+
+	while (1) {
+		Ready = true;
+		for (int i=0; i<nNeighbours; i++) {
+			if ((ScatterPhase == true ? Neighbours[i]->ScatterCount : Neighbours[i]->ConnectCount) < Iteration) {
+				Ready = false;
+			}
+		}
+		if (Ready == true) {
+			return true;
+		}
+
+		// A section ahead of the stop iteration may be waiting on a neighbour that has already stopped
+		if (Data->Completed >= StopIteration) {
+			return false;
+		}
+
+		WaitForSingleObject(hWakeEvent[Data->Index.X][Data->Index.Y][Data->Index.Z], INFINITE);
+	}
+}
+
+
+// Wake the face neighbours of a section after it has published its boundary
+void WakeNeighbours(ThreadData_t **Neighbours, int nNeighbours)
+{
+	for (int i=0; i<nNeighbours; i++) {
+		SetEvent(hWakeEvent[Neighbours[i]->Index.X][Neighbours[i]->Index.Y][Neighbours[i]->Index.Z]);
+	}
+}
+
+
+// Add a junction to the active set of a section, keeping the boundary junctions separate when the halo is overlapped
+void InsertActiveJunction(ThreadData_t *Data, ActiveNode *NewNode)
+{
+	int xIndex = Data->Index.X;
+	int yIndex = Data->Index.Y;
+	int zIndex = Data->Index.Z;
+
+	if (InputData.OverlapHalo.Flag == true && 
+		(NewNode->X == Data->xMin || NewNode->X == Data->xMax || NewNode->Y == Data->yMin || NewNode->Y == Data->yMax || NewNode->Z == Data->zMin || NewNode->Z == Data->zMax)) 
+	{
+		NewNode->NextActiveNode = BoundarySet[xIndex][yIndex][zIndex];
+		BoundarySet[xIndex][yIndex][zIndex] = NewNode;
+	}
+	else {
+		NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
+		ActiveSet[xIndex][yIndex][zIndex] = NewNode;
+	}
+	ActiveJunctions[xIndex][yIndex][zIndex]++;
+}
+
+
+// Pass a junction to the sector owning it with the radial decomposition, the sending section has its own list so there is a single writer
+void AddSectorJunction(ThreadData_t *Data, int x, int y, int z)
+{
+	ActiveNode *NewNode;
+	int Owner = SectorMap[x][y];
+
+	NewNode = AddJunctionToSet(Data->Pool, x, y, z, false);
+	NewNode->NextActiveNode = NodeAdditions[Owner][0][0][Data->Index.X];
+	NodeAdditions[Owner][0][0][Data->Index.X] = NewNode;
+	Data->BoundaryJunctions++;
+}
+
+
+// Add a junction on a face of the slab that the neighbouring process has reached to the section containing it
+void ActivateDomainJunction(int x, int y, int z)
+{
+	ThreadData_t *Data;
+	int Section;
+
+	if (Grid[x][y][z].Active == false && Grid[x][y][z].PropagateFlag == true) {
+		Section = SectionWorker(x, y, z);
+		Data = &ThreadData[Section/(MaxThreadIndex.Y*MaxThreadIndex.Z)][(Section/MaxThreadIndex.Z)%MaxThreadIndex.Y][Section%MaxThreadIndex.Z];
+		InsertActiveJunction(Data, AddJunctionToSet(Data->Pool, x, y, z, true));
+		Data->BoundaryJunctions++;
+	}
+}
+
+
+// Add a junction that was active when the checkpoint being resumed was taken to the section containing it
+void ActivateCheckpointJunction(int x, int y, int z)
+{
+	ThreadData_t *Data;
+	int Section;
+
+	Section = SectionWorker(x, y, z);
+	Data = &ThreadData[Section/(MaxThreadIndex.Y*MaxThreadIndex.Z)][(Section/MaxThreadIndex.Z)%MaxThreadIndex.Y][Section%MaxThreadIndex.Z];
+	InsertActiveJunction(Data, AddJunctionToSet(Data->Pool, x, y, z, true));
+}
+
+
+// Copy the state of the active junctions of a section to the checkpoint, by the worker running the section once it has connected
+void CopyCheckpointSection(ThreadData_t *Data)
+{
+	for (ActiveNode *NodePtr = ActiveSet[Data->Index.X][Data->Index.Y][Data->Index.Z]; NodePtr != NULL; NodePtr = NodePtr->NextActiveNode) {
+		AddCheckpointJunction(Data->Pool->Index, NodePtr->X, NodePtr->Y, NodePtr->Z);
+	}
+	EndCheckpointSection(Data->Pool->Index);
+}
+
+
+// Print the number of active junctions in each section, by handing a copy to the output thread. The status of an iteration is
+// dropped rather than waiting if the output thread has fallen behind
+void PrintSectionStatus(int nIterations)
+{
+	OutputRecord *Record;
+	int n = 0;
+
+	Record = ReserveOutputRecord(StatusQueue, false);
+	if (Record == NULL) {
+		return;
+	}
+
+	Record->Type = OUTPUT_SECTION_STATUS;
+	Record->Iteration = nIterations;
+	Record->Shape[0] = MaxThreadIndex.X;
+	Record->Shape[1] = MaxThreadIndex.Y;
+	Record->Shape[2] = MaxThreadIndex.Z;
+	for (int i=0; i<MaxThreadIndex.X; i++) {
+		for (int j=0; j<MaxThreadIndex.Y; j++) {
+			for (int k=0; k<MaxThreadIndex.Z; k++) {
+				Record->Values[n++] = ActiveJunctions[i][j][k];
+			}
+		}
+	}
+	Record->nValues = n;
+	PostOutputRecord(StatusQueue);
 }
 
 
 // Single iteration of the TLM algorithm scatter sequence
 void Scatter(ThreadData_t *Data) 
+{
+	// Reset the bounds of the active junctions
+	Data->ActiveRegion.xMin = xSize;
+	Data->ActiveRegion.xMax = -1;
+	Data->ActiveRegion.yMin = ySize;
+	Data->ActiveRegion.yMax = -1;
+	Data->ActiveRegion.zMin = zSize;
+	Data->ActiveRegion.zMax = -1;
+
+	ScatterList(Data, ActiveSet[Data->Index.X][Data->Index.Y][Data->Index.Z]);
+}
+
+
+// Scatter the junctions of a list, starting from the node given. Junctions added to the head of the list are not scattered until the next iteration
+void ScatterList(ThreadData_t *Data, ActiveNode *CurrentNode) 
 {
 	double Value;			// Temporary node value
 	Node *NodeReference;	// Temporary node reference
-	ActiveNode *CurrentNode;
 	ActiveNode *NewNode;
 	int x, y, z;
 	int xIndex = Data->Index.X;
@@ -309,15 +996,26 @@ void Scatter(ThreadData_t *Data)
 	int zMin = Data->zMin;
 	int zMax = Data->zMax;
 
-	// Setup the current node pointer
-	CurrentNode = ActiveSet[xIndex][yIndex][zIndex];
-
 	// Scatter phase, compute the junction outputs for all of the junctions in the active set
 	while (CurrentNode != NULL) {
 		x = CurrentNode->X;
 		y = CurrentNode->Y;
 		z = CurrentNode->Z;
 
+		// Track the bounds of the active junctions for temporal blocking
+		if (TemporalBlock > 1) {
+			Data->ActiveRegion.xMin = MIN(Data->ActiveRegion.xMin, x);
+			Data->ActiveRegion.xMax = MAX(Data->ActiveRegion.xMax, x);
+			Data->ActiveRegion.yMin = MIN(Data->ActiveRegion.yMin, y);
+			Data->ActiveRegion.yMax = MAX(Data->ActiveRegion.yMax, y);
+			Data->ActiveRegion.zMin = MIN(Data->ActiveRegion.zMin, z);
+			Data->ActiveRegion.zMax = MAX(Data->ActiveRegion.zMax, z);
+		}
+
+		if (NUMA_STATISTICS && InputData.NumaReport.Flag == true) {
+			RecordRowAccess(&Data->Traffic, x, y);
+		}
+
 		NodeReference = &Grid[x][y][z];
 		Value = NodeReference->V/3;
 		NodeReference->VxpOut = Value - NodeReference->VxpIn;
@@ -332,17 +1030,28 @@ void Scatter(ThreadData_t *Data)
 		if (x < (xSize-1)) {
 			if (x == xMax) {
 				if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x+1,y,z, false);
-					NewNode->NextActiveNode = NodeAdditions[xIndex+1][yIndex][zIndex][0];
-					NodeAdditions[xIndex+1][yIndex][zIndex][0] = NewNode;
+					// The last section of a slab hands the junction to the neighbouring process
+					if (xIndex == MaxThreadIndex.X-1) {
+						MarkDomainFrontier(DOMAIN_XP, y, z);
+					}
+					else {
+						NewNode = AddJunctionToSet(Data->Pool, x+1,y,z, false);
+						NewNode->NextActiveNode = NodeAdditions[xIndex+1][yIndex][zIndex][0];
+						NodeAdditions[xIndex+1][yIndex][zIndex][0] = NewNode;
+					}
+					Data->BoundaryJunctions++;
 				}
 			}
 			else {
 				if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x+1,y,z, true);
-					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
-					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
-					ActiveJunctions[xIndex][yIndex][zIndex]++;
+					// With the radial decomposition a neighbouring column may belong to another sector
+					if (SectorMap != NULL && SectorMap[x+1][y] != xIndex) {
+						AddSectorJunction(Data, x+1, y, z);
+					}
+					else {
+						NewNode = AddJunctionToSet(Data->Pool, x+1,y,z, true);
+						InsertActiveJunction(Data, NewNode);
+					}
 				}
 			}
 		
@@ -352,17 +1061,28 @@ void Scatter(ThreadData_t *Data)
 		if (x > 0) {
 			if (x == xMin) {
 				if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x-1,y,z, false);
-					NewNode->NextActiveNode = NodeAdditions[xIndex-1][yIndex][zIndex][1];
-					NodeAdditions[xIndex-1][yIndex][zIndex][1] = NewNode;
+					// The first section of a slab hands the junction to the neighbouring process
+					if (xIndex == 0) {
+						MarkDomainFrontier(DOMAIN_XN, y, z);
+					}
+					else {
+						NewNode = AddJunctionToSet(Data->Pool, x-1,y,z, false);
+						NewNode->NextActiveNode = NodeAdditions[xIndex-1][yIndex][zIndex][1];
+						NodeAdditions[xIndex-1][yIndex][zIndex][1] = NewNode;
+					}
+					Data->BoundaryJunctions++;
 				}
 			}
 			else {
 				if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x-1,y,z, true);
-					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
-					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
-					ActiveJunctions[xIndex][yIndex][zIndex]++;
+					// With the radial decomposition a neighbouring column may belong to another sector
+					if (SectorMap != NULL && SectorMap[x-1][y] != xIndex) {
+						AddSectorJunction(Data, x-1, y, z);
+					}
+					else {
+						NewNode = AddJunctionToSet(Data->Pool, x-1,y,z, true);
+						InsertActiveJunction(Data, NewNode);
+					}
 				}
 			}
 		}
@@ -371,17 +1091,22 @@ void Scatter(ThreadData_t *Data)
 		if (y < (ySize - 1)) {
 			if (y == yMax) {
 				if (Grid[x][y+1][z].Active == false && Grid[x][y+1][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y+1,z,false);
+					NewNode = AddJunctionToSet(Data->Pool, x,y+1,z,false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex][yIndex+1][zIndex][2];
 					NodeAdditions[xIndex][yIndex+1][zIndex][2] = NewNode;
+					Data->BoundaryJunctions++;
 				}				
 			}
 			else {
 				if (Grid[x][y+1][z].Active == false && Grid[x][y+1][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y+1,z, true);
-					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
-					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
-					ActiveJunctions[xIndex][yIndex][zIndex]++;
+					// With the radial decomposition a neighbouring column may belong to another sector
+					if (SectorMap != NULL && SectorMap[x][y+1] != xIndex) {
+						AddSectorJunction(Data, x, y+1, z);
+					}
+					else {
+						NewNode = AddJunctionToSet(Data->Pool, x,y+1,z, true);
+						InsertActiveJunction(Data, NewNode);
+					}
 				}
 			}
 		}
@@ -390,17 +1115,22 @@ void Scatter(ThreadData_t *Data)
 		if (y > 0) {
 			if (y == yMin) {
 				if (Grid[x][y-1][z].Active == false && Grid[x][y-1][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y-1,z, false);
+					NewNode = AddJunctionToSet(Data->Pool, x,y-1,z, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex][yIndex-1][zIndex][3];
 					NodeAdditions[xIndex][yIndex-1][zIndex][3] = NewNode;
+					Data->BoundaryJunctions++;
 				}
 			}
 			else {
 				if (Grid[x][y-1][z].Active == false && Grid[x][y-1][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y-1,z, true);
-					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
-					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
-					ActiveJunctions[xIndex][yIndex][zIndex]++;
+					// With the radial decomposition a neighbouring column may belong to another sector
+					if (SectorMap != NULL && SectorMap[x][y-1] != xIndex) {
+						AddSectorJunction(Data, x, y-1, z);
+					}
+					else {
+						NewNode = AddJunctionToSet(Data->Pool, x,y-1,z, true);
+						InsertActiveJunction(Data, NewNode);
+					}
 				}
 			}
 		}
@@ -408,17 +1138,16 @@ void Scatter(ThreadData_t *Data)
 		if (z < (zSize - 1)) {
 			if (z == zMax) {
 				if (Grid[x][y][z+1].Active == false && Grid[x][y][z+1].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y,z+1, false);
+					NewNode = AddJunctionToSet(Data->Pool, x,y,z+1, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex][yIndex][zIndex+1][4];
 					NodeAdditions[xIndex][yIndex][zIndex+1][4] = NewNode;
+					Data->BoundaryJunctions++;
 				}
 			}
 			else {
 				if (Grid[x][y][z+1].Active == false && Grid[x][y][z+1].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y,z+1, true);
-					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
-					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
-					ActiveJunctions[xIndex][yIndex][zIndex]++;
+					NewNode = AddJunctionToSet(Data->Pool, x,y,z+1, true);
+					InsertActiveJunction(Data, NewNode);
 				}
 			}
 		}
@@ -426,17 +1155,16 @@ void Scatter(ThreadData_t *Data)
 		if (z > 0) {
 			if (z == zMin) {
 				if (Grid[x][y][z-1].Active == false && Grid[x][y][z-1].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y,z-1, false);
+					NewNode = AddJunctionToSet(Data->Pool, x,y,z-1, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex][yIndex][zIndex-1][5];
 					NodeAdditions[xIndex][yIndex][zIndex-1][5] = NewNode;
+					Data->BoundaryJunctions++;
 				}
 			}
 			else {
 				if (Grid[x][y][z-1].Active == false && Grid[x][y][z-1].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y,z-1, true);
-					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
-					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
-					ActiveJunctions[xIndex][yIndex][zIndex]++;
+					NewNode = AddJunctionToSet(Data->Pool, x,y,z-1, true);
+					InsertActiveJunction(Data, NewNode);
 				}
 			}
 		}
@@ -448,6 +1176,13 @@ void Scatter(ThreadData_t *Data)
 
 // Single iteration of the TLM algorithm connent sequence
 void Connect(ThreadData_t *Data) 
+{
+	ConnectList(Data, &ActiveSet[Data->Index.X][Data->Index.Y][Data->Index.Z]);
+}
+
+
+// Connect the junctions of a list, removing those that fall below the thresholds
+void ConnectList(ThreadData_t *Data, ActiveNode **ListHead) 
 {
 	double Value;			// Temporary node value
 	double AvgEnergy;		// Average energy over two iterations
@@ -460,9 +1195,9 @@ void Connect(ThreadData_t *Data)
 
 	int x, y, z;
 
-	// Connect phase, compute the junction inputs for all of the junctions in the active set
+	// Connect phase, compute the junction inputs for all of the junctions in the list
 	PreviousNode = NULL;
-	CurrentNode = ActiveSet[xIndex][yIndex][zIndex];
+	CurrentNode = *ListHead;
 
 	while (CurrentNode != NULL) {
 
@@ -472,6 +1207,23 @@ void Connect(ThreadData_t *Data)
 		z = CurrentNode->Z;
 		NodeReference = &Grid[x][y][z];
 
+		// Record the rows of nodes read by the connection
+		if (NUMA_STATISTICS && InputData.NumaReport.Flag == true) {
+			RecordRowAccess(&Data->Traffic, x, y);
+			if (x < (xSize-1)) {
+				RecordRowAccess(&Data->Traffic, x+1, y);
+			}
+			if (x > 0) {
+				RecordRowAccess(&Data->Traffic, x-1, y);
+			}
+			if (y < (ySize-1)) {
+				RecordRowAccess(&Data->Traffic, x, y+1);
+			}
+			if (y > 0) {
+				RecordRowAccess(&Data->Traffic, x, y-1);
+			}
+		}
+
 		// Check if the node is a material or grid boundary, if so then incorporate transmission and reflection coefficients
 		if (Grid[x][y][z].RT == NULL) {
 			if (x < (xSize-1)) {
@@ -555,8 +1307,8 @@ void Connect(ThreadData_t *Data)
 				NodeReference->VzpIn +
 				NodeReference->VznIn;
 
-		// Compute the average energy over the previous two node voltages
-		AvgEnergy = SQUARE(Value) + SQUARE(Grid[x][y][z].V);
+		// Compute the average energy over the previous two node voltages, as the observers built in measure it
+		AvgEnergy = RemovalEnergy(NodeReference, Value);
 		
 		// Add instantaneous energy to the total energy at this node
 		Grid[x][y][z].Epulse += SQUARE(Value);
@@ -565,18 +1317,21 @@ void Connect(ThreadData_t *Data)
 		if (Grid[x][y][z].Epulse > Grid[x][y][z].Emax) {
 			Grid[x][y][z].Emax = Grid[x][y][z].Epulse;
 		}
+
+		// Update the observers built in, the connect step gives the voltages of the next iteration
+		ObserveJunction(NodeReference, Value, CurrentIteration+1);
 		
 		// Assign to the node
 		Grid[x][y][z].V = Value;
 
-		if (AvgEnergy < AbsoluteThreshold || AvgEnergy < NodeReference->Emax*RelativeThreshold) {
-			CurrentNode = RemoveJunctionFromSet(x,y,z,CurrentNode);
+		if (AvgEnergy < AbsoluteThreshold || AvgEnergy < RemovalReference(NodeReference)*RelativeEnergyThreshold) {
+			CurrentNode = RemoveJunctionFromSet(Data->Pool, x,y,z,CurrentNode);
 			ActiveJunctions[xIndex][yIndex][zIndex]--;
 			if (PreviousNode != NULL) {
 				PreviousNode->NextActiveNode = CurrentNode;
 			}
 			else {
-				ActiveSet[xIndex][yIndex][zIndex] = CurrentNode;
+				*ListHead = CurrentNode;
 			}
 		}
 		else {
@@ -588,6 +1343,361 @@ void Connect(ThreadData_t *Data)
 }
 
 
+// Decide whether the next pass should be temporally blocked, and if so find the region of the grid it must advance
+bool ChooseTemporalBlocking(void)
+{
+	Region_t Region = {xSize, -1, ySize, -1, zSize, -1};
+	double Volume;
+	int Total = 0;
+	int Margin = TemporalBlock + 1;
+
+	// Find the bounds of all of the active junctions
+	for (int i=0; i<MaxThreadIndex.X; i++) {
+		for (int j=0; j<MaxThreadIndex.Y; j++) {
+			for (int k=0; k<MaxThreadIndex.Z; k++) {
+				if (ActiveJunctions[i][j][k] > 0) {
+					Region.xMin = MIN(Region.xMin, ThreadData[i][j][k].ActiveRegion.xMin);
+					Region.xMax = MAX(Region.xMax, ThreadData[i][j][k].ActiveRegion.xMax);
+					Region.yMin = MIN(Region.yMin, ThreadData[i][j][k].ActiveRegion.yMin);
+					Region.yMax = MAX(Region.yMax, ThreadData[i][j][k].ActiveRegion.yMax);
+					Region.zMin = MIN(Region.zMin, ThreadData[i][j][k].ActiveRegion.zMin);
+					Region.zMax = MAX(Region.zMax, ThreadData[i][j][k].ActiveRegion.zMax);
+					Total += ActiveJunctions[i][j][k];
+				}
+			}
+		}
+	}
+	if (Total == 0 || Region.xMin > Region.xMax || Region.yMin > Region.yMax || Region.zMin > Region.zMax) {
+		return false;
+	}
+
+	// The bounds were found before the last connection, so allow one node for junctions added since, plus one for each iteration of the pass
+	BlockRegion.xMin = MAX(Region.xMin - Margin, 0);
+	BlockRegion.xMax = MIN(Region.xMax + Margin, xSize-1);
+	BlockRegion.yMin = MAX(Region.yMin - Margin, 0);
+	BlockRegion.yMax = MIN(Region.yMax + Margin, ySize-1);
+	BlockRegion.zMin = MAX(Region.zMin - Margin, 0);
+	BlockRegion.zMax = MIN(Region.zMax + Margin, zSize-1);
+
+	// Only block when most of the region is active, otherwise the event based algorithm does less work
+	Volume = (double)(BlockRegion.xMax-BlockRegion.xMin+1)*(BlockRegion.yMax-BlockRegion.yMin+1)*(BlockRegion.zMax-BlockRegion.zMin+1);
+
+	return (Total >= TemporalBlockDensity*Volume);
+}
+
+
+// First half of a temporally blocked pass, advance the section's part of the block region by several iterations without writing to the grid
+void BlockedScatter(ThreadData_t *Data)
+{
+	Region_t *Region = &Data->BlockRegion;
+	SIZE_T Nodes;
+
+	// Find the part of the block region inside this section
+	Region->xMin = MAX(Data->xMin, BlockRegion.xMin);
+	Region->xMax = MIN(Data->xMax, BlockRegion.xMax);
+	Region->yMin = MAX(Data->yMin, BlockRegion.yMin);
+	Region->yMax = MIN(Data->yMax, BlockRegion.yMax);
+	Region->zMin = MAX(Data->zMin, BlockRegion.zMin);
+	Region->zMax = MIN(Data->zMax, BlockRegion.zMax);
+
+	Data->BlockAdvanced = false;
+	if (Region->xMin > Region->xMax || Region->yMin > Region->yMax || Region->zMin > Region->zMax) {
+		return;
+	}
+
+	// The results cannot be written to the grid until every section has read the halos of its tiles, so they are held until
+	// the connect, a whole tile to each block of the buffer. The buffer is kept between passes and only grows with the region
+	Nodes = (SIZE_T)((Region->xMax-Region->xMin)/TEMPORAL_TILE+1)*((Region->yMax-Region->yMin)/TEMPORAL_TILE+1)*((Region->zMax-Region->zMin)/TEMPORAL_TILE+1)*TEMPORAL_TILE*TEMPORAL_TILE*TEMPORAL_TILE;
+	if (Nodes > Data->BlockCapacity) {
+		free(Data->BlockResult);
+		Data->BlockResult = (BlockNode*)malloc(Nodes*sizeof(BlockNode));
+		Data->BlockCapacity = Nodes;
+	}
+	Data->BlockAdvanced = true;
+
+	// Advance each tile of the region in turn
+	for (int x0 = Region->xMin; x0 <= Region->xMax; x0 += TEMPORAL_TILE) {
+		for (int y0 = Region->yMin; y0 <= Region->yMax; y0 += TEMPORAL_TILE) {
+			for (int z0 = Region->zMin; z0 <= Region->zMax; z0 += TEMPORAL_TILE) {
+				AdvanceTile(Data, x0, MIN(x0+TEMPORAL_TILE-1, Region->xMax), y0, MIN(y0+TEMPORAL_TILE-1, Region->yMax), z0, MIN(z0+TEMPORAL_TILE-1, Region->zMax));
+			}
+		}
+	}
+}
+
+
+// Advance a tile by several iterations in a working copy, the region of valid nodes shrinks by one node each iteration so a halo of one node per iteration is copied
+void AdvanceTile(ThreadData_t *Data, int x0, int x1, int y0, int y1, int z0, int z1)
+{
+	double Value;			// Temporary node value
+	double AvgEnergy;		// Average energy over two iterations
+	Node *NodeReference;	// Temporary node reference
+	Node *Tile = Data->Tile;
+	Region_t *Region = &Data->BlockRegion;
+	BlockNode *Result;
+	int Steps = TemporalBlock;
+	int xStride, yStride;
+	int xStart, xEnd, yStart, yEnd, zStart, zEnd;
+
+	// Bounds of the tile including its halo
+	int xMin = MAX(x0-Steps, 0);
+	int xMax = MIN(x1+Steps, xSize-1);
+	int yMin = MAX(y0-Steps, 0);
+	int yMax = MIN(y1+Steps, ySize-1);
+	int zMin = MAX(z0-Steps, 0);
+	int zMax = MIN(z1+Steps, zSize-1);
+
+	yStride = zMax-zMin+1;
+	xStride = (yMax-yMin+1)*yStride;
+
+	// Copy the tile from the grid
+	for (int x = xMin; x <= xMax; x++) {
+		for (int y = yMin; y <= yMax; y++) {
+			memcpy(&Tile[(x-xMin)*xStride + (y-yMin)*yStride], &Grid[x][y][zMin], yStride*sizeof(Node));
+		}
+	}
+
+	for (int n = 1; n <= Steps; n++) {
+
+		// Scatter the nodes that were valid after the previous iteration
+		xStart = MAX(x0-(Steps-n+1), xMin);
+		xEnd = MIN(x1+(Steps-n+1), xMax);
+		yStart = MAX(y0-(Steps-n+1), yMin);
+		yEnd = MIN(y1+(Steps-n+1), yMax);
+		zStart = MAX(z0-(Steps-n+1), zMin);
+		zEnd = MIN(z1+(Steps-n+1), zMax);
+
+		for (int x = xStart; x <= xEnd; x++) {
+			for (int y = yStart; y <= yEnd; y++) {
+				NodeReference = &Tile[(x-xMin)*xStride + (y-yMin)*yStride + (zStart-zMin)];
+				for (int z = zStart; z <= zEnd; z++, NodeReference++) {
+					if (NodeReference->PropagateFlag == true || NodeReference->Active == true) {
+						Value = NodeReference->V/3;
+						NodeReference->VxpOut = Value - NodeReference->VxpIn;
+						NodeReference->VxnOut = Value - NodeReference->VxnIn;
+						NodeReference->VypOut = Value - NodeReference->VypIn;
+						NodeReference->VynOut = Value - NodeReference->VynIn;
+						NodeReference->VzpOut = Value - NodeReference->VzpIn;
+						NodeReference->VznOut = Value - NodeReference->VznIn;
+					}
+				}
+			}
+		}
+
+		// Connect the nodes that are still valid after this iteration
+		xStart = MAX(x0-(Steps-n), xMin);
+		xEnd = MIN(x1+(Steps-n), xMax);
+		yStart = MAX(y0-(Steps-n), yMin);
+		yEnd = MIN(y1+(Steps-n), yMax);
+		zStart = MAX(z0-(Steps-n), zMin);
+		zEnd = MIN(z1+(Steps-n), zMax);
+
+		for (int x = xStart; x <= xEnd; x++) {
+			for (int y = yStart; y <= yEnd; y++) {
+				NodeReference = &Tile[(x-xMin)*xStride + (y-yMin)*yStride + (zStart-zMin)];
+				for (int z = zStart; z <= zEnd; z++, NodeReference++) {
+					AvgEnergy = 0;
+					if (NodeReference->PropagateFlag == true || NodeReference->Active == true) {
+						// Same connection rules as the event based algorithm
+						if (NodeReference->RT == NULL) {
+							if (x < (xSize-1)) {
+								NodeReference->VxpIn = NodeReference[xStride].VxnOut;
+							}
+							if (x > 0) {
+								NodeReference->VxnIn = NodeReference[-xStride].VxpOut;
+							}
+							else {
+								NodeReference->VxnIn = 0;
+							}
+							if (y < (ySize-1)) {
+								NodeReference->VypIn = NodeReference[yStride].VynOut;
+							}
+							else {
+								NodeReference->VypIn = 0;
+							}
+							if (y > 0) {
+								NodeReference->VynIn = NodeReference[-yStride].VypOut;
+							}
+							else {
+								NodeReference->VynIn = 0;
+							}
+							if (z < (zSize-1)) {
+								NodeReference->VzpIn = NodeReference[1].VznOut;
+							}
+							else {
+								NodeReference->VzpIn = 0;
+							}
+							if (z > 0) {
+								NodeReference->VznIn = NodeReference[-1].VzpOut;
+							}
+							else {
+								NodeReference->VznIn = 0;
+							}
+						}
+						else {
+							RTCoeffs *RT = NodeReference->RT;
+
+							NodeReference->VxpIn = RT->Rxp*NodeReference->VxpOut;
+							if (x < (xSize-1)) {
+								NodeReference->VxpIn += NodeReference[xStride].VxnOut * RT->Txp;
+							}
+							NodeReference->VxnIn = RT->Rxn*NodeReference->VxnOut;
+							if (x > 0) {
+								NodeReference->VxnIn += NodeReference[-xStride].VxpOut * RT->Txn;
+							}
+							NodeReference->VypIn = RT->Ryp*NodeReference->VypOut;
+							if (y < (ySize-1)) {
+								NodeReference->VypIn += NodeReference[yStride].VynOut * RT->Typ;
+							}
+							NodeReference->VynIn = RT->Ryn*NodeReference->VynOut;
+							if (y > 0) {
+								NodeReference->VynIn += NodeReference[-yStride].VypOut * RT->Tyn;
+							}
+							NodeReference->VzpIn = RT->Rzp*NodeReference->VzpOut;
+							if (z < (zSize-1)) {
+								NodeReference->VzpIn += NodeReference[1].VznOut * RT->Tzp;
+							}
+							NodeReference->VznIn = RT->Rzn*NodeReference->VznOut;
+							if (z > 0) {
+								NodeReference->VznIn += NodeReference[-1].VzpOut * RT->Tzn;
+							}
+						}
+
+						// Compute the state of the node
+						Value = NodeReference->VxpIn + 
+								NodeReference->VxnIn +
+								NodeReference->VypIn +
+								NodeReference->VynIn +
+								NodeReference->VzpIn +
+								NodeReference->VznIn;
+
+						AvgEnergy = SQUARE(Value) + SQUARE(NodeReference->V);
+						NodeReference->Epulse += SQUARE(Value);
+						if (NodeReference->Epulse > NodeReference->Emax) {
+							NodeReference->Emax = NodeReference->Epulse;
+						}
+						NodeReference->V = Value;
+					}
+
+					// After the last iteration only the tile itself remains, store its state
+					if (n == Steps) {
+						Result = &Data->BlockResult[BlockResultIndex(Region, x, y, z)];
+						Result->V = NodeReference->V;
+						Result->VxpIn = NodeReference->VxpIn;
+						Result->VxnIn = NodeReference->VxnIn;
+						Result->VypIn = NodeReference->VypIn;
+						Result->VynIn = NodeReference->VynIn;
+						Result->VzpIn = NodeReference->VzpIn;
+						Result->VznIn = NodeReference->VznIn;
+						Result->Epulse = NodeReference->Epulse;
+						Result->Emax = NodeReference->Emax;
+						Result->AvgEnergy = AvgEnergy;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+// Return the position of a node of the block region in the block result. The results of each tile lie together, so a tile
+// writes its own block of the buffer while it is advanced
+SIZE_T BlockResultIndex(Region_t *Region, int x, int y, int z)
+{
+	int i = x-Region->xMin;
+	int j = y-Region->yMin;
+	int k = z-Region->zMin;
+	SIZE_T Tile = ((SIZE_T)(i/TEMPORAL_TILE)*((Region->yMax-Region->yMin)/TEMPORAL_TILE+1) + j/TEMPORAL_TILE)*((Region->zMax-Region->zMin)/TEMPORAL_TILE+1) + k/TEMPORAL_TILE;
+
+	return Tile*TEMPORAL_TILE*TEMPORAL_TILE*TEMPORAL_TILE + ((i%TEMPORAL_TILE)*TEMPORAL_TILE + j%TEMPORAL_TILE)*TEMPORAL_TILE + k%TEMPORAL_TILE;
+}
+
+
+// Second half of a temporally blocked pass, write the advanced region back to the grid and rebuild the section's active set from the thresholds
+void BlockedConnect(ThreadData_t *Data)
+{
+	ActiveNode *CurrentNode;
+	ActiveNode *NewNode;
+	Node *NodeReference;
+	BlockNode *Result;
+	Region_t *Region = &Data->BlockRegion;
+	int xIndex = Data->Index.X;
+	int yIndex = Data->Index.Y;
+	int zIndex = Data->Index.Z;
+
+	// Every active junction of the section lies within the block region, so the set can be rebuilt from scratch
+	while (ActiveSet[xIndex][yIndex][zIndex] != NULL) {
+		CurrentNode = ActiveSet[xIndex][yIndex][zIndex];
+		ActiveSet[xIndex][yIndex][zIndex] = CurrentNode->NextActiveNode;
+		FreeActiveNode(Data->Pool, CurrentNode);
+	}
+	ActiveJunctions[xIndex][yIndex][zIndex] = 0;
+
+	Data->ActiveRegion.xMin = xSize;
+	Data->ActiveRegion.xMax = -1;
+	Data->ActiveRegion.yMin = ySize;
+	Data->ActiveRegion.yMax = -1;
+	Data->ActiveRegion.zMin = zSize;
+	Data->ActiveRegion.zMax = -1;
+
+	if (Data->BlockAdvanced == false) {
+		return;
+	}
+
+	// The junctions are added back in the order of the grid, which the connection of the following iterations depends on
+	for (int x = Region->xMin; x <= Region->xMax; x++) {
+		for (int y = Region->yMin; y <= Region->yMax; y++) {
+			for (int z = Region->zMin; z <= Region->zMax; z++) {
+				Result = &Data->BlockResult[BlockResultIndex(Region, x, y, z)];
+				NodeReference = &Grid[x][y][z];
+				NodeReference->Emax = Result->Emax;
+
+				if ((NodeReference->PropagateFlag == true || NodeReference->Active == true) && 
+					Result->AvgEnergy >= AbsoluteThreshold && Result->AvgEnergy >= Result->Emax*RelativeEnergyThreshold) 
+				{
+					NodeReference->V = Result->V;
+					NodeReference->VxpIn = Result->VxpIn;
+					NodeReference->VxnIn = Result->VxnIn;
+					NodeReference->VypIn = Result->VypIn;
+					NodeReference->VynIn = Result->VynIn;
+					NodeReference->VzpIn = Result->VzpIn;
+					NodeReference->VznIn = Result->VznIn;
+					NodeReference->Epulse = Result->Epulse;
+
+					NewNode = AddJunctionToSet(Data->Pool, x,y,z, true);
+					InsertActiveJunction(Data, NewNode);
+
+					Data->ActiveRegion.xMin = MIN(Data->ActiveRegion.xMin, x);
+					Data->ActiveRegion.xMax = MAX(Data->ActiveRegion.xMax, x);
+					Data->ActiveRegion.yMin = MIN(Data->ActiveRegion.yMin, y);
+					Data->ActiveRegion.yMax = MAX(Data->ActiveRegion.yMax, y);
+					Data->ActiveRegion.zMin = MIN(Data->ActiveRegion.zMin, z);
+					Data->ActiveRegion.zMax = MAX(Data->ActiveRegion.zMax, z);
+				}
+				else if (NodeReference->Active == true) {
+					// Below the thresholds, remove the junction as the event based algorithm would. Inactive nodes were not changed by the pass
+					NodeReference->Active = false;
+					NodeReference->V = 0;
+					NodeReference->VxpIn = 0;
+					NodeReference->VxnIn = 0;
+					NodeReference->VypIn = 0;
+					NodeReference->VynIn = 0;
+					NodeReference->VzpIn = 0;
+					NodeReference->VznIn = 0;
+					NodeReference->VxpOut = 0;
+					NodeReference->VxnOut = 0;
+					NodeReference->VypOut = 0;
+					NodeReference->VynOut = 0;
+					NodeReference->VzpOut = 0;
+					NodeReference->VznOut = 0;
+					NodeReference->Epulse = 0;
+				}
+			}
+		}
+	}
+}
+
+
 // Evaluate the source input to the grid
 void EvaluateSource(int Iteration)
 {
@@ -616,6 +1726,8 @@ void EvaluateSource(int Iteration)
 	if (Grid[ImpulseSource.X][ImpulseSource.Y][ImpulseSource.Z].Epulse > Grid[ImpulseSource.X][ImpulseSource.Y][ImpulseSource.Z].Emax) {
 		Grid[ImpulseSource.X][ImpulseSource.Y][ImpulseSource.Z].Emax = Grid[ImpulseSource.X][ImpulseSource.Y][ImpulseSource.Z].Epulse;
 	}
+
+	ObserveJunction(&Grid[ImpulseSource.X][ImpulseSource.Y][ImpulseSource.Z], V, Iteration);
 }
 
 
@@ -642,12 +1754,12 @@ void CalculateBoundary(void)
 }
 
 
-// Return a newly allocated ActiveNode structure with the coordinates given
-ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active)
+// Return an ActiveNode structure from the pool of the section with the coordinates given
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z, bool Active)
 {
 	ActiveNode *NewNode;
 
-	NewNode = (ActiveNode*)malloc(sizeof(ActiveNode)); 
+	NewNode = AllocateActiveNode(Pool);
 
 
 	NewNode->X = x;
@@ -662,13 +1774,16 @@ ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active)
 }
 
 
-// Remove a junction from the active set and free memory allocated to it, returns the a pointer to the rest of the list which should be appended to the first half
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode)
+// Remove a junction from the active set and return its record to the pool, returns the a pointer to the rest of the list which should be appended to the first half
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode)
 {
 	ActiveNode *NextNode;
 	
 	NextNode = InactiveNode->NextActiveNode;
-	free(InactiveNode);
+	FreeActiveNode(Pool, InactiveNode);
+	if (Checkpointing == true) {
+		LogResetJunction(Pool->Index, x, y, z);
+	}
 	Grid[x][y][z].Active = false;
 	Grid[x][y][z].V = 0;
 	Grid[x][y][z].VxpIn = 0;
@@ -684,6 +1799,7 @@ ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode)
 	Grid[x][y][z].VzpOut = 0;
 	Grid[x][y][z].VznOut = 0;
 	Grid[x][y][z].Epulse = 0;
+	ResetJunctionObservers(&Grid[x][y][z]);
 
 	return NextNode;
 }
@@ -693,11 +1809,20 @@ ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode)
 void CopyNodeAdditions(ThreadData_t *Data)
 {
 	ActiveNode *TempNode, *CurrentNode, *PreviousNode;
+	ActiveNode **ListHead;
 	int xIndex = Data->Index.X;
 	int yIndex = Data->Index.Y;
 	int zIndex = Data->Index.Z;
 
-	for (int i=0; i<6; i++) {
+	// Additions always lie on the section faces, so join the boundary set when the halo is overlapped
+	if (InputData.OverlapHalo.Flag == true) {
+		ListHead = &BoundarySet[xIndex][yIndex][zIndex];
+	}
+	else {
+		ListHead = &ActiveSet[xIndex][yIndex][zIndex];
+	}
+
+	for (int i=0; i<nAdditionLists; i++) {
 
 		PreviousNode = NULL;
 		CurrentNode = NodeAdditions[xIndex][yIndex][zIndex][i];
@@ -706,7 +1831,7 @@ void CopyNodeAdditions(ThreadData_t *Data)
 				// Junction already added to active set, remove the node from the active set
 				TempNode = CurrentNode;
 				CurrentNode = CurrentNode->NextActiveNode;
-				free(TempNode);
+				FreeActiveNode(Data->Pool, TempNode);
 				if (PreviousNode != NULL) {
 					PreviousNode->NextActiveNode = CurrentNode;
 				}
@@ -716,6 +1841,7 @@ void CopyNodeAdditions(ThreadData_t *Data)
 			}
 			else {
 				ActiveJunctions[xIndex][yIndex][zIndex]++;
+				Data->BoundaryJunctions++;
 				Grid[CurrentNode->X][CurrentNode->Y][CurrentNode->Z].Active = true;
 				// Get the next node in the list
 				PreviousNode = CurrentNode;
@@ -726,12 +1852,12 @@ void CopyNodeAdditions(ThreadData_t *Data)
 		// Add the list to the head of the main list
 		if (NodeAdditions[xIndex][yIndex][zIndex][i] != NULL) {
 			if (PreviousNode != NULL) {
-				PreviousNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
+				PreviousNode->NextActiveNode = *ListHead;
 			}
 			else {
-				NodeAdditions[xIndex][yIndex][zIndex][i]->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
+				NodeAdditions[xIndex][yIndex][zIndex][i]->NextActiveNode = *ListHead;
 			}
-			ActiveSet[xIndex][yIndex][zIndex] = NodeAdditions[xIndex][yIndex][zIndex][i];
+			*ListHead = NodeAdditions[xIndex][yIndex][zIndex][i];
 			NodeAdditions[xIndex][yIndex][zIndex][i] = NULL;
 		}
 	}
@@ -798,15 +1924,17 @@ void CorrectActiveSet(ThreadData_t *Data)
 }
 
 
-void CalculateSectionIndices(void)
+// Find the factors of the number of threads into three that give the most sections, and of those the most even, with the
+// largest first. The factor found for the z-direction is at most zMax. Returns the number of sections
+int FactoriseThreads(int zMax, int *MaxSizes)
 {
 	int nSections = 1;
-	int MaxSizes[3] = {1,1,1};
 	int MaxSections = 1;
 
+	MaxSizes[0] = MaxSizes[1] = MaxSizes[2] = 1;
 	for (int i=1; i<=Threads; i++) {
 		for (int j=1; j<=Threads/i; j++) {
-			for (int k=1; k<= Threads/i/j; k++) {
+			for (int k=1; k<= MIN(zMax, Threads/i/j); k++) {
 				nSections = i*j*k;
 				if (nSections > MaxSections || (nSections == MaxSections && i+j+k < MaxSizes[0]+MaxSizes[1]+MaxSizes[2])) {
 					MaxSections = nSections;
@@ -851,8 +1979,32 @@ void CalculateSectionIndices(void)
 		}
 	}
 
-	if (xSize >= ySize) {
-		if (xSize >= zSize) {
+	return MaxSections;
+}
+
+
+// Calculate the number of sections in each direction from the number of threads
+void CalculateSectionIndices(void)
+{
+	int MaxSizes[3];
+	int MaxSections;
+	int xRows = LastOwnedRow()-FirstOwnedRow()+1;
+	ThreadIndex_t Layout;
+
+	// The radial decomposition gives each thread a sector around the source
+	if (Decomposition == DECOMPOSITION_RADIAL) {
+		MaxThreadIndex.X = Threads;
+		MaxThreadIndex.Y = 1;
+		MaxThreadIndex.Z = 1;
+		CalculateSectorMap();
+		return;
+	}
+
+	MaxSections = FactoriseThreads(Threads, MaxSizes);
+
+	// The longest direction of the rows owned by this process gets the most sections
+	if (xRows >= ySize) {
+		if (xRows >= zSize) {
 			MaxThreadIndex.X = MaxSizes[0];
 			if (ySize >= zSize) {
 				MaxThreadIndex.Y = MaxSizes[1];
@@ -870,7 +2022,7 @@ void CalculateSectionIndices(void)
 		}
 	}
 	else {
-		if (xSize < zSize) {
+		if (xRows < zSize) {
 			MaxThreadIndex.X = MaxSizes[2];
 			if (ySize >= zSize) {
 				MaxThreadIndex.Y = MaxSizes[0];
@@ -887,6 +2039,185 @@ void CalculateSectionIndices(void)
 			MaxThreadIndex.Z = MaxSizes[2];
 		}
 	}
+
+	// Pages placed by first touch hold whole rows in the z-direction, so the sections are not split along z. The layout that
+	// would have split them is reported once
+	if (GridPlacement == NUMA_FIRST_TOUCH && MaxThreadIndex.Z > 1) {
+		Layout = MaxThreadIndex;
+		MaxSections = FactoriseThreads(1, MaxSizes);
+		MaxThreadIndex.X = xRows >= ySize ? MaxSizes[0] : MaxSizes[1];
+		MaxThreadIndex.Y = xRows >= ySize ? MaxSizes[1] : MaxSizes[0];
+		MaxThreadIndex.Z = 1;
+		if (WholeRowsReported == false) {
+			printf("First touch placement keeps the rows in the z-direction whole, using %d x %d x 1 sections in place of %d x %d x %d\n", MaxThreadIndex.X, MaxThreadIndex.Y, Layout.X, Layout.Y, Layout.Z);
+			WholeRowsReported = true;
+		}
+	}
+
+	// The layout by size is kept unless the scene predicts a better balanced one
+	if (Decomposition == DECOMPOSITION_SCENE && MaxSections > 1) {
+		ChooseSceneDecomposition(MaxSections);
+	}
+}
+
+
+// Choose the division of the owned rows into a number of sections from the free space of the scene and the position of
+// the source. The wavefront reaches each propagating junction at its distance from the source, and keeps it active for
+// about the time taken to cross the grid, so the iterations are predicted from a coarse copy of the scene
+void ChooseSceneDecomposition(int nSections)
+{
+	int xFirst = FirstOwnedRow();
+	int xRows = LastOwnedRow()-FirstOwnedRow()+1;
+	int xCells = (xRows+SCENE_CELL-1)/SCENE_CELL;
+	int yCells = (ySize+SCENE_CELL-1)/SCENE_CELL;
+	int zCells = (zSize+SCENE_CELL-1)/SCENE_CELL;
+	int nCells = xCells*yCells*zCells;
+	int nBuckets = (xSize+ySize+zSize)/SCENE_CELL+1;
+	int *CellNodes = (int*)calloc(nCells, sizeof(int));			// Propagating nodes in each cell
+	int *CellDistance = (int*)malloc(nCells*sizeof(int));		// Distance from the source to the cell centre, in cells
+	int c, xc, yc, zc;
+	ThreadIndex_t Layout, BoxLayout = MaxThreadIndex;
+	double Efficiency, BoxEfficiency, BestEfficiency;
+
+	// Count the free space of each cell
+	for (int x=xFirst; x<xFirst+xRows; x++) {
+		for (int y=0; y<ySize; y++) {
+			for (int z=0; z<zSize; z++) {
+				if (Grid[x][y][z].PropagateFlag == true) {
+					CellNodes[(((x-xFirst)/SCENE_CELL)*yCells + y/SCENE_CELL)*zCells + z/SCENE_CELL]++;
+				}
+			}
+		}
+	}
+	for (int i=0; i<xCells; i++) {
+		for (int j=0; j<yCells; j++) {
+			for (int k=0; k<zCells; k++) {
+				xc = MIN(xFirst + i*SCENE_CELL + SCENE_CELL/2, xFirst+xRows-1);
+				yc = MIN(j*SCENE_CELL + SCENE_CELL/2, ySize-1);
+				zc = MIN(k*SCENE_CELL + SCENE_CELL/2, zSize-1);
+				c = (i*yCells + j)*zCells + k;
+				CellDistance[c] = (abs(xc-ImpulseSource.X) + abs(yc-ImpulseSource.Y) + abs(zc-ImpulseSource.Z))/SCENE_CELL;
+			}
+		}
+	}
+
+	// Try every box layout of the sections that fits the owned rows
+	BoxEfficiency = PredictLayoutEfficiency(&BoxLayout, CellNodes, CellDistance, nCells, nBuckets);
+	BestEfficiency = BoxEfficiency;
+	for (Layout.X=1; Layout.X<=nSections && Layout.X<=xRows; Layout.X++) {
+		for (Layout.Y=1; Layout.Y<=nSections/Layout.X && Layout.Y<=ySize; Layout.Y++) {
+			if (nSections%(Layout.X*Layout.Y) != 0) {
+				continue;
+			}
+			Layout.Z = nSections/(Layout.X*Layout.Y);
+			if (Layout.Z > zSize) {
+				continue;
+			}
+			Efficiency = PredictLayoutEfficiency(&Layout, CellNodes, CellDistance, nCells, nBuckets);
+			if (Efficiency > BestEfficiency) {
+				BestEfficiency = Efficiency;
+				MaxThreadIndex = Layout;
+			}
+		}
+	}
+
+	printf("Scene decomposition: %d x %d x %d sections, predicted %.1f%% parallel efficiency (%.1f%% for %d x %d x %d by size)\n",
+		MaxThreadIndex.X, MaxThreadIndex.Y, MaxThreadIndex.Z, 100*BestEfficiency,
+		100*BoxEfficiency, BoxLayout.X, BoxLayout.Y, BoxLayout.Z);
+
+	free(CellNodes);
+	free(CellDistance);
+}
+
+
+// Predict the parallel efficiency of a layout of sections over the coarse scene, as the active junctions of all the
+// sections over the sum of the largest section at each iteration
+double PredictLayoutEfficiency(ThreadIndex_t *Layout, int *CellNodes, int *CellDistance, int nCells, int nBuckets)
+{
+	int nSections = Layout->X*Layout->Y*Layout->Z;
+	int Width = nBuckets;			// Iterations, in cells, for which a junction stays active after the wavefront arrives
+	int xFirst = FirstOwnedRow();
+	int xRows = LastOwnedRow()-FirstOwnedRow()+1;
+	int yCells = (ySize+SCENE_CELL-1)/SCENE_CELL;
+	int zCells = (zSize+SCENE_CELL-1)/SCENE_CELL;
+	double *Arrivals = (double*)calloc(nSections*nBuckets, sizeof(double));
+	double *Active = (double*)calloc(nSections, sizeof(double));
+	double Peak, Total = 0, Makespan = 0;
+	int c, s, x, y, z;
+
+	// Sort the free space of each section by the time the wavefront reaches it
+	for (c=0; c<nCells; c++) {
+		if (CellNodes[c] > 0) {
+			x = MIN(xFirst + (c/(yCells*zCells))*SCENE_CELL + SCENE_CELL/2, xFirst+xRows-1);
+			y = MIN(((c/zCells)%yCells)*SCENE_CELL + SCENE_CELL/2, ySize-1);
+			z = MIN((c%zCells)*SCENE_CELL + SCENE_CELL/2, zSize-1);
+			s = BoxSection(Layout, x, y, z);
+			Arrivals[s*nBuckets + CellDistance[c]] += CellNodes[c];
+		}
+	}
+
+	// Step the wavefront through the sections, junctions leave the active set once the width has passed
+	for (int t=0; t<nBuckets+Width; t++) {
+		Peak = 0;
+		for (s=0; s<nSections; s++) {
+			if (t < nBuckets) {
+				Active[s] += Arrivals[s*nBuckets + t];
+			}
+			if (t >= Width) {
+				Active[s] -= Arrivals[s*nBuckets + t-Width];
+			}
+			Total += Active[s];
+			if (Active[s] > Peak) {
+				Peak = Active[s];
+			}
+		}
+		Makespan += Peak;
+	}
+
+	free(Arrivals);
+	free(Active);
+
+	if (Makespan == 0) {
+		return 1;
+	}
+	return Total/(nSections*Makespan);
+}
+
+
+// Return the number of sections the grid is divided into
+int SectionWorkerCount(void)
+{
+	return MaxThreadIndex.X * MaxThreadIndex.Y * MaxThreadIndex.Z;
+}
+
+
+// Return the index of the worker whose section contains a node, using the same boundaries as CalculateInitialBoundaries
+int SectionWorker(int x, int y, int z)
+{
+	if (SectorMap != NULL) {
+		return SectorMap[x][y];
+	}
+
+	return BoxSection(&MaxThreadIndex, x, y, z);
+}
+
+
+// Return the index of the section of a box layout containing a node
+int BoxSection(ThreadIndex_t *Layout, int x, int y, int z)
+{
+	int i = 0, j = 0, k = 0;
+
+	while (i < Layout->X-1 && x > FirstOwnedRow() + (i+1)*(LastOwnedRow()-FirstOwnedRow()+1)/Layout->X-1) {
+		i++;
+	}
+	while (j < Layout->Y-1 && y > (j+1)*ySize/Layout->Y-1) {
+		j++;
+	}
+	while (k < Layout->Z-1 && z > (k+1)*zSize/Layout->Z-1) {
+		k++;
+	}
+
+	return (i*Layout->Y + j)*Layout->Z + k;
 }
 
 
@@ -894,42 +2225,40 @@ void CalculateSectionIndices(void)
 void AllocateResources(void)
 {
 	ThreadData_t *pData;
+	int Worker;
+	int nSections = SectionWorkerCount();
+	NodePool *Pools = CreateNodePools(nSections);
+
+	// Each sector can receive junctions from any other, so give every sending section its own list
+	if (Decomposition == DECOMPOSITION_RADIAL) {
+		nAdditionLists = MaxThreadIndex.X;
+	}
+	else {
+		nAdditionLists = 6;
+	}
 
-	hWorkerThreads = (HANDLE***)malloc(MaxThreadIndex.X*sizeof(HANDLE**));
-	dwWorkerThreadIDs = (DWORD***)malloc(MaxThreadIndex.X*sizeof(DWORD**));
 	ActiveJunctions = (int***)malloc(MaxThreadIndex.X*sizeof(int**));
 	ActiveSet = (ActiveNode****)malloc(MaxThreadIndex.X*sizeof(ActiveNode***));
+	BoundarySet = (ActiveNode****)malloc(MaxThreadIndex.X*sizeof(ActiveNode***));
 	NodeAdditions = (ActiveNode*****)malloc(MaxThreadIndex.X*sizeof(ActiveNode****));
-	hReadyEvent = (HANDLE***)malloc(MaxThreadIndex.X*sizeof(HANDLE**));
-	hScatterEvent = (HANDLE***)malloc(MaxThreadIndex.X*sizeof(HANDLE**));
-	hConnectEvent = (HANDLE***)malloc(MaxThreadIndex.X*sizeof(HANDLE**));
-	hEndEvent = (HANDLE***)malloc(MaxThreadIndex.X*sizeof(HANDLE**));
+	hWakeEvent = (HANDLE***)malloc(MaxThreadIndex.X*sizeof(HANDLE**));
 	ThreadData = (ThreadData_t***)malloc(MaxThreadIndex.X*sizeof(ThreadData_t**));
+	Schedule = (ThreadData_t**)malloc(MaxThreadIndex.X*MaxThreadIndex.Y*MaxThreadIndex.Z*sizeof(ThreadData_t*));
 
 	for (int i=0; i<MaxThreadIndex.X; i++) {
-		hWorkerThreads[i] = (HANDLE**)malloc(MaxThreadIndex.Y*sizeof(HANDLE*));
-		dwWorkerThreadIDs[i] = (DWORD**)malloc(MaxThreadIndex.Y*sizeof(DWORD*));
-		ThreadData[i] = (ThreadData_t**)malloc(MaxThreadIndex.Y*sizeof(ThreadData_t*));
 		ActiveJunctions[i] = (int**)malloc(MaxThreadIndex.Y*sizeof(int*));
 		ActiveSet[i] = (ActiveNode***)malloc(MaxThreadIndex.Y*sizeof(ActiveNode**));
+		BoundarySet[i] = (ActiveNode***)malloc(MaxThreadIndex.Y*sizeof(ActiveNode**));
 		NodeAdditions[i] = (ActiveNode****)malloc(MaxThreadIndex.Y*sizeof(ActiveNode***));
-		hReadyEvent[i] = (HANDLE**)malloc(MaxThreadIndex.Y*sizeof(HANDLE*));
-		hScatterEvent[i] = (HANDLE**)malloc(MaxThreadIndex.Y*sizeof(HANDLE*));
-		hConnectEvent[i] = (HANDLE**)malloc(MaxThreadIndex.Y*sizeof(HANDLE*));
-		hEndEvent[i] = (HANDLE**)malloc(MaxThreadIndex.Y*sizeof(HANDLE*));
+		hWakeEvent[i] = (HANDLE**)malloc(MaxThreadIndex.Y*sizeof(HANDLE*));
 		ThreadData[i] = (ThreadData_t**)malloc(MaxThreadIndex.Y*sizeof(ThreadData_t*));
 
 		for (int j=0; j<MaxThreadIndex.Y; j++) {
-			hWorkerThreads[i][j] = (HANDLE*)malloc(MaxThreadIndex.Z*sizeof(HANDLE));
-			dwWorkerThreadIDs[i][j] = (DWORD*)malloc(MaxThreadIndex.Z*sizeof(DWORD));		
-			ThreadData[i][j] = (ThreadData_t*)malloc(MaxThreadIndex.Z*sizeof(ThreadData_t));
 			ActiveJunctions[i][j] = (int*)malloc(MaxThreadIndex.Z*sizeof(int));
 			ActiveSet[i][j] = (ActiveNode**)malloc(MaxThreadIndex.Z*sizeof(ActiveNode*));
+			BoundarySet[i][j] = (ActiveNode**)malloc(MaxThreadIndex.Z*sizeof(ActiveNode*));
 			NodeAdditions[i][j] = (ActiveNode***)malloc(MaxThreadIndex.Z*sizeof(ActiveNode**));
-			hReadyEvent[i][j] = (HANDLE*)malloc(MaxThreadIndex.Z*sizeof(HANDLE));
-			hScatterEvent[i][j] = (HANDLE*)malloc(MaxThreadIndex.Z*sizeof(HANDLE));
-			hConnectEvent[i][j] = (HANDLE*)malloc(MaxThreadIndex.Z*sizeof(HANDLE));
-			hEndEvent[i][j] = (HANDLE*)malloc(MaxThreadIndex.Z*sizeof(HANDLE));
+			hWakeEvent[i][j] = (HANDLE*)malloc(MaxThreadIndex.Z*sizeof(HANDLE));
 			ThreadData[i][j] = (ThreadData_t*)malloc(MaxThreadIndex.Z*sizeof(ThreadData_t));
 
 			for (int k=0; k<MaxThreadIndex.Z; k++) {
@@ -938,39 +2267,100 @@ void AllocateResources(void)
 
 				// Initialise the list heads
 				ActiveSet[i][j][k] = NULL;
-				NodeAdditions[i][j][k] = (ActiveNode**)malloc(6*sizeof(ActiveNode*));
-				NodeAdditions[i][j][k][0] = NULL;
-				NodeAdditions[i][j][k][1] = NULL;
-				NodeAdditions[i][j][k][2] = NULL;
-				NodeAdditions[i][j][k][3] = NULL;
-				NodeAdditions[i][j][k][4] = NULL;
-				NodeAdditions[i][j][k][5] = NULL;
+				BoundarySet[i][j][k] = NULL;
+				NodeAdditions[i][j][k] = (ActiveNode**)malloc(nAdditionLists*sizeof(ActiveNode*));
+				for (int l=0; l<nAdditionLists; l++) {
+					NodeAdditions[i][j][k][l] = NULL;
+				}
 
 				// Create the mutexs
-				hReadyEvent[i][j][k] = CreateEvent(NULL, FALSE, FALSE, NULL);
-				hScatterEvent[i][j][k] = CreateEvent(NULL, FALSE, FALSE, NULL);
-				hConnectEvent[i][j][k] = CreateEvent(NULL, FALSE, FALSE, NULL);
-				hEndEvent[i][j][k] = CreateEvent(NULL, FALSE, FALSE, NULL);
+				hWakeEvent[i][j][k] = CreateEvent(NULL, FALSE, FALSE, NULL);
 				
 				// Initialise the thread index
 				pData = &ThreadData[i][j][k];
 				pData->Index.X = i;
 				pData->Index.Y = j;
 				pData->Index.Z = k;
-
-				hWorkerThreads[i][j][k] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)WorkerThread, (LPVOID)&ThreadData[i][j][k], 0, &dwWorkerThreadIDs[i][j][k]);
-				if (hWorkerThreads[i] == NULL) {
-					printf("Worker thread for block (%d,%d,%d) could not be started\n", i+1, j+1, k+1);
-					exit(1);
-				}
-				else {
-					printf("Worker thread (%d,%d,%d) started\n", i+1,j+1,k+1);
+				pData->ScatterCount = 0;
+				pData->ConnectCount = 0;
+				pData->Completed = 0;
+				pData->LastActive = -1;
+
+				// Initialise the cost model
+				pData->Ticks = 0;
+				pData->BoundaryJunctions = 0;
+				pData->Workload = 0;
+				pData->CostPerNode = 0;
+				pData->PredictedCost = 0;
+
+				// Initialise the NUMA traffic counters, the node is that of the worker given the section
+				Worker = (i*MaxThreadIndex.Y + j)*MaxThreadIndex.Z + k;
+				pData->Traffic.SectionX = i;
+				pData->Traffic.SectionY = j;
+				pData->Traffic.SectionZ = k;
+				pData->Traffic.LocalAccesses = 0;
+				pData->Traffic.RemoteAccesses = 0;
+
+				// Give the section its own active junction records
+				pData->Pool = &Pools[Worker];
+
+				// Allocate the working copy used for temporal blocking
+				pData->BlockResult = NULL;
+				pData->BlockCapacity = 0;
+				pData->BlockAdvanced = false;
+				pData->Tile = NULL;
+				if (TemporalBlock > 1) {
+					pData->Tile = (Node*)malloc((TEMPORAL_TILE+2*TemporalBlock)*(TEMPORAL_TILE+2*TemporalBlock)*(TEMPORAL_TILE+2*TemporalBlock)*sizeof(Node));
 				}
-		
+			}
+		}
+	}
 
+	// Start the worker pool, the sections are shared between the workers each iteration
+	nWorkers = WorkerPoolSize(nSections);
+	printf("Running %d sections on %d worker threads\n", nSections, nWorkers);
+	WorkerData = (WorkerData_t*)malloc(nWorkers*sizeof(WorkerData_t));
+	hWorkerThreads = (HANDLE*)malloc(nWorkers*sizeof(HANDLE));
+	dwWorkerThreadIDs = (DWORD*)malloc(nWorkers*sizeof(DWORD));
+
+	for (int w=0; w<nWorkers; w++) {
+		WorkerData[w].Index = w;
+		WorkerData[w].Sections = (ThreadData_t**)malloc(nSections*sizeof(ThreadData_t*));
+		WorkerData[w].nSections = 0;
+		WorkerData[w].Load = 0;
+		WorkerData[w].hReadyEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+		WorkerData[w].hScatterEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+		WorkerData[w].hConnectEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+		WorkerData[w].hEndEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	}
+
+	// Start with the sections dealt in turn, which gives each overlapped section a worker of its own
+	Worker = 0;
+	for (int i=0; i<MaxThreadIndex.X; i++) {
+		for (int j=0; j<MaxThreadIndex.Y; j++) {
+			for (int k=0; k<MaxThreadIndex.Z; k++) {
+				WorkerData[Worker].Sections[WorkerData[Worker].nSections++] = &ThreadData[i][j][k];
+				ThreadData[i][j][k].Traffic.NumaNode = WorkerNumaNode(Worker, nWorkers);
+				Worker = (Worker+1)%nWorkers;
 			}
 		}
 	}
+
+	for (int w=0; w<nWorkers; w++) {
+		hWorkerThreads[w] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)WorkerThread, (LPVOID)&WorkerData[w], 0, &dwWorkerThreadIDs[w]);
+		if (hWorkerThreads[w] == NULL) {
+			printf("Worker thread %d could not be started\n", w+1);
+			exit(1);
+		}
+		else {
+			printf("Worker thread %d started\n", w+1);
+		}
+
+		// Keep the worker on its own NUMA node
+		if (InputData.PinThreads.Flag == true) {
+			PinWorkerThread(hWorkerThreads[w], w, nWorkers);
+		}
+	}
 }
 
 
@@ -979,58 +2369,86 @@ void FreeResources(void)
 {
 	for (int i=0; i<MaxThreadIndex.X; i++) {
 		for (int j=0; j<MaxThreadIndex.Y; j++) {
-			free(hWorkerThreads[i][j]);
-			free(dwWorkerThreadIDs[i][j]);
+			for (int k=0; k<MaxThreadIndex.Z; k++) {
+				if (ThreadData[i][j][k].Tile != NULL) {
+					free(ThreadData[i][j][k].Tile);
+				}
+				free(ThreadData[i][j][k].BlockResult);
+				free(NodeAdditions[i][j][k]);
+				CloseHandle(hWakeEvent[i][j][k]);
+			}
 			free(ActiveJunctions[i][j]);
 			free(ActiveSet[i][j]);
+			free(BoundarySet[i][j]);
 			free(NodeAdditions[i][j]);
-			free(hReadyEvent[i][j]);
-			free(hScatterEvent[i][j]);
-			free(hConnectEvent[i][j]);
-			free(hEndEvent[i][j]);
+			free(hWakeEvent[i][j]);
 			free(ThreadData[i][j]);
 		}
-		free(hWorkerThreads[i]);
-		free(dwWorkerThreadIDs[i]);
 		free(ActiveJunctions[i]);
 		free(ActiveSet[i]);
+		free(BoundarySet[i]);
 		free(NodeAdditions[i]);
-		free(hReadyEvent[i]);
-		free(hScatterEvent[i]);
-		free(hConnectEvent[i]);
-		free(hEndEvent[i]);
+		free(hWakeEvent[i]);
 		free(ThreadData[i]);
 	}
-	free(hWorkerThreads);
-	free(dwWorkerThreadIDs);
 	free(ActiveJunctions);
 	free(ActiveSet);
+	free(BoundarySet);
 	free(NodeAdditions);
-	free(hReadyEvent);
-	free(hScatterEvent);
-	free(hConnectEvent);
-	free(hEndEvent);
+	free(hWakeEvent);
 	free(ThreadData);
+	free(Schedule);
+
+	for (int w=0; w<nWorkers; w++) {
+		free(WorkerData[w].Sections);
+		CloseHandle(WorkerData[w].hReadyEvent);
+		CloseHandle(WorkerData[w].hScatterEvent);
+		CloseHandle(WorkerData[w].hConnectEvent);
+		CloseHandle(WorkerData[w].hEndEvent);
+		CloseHandle(hWorkerThreads[w]);
+	}
+	free(WorkerData);
+	free(hWorkerThreads);
+	free(dwWorkerThreadIDs);
 }
 
 
-void CalculateInitialBoundaries(void)
+void CalculateInitialBoundaries(bool InsertSource)
 {
+	int xFirst = FirstOwnedRow();
+	int xRows = LastOwnedRow()-xFirst+1;
+
 	for (int i=0; i<MaxThreadIndex.X; i++) {
 		for (int j=0; j<MaxThreadIndex.Y; j++) {
 			for (int k=0; k<MaxThreadIndex.Z; k++) {
-				ThreadData[i][j][k].xMin = RoundToNearest(i*xSize/MaxThreadIndex.X);
-				ThreadData[i][j][k].xMax = RoundToNearest((i+1)*xSize/MaxThreadIndex.X-1);
+				ThreadData[i][j][k].xMin = xFirst + RoundToNearest(i*xRows/MaxThreadIndex.X);
+				ThreadData[i][j][k].xMax = xFirst + RoundToNearest((i+1)*xRows/MaxThreadIndex.X-1);
 				ThreadData[i][j][k].yMin = RoundToNearest(j*ySize/MaxThreadIndex.Y);
 				ThreadData[i][j][k].yMax = RoundToNearest((j+1)*ySize/MaxThreadIndex.Y-1);
 				ThreadData[i][j][k].zMin = RoundToNearest(k*zSize/MaxThreadIndex.Z);
 				ThreadData[i][j][k].zMax = RoundToNearest((k+1)*zSize/MaxThreadIndex.Z-1);
+				if (SectorMap != NULL) {
+					// Sectors span the grid, their junctions are confined by the sector map instead
+					ThreadData[i][j][k].xMin = 0;
+					ThreadData[i][j][k].xMax = xSize-1;
+					ThreadData[i][j][k].yMin = 0;
+					ThreadData[i][j][k].yMax = ySize-1;
+					ThreadData[i][j][k].zMin = 0;
+					ThreadData[i][j][k].zMax = zSize-1;
+				}
+				ThreadData[i][j][k].ActiveRegion.xMin = ImpulseSource.X;
+				ThreadData[i][j][k].ActiveRegion.xMax = ImpulseSource.X;
+				ThreadData[i][j][k].ActiveRegion.yMin = ImpulseSource.Y;
+				ThreadData[i][j][k].ActiveRegion.yMax = ImpulseSource.Y;
+				ThreadData[i][j][k].ActiveRegion.zMin = ImpulseSource.Z;
+				ThreadData[i][j][k].ActiveRegion.zMax = ImpulseSource.Z;
 				if (ImpulseSource.X >= ThreadData[i][j][k].xMin && ImpulseSource.X <= ThreadData[i][j][k].xMax &&
 					ImpulseSource.Y >= ThreadData[i][j][k].yMin && ImpulseSource.Y <= ThreadData[i][j][k].yMax &&
-					ImpulseSource.Z >= ThreadData[i][j][k].zMin && ImpulseSource.Z <= ThreadData[i][j][k].zMax) 
+					ImpulseSource.Z >= ThreadData[i][j][k].zMin && ImpulseSource.Z <= ThreadData[i][j][k].zMax &&
+					(SectorMap == NULL || SectorMap[ImpulseSource.X][ImpulseSource.Y] == i) && InsertSource == true) 
 				{
-					ActiveJunctions[i][j][k] = 1;
-					ActiveSet[i][j][k] = AddJunctionToSet(ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
+					InsertActiveJunction(&ThreadData[i][j][k], AddJunctionToSet(ThreadData[i][j][k].Pool, ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true));
+					ThreadData[i][j][k].LastActive = 0;
 				}
 			}
 		}
@@ -1038,11 +2456,58 @@ void CalculateInitialBoundaries(void)
 }
 
 
-// Compare the size of two active junctions (for quick sort algorithm)
-int CompareActiveJunctions(const void *Thread1, const void *Thread2)
+// Divide the grid into sectors around the source, each column of nodes is owned by one sector. Successive shells
+// are rotated by one sector so that a wavefront travelling in a single direction is shared between the threads
+void CalculateSectorMap(void)
+{
+	double Angle, Radius;
+	int Sector, Shell;
+
+	if (SectorMap != NULL) {
+		return;
+	}
+
+	SectorMap = (int**)malloc(xSize*sizeof(int*));
+	for (int x=0; x<xSize; x++) {
+		SectorMap[x] = (int*)malloc(ySize*sizeof(int));
+		for (int y=0; y<ySize; y++) {
+			Angle = atan2((double)(y - ImpulseSource.Y), (double)(x - ImpulseSource.X));
+			Radius = sqrt((double)(SQUARE(x - ImpulseSource.X) + SQUARE(y - ImpulseSource.Y)))*GridSpacing;
+			Sector = (int)((Angle + M_PI)/(2*M_PI)*Threads);
+			if (Sector >= Threads) {
+				Sector = Threads-1;
+			}
+			Shell = (int)(Radius/RadialShellWidth);
+			SectorMap[x][y] = (Sector + Shell)%Threads;
+		}
+	}
+}
+
+
+// Free the sector map of the radial decomposition
+void FreeSectorMap(void)
 {
-	int A = ActiveJunctions[(*(int**)Thread1)[0]][(*(int**)Thread1)[1]][(*(int**)Thread1)[2]];
-	int B = ActiveJunctions[(*(int**)Thread2)[0]][(*(int**)Thread2)[1]][(*(int**)Thread2)[2]];
+	if (SectorMap != NULL) {
+		for (int x=0; x<xSize; x++) {
+			free(SectorMap[x]);
+		}
+		free(SectorMap);
+		SectorMap = NULL;
+	}
+}
+
 
-	return (ActiveJunctions[(*(int**)Thread2)[0]][(*(int**)Thread2)[1]][(*(int**)Thread2)[2]] - ActiveJunctions[(*(int**)Thread1)[0]][(*(int**)Thread1)[1]][(*(int**)Thread1)[2]]);
+// Compare the predicted cost of two sections, most expensive first (for quick sort algorithm)
+int CompareSectionCost(const void *Section1, const void *Section2)
+{
+	double A = (*(ThreadData_t**)Section1)->PredictedCost;
+	double B = (*(ThreadData_t**)Section2)->PredictedCost;
+
+	if (A > B) {
+		return -1;
+	}
+	else if (A < B) {
+		return 1;
+	}
+	return 0;
 }
@@ -15,5 +15,8 @@
 
 // Function prototypes
 void MainLoop(void);
+void CalculateSectionIndices(void);
+int SectionWorkerCount(void);
+int SectionWorker(int x, int y, int z);
 
 #endif //TLM_ALGORITHM_H
\ No newline at end of file
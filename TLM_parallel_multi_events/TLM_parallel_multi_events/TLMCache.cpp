@@ -0,0 +1,416 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMCache.cpp
+//
+/*********************************************************************************************/
+
+#include "stdafx.h"
+#include "TLM.h"
+#include "TLMMaths.h"
+#include "TLMCache.h"
+#include "TLMScene.h"
+#include "TLMNuma.h"
+#include "TLMDomain.h"
+#include "TLMTiming.h"
+
+
+// Definitions
+#define CACHE_MAGIC			"TLMSCENE"
+#define CACHE_VERSION		4
+#define CACHE_PROPAGATE		0x8000		// Node code bit set when the node propagates
+#define CACHE_BOUNDARY		0x4000		// Node code bit set when the node lies on a material boundary
+#define CACHE_MATERIAL		0x3fff		// Node code bits holding the index of the impedance of the node
+#define CACHE_MAX_MATERIALS	0x4000
+#define FNV_OFFSET			0xcbf29ce484222325ULL
+#define FNV_PRIME			0x100000001b3ULL
+
+
+// Type definitions
+
+// Header at the start of a scene cache file, the sections follow at the given offsets, each aligned to 8 bytes
+typedef struct {
+				char Magic[8];				// Written last, so an interrupted write is never read
+				int Version;
+				int CoeffsSize;				// Size of the reflection and transmission coefficients of a node
+				ULONGLONG SceneHash;		// Hash of the scene file contents
+				double GridSpacing;
+				double Frequency;			// Frequency of the coefficients of thin walls, zero without them
+				int xSize;
+				int ySize;
+				int zSize;
+				int xOffset;				// Grid spacings from the origin of the scene to the first node
+				int yOffset;
+				int zOffset;
+				int SceneMin[3];			// Extent of the whole scene, in grid spacings from its origin
+				int SceneMax[3];
+				int ThinWalls;
+				int nMaterials;
+				int nBoundaries;
+				ULONGLONG MaterialsOffset;	// Impedance of each material
+				ULONGLONG CodesOffset;		// Material, boundary and propagate bits of each node
+				ULONGLONG RowsOffset;		// Index of the first boundary of each x row, and the total
+				ULONGLONG CoeffsOffset;		// Coefficients of each boundary node, in grid order
+				ULONGLONG FileSize;
+				} SceneCacheHeader;
+
+
+// Global variables
+static HANDLE hCacheFile = NULL;
+static HANDLE hCacheMapping = NULL;
+static char *CacheView = NULL;			// Read only view of the cache used to build the grid
+static ULONGLONG SceneHash;
+
+extern Node ***Grid;
+extern int xSize, ySize, zSize;
+extern int xOffset, yOffset, zOffset;
+extern char *SceneFilename;
+extern double GridSpacing;
+extern double Frequency;
+extern InputFlags InputData;
+
+
+// Function prototypes
+bool HashSceneFile(ULONGLONG *Hash);
+void SceneCacheFilename(char *Filename, size_t FilenameSize);
+void LoadCacheSlab(int xMin, int xMax, void *Context);
+ULONGLONG AlignCacheOffset(ULONGLONG Offset);
+double CacheFrequency(void);
+void WriteCachePadding(FILE *CacheFile, ULONGLONG *Written, ULONGLONG To);
+
+
+// Build the grid from the scene cache if one matches the scene file and grid spacing, returns false if the scene must be read
+bool LoadSceneCache(void)
+{
+	char Filename[MAX_PATH];
+	SceneCacheHeader *Header;
+	LARGE_INTEGER FileSize;
+	int *RowBoundaries;
+	int GridMin[3], GridMax[3];
+
+	if (HashSceneFile(&SceneHash) == false) {
+		return false;
+	}
+
+	SceneCacheFilename(Filename, sizeof(Filename));
+	hCacheFile = CreateFile(Filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hCacheFile == INVALID_HANDLE_VALUE) {
+		hCacheFile = NULL;
+		return false;
+	}
+	GetFileSizeEx(hCacheFile, &FileSize);
+	if ((ULONGLONG)FileSize.QuadPart < sizeof(SceneCacheHeader)) {
+		CloseSceneCache();
+		return false;
+	}
+	hCacheMapping = CreateFileMapping(hCacheFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (hCacheMapping != NULL) {
+		CacheView = (char*)MapViewOfFile(hCacheMapping, FILE_MAP_READ, 0, 0, 0);
+	}
+	if (CacheView == NULL) {
+		CloseSceneCache();
+		return false;
+	}
+
+	// The cache is only used if it was written for this scene, grid spacing, thin wall model and layout of the coefficients
+	Header = (SceneCacheHeader*)CacheView;
+	if (memcmp(Header->Magic, CACHE_MAGIC, sizeof(Header->Magic)) != 0 || Header->Version != CACHE_VERSION || 
+		Header->CoeffsSize != sizeof(RTCoeffs) || Header->SceneHash != SceneHash || Header->GridSpacing != GridSpacing ||
+		Header->ThinWalls != (int)InputData.ThinWalls.Flag || Header->Frequency != CacheFrequency() ||
+		Header->FileSize != (ULONGLONG)FileSize.QuadPart)
+	{
+		printf("Scene cache '%s' does not match the scene, rebuilding it\n", Filename);
+		CloseSceneCache();
+		return false;
+	}
+
+	// The grid held must also have the extent the scene and the cropping options give now
+	SetSceneExtent(Header->SceneMin, Header->SceneMax);
+	FindGridExtent(GridMin, GridMax);
+	if (GridMin[0] != Header->xOffset || GridMin[1] != Header->yOffset || GridMin[2] != Header->zOffset ||
+		GridMax[0]-GridMin[0]+1 != Header->xSize || GridMax[1]-GridMin[1]+1 != Header->ySize || GridMax[2]-GridMin[2]+1 != Header->zSize)
+	{
+		printf("Scene cache '%s' holds a different extent of the scene, rebuilding it\n", Filename);
+		CloseSceneCache();
+		return false;
+	}
+
+	printf("\nReading the rasterised scene from cache '%s'\n\n", Filename);
+	if (InputData.PrintTimingInformation.Flag == true) {
+		SetSceneFileReadTime();
+	}
+
+	// Allocate memory for the TLM grid
+	PlaceGrid(GridMin, GridMax);
+	if (DomainCoordinator() == false) {
+		AllocateNumaGrid();
+	}
+	if (InputData.PrintTimingInformation.Flag == true) {
+		SetGridAllocatedTime();
+	}
+	// The coordinator of a split grid only needs its size
+	if (DomainCoordinator() == true) {
+		return true;
+	}
+
+	// Copy the materials into the rows held by this process, the coefficients of the boundaries are used in place
+	ParallelSlabs(FirstAllocatedRow(), LastAllocatedRow(), LoadCacheSlab, NULL);
+	if (InputData.PrintTimingInformation.Flag == true) {
+		SetGridRasterisedTime();
+	}
+
+	RowBoundaries = (int*)(CacheView + Header->RowsOffset);
+	PrintGridBoundaries(RowBoundaries[LastOwnedRow()+1] - RowBoundaries[FirstOwnedRow()]);
+
+	return true;
+}
+
+
+// Write the rasterised grid and its boundary coefficients to the scene cache, once the whole grid has been built by this process
+void SaveSceneCache(void)
+{
+	char Filename[MAX_PATH];
+	FILE *CacheFile;
+	SceneCacheHeader Header;
+	double *Materials = NULL;
+	USHORT *Codes;
+	int *RowBoundaries;
+	int Material = 0;
+	int m;
+	ULONGLONG Offset;
+	ULONGLONG Written;
+
+	memset(&Header, 0, sizeof(Header));
+	Header.Version = CACHE_VERSION;
+	Header.CoeffsSize = sizeof(RTCoeffs);
+	Header.SceneHash = SceneHash;
+	Header.GridSpacing = GridSpacing;
+	Header.Frequency = CacheFrequency();
+	Header.ThinWalls = (int)InputData.ThinWalls.Flag;
+	Header.xSize = xSize;
+	Header.ySize = ySize;
+	Header.zSize = zSize;
+	Header.xOffset = xOffset;
+	Header.yOffset = yOffset;
+	Header.zOffset = zOffset;
+	GetSceneExtent(Header.SceneMin, Header.SceneMax);
+
+	// Number each distinct impedance in the grid, nodes of the same material are usually together
+	Codes = (USHORT*)malloc((SIZE_T)xSize*ySize*zSize*sizeof(USHORT));
+	RowBoundaries = (int*)malloc((xSize+1)*sizeof(int));
+	if (Codes == NULL || RowBoundaries == NULL) {
+		printf("Could not allocate memory for the scene cache, it has not been written\n");
+		free(Codes);
+		free(RowBoundaries);
+		return;
+	}
+	for (int x=0; x<xSize; x++) {
+		RowBoundaries[x] = Header.nBoundaries;
+		for (int y=0; y<ySize; y++) {
+			for (int z=0; z<zSize; z++) {
+				if (Header.nMaterials == 0 || Materials[Material] != Grid[x][y][z].Z) {
+					for (m=0; m<Header.nMaterials && Materials[m] != Grid[x][y][z].Z; m++);
+					if (m == Header.nMaterials) {
+						if (Header.nMaterials == CACHE_MAX_MATERIALS) {
+							printf("The scene has more than %d materials, the scene cache has not been written\n", CACHE_MAX_MATERIALS);
+							free(Materials);
+							free(Codes);
+							free(RowBoundaries);
+							return;
+						}
+						// Reallocate the materials 16 at a time
+						if (Header.nMaterials%16 == 0) {
+							Materials = (double*)realloc(Materials, (Header.nMaterials+16)*sizeof(double));
+						}
+						Materials[Header.nMaterials++] = Grid[x][y][z].Z;
+					}
+					Material = m;
+				}
+				Codes[((SIZE_T)x*ySize + y)*zSize + z] = (USHORT)(Material | (Grid[x][y][z].PropagateFlag == true ? CACHE_PROPAGATE : 0) |
+					(Grid[x][y][z].RT != NULL ? CACHE_BOUNDARY : 0));
+				if (Grid[x][y][z].RT != NULL) {
+					Header.nBoundaries++;
+				}
+			}
+		}
+	}
+	RowBoundaries[xSize] = Header.nBoundaries;
+
+	Offset = AlignCacheOffset(sizeof(SceneCacheHeader));
+	Header.MaterialsOffset = Offset;
+	Offset = AlignCacheOffset(Offset + Header.nMaterials*sizeof(double));
+	Header.CodesOffset = Offset;
+	Offset = AlignCacheOffset(Offset + (ULONGLONG)xSize*ySize*zSize*sizeof(USHORT));
+	Header.RowsOffset = Offset;
+	Offset = AlignCacheOffset(Offset + (xSize+1)*sizeof(int));
+	Header.CoeffsOffset = Offset;
+	Header.FileSize = Offset + (ULONGLONG)Header.nBoundaries*sizeof(RTCoeffs);
+
+	SceneCacheFilename(Filename, sizeof(Filename));
+	if (fopen_s(&CacheFile, Filename, "wb") != 0) {
+		printf("Could not write the scene cache '%s'\n", Filename);
+	}
+	else {
+		// The header is written without its magic until every section is in place
+		fwrite(&Header, sizeof(Header), 1, CacheFile);
+		Written = sizeof(Header);
+		WriteCachePadding(CacheFile, &Written, Header.MaterialsOffset);
+		Written += fwrite(Materials, sizeof(double), Header.nMaterials, CacheFile)*sizeof(double);
+		WriteCachePadding(CacheFile, &Written, Header.CodesOffset);
+		Written += fwrite(Codes, sizeof(USHORT), (SIZE_T)xSize*ySize*zSize, CacheFile)*sizeof(USHORT);
+		WriteCachePadding(CacheFile, &Written, Header.RowsOffset);
+		Written += fwrite(RowBoundaries, sizeof(int), xSize+1, CacheFile)*sizeof(int);
+		WriteCachePadding(CacheFile, &Written, Header.CoeffsOffset);
+		for (int x=0; x<xSize; x++) {
+			for (int y=0; y<ySize; y++) {
+				for (int z=0; z<zSize; z++) {
+					if (Grid[x][y][z].RT != NULL) {
+						fwrite(Grid[x][y][z].RT, sizeof(RTCoeffs), 1, CacheFile);
+					}
+				}
+			}
+		}
+		if (ferror(CacheFile) == 0) {
+			memcpy(Header.Magic, CACHE_MAGIC, sizeof(Header.Magic));
+			fseek(CacheFile, 0, SEEK_SET);
+			fwrite(Header.Magic, sizeof(Header.Magic), 1, CacheFile);
+		}
+		if (ferror(CacheFile) != 0) {
+			printf("Error writing the scene cache '%s'\n", Filename);
+		}
+		else {
+			printf("Rasterised scene written to cache '%s'\n", Filename);
+		}
+		fclose(CacheFile);
+	}
+
+	free(Materials);
+	free(Codes);
+	free(RowBoundaries);
+}
+
+
+// Return whether the boundary coefficients of the grid are held in the scene cache rather than allocated for each node
+bool SceneCacheMapped(void)
+{
+	return CacheView != NULL;
+}
+
+
+// Unmap and close the scene cache
+void CloseSceneCache(void)
+{
+	if (CacheView != NULL) {
+		UnmapViewOfFile(CacheView);
+		CacheView = NULL;
+	}
+	if (hCacheMapping != NULL) {
+		CloseHandle(hCacheMapping);
+		hCacheMapping = NULL;
+	}
+	if (hCacheFile != NULL) {
+		CloseHandle(hCacheFile);
+		hCacheFile = NULL;
+	}
+}
+
+
+// Hash the contents of the scene file, followed by any mesh files it uses, with 64 bit FNV-1a
+bool HashSceneFile(ULONGLONG *Hash)
+{
+	*Hash = FNV_OFFSET;
+
+	return HashFile(SceneFilename, Hash) && HashSceneMeshes(Hash);
+}
+
+
+// Add the contents of a file to a 64 bit FNV-1a hash
+bool HashFile(char *Filename, ULONGLONG *Hash)
+{
+	FILE *File;
+	unsigned char *Buffer;
+	size_t nBytes;
+
+	if (fopen_s(&File, Filename, "rb") != 0) {
+		return false;
+	}
+
+	Buffer = (unsigned char*)malloc(65536);
+	while ((nBytes = fread(Buffer, 1, 65536, File)) > 0) {
+		for (size_t i=0; i<nBytes; i++) {
+			*Hash = (*Hash ^ Buffer[i])*FNV_PRIME;
+		}
+	}
+	free(Buffer);
+	fclose(File);
+
+	return true;
+}
+
+
+// Name the cache after the scene file and the grid spacing, so each spacing of a scene has its own cache
+void SceneCacheFilename(char *Filename, size_t FilenameSize)
+{
+	sprintf_s(Filename, FilenameSize, "%s.%g.cache", SceneFilename, GridSpacing);
+}
+
+
+// Set the impedance, propagate flag and boundary coefficients of a slab of nodes from the cache
+void LoadCacheSlab(int xMin, int xMax, void *Context)
+{
+	SceneCacheHeader *Header = (SceneCacheHeader*)CacheView;
+	double *Materials = (double*)(CacheView + Header->MaterialsOffset);
+	USHORT *Codes = (USHORT*)(CacheView + Header->CodesOffset);
+	int *RowBoundaries = (int*)(CacheView + Header->RowsOffset);
+	RTCoeffs *Coeffs = (RTCoeffs*)(CacheView + Header->CoeffsOffset);
+	RTCoeffs *Boundary;
+	USHORT Code;
+	bool Owned;
+
+	for (int x = xMin; x <= xMax; x++) {
+		// Only the rows owned by this process have coefficients, as when they are calculated
+		Owned = (x >= FirstOwnedRow() && x <= LastOwnedRow());
+		Boundary = &Coeffs[RowBoundaries[x]];
+		for (int y = 0; y < ySize; y++) {
+			for (int z = 0; z < zSize; z++) {
+				Code = Codes[((SIZE_T)x*ySize + y)*zSize + z];
+				Grid[x][y][z].Z = Materials[Code & CACHE_MATERIAL];
+				Grid[x][y][z].PropagateFlag = (Code & CACHE_PROPAGATE) != 0;
+				if ((Code & CACHE_BOUNDARY) != 0) {
+					Grid[x][y][z].RT = Owned == true ? Boundary : NULL;
+					Boundary++;
+				}
+				else {
+					Grid[x][y][z].RT = NULL;
+				}
+			}
+		}
+	}
+}
+
+
+// Round an offset in the cache file up to the next multiple of 8 bytes
+ULONGLONG AlignCacheOffset(ULONGLONG Offset)
+{
+	return (Offset + 7) & ~(ULONGLONG)7;
+}
+
+
+// The frequency the coefficients depend on, only thin walls use it
+double CacheFrequency(void)
+{
+	return InputData.ThinWalls.Flag == true ? Frequency : 0;
+}
+
+
+// Pad the cache file with zeros up to an offset, given the number of bytes written so far
+void WriteCachePadding(FILE *CacheFile, ULONGLONG *Written, ULONGLONG To)
+{
+	while (*Written < To) {
+		fputc(0, CacheFile);
+		(*Written)++;
+	}
+}
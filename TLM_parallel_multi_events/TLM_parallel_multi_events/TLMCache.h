@@ -0,0 +1,21 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMCache.h
+//
+/*********************************************************************************************/
+
+#ifndef TLM_CACHE_H
+#define TLM_CACHE_H
+
+// Function prototypes
+bool LoadSceneCache(void);
+void SaveSceneCache(void);
+bool SceneCacheMapped(void);
+void CloseSceneCache(void);
+bool HashFile(char *Filename, ULONGLONG *Hash);
+
+#endif //TLM_CACHE_H
@@ -0,0 +1,571 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMCheckpoint.cpp
+//
+/*********************************************************************************************/
+
+#include "stdafx.h"
+#include "TLM.h"
+#include "TLMMaths.h"
+#include "TLMOutput.h"
+#include "TLMCheckpoint.h"
+
+
+// Definitions
+#define CHECKPOINT_MAGIC	"TLMCHKPT"
+#define CHECKPOINT_END		"CHKPTEND"
+#define CHECKPOINT_VERSION	1
+#define CHECKPOINT_RECORDS	8			// Records held by the file, the first a base, before it is replaced by a new base
+
+
+// Type definitions
+
+// Checkpoint state of a section, only written by the thread running the section. The junctions that left the active set are
+// logged between checkpoints, and the section copies its part of a checkpoint once it has connected
+typedef struct {
+				int (*Junctions)[3];		// Junctions that left the active set since the last checkpoint
+				int nJunctions;
+				int MaxJunctions;
+				CheckpointNode *Nodes;		// Active junctions at the checkpoint being taken
+				int nNodes;
+				int MaxNodes;
+				CheckpointReset *Resets;	// Logged junctions no longer active at the checkpoint being taken
+				int nResets;
+				int MaxResets;
+				} SectionCheckpoint;
+
+
+// Global variables
+static char CheckpointPath[MAX_PATH];
+static char ReplacementPath[MAX_PATH];			// Checkpoint file being written to replace the current one
+static FILE *CheckpointFile = NULL;
+static SectionCheckpoint *Sections = NULL;
+static int nCheckpointSections = 0;
+static OutputQueue *CheckpointQueue = NULL;
+
+// Header of the checkpoint being taken, handed to the output thread to write with the sections while the iterations continue
+static CheckpointHeader RecordHeader;
+static volatile LONG RecordPending = 0;			// Set while the output thread has the record
+static int LastIteration;						// Iteration of the last checkpoint taken or resumed
+static time_t LastTime;
+
+// Peak energy of every junction that has left the active set, folded into the base when the file is replaced. Only used by
+// the output thread once the run has started
+static CheckpointReset *BaseResets = NULL;
+static int nBaseResets = 0;
+static int MaxBaseResets = 0;
+static int nFileRecords = 0;					// Records held by the checkpoint file
+
+extern Node ***Grid;
+extern int xSize, ySize, zSize;
+extern double GridSpacing;
+extern Source ImpulseSource;
+extern char *FolderName;
+extern char *ProjectName;
+extern char *CheckpointFilename;
+extern int CheckpointIterations;
+extern double CheckpointMinutes;
+extern InputFlags InputData;
+
+
+// Function prototypes
+char *ReadCheckpointRecord(char *Buffer, SIZE_T *BufferSize);
+bool CheckpointMatchesGrid(CheckpointHeader *Header);
+void ApplyCheckpointRecord(char *Buffer);
+void AddBaseResets(CheckpointReset *Resets, int nResets);
+void FoldBaseResets(void);
+int CompareBaseResets(const void *A, const void *B);
+bool WriteCheckpointRecord(FILE *File, bool Base);
+void ReplaceCheckpointFile(void);
+
+
+// Open the checkpoint file of the project before the first iteration. If the run is resuming, the complete records are
+// applied to the grid in turn and the junctions active at the last of them are passed to ActivateJunction, in the order of
+// their active sets. Returns true if the run resumes from a checkpoint, with the iterations it had completed
+bool OpenCheckpoint(int nSections, int *Iteration, void (*ActivateJunction)(int x, int y, int z))
+{
+	char *Buffer = NULL;
+	char *LastRecord = NULL;
+	SIZE_T BufferSize = 0;
+	SIZE_T LastRecordSize = 0;
+	__int64 GoodLength = 0;
+	bool Resumed = false;
+
+	sprintf_s(CheckpointPath, sizeof(CheckpointPath), "%s/%s_%s", FolderName, ProjectName, CheckpointFilename);
+	sprintf_s(ReplacementPath, sizeof(ReplacementPath), "%s.new", CheckpointPath);
+
+	Sections = (SectionCheckpoint*)calloc(nSections, sizeof(SectionCheckpoint));
+	nCheckpointSections = nSections;
+	RecordPending = 0;
+	LastIteration = 0;
+	nBaseResets = 0;
+	nFileRecords = 0;
+
+	// A run stopped after the old file was removed, but before the new base took its place, resumes from the new base
+	if (InputData.ResumeCheckpoint.Flag == true && _access(CheckpointPath, 0) != 0) {
+		rename(ReplacementPath, CheckpointPath);
+	}
+
+	// Replay the records in the order they were written, a record cut short by the end of the previous run is ignored
+	if (InputData.ResumeCheckpoint.Flag == true && fopen_s(&CheckpointFile, CheckpointPath, "r+b") == 0) {
+		while ((Buffer = ReadCheckpointRecord(Buffer, &BufferSize)) != NULL) {
+			CheckpointHeader *Header = (CheckpointHeader*)Buffer;
+
+			if (CheckpointMatchesGrid(Header) == false || Header->Iteration <= LastIteration) {
+				break;
+			}
+			ApplyCheckpointRecord(Buffer);
+			AddBaseResets((CheckpointReset*)(Buffer + sizeof(CheckpointHeader) + (SIZE_T)Header->nNodes*sizeof(CheckpointNode)), Header->nResets);
+			LastIteration = Header->Iteration;
+			GoodLength = _ftelli64(CheckpointFile);
+			nFileRecords++;
+
+			// Keep the last record for its active junctions
+			char *Swap = LastRecord;
+			SIZE_T SwapSize = LastRecordSize;
+			LastRecord = Buffer;
+			LastRecordSize = BufferSize;
+			Buffer = Swap;
+			BufferSize = SwapSize;
+		}
+		free(Buffer);
+
+		if (LastRecord != NULL) {
+			CheckpointHeader *Header = (CheckpointHeader*)LastRecord;
+			CheckpointNode *Nodes = (CheckpointNode*)(LastRecord + sizeof(CheckpointHeader));
+
+			// The active sets are built by pushing onto their heads
+			for (int n=Header->nNodes-1; n>=0; n--) {
+				ActivateJunction(Nodes[n].X, Nodes[n].Y, Nodes[n].Z);
+			}
+			printf("Resuming from checkpoint '%s' after %d iterations, %d active junctions\n", CheckpointFilename, Header->Iteration, Header->nNodes);
+			*Iteration = Header->Iteration;
+			free(LastRecord);
+			Resumed = true;
+		}
+		else {
+			printf("No complete checkpoint for this grid in '%s', starting from the source\n", CheckpointFilename);
+		}
+
+		// Later records replace anything after the last complete record
+		_fseeki64(CheckpointFile, GoodLength, SEEK_SET);
+		if (_chsize_s(_fileno(CheckpointFile), GoodLength) != 0) {
+			printf("Could not truncate checkpoint file '%s'\n", CheckpointFilename);
+		}
+	}
+	else if (fopen_s(&CheckpointFile, CheckpointPath, "wb") != 0) {
+		printf("Could not open checkpoint file '%s', no checkpoints will be taken\n", CheckpointFilename);
+		CheckpointFile = NULL;
+	}
+
+	CheckpointQueue = OpenOutputQueue(0);
+	LastTime = time(NULL);
+
+	return Resumed;
+}
+
+
+// Read the next record of the checkpoint file into a buffer, growing it if necessary. Returns NULL, having freed the buffer,
+// if there is no complete record
+char *ReadCheckpointRecord(char *Buffer, SIZE_T *BufferSize)
+{
+	CheckpointHeader Header;
+	SIZE_T Size;
+
+	if (fread(&Header, sizeof(CheckpointHeader), 1, CheckpointFile) != 1 || memcmp(Header.Magic, CHECKPOINT_MAGIC, 8) != 0 ||
+		Header.Version != CHECKPOINT_VERSION || Header.nNodes < 0 || Header.nResets < 0)
+	{
+		free(Buffer);
+		return NULL;
+	}
+	Size = sizeof(CheckpointHeader) + (SIZE_T)Header.nNodes*sizeof(CheckpointNode) + (SIZE_T)Header.nResets*sizeof(CheckpointReset) + 8;
+	if (Header.RecordSize != Size) {
+		free(Buffer);
+		return NULL;
+	}
+
+	if (Size > *BufferSize) {
+		free(Buffer);
+		Buffer = (char*)malloc(Size);
+		*BufferSize = Size;
+	}
+	memcpy(Buffer, &Header, sizeof(CheckpointHeader));
+	if (fread(Buffer + sizeof(CheckpointHeader), Size - sizeof(CheckpointHeader), 1, CheckpointFile) != 1 ||
+		memcmp(Buffer + Size - 8, CHECKPOINT_END, 8) != 0)
+	{
+		free(Buffer);
+		return NULL;
+	}
+
+	return Buffer;
+}
+
+
+// A checkpoint can only be resumed on the grid and source it was taken from
+bool CheckpointMatchesGrid(CheckpointHeader *Header)
+{
+	return Header->Size[0] == xSize && Header->Size[1] == ySize && Header->Size[2] == zSize &&
+		   Header->Source[0] == ImpulseSource.X && Header->Source[1] == ImpulseSource.Y && Header->Source[2] == ImpulseSource.Z &&
+		   Header->GridSpacing == GridSpacing;
+}
+
+
+// Restore the junctions of a record to the grid, those that left the active set have only their peak energy
+void ApplyCheckpointRecord(char *Buffer)
+{
+	CheckpointHeader *Header = (CheckpointHeader*)Buffer;
+	CheckpointNode *Nodes = (CheckpointNode*)(Buffer + sizeof(CheckpointHeader));
+	CheckpointReset *Resets = (CheckpointReset*)(Buffer + sizeof(CheckpointHeader) + (SIZE_T)Header->nNodes*sizeof(CheckpointNode));
+	Node *NodePtr;
+
+	for (int n=0; n<Header->nResets; n++) {
+		NodePtr = &Grid[Resets[n].X][Resets[n].Y][Resets[n].Z];
+		NodePtr->V = 0;
+		NodePtr->VxpIn = NodePtr->VxnIn = NodePtr->VypIn = NodePtr->VynIn = NodePtr->VzpIn = NodePtr->VznIn = 0;
+		NodePtr->VxpOut = NodePtr->VxnOut = NodePtr->VypOut = NodePtr->VynOut = NodePtr->VzpOut = NodePtr->VznOut = 0;
+		NodePtr->Epulse = 0;
+		NodePtr->Emax = Resets[n].Emax;
+	}
+
+	for (int n=0; n<Header->nNodes; n++) {
+		NodePtr = &Grid[Nodes[n].X][Nodes[n].Y][Nodes[n].Z];
+		NodePtr->V = Nodes[n].V;
+		NodePtr->VxpIn = Nodes[n].In[0];
+		NodePtr->VxnIn = Nodes[n].In[1];
+		NodePtr->VypIn = Nodes[n].In[2];
+		NodePtr->VynIn = Nodes[n].In[3];
+		NodePtr->VzpIn = Nodes[n].In[4];
+		NodePtr->VznIn = Nodes[n].In[5];
+		NodePtr->VxpOut = Nodes[n].Out[0];
+		NodePtr->VxnOut = Nodes[n].Out[1];
+		NodePtr->VypOut = Nodes[n].Out[2];
+		NodePtr->VynOut = Nodes[n].Out[3];
+		NodePtr->VzpOut = Nodes[n].Out[4];
+		NodePtr->VznOut = Nodes[n].Out[5];
+		NodePtr->Epulse = Nodes[n].Epulse;
+		NodePtr->Emax = Nodes[n].Emax;
+	}
+}
+
+
+// Note a junction leaving the active set of a section, called by the thread running the section. A junction is logged once
+// between checkpoints
+void LogResetJunction(int Section, int x, int y, int z)
+{
+	SectionCheckpoint *Log = &Sections[Section];
+
+	if (Grid[x][y][z].Reset == true) {
+		return;
+	}
+	Grid[x][y][z].Reset = true;
+
+	if (Log->nJunctions == Log->MaxJunctions) {
+		Log->MaxJunctions = MAX(1024, 2*Log->MaxJunctions);
+		Log->Junctions = (int(*)[3])realloc(Log->Junctions, Log->MaxJunctions*sizeof(Log->Junctions[0]));
+	}
+	Log->Junctions[Log->nJunctions][0] = x;
+	Log->Junctions[Log->nJunctions][1] = y;
+	Log->Junctions[Log->nJunctions][2] = z;
+	Log->nJunctions++;
+}
+
+
+// Whether enough iterations or time will have passed since the last checkpoint, by the end of an iteration, to take another
+bool CheckpointDue(int Iteration)
+{
+	if (CheckpointFile == NULL) {
+		return false;
+	}
+	if (CheckpointIterations > 0 && Iteration - LastIteration >= CheckpointIterations) {
+		return true;
+	}
+	if (CheckpointMinutes > 0 && difftime(time(NULL), LastTime) >= 60*CheckpointMinutes) {
+		return true;
+	}
+
+	return false;
+}
+
+
+// Start a checkpoint to be taken at the end of an iteration, before the sections connect. Waits for the output thread to
+// write the previous one, whose sections are about to be overwritten
+void BeginCheckpoint(int Iteration)
+{
+	while (RecordPending != 0) {
+		Sleep(1);
+	}
+
+	memset(&RecordHeader, 0, sizeof(CheckpointHeader));
+	memcpy(RecordHeader.Magic, CHECKPOINT_MAGIC, 8);
+	RecordHeader.Version = CHECKPOINT_VERSION;
+	RecordHeader.Iteration = Iteration;
+	RecordHeader.Size[0] = xSize;
+	RecordHeader.Size[1] = ySize;
+	RecordHeader.Size[2] = zSize;
+	RecordHeader.Source[0] = ImpulseSource.X;
+	RecordHeader.Source[1] = ImpulseSource.Y;
+	RecordHeader.Source[2] = ImpulseSource.Z;
+	RecordHeader.GridSpacing = GridSpacing;
+
+	for (int s=0; s<nCheckpointSections; s++) {
+		Sections[s].nNodes = 0;
+		Sections[s].nResets = 0;
+	}
+
+	LastIteration = Iteration;
+	LastTime = time(NULL);
+}
+
+
+// Copy the state of an active junction of a section into the checkpoint, called by the thread running the section
+void AddCheckpointJunction(int Section, int x, int y, int z)
+{
+	SectionCheckpoint *Log = &Sections[Section];
+	CheckpointNode *Entry;
+	Node *NodePtr = &Grid[x][y][z];
+
+	if (Log->nNodes == Log->MaxNodes) {
+		Log->MaxNodes = MAX(1024, 2*Log->MaxNodes);
+		Log->Nodes = (CheckpointNode*)realloc(Log->Nodes, Log->MaxNodes*sizeof(CheckpointNode));
+	}
+	Entry = &Log->Nodes[Log->nNodes++];
+
+	Entry->X = x;
+	Entry->Y = y;
+	Entry->Z = z;
+	Entry->Padding = 0;
+	Entry->V = NodePtr->V;
+	Entry->In[0] = NodePtr->VxpIn;
+	Entry->In[1] = NodePtr->VxnIn;
+	Entry->In[2] = NodePtr->VypIn;
+	Entry->In[3] = NodePtr->VynIn;
+	Entry->In[4] = NodePtr->VzpIn;
+	Entry->In[5] = NodePtr->VznIn;
+	Entry->Out[0] = NodePtr->VxpOut;
+	Entry->Out[1] = NodePtr->VxnOut;
+	Entry->Out[2] = NodePtr->VypOut;
+	Entry->Out[3] = NodePtr->VynOut;
+	Entry->Out[4] = NodePtr->VzpOut;
+	Entry->Out[5] = NodePtr->VznOut;
+	Entry->Epulse = NodePtr->Epulse;
+	Entry->Emax = NodePtr->Emax;
+}
+
+
+// Finish the part of a section with the peak energy of its logged junctions that are no longer active, the others were copied
+// with the active set. Called by the thread running the section
+void EndCheckpointSection(int Section)
+{
+	SectionCheckpoint *Log = &Sections[Section];
+
+	for (int n=0; n<Log->nJunctions; n++) {
+		int *Position = Log->Junctions[n];
+		Node *NodePtr = &Grid[Position[0]][Position[1]][Position[2]];
+
+		if (NodePtr->Active == false) {
+			if (Log->nResets == Log->MaxResets) {
+				Log->MaxResets = MAX(1024, 2*Log->MaxResets);
+				Log->Resets = (CheckpointReset*)realloc(Log->Resets, Log->MaxResets*sizeof(CheckpointReset));
+			}
+			CheckpointReset *Entry = &Log->Resets[Log->nResets++];
+			Entry->X = Position[0];
+			Entry->Y = Position[1];
+			Entry->Z = Position[2];
+			Entry->Padding = 0;
+			Entry->Emax = NodePtr->Emax;
+		}
+		NodePtr->Reset = false;
+	}
+	Log->nJunctions = 0;
+}
+
+
+// Hand the checkpoint copied by the sections to the output thread
+void EndCheckpoint(void)
+{
+	OutputRecord *OutRecord;
+
+	InterlockedExchange(&RecordPending, 1);
+	OutRecord = ReserveOutputRecord(CheckpointQueue, true);
+	OutRecord->Type = OUTPUT_CHECKPOINT;
+	OutRecord->Iteration = RecordHeader.Iteration;
+	OutRecord->nValues = 0;
+	PostOutputRecord(CheckpointQueue);
+}
+
+
+// Add the peak energy of junctions that left the active set to those to be folded into the next base
+void AddBaseResets(CheckpointReset *Resets, int nResets)
+{
+	if (nBaseResets + nResets > MaxBaseResets) {
+		MaxBaseResets = MAX(nBaseResets + nResets, 2*MaxBaseResets);
+		BaseResets = (CheckpointReset*)realloc(BaseResets, MaxBaseResets*sizeof(CheckpointReset));
+	}
+	memcpy(BaseResets + nBaseResets, Resets, nResets*sizeof(CheckpointReset));
+	nBaseResets += nResets;
+}
+
+
+// Keep only the latest peak energy of each junction to be folded into the base, the order of the entries is held in their
+// padding while they are sorted
+void FoldBaseResets(void)
+{
+	int nFolded = 0;
+
+	for (int n=0; n<nBaseResets; n++) {
+		BaseResets[n].Padding = n;
+	}
+	qsort(BaseResets, nBaseResets, sizeof(CheckpointReset), CompareBaseResets);
+
+	for (int n=0; n<nBaseResets; n++) {
+		if (n+1 < nBaseResets && BaseResets[n+1].X == BaseResets[n].X && BaseResets[n+1].Y == BaseResets[n].Y && BaseResets[n+1].Z == BaseResets[n].Z) {
+			continue;
+		}
+		BaseResets[nFolded] = BaseResets[n];
+		BaseResets[nFolded].Padding = 0;
+		nFolded++;
+	}
+	nBaseResets = nFolded;
+}
+
+
+// Order the entries to be folded by position and then by the order they were logged
+int CompareBaseResets(const void *A, const void *B)
+{
+	const CheckpointReset *a = (const CheckpointReset*)A;
+	const CheckpointReset *b = (const CheckpointReset*)B;
+
+	if (a->X != b->X) {
+		return a->X < b->X ? -1 : 1;
+	}
+	if (a->Y != b->Y) {
+		return a->Y < b->Y ? -1 : 1;
+	}
+	if (a->Z != b->Z) {
+		return a->Z < b->Z ? -1 : 1;
+	}
+	return a->Padding < b->Padding ? -1 : a->Padding > b->Padding ? 1 : 0;
+}
+
+
+// Write the record of the sections to a file. A base holds the peak energy of every junction that has left the active set
+// in place of those that left since the previous record
+bool WriteCheckpointRecord(FILE *File, bool Base)
+{
+	CheckpointHeader Header = RecordHeader;
+	bool Written = true;
+
+	for (int s=0; s<nCheckpointSections; s++) {
+		Header.nNodes += Sections[s].nNodes;
+		Header.nResets += Base == true ? 0 : Sections[s].nResets;
+	}
+	if (Base == true) {
+		Header.nResets = nBaseResets;
+	}
+	Header.RecordSize = sizeof(CheckpointHeader) + (ULONGLONG)Header.nNodes*sizeof(CheckpointNode) + (ULONGLONG)Header.nResets*sizeof(CheckpointReset) + 8;
+
+	Written &= fwrite(&Header, sizeof(CheckpointHeader), 1, File) == 1;
+	for (int s=0; s<nCheckpointSections; s++) {
+		Written &= fwrite(Sections[s].Nodes, sizeof(CheckpointNode), Sections[s].nNodes, File) == (SIZE_T)Sections[s].nNodes;
+	}
+	if (Base == true) {
+		Written &= fwrite(BaseResets, sizeof(CheckpointReset), nBaseResets, File) == (SIZE_T)nBaseResets;
+	}
+	else {
+		for (int s=0; s<nCheckpointSections; s++) {
+			Written &= fwrite(Sections[s].Resets, sizeof(CheckpointReset), Sections[s].nResets, File) == (SIZE_T)Sections[s].nResets;
+		}
+	}
+	Written &= fwrite(CHECKPOINT_END, 8, 1, File) == 1;
+	Written &= fflush(File) == 0;
+
+	return Written;
+}
+
+
+// Replace the checkpoint file with a single base record, written to a new file which takes the place of the old one once it
+// is complete
+void ReplaceCheckpointFile(void)
+{
+	FILE *Replacement;
+	bool Written = false;
+
+	FoldBaseResets();
+	if (fopen_s(&Replacement, ReplacementPath, "wb") == 0) {
+		Written = WriteCheckpointRecord(Replacement, true);
+		Written = fclose(Replacement) == 0 && Written;
+	}
+	if (Written == false) {
+		printf("Could not write checkpoint file '%s.new', the checkpoint is added to the old file\n", CheckpointFilename);
+		remove(ReplacementPath);
+		if (WriteCheckpointRecord(CheckpointFile, false) == false) {
+			printf("Could not write checkpoint to '%s'\n", CheckpointFilename);
+		}
+		nFileRecords++;
+		return;
+	}
+
+	fclose(CheckpointFile);
+	remove(CheckpointPath);
+	if (rename(ReplacementPath, CheckpointPath) != 0 || fopen_s(&CheckpointFile, CheckpointPath, "ab") != 0) {
+		printf("Could not replace checkpoint file '%s', no more checkpoints will be taken\n", CheckpointFilename);
+		CheckpointFile = NULL;
+		return;
+	}
+	nFileRecords = 1;
+}
+
+
+// Add the record to the checkpoint file, called by the output thread. Once the file holds enough records it is replaced by a
+// base, so that it stays within a few active sets and a resumed run only replays a few records
+void WriteCheckpoint(void)
+{
+	for (int s=0; s<nCheckpointSections; s++) {
+		AddBaseResets(Sections[s].Resets, Sections[s].nResets);
+	}
+
+	if (nFileRecords >= CHECKPOINT_RECORDS) {
+		ReplaceCheckpointFile();
+	}
+	else {
+		if (WriteCheckpointRecord(CheckpointFile, false) == false) {
+			printf("Could not write checkpoint to '%s'\n", CheckpointFilename);
+		}
+		nFileRecords++;
+	}
+
+	MemoryBarrier();
+	InterlockedExchange(&RecordPending, 0);
+}
+
+
+// Close and remove the checkpoint file once the iterations have finished
+void CloseCheckpoint(void)
+{
+	FlushOutput();
+
+	if (CheckpointFile != NULL) {
+		if (fclose(CheckpointFile)) {
+			printf("Checkpoint file close unsuccessful\n");
+		}
+		CheckpointFile = NULL;
+		remove(CheckpointPath);
+	}
+
+	for (int s=0; s<nCheckpointSections; s++) {
+		free(Sections[s].Junctions);
+		free(Sections[s].Nodes);
+		free(Sections[s].Resets);
+	}
+	free(Sections);
+	Sections = NULL;
+	nCheckpointSections = 0;
+	free(BaseResets);
+	BaseResets = NULL;
+	nBaseResets = 0;
+	MaxBaseResets = 0;
+}
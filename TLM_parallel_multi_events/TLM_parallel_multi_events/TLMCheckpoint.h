@@ -0,0 +1,60 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMCheckpoint.h
+//
+/*********************************************************************************************/
+
+#ifndef TLM_CHECKPOINT_H
+#define TLM_CHECKPOINT_H
+
+// Type definitions
+
+// Header of a checkpoint record. The file is a sequence of records, each followed by the state of the junctions active when it
+// was taken, the peak energy of the junctions that left the active set since the previous record, and an end marker. The first
+// record is a base, holding the peak energy of every junction that had left the active set
+typedef struct {
+				char Magic[8];				// "TLMCHKPT"
+				int Version;
+				int Iteration;				// Iterations completed when the checkpoint was taken
+				int Size[3];				// Nodes of the grid in each direction
+				int Source[3];				// Node of the source
+				double GridSpacing;
+				int nNodes;					// Active junctions, with their full state
+				int nResets;				// Junctions that left the active set, with their peak energy
+				ULONGLONG RecordSize;		// Bytes of the record, including the header and the end marker
+				} CheckpointHeader;
+
+// State of a junction active when the checkpoint was taken
+typedef struct {
+				int X, Y, Z;
+				int Padding;
+				double V;
+				double In[6];				// [Xp, Xn, Yp, Yn, Zp, Zn]
+				double Out[6];
+				double Epulse;
+				double Emax;
+				} CheckpointNode;
+
+// Peak energy of a junction no longer active, whose other state is zero
+typedef struct {
+				int X, Y, Z;
+				int Padding;
+				double Emax;
+				} CheckpointReset;
+
+// Function prototypes
+bool OpenCheckpoint(int nSections, int *Iteration, void (*ActivateJunction)(int x, int y, int z));
+void LogResetJunction(int Section, int x, int y, int z);
+bool CheckpointDue(int Iteration);
+void BeginCheckpoint(int Iteration);
+void AddCheckpointJunction(int Section, int x, int y, int z);
+void EndCheckpointSection(int Section);
+void EndCheckpoint(void);
+void WriteCheckpoint(void);
+void CloseCheckpoint(void);
+
+#endif //TLM_CHECKPOINT_H
@@ -0,0 +1,253 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMCoverage.cpp
+//
+/*********************************************************************************************/
+
+#include "stdafx.h"
+#include "TLM.h"
+#include "TLMMaths.h"
+#include "TLMScene.h"
+#include "TLMOutput.h"
+#include "TLMCoverage.h"
+
+
+// Definitions
+#define COVERAGE_FILE_MAGIC		"TLMCOVER"
+#define COVERAGE_FILE_VERSION	1
+
+
+// Type definitions
+
+// Coverage map being written by the setup threads, a column of tiles at a time
+typedef struct {
+				CoverageFileHeader *Header;
+				float *Pyramid;				// First level of the pyramid
+				char *Tiles;
+				bool WriteValues;			// Whether the pass writes the tiles as well as finding the range of each
+				} CoverageMap;
+
+
+// Global variables
+extern int xSize, ySize, zSize;
+extern double GridSpacing;
+extern double Frequency;
+extern double MaxPathLoss;
+extern char *FolderName;
+extern char *ProjectName;
+extern char *CoverageFilename;
+extern int CoverageTileSize;
+extern InputFlags InputData;
+
+
+// Function prototypes
+double NodePathLoss(int x, int y, int z);
+void CoverageTileColumn(int txMin, int txMax, void *Context);
+void ReducePyramidLevel(float *Level, int *Cells, float *NextLevel, int *NextCells);
+
+
+// Path loss of a node in dB, from its peak pulse energy
+double NodePathLoss(int x, int y, int z)
+{
+	return VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(NodeEmax(x, y, z)) * KAPPA/4/M_PI/GridSpacing);
+}
+
+
+// Find the range of path loss of each tile of the columns of tiles from txMin to txMax at every height, and write their
+// values if the pass writes them
+void CoverageTileColumn(int txMin, int txMax, void *Context)
+{
+	CoverageMap *Map = (CoverageMap*)Context;
+	CoverageFileHeader *Header = Map->Header;
+	int Tile = Header->TileSize;
+	int nTiles = Header->nTiles[0]*Header->nTiles[1];
+	double PathLoss;
+
+	for (int tx=txMin; tx<=txMax; tx++) {
+		for (int ty=0; ty<Header->nTiles[1]; ty++) {
+			char *TileData = Map->Tiles + (SIZE_T)(ty*Header->nTiles[0] + tx)*Header->TileBytes;
+			float *Range = &Map->Pyramid[2*(ty*Header->nTiles[0] + tx)];
+
+			for (int z=0; z<zSize; z++) {
+				Range[2*z*nTiles] = (float)HUGE_VAL;
+				Range[2*z*nTiles+1] = (float)-HUGE_VAL;
+			}
+
+			// The nodes of a column are read along z, where they lie together in the grid
+			for (int j=0; j<Tile; j++) {
+				int y = ty*Tile + j;
+				for (int i=0; i<Tile; i++) {
+					int x = tx*Tile + i;
+					for (int z=0; z<zSize; z++) {
+						SIZE_T Index = ((SIZE_T)z*Tile + j)*Tile + i;
+
+						PathLoss = x < xSize && y < ySize ? NodePathLoss(x, y, z) : Header->NoiseFloor;
+						if (x < xSize && y < ySize) {
+							Range[2*z*nTiles] = MIN(Range[2*z*nTiles], (float)PathLoss);
+							Range[2*z*nTiles+1] = MAX(Range[2*z*nTiles+1], (float)PathLoss);
+						}
+						if (Map->WriteValues == false) {
+							continue;
+						}
+						if (Header->Quantised != 0) {
+							double Value = floor((PathLoss - Header->Floor)/Header->Step + 0.5);
+							((unsigned char*)TileData)[Index] = (unsigned char)MIN(MAX(Value, 0), 255);
+						}
+						else {
+							((float*)TileData)[Index] = (float)PathLoss;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+
+// Combine each two by two cells of a level of the pyramid at every height into a cell of the next level
+void ReducePyramidLevel(float *Level, int *Cells, float *NextLevel, int *NextCells)
+{
+	NextCells[0] = (Cells[0]+1)/2;
+	NextCells[1] = (Cells[1]+1)/2;
+
+	for (int z=0; z<zSize; z++) {
+		float *Plane = &Level[(SIZE_T)2*z*Cells[0]*Cells[1]];
+		float *NextPlane = &NextLevel[(SIZE_T)2*z*NextCells[0]*NextCells[1]];
+
+		for (int cy=0; cy<NextCells[1]; cy++) {
+			for (int cx=0; cx<NextCells[0]; cx++) {
+				float *Range = &NextPlane[2*(cy*NextCells[0] + cx)];
+
+				Range[0] = (float)HUGE_VAL;
+				Range[1] = (float)-HUGE_VAL;
+				for (int j=2*cy; j<MIN(2*cy+2, Cells[1]); j++) {
+					for (int i=2*cx; i<MIN(2*cx+2, Cells[0]); i++) {
+						Range[0] = MIN(Range[0], Plane[2*(j*Cells[0] + i)]);
+						Range[1] = MAX(Range[1], Plane[2*(j*Cells[0] + i)+1]);
+					}
+				}
+			}
+		}
+	}
+}
+
+
+// Write the path loss of every node of the grid to a tiled coverage map with a min/max pyramid, through a view of the file
+// mapped for writing. The tiles are shared between the setup threads a column at a time. Quantised values span the lowest to
+// the highest path loss of the grid, which takes a first pass over the grid to find
+void WriteCoverageMap(void)
+{
+	char Filename[MAX_PATH];
+	HANDLE hFile, hMapping;
+	char *View = NULL;
+	CoverageFileHeader *Header;
+	CoverageFileHeader Layout;
+	CoverageMap Map;
+	int Cells[2], NextCells[2];
+	float *Level, *NextLevel;
+	SIZE_T PyramidFloats = 0;
+	ULONGLONG Bytes;
+	double Lowest, Highest;
+
+	// Find the size of the pyramid and the tiles
+	memset(&Layout, 0, sizeof(CoverageFileHeader));
+	Layout.TileSize = CoverageTileSize;
+	Layout.nTiles[0] = (xSize + CoverageTileSize-1)/CoverageTileSize;
+	Layout.nTiles[1] = (ySize + CoverageTileSize-1)/CoverageTileSize;
+	Cells[0] = Layout.nTiles[0];
+	Cells[1] = Layout.nTiles[1];
+	Layout.nLevels = 1;
+	PyramidFloats = (SIZE_T)2*zSize*Cells[0]*Cells[1];
+	while (Cells[0] > 1 || Cells[1] > 1) {
+		Cells[0] = (Cells[0]+1)/2;
+		Cells[1] = (Cells[1]+1)/2;
+		PyramidFloats += (SIZE_T)2*zSize*Cells[0]*Cells[1];
+		Layout.nLevels++;
+	}
+	Layout.Quantised = InputData.CoverageQuantise.Flag == true ? 1 : 0;
+	Layout.TileBytes = (ULONGLONG)CoverageTileSize*CoverageTileSize*zSize*(Layout.Quantised != 0 ? sizeof(unsigned char) : sizeof(float));
+	Layout.PyramidOffset = sizeof(CoverageFileHeader);
+	Layout.TilesOffset = Layout.PyramidOffset + PyramidFloats*sizeof(float);
+	Bytes = Layout.TilesOffset + (ULONGLONG)Layout.nTiles[0]*Layout.nTiles[1]*Layout.TileBytes;
+
+	sprintf_s(Filename, sizeof(Filename), "%s/%s_%s", FolderName, ProjectName, CoverageFilename);
+	hFile = CreateFile(Filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		printf("Could not open file '%s'\n", CoverageFilename);
+		return;
+	}
+	hMapping = CreateFileMapping(hFile, NULL, PAGE_READWRITE, (DWORD)(Bytes >> 32), (DWORD)Bytes, NULL);
+	if (hMapping != NULL) {
+		View = (char*)MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, 0);
+	}
+	if (View == NULL) {
+		printf("Could not map file '%s' for writing\n", CoverageFilename);
+		if (hMapping != NULL) {
+			CloseHandle(hMapping);
+		}
+		CloseHandle(hFile);
+		return;
+	}
+
+	printf("Writing coverage map of %d x %d tiles to '%s'\n", Layout.nTiles[0], Layout.nTiles[1], CoverageFilename);
+	Header = (CoverageFileHeader*)View;
+	*Header = Layout;
+	Header->Version = COVERAGE_FILE_VERSION;
+	Header->HeaderSize = sizeof(CoverageFileHeader);
+	Header->Size[0] = xSize;
+	Header->Size[1] = ySize;
+	Header->Size[2] = zSize;
+	Header->Origin[0] = NodePositionX(0);
+	Header->Origin[1] = NodePositionY(0);
+	Header->Origin[2] = NodePositionZ(0);
+	Header->GridSpacing = GridSpacing;
+	Header->Frequency = Frequency;
+	Header->NoiseFloor = MaxPathLoss;
+	Header->Floor = MaxPathLoss;
+	Header->Step = 0;
+	strcpy_s(Header->Units, sizeof(Header->Units), "dB");
+
+	// Fill the first level of the pyramid, writing the tiles at the same time unless they are quantised
+	Map.Header = Header;
+	Map.Pyramid = (float*)(View + Header->PyramidOffset);
+	Map.Tiles = View + Header->TilesOffset;
+	Map.WriteValues = Header->Quantised == 0;
+	ParallelSlabs(0, Header->nTiles[0]-1, CoverageTileColumn, (void*)&Map);
+
+	// Quantised values span the range of path loss of the grid
+	if (Header->Quantised != 0) {
+		Lowest = HUGE_VAL;
+		Highest = -HUGE_VAL;
+		for (SIZE_T n=0; n<(SIZE_T)zSize*Header->nTiles[0]*Header->nTiles[1]; n++) {
+			Lowest = MIN(Lowest, Map.Pyramid[2*n]);
+			Highest = MAX(Highest, Map.Pyramid[2*n+1]);
+		}
+		Header->Floor = Lowest;
+		Header->Step = Highest > Lowest ? (Highest - Lowest)/255 : 1;
+		Map.WriteValues = true;
+		ParallelSlabs(0, Header->nTiles[0]-1, CoverageTileColumn, (void*)&Map);
+	}
+
+	// Each further level of the pyramid follows the one it was reduced from
+	Level = Map.Pyramid;
+	Cells[0] = Header->nTiles[0];
+	Cells[1] = Header->nTiles[1];
+	for (int l=1; l<Header->nLevels; l++) {
+		NextLevel = Level + (SIZE_T)2*zSize*Cells[0]*Cells[1];
+		ReducePyramidLevel(Level, Cells, NextLevel, NextCells);
+		Level = NextLevel;
+		Cells[0] = NextCells[0];
+		Cells[1] = NextCells[1];
+	}
+
+	// The magic is written last, so that an interrupted write is never read
+	memcpy(Header->Magic, COVERAGE_FILE_MAGIC, sizeof(Header->Magic));
+	FlushViewOfFile(View, 0);
+	UnmapViewOfFile(View);
+	CloseHandle(hMapping);
+	CloseHandle(hFile);
+}
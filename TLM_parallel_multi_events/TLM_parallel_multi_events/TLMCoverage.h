@@ -0,0 +1,45 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMCoverage.h
+//
+/*********************************************************************************************/
+
+#ifndef TLM_COVERAGE_H
+#define TLM_COVERAGE_H
+
+// Type definitions
+
+// Header at the start of a coverage map file. The min/max pyramid follows at PyramidOffset, then the tiles at TilesOffset.
+// Each level of the pyramid holds a minimum and maximum path loss as floats for every cell of every height, x varying fastest
+// then y then the height. The cells of the first level are the tiles, each further level halves the cells along x and y until
+// there is one. A tile holds TileSize x TileSize columns of nodes at every height, x varying fastest then y then the height,
+// the tiles in turn along x then y. The nodes of a tile beyond the grid are given the noise floor
+typedef struct {
+				char Magic[8];				// Written last, so an interrupted write is never read
+				int Version;
+				int HeaderSize;
+				int Size[3];				// Nodes of the grid along each axis
+				int TileSize;				// Nodes along x and y of a tile
+				int nTiles[2];				// Tiles along x and y
+				int nLevels;				// Levels of the pyramid
+				int Quantised;				// Path loss stored as bytes, Floor + Step*value, rather than floats
+				double Origin[3];			// Position of the first node in metres
+				double GridSpacing;
+				double Frequency;
+				double NoiseFloor;			// Path loss given to nodes the pulse never reached
+				double Floor;				// Path loss of a quantised value of zero
+				double Step;				// Path loss between quantised values
+				ULONGLONG PyramidOffset;	// Bytes from the start of the file to the pyramid
+				ULONGLONG TilesOffset;		// Bytes from the start of the file to the first tile
+				ULONGLONG TileBytes;		// Bytes of each tile
+				char Units[8];				// Units of the path loss values
+				} CoverageFileHeader;
+
+// Function prototypes
+void WriteCoverageMap(void);
+
+#endif //TLM_COVERAGE_H
@@ -0,0 +1,691 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMDomain.cpp
+//
+/*********************************************************************************************/
+
+#include "stdafx.h"
+#include "TLM.h"
+#include "TLMMaths.h"
+#include "TLMDomain.h"
+#include "TLMOutput.h"
+
+
+// Definitions
+#define RING_SLOTS			4		// Faces a process can send before its neighbour has read the oldest
+#define RING_HEADER_BYTES	64		// Space for the counters at the start of each ring, keeping them on their own cache line
+
+
+// Type definitions
+
+// Counters shared between the coordinator and the processes running the slabs
+typedef struct {
+				volatile LONG Posted[MAX_DOMAIN_RANKS];		// Last iteration each process has posted its active junctions for
+				volatile LONG Active[MAX_DOMAIN_RANKS];		// Active junctions of each process after that iteration
+				volatile LONG Decided;						// Last iteration the coordinator has decided on
+				volatile LONG Continue;						// Whether the processes continue after the decided iteration
+				volatile LONG ResultsPosted;				// Processes that have written their peak energies
+				volatile LONG Abandoned;					// Set by the coordinator when it gives up the job
+				DWORD Coordinator;							// Process identifier of the coordinator
+				} SharedControl;
+
+// Counters of a ring carrying the faces sent from one process to its neighbour
+typedef struct {
+				volatile LONG Written;		// Last iteration written to the ring
+				volatile LONG Read;			// Last iteration read from the ring
+				} SharedRing;
+
+
+// Global variables
+double *DomainResults = NULL;			// Peak energy of every node gathered by the coordinator, NULL until the processes finish
+
+static int DomainRank = -1;				// Rank of this process in a split domain, -1 for the coordinator or a single process
+static char *DomainJob = NULL;			// Name of the job shared by the coordinator and its processes
+static UCHAR *FrontierFlags[2];			// Junctions of each neighbouring face reached by this process during the scatter
+static UCHAR *FrontierBitmap;			// Frontier flags packed for the transport
+static double *FaceValues;				// Outputs of a face packed for the transport
+static HANDLE *hRankProcesses;
+
+// Shared memory transport
+static HANDLE hSharedMapping = NULL;
+static char *SharedView = NULL;
+static SharedControl *Control;
+static double *SharedResults;
+static HANDLE hSharedCoordinator = NULL;
+static int SharedRank;
+static int SharedRanks;
+static int SharedFaceNodes;
+static SIZE_T ControlBytes;
+static SIZE_T SlotBytes;
+static SIZE_T ActivityBytes;
+static SIZE_T RingBytes;
+
+extern Node ***Grid;
+extern int xSize, ySize, zSize;
+extern int Processes;
+extern char *InputFilename;
+
+
+// Function prototypes
+bool HasNeighbour(int Face);
+bool RankFailed(void);
+bool SharedMemoryCreate(char *Job, int nRanks, int nFaceNodes, SIZE_T nNodes);
+bool SharedMemoryAttach(char *Job, int Rank, int nRanks, int nFaceNodes, SIZE_T nNodes);
+SIZE_T SharedMemoryLayout(int nRanks, int nFaceNodes, SIZE_T nNodes);
+SharedRing *SharedMemoryRing(int From, int To);
+void SharedMemorySendFace(int Face, LONG Iteration, double *Out, UCHAR *Frontier);
+void SharedMemoryReceiveFace(int Face, LONG Iteration, double *Out, UCHAR *Frontier);
+void SharedMemoryPostActive(LONG Iteration, LONG ActiveJunctions);
+bool SharedMemoryPollActive(LONG Iteration, LONG *ActiveJunctions);
+void SharedMemoryPostDecision(LONG Iteration, bool Continue);
+bool SharedMemoryWaitForDecision(LONG Iteration);
+void SharedMemorySendActivity(int Face, UCHAR *Active);
+void SharedMemoryReceiveActivity(int Face, UCHAR *Active);
+void SharedMemoryAbandon(void);
+void SharedMemoryYield(void);
+void SharedMemorySendResults(int xMin, int xMax, double *Emax);
+double *SharedMemoryPollResults(void);
+void SharedMemoryClose(void);
+
+
+// Processes on a single host share named memory, another transport only needs to provide the same operations
+DomainTransport SharedMemoryTransport = {
+				"shared memory",
+				SharedMemoryCreate,
+				SharedMemoryAttach,
+				SharedMemorySendFace,
+				SharedMemoryReceiveFace,
+				SharedMemoryPostActive,
+				SharedMemoryPollActive,
+				SharedMemoryPostDecision,
+				SharedMemoryWaitForDecision,
+				SharedMemorySendActivity,
+				SharedMemoryReceiveActivity,
+				SharedMemoryAbandon,
+				SharedMemorySendResults,
+				SharedMemoryPollResults,
+				SharedMemoryClose
+				};
+
+static DomainTransport *Transport = &SharedMemoryTransport;
+
+
+// Set the rank of this process and the job it belongs to, when started by a coordinator
+void SetDomainRank(int Rank, char *Job)
+{
+	DomainRank = Rank;
+	DomainJob = _strdup(Job);
+}
+
+
+// Return true if this process starts and coordinates the processes sharing the grid
+bool DomainCoordinator(void)
+{
+	return Processes > 1 && DomainRank < 0;
+}
+
+
+// Return true if this process runs a slab of a grid shared with other processes
+bool DomainMember(void)
+{
+	return DomainRank >= 0;
+}
+
+
+// Return the first row in the x-direction owned by this process
+int FirstOwnedRow(void)
+{
+	if (DomainRank < 0) {
+		return 0;
+	}
+	return DomainRank*xSize/Processes;
+}
+
+
+// Return the last row in the x-direction owned by this process
+int LastOwnedRow(void)
+{
+	if (DomainRank < 0) {
+		return xSize-1;
+	}
+	return (DomainRank+1)*xSize/Processes-1;
+}
+
+
+// Return the first row of the grid held by this process, including the halo of the slab
+int FirstAllocatedRow(void)
+{
+	return MAX(FirstOwnedRow()-1, 0);
+}
+
+
+// Return the last row of the grid held by this process, including the halo of the slab
+int LastAllocatedRow(void)
+{
+	return MIN(LastOwnedRow()+1, xSize-1);
+}
+
+
+// Return true if the face of the slab given is shared with another process
+bool HasNeighbour(int Face)
+{
+	if (Face == DOMAIN_XN) {
+		return DomainRank > 0;
+	}
+	return DomainRank >= 0 && DomainRank < Processes-1;
+}
+
+
+// Start a process for each slab of the grid and decide after every iteration whether they continue, until none has active junctions.
+// The peak energies of the whole grid are then gathered into DomainResults
+bool RunDomainCoordinator(void)
+{
+	char Job[32];
+	char ModuleName[MAX_PATH];
+	char *CommandLine;
+	SIZE_T CommandLineSize;
+	STARTUPINFO StartupInfo;
+	PROCESS_INFORMATION ProcessInformation;
+	OutputQueue *StatusQueue;
+	OutputRecord *Record;
+	LONG ActiveJunctions;
+	bool Successful = true;
+
+	if (Processes > xSize) {
+		printf("The grid is %d nodes long, too short to be split between %d processes\n", xSize, Processes);
+		return false;
+	}
+
+	sprintf_s(Job, sizeof(Job), "TLM_Domain_%lu", GetCurrentProcessId());
+	if (Transport->Create(Job, Processes, ySize*zSize, (SIZE_T)xSize*ySize*zSize) == false) {
+		printf("Could not create the %s transport for job '%s'\n", Transport->Name, Job);
+		return false;
+	}
+
+	// Each process is started with the same input file and told its rank
+	GetModuleFileName(NULL, ModuleName, MAX_PATH);
+	CommandLineSize = strlen(ModuleName) + strlen(InputFilename) + strlen(Job) + 64;
+	CommandLine = (char*)malloc(CommandLineSize*sizeof(char));
+	hRankProcesses = (HANDLE*)malloc(Processes*sizeof(HANDLE));
+
+	for (int r=0; r<Processes; r++) {
+		sprintf_s(CommandLine, CommandLineSize, "\"%s\" \"%s\" -rank %d -job %s", ModuleName, InputFilename, r, Job);
+		ZeroMemory(&StartupInfo, sizeof(StartupInfo));
+		StartupInfo.cb = sizeof(StartupInfo);
+		if (CreateProcess(NULL, CommandLine, NULL, NULL, FALSE, 0, NULL, NULL, &StartupInfo, &ProcessInformation) == 0) {
+			printf("Process %d could not be started\n", r+1);
+			for (int i=0; i<r; i++) {
+				TerminateProcess(hRankProcesses[i], 1);
+				CloseHandle(hRankProcesses[i]);
+			}
+			free(hRankProcesses);
+			free(CommandLine);
+			Transport->Close();
+			return false;
+		}
+		CloseHandle(ProcessInformation.hThread);
+		hRankProcesses[r] = ProcessInformation.hProcess;
+	}
+	free(CommandLine);
+	printf("Grid split between %d processes, exchanging halos through %s\n", Processes, Transport->Name);
+	StatusQueue = OpenOutputQueue(1);
+
+	// Sum the active junctions of the processes after each iteration, they stop together once every slab is empty
+	for (LONG Iteration=1; Successful == true; Iteration++) {
+		while (Transport->PollActive(Iteration, &ActiveJunctions) == false) {
+			if (RankFailed() == true) {
+				Successful = false;
+				break;
+			}
+			Sleep(0);
+		}
+		if (Successful == true) {
+			Transport->PostDecision(Iteration, ActiveJunctions > 0);
+
+			// The status is written by the output thread, and dropped if it has fallen behind
+			Record = ReserveOutputRecord(StatusQueue, false);
+			if (Record != NULL) {
+				Record->Type = OUTPUT_DOMAIN_STATUS;
+				Record->Iteration = Iteration;
+				Record->nValues = 1;
+				Record->Values[0] = ActiveJunctions;
+				PostOutputRecord(StatusQueue);
+			}
+			if (ActiveJunctions == 0) {
+				FlushOutput();
+				printf("Algorithm complete, took %d iterations\n", Iteration);
+				break;
+			}
+		}
+	}
+
+	// Gather the peak energies written by the processes
+	while (Successful == true && (DomainResults = Transport->PollResults()) == NULL) {
+		if (RankFailed() == true) {
+			Successful = false;
+		}
+		Sleep(1);
+	}
+
+	if (Successful == false) {
+		printf("A process sharing the grid failed, stopping the others\n");
+		Transport->Abandon();
+		for (int r=0; r<Processes; r++) {
+			TerminateProcess(hRankProcesses[r], 1);
+		}
+	}
+	WaitForMultipleObjects(Processes, hRankProcesses, true, INFINITE);
+	for (int r=0; r<Processes; r++) {
+		CloseHandle(hRankProcesses[r]);
+	}
+	free(hRankProcesses);
+
+	return Successful;
+}
+
+
+// Return true if a process sharing the grid has exited with an error
+bool RankFailed(void)
+{
+	DWORD ExitCode;
+
+	for (int r=0; r<Processes; r++) {
+		if (GetExitCodeProcess(hRankProcesses[r], &ExitCode) != 0 && ExitCode != STILL_ACTIVE && ExitCode != 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+// Attach this process to the transport of its coordinator and allocate the buffers for its faces
+bool JoinDomain(void)
+{
+	int nFaceNodes = ySize*zSize;
+
+	if (Transport->Attach(DomainJob, DomainRank, Processes, nFaceNodes, (SIZE_T)xSize*ySize*zSize) == false) {
+		printf("Process %d could not attach to the %s transport of job '%s'\n", DomainRank+1, Transport->Name, DomainJob);
+		return false;
+	}
+
+	FrontierFlags[DOMAIN_XN] = (UCHAR*)calloc(nFaceNodes, sizeof(UCHAR));
+	FrontierFlags[DOMAIN_XP] = (UCHAR*)calloc(nFaceNodes, sizeof(UCHAR));
+	FrontierBitmap = (UCHAR*)malloc((nFaceNodes+7)/8*sizeof(UCHAR));
+	FaceValues = (double*)malloc(nFaceNodes*sizeof(double));
+
+	printf("Process %d running rows %d to %d of %d\n", DomainRank+1, FirstOwnedRow(), LastOwnedRow(), xSize);
+
+	return true;
+}
+
+
+// Record that a junction on a face of the slab has reached the neighbouring process's first row. Each node has its own flag,
+// so the sections along the face can mark it without synchronising
+void MarkDomainFrontier(int Face, int y, int z)
+{
+	FrontierFlags[Face][y*zSize + z] = 1;
+}
+
+
+// Send the outputs and frontier of each shared face to the neighbouring process, then copy the neighbours' outputs into the
+// halo rows and activate the junctions they have reached. Called between the scatter and connect of an iteration
+void ExchangeDomainFaces(LONG Iteration, FrontierFunction Activate)
+{
+	int nFaceNodes = ySize*zSize;
+	int x, n;
+
+	for (int Face=DOMAIN_XN; Face<=DOMAIN_XP; Face++) {
+		if (HasNeighbour(Face) == false) {
+			continue;
+		}
+		x = Face == DOMAIN_XN ? FirstOwnedRow() : LastOwnedRow();
+		memset(FrontierBitmap, 0, (nFaceNodes+7)/8*sizeof(UCHAR));
+		for (int y=0; y<ySize; y++) {
+			for (int z=0; z<zSize; z++) {
+				n = y*zSize + z;
+				FaceValues[n] = Face == DOMAIN_XN ? Grid[x][y][z].VxnOut : Grid[x][y][z].VxpOut;
+				if (FrontierFlags[Face][n] != 0) {
+					FrontierBitmap[n/8] |= (UCHAR)(1 << (n%8));
+					FrontierFlags[Face][n] = 0;
+				}
+			}
+		}
+		Transport->SendFace(Face, Iteration, FaceValues, FrontierBitmap);
+	}
+
+	for (int Face=DOMAIN_XN; Face<=DOMAIN_XP; Face++) {
+		if (HasNeighbour(Face) == false) {
+			continue;
+		}
+		x = Face == DOMAIN_XN ? FirstOwnedRow()-1 : LastOwnedRow()+1;
+		Transport->ReceiveFace(Face, Iteration, FaceValues, FrontierBitmap);
+		for (int y=0; y<ySize; y++) {
+			for (int z=0; z<zSize; z++) {
+				n = y*zSize + z;
+				if (Face == DOMAIN_XN) {
+					Grid[x][y][z].VxpOut = FaceValues[n];
+				}
+				else {
+					Grid[x][y][z].VxnOut = FaceValues[n];
+				}
+				if ((FrontierBitmap[n/8] >> (n%8)) & 1) {
+					Activate(Face == DOMAIN_XN ? x+1 : x-1, y, z);
+				}
+			}
+		}
+	}
+}
+
+
+// Post the active junctions of this process after an iteration, returns true once the coordinator has found every process empty.
+// The active flags of the halo rows are then updated from the neighbours' faces, so that the next scatter only hands a junction
+// across a face when the neighbour does not already hold it
+bool DomainIterationComplete(LONG Iteration, LONG ActiveJunctions)
+{
+	int nFaceNodes = ySize*zSize;
+	bool Complete;
+	int x, n;
+
+	for (int Face=DOMAIN_XN; Face<=DOMAIN_XP; Face++) {
+		if (HasNeighbour(Face) == false) {
+			continue;
+		}
+		x = Face == DOMAIN_XN ? FirstOwnedRow() : LastOwnedRow();
+		memset(FrontierBitmap, 0, (nFaceNodes+7)/8*sizeof(UCHAR));
+		for (int y=0; y<ySize; y++) {
+			for (int z=0; z<zSize; z++) {
+				n = y*zSize + z;
+				if (Grid[x][y][z].Active == true) {
+					FrontierBitmap[n/8] |= (UCHAR)(1 << (n%8));
+				}
+			}
+		}
+		Transport->SendActivity(Face, FrontierBitmap);
+	}
+
+	Transport->PostActive(Iteration, ActiveJunctions);
+	Complete = Transport->WaitForDecision(Iteration) == false;
+
+	for (int Face=DOMAIN_XN; Face<=DOMAIN_XP; Face++) {
+		if (Complete == true || HasNeighbour(Face) == false) {
+			continue;
+		}
+		x = Face == DOMAIN_XN ? FirstOwnedRow()-1 : LastOwnedRow()+1;
+		Transport->ReceiveActivity(Face, FrontierBitmap);
+		for (int y=0; y<ySize; y++) {
+			for (int z=0; z<zSize; z++) {
+				n = y*zSize + z;
+				Grid[x][y][z].Active = ((FrontierBitmap[n/8] >> (n%8)) & 1) != 0;
+			}
+		}
+	}
+
+	return Complete;
+}
+
+
+// Send the peak energies of the rows owned by this process to the coordinator
+void SendDomainResults(void)
+{
+	int xMin = FirstOwnedRow();
+	int xMax = LastOwnedRow();
+	double *Emax;
+	SIZE_T n = 0;
+
+	Emax = (double*)malloc((SIZE_T)(xMax-xMin+1)*ySize*zSize*sizeof(double));
+	for (int x=xMin; x<=xMax; x++) {
+		for (int y=0; y<ySize; y++) {
+			for (int z=0; z<zSize; z++) {
+				Emax[n++] = Grid[x][y][z].Emax;
+			}
+		}
+	}
+	Transport->SendResults(xMin, xMax, Emax);
+	free(Emax);
+}
+
+
+// Release the transport and the face buffers
+void CloseDomain(void)
+{
+	Transport->Close();
+	DomainResults = NULL;
+
+	if (DomainRank >= 0) {
+		free(FrontierFlags[DOMAIN_XN]);
+		free(FrontierFlags[DOMAIN_XP]);
+		free(FrontierBitmap);
+		free(FaceValues);
+	}
+}
+
+
+// Create the named memory shared by the coordinator and the processes, pagefile backed memory starts zeroed
+bool SharedMemoryCreate(char *Job, int nRanks, int nFaceNodes, SIZE_T nNodes)
+{
+	ULONGLONG Bytes = SharedMemoryLayout(nRanks, nFaceNodes, nNodes);
+
+	hSharedMapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(Bytes >> 32), (DWORD)Bytes, Job);
+	if (hSharedMapping == NULL) {
+		return false;
+	}
+	SharedView = (char*)MapViewOfFile(hSharedMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (SharedView == NULL) {
+		CloseHandle(hSharedMapping);
+		return false;
+	}
+	Control = (SharedControl*)SharedView;
+	SharedResults = (double*)(SharedView + ControlBytes + 2*(nRanks-1)*RingBytes);
+	SharedRank = -1;
+	Control->Coordinator = GetCurrentProcessId();
+
+	return true;
+}
+
+
+// Open the named memory created by the coordinator
+bool SharedMemoryAttach(char *Job, int Rank, int nRanks, int nFaceNodes, SIZE_T nNodes)
+{
+	SharedMemoryLayout(nRanks, nFaceNodes, nNodes);
+
+	hSharedMapping = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, Job);
+	if (hSharedMapping == NULL) {
+		return false;
+	}
+	SharedView = (char*)MapViewOfFile(hSharedMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (SharedView == NULL) {
+		CloseHandle(hSharedMapping);
+		return false;
+	}
+	Control = (SharedControl*)SharedView;
+	SharedResults = (double*)(SharedView + ControlBytes + 2*(nRanks-1)*RingBytes);
+	SharedRank = Rank;
+
+	// The processes watch the coordinator while they wait, so that none is left spinning if it exits
+	hSharedCoordinator = OpenProcess(SYNCHRONIZE, FALSE, Control->Coordinator);
+
+	return true;
+}
+
+
+// Calculate the size of the rings in the shared memory and return its total size. The control block is followed by a ring for each
+// direction between neighbouring processes, each ending with the activity of its face, then the peak energy of every node
+SIZE_T SharedMemoryLayout(int nRanks, int nFaceNodes, SIZE_T nNodes)
+{
+	ControlBytes = RING_HEADER_BYTES*((sizeof(SharedControl)+RING_HEADER_BYTES-1)/RING_HEADER_BYTES);
+	SharedRanks = nRanks;
+	SharedFaceNodes = nFaceNodes;
+	SlotBytes = 8*((nFaceNodes*sizeof(double) + (nFaceNodes+7)/8 + 7)/8);
+	ActivityBytes = 8*(((nFaceNodes+7)/8 + 7)/8);
+	RingBytes = RING_HEADER_BYTES + RING_SLOTS*SlotBytes + ActivityBytes;
+
+	return ControlBytes + 2*(nRanks-1)*RingBytes + nNodes*sizeof(double);
+}
+
+
+// Return the ring carrying faces from one process to a neighbour
+SharedRing *SharedMemoryRing(int From, int To)
+{
+	int Link = From < To ? 2*From : 2*To+1;
+
+	return (SharedRing*)(SharedView + ControlBytes + Link*RingBytes);
+}
+
+
+// Write a face into the next slot of the ring to the neighbour, waiting if the neighbour has fallen a full ring behind
+void SharedMemorySendFace(int Face, LONG Iteration, double *Out, UCHAR *Frontier)
+{
+	SharedRing *Ring = SharedMemoryRing(SharedRank, Face == DOMAIN_XN ? SharedRank-1 : SharedRank+1);
+	char *Slot = (char*)Ring + RING_HEADER_BYTES + (Iteration%RING_SLOTS)*SlotBytes;
+
+	while (Iteration - Ring->Read > RING_SLOTS) {
+		SharedMemoryYield();
+	}
+	memcpy(Slot, Out, SharedFaceNodes*sizeof(double));
+	memcpy(Slot + SharedFaceNodes*sizeof(double), Frontier, (SharedFaceNodes+7)/8);
+	MemoryBarrier();
+	InterlockedExchange(&Ring->Written, Iteration);
+}
+
+
+// Read the face of an iteration from the ring from the neighbour, waiting until it has been written
+void SharedMemoryReceiveFace(int Face, LONG Iteration, double *Out, UCHAR *Frontier)
+{
+	SharedRing *Ring = SharedMemoryRing(Face == DOMAIN_XN ? SharedRank-1 : SharedRank+1, SharedRank);
+	char *Slot = (char*)Ring + RING_HEADER_BYTES + (Iteration%RING_SLOTS)*SlotBytes;
+
+	while (Ring->Written < Iteration) {
+		SharedMemoryYield();
+	}
+	MemoryBarrier();
+	memcpy(Out, Slot, SharedFaceNodes*sizeof(double));
+	memcpy(Frontier, Slot + SharedFaceNodes*sizeof(double), (SharedFaceNodes+7)/8);
+	InterlockedExchange(&Ring->Read, Iteration);
+}
+
+
+// Post the active junctions of this process after an iteration
+void SharedMemoryPostActive(LONG Iteration, LONG ActiveJunctions)
+{
+	Control->Active[SharedRank] = ActiveJunctions;
+	MemoryBarrier();
+	InterlockedExchange(&Control->Posted[SharedRank], Iteration);
+}
+
+
+// Sum the active junctions of the processes if every one has posted the iteration given
+bool SharedMemoryPollActive(LONG Iteration, LONG *ActiveJunctions)
+{
+	for (int r=0; r<SharedRanks; r++) {
+		if (Control->Posted[r] < Iteration) {
+			return false;
+		}
+	}
+	MemoryBarrier();
+
+	*ActiveJunctions = 0;
+	for (int r=0; r<SharedRanks; r++) {
+		*ActiveJunctions += Control->Active[r];
+	}
+
+	return true;
+}
+
+
+// Tell the processes whether to continue after an iteration
+void SharedMemoryPostDecision(LONG Iteration, bool Continue)
+{
+	Control->Continue = Continue == true ? 1 : 0;
+	MemoryBarrier();
+	InterlockedExchange(&Control->Decided, Iteration);
+}
+
+
+// Wait for the coordinator to decide on an iteration, returns true if the processes continue
+bool SharedMemoryWaitForDecision(LONG Iteration)
+{
+	while (Control->Decided < Iteration) {
+		SharedMemoryYield();
+	}
+	MemoryBarrier();
+
+	return Control->Continue != 0;
+}
+
+
+// Write the active flags of the owned row on a face into the ring to the neighbour, it is not read until the iteration is decided
+void SharedMemorySendActivity(int Face, UCHAR *Active)
+{
+	SharedRing *Ring = SharedMemoryRing(SharedRank, Face == DOMAIN_XN ? SharedRank-1 : SharedRank+1);
+
+	memcpy((char*)Ring + RING_HEADER_BYTES + RING_SLOTS*SlotBytes, Active, (SharedFaceNodes+7)/8);
+}
+
+
+// Read the active flags of the neighbour's row on a face from the ring from the neighbour
+void SharedMemoryReceiveActivity(int Face, UCHAR *Active)
+{
+	SharedRing *Ring = SharedMemoryRing(Face == DOMAIN_XN ? SharedRank-1 : SharedRank+1, SharedRank);
+
+	memcpy(Active, (char*)Ring + RING_HEADER_BYTES + RING_SLOTS*SlotBytes, (SharedFaceNodes+7)/8);
+}
+
+
+// Tell the processes that the coordinator has given up the job
+void SharedMemoryAbandon(void)
+{
+	InterlockedExchange(&Control->Abandoned, 1);
+}
+
+
+// Give up the processor while waiting on the coordinator or a neighbour, stopping this process if the coordinator has given up the
+// job or exited. A neighbour that fails is found by the coordinator, which then gives up the job
+void SharedMemoryYield(void)
+{
+	if (Control->Abandoned != 0 || (hSharedCoordinator != NULL && WaitForSingleObject(hSharedCoordinator, 0) == WAIT_OBJECT_0)) {
+		printf("Process %d lost its coordinator, stopping\n", SharedRank+1);
+		exit(1);
+	}
+	Sleep(0);
+}
+
+
+// Write the peak energies of a slab of rows into the results
+void SharedMemorySendResults(int xMin, int xMax, double *Emax)
+{
+	memcpy(SharedResults + (SIZE_T)xMin*SharedFaceNodes, Emax, (SIZE_T)(xMax-xMin+1)*SharedFaceNodes*sizeof(double));
+	MemoryBarrier();
+	InterlockedIncrement(&Control->ResultsPosted);
+}
+
+
+// Return the results once every process has written its slab
+double *SharedMemoryPollResults(void)
+{
+	if (Control->ResultsPosted < SharedRanks) {
+		return NULL;
+	}
+	MemoryBarrier();
+
+	return SharedResults;
+}
+
+
+// Unmap the shared memory
+void SharedMemoryClose(void)
+{
+	if (SharedView != NULL) {
+		UnmapViewOfFile(SharedView);
+		CloseHandle(hSharedMapping);
+		SharedView = NULL;
+	}
+	if (hSharedCoordinator != NULL) {
+		CloseHandle(hSharedCoordinator);
+		hSharedCoordinator = NULL;
+	}
+}
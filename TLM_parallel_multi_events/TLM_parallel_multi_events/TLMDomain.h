@@ -0,0 +1,61 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMDomain.h
+//
+/*********************************************************************************************/
+
+#ifndef TLM_DOMAIN_H
+#define TLM_DOMAIN_H
+
+// Definitions
+#define MAX_DOMAIN_RANKS	64		// Maximum number of processes the grid can be split between
+#define DOMAIN_XN			0		// Face of a slab shared with the process owning the rows below it
+#define DOMAIN_XP			1		// Face of a slab shared with the process owning the rows above it
+
+// Type definitions
+
+// Operations of the transport carrying halos, active junction counts and results between the processes sharing the grid.
+// Faces are sent by iteration and received in the same order, the polling operations return false until the data is ready.
+// The activity of a face is sent before the active junctions are posted, and can be received once the coordinator has decided
+typedef struct {
+				char *Name;
+				bool (*Create)(char *Job, int nRanks, int nFaceNodes, SIZE_T nNodes);
+				bool (*Attach)(char *Job, int Rank, int nRanks, int nFaceNodes, SIZE_T nNodes);
+				void (*SendFace)(int Face, LONG Iteration, double *Out, UCHAR *Frontier);
+				void (*ReceiveFace)(int Face, LONG Iteration, double *Out, UCHAR *Frontier);
+				void (*PostActive)(LONG Iteration, LONG ActiveJunctions);
+				bool (*PollActive)(LONG Iteration, LONG *ActiveJunctions);
+				void (*PostDecision)(LONG Iteration, bool Continue);
+				bool (*WaitForDecision)(LONG Iteration);
+				void (*SendActivity)(int Face, UCHAR *Active);
+				void (*ReceiveActivity)(int Face, UCHAR *Active);
+				void (*Abandon)(void);
+				void (*SendResults)(int xMin, int xMax, double *Emax);
+				double *(*PollResults)(void);
+				void (*Close)(void);
+				} DomainTransport;
+
+// Function run on each junction of a face that the neighbouring process has reached
+typedef void (*FrontierFunction)(int x, int y, int z);
+
+// Function prototypes
+void SetDomainRank(int Rank, char *Job);
+bool DomainCoordinator(void);
+bool DomainMember(void);
+int FirstOwnedRow(void);
+int LastOwnedRow(void);
+int FirstAllocatedRow(void);
+int LastAllocatedRow(void);
+bool RunDomainCoordinator(void);
+bool JoinDomain(void);
+void MarkDomainFrontier(int Face, int y, int z);
+void ExchangeDomainFaces(LONG Iteration, FrontierFunction Activate);
+bool DomainIterationComplete(LONG Iteration, LONG ActiveJunctions);
+void SendDomainResults(void);
+void CloseDomain(void);
+
+#endif //TLM_DOMAIN_H
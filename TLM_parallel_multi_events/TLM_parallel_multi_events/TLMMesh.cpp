@@ -0,0 +1,331 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMMesh.cpp
+//
+/*********************************************************************************************/
+
+// Header files
+#include "stdafx.h"
+#include "TLMMaths.h"
+#include "TLMMesh.h"
+
+
+// Definitions
+#define MESH_GROWTH		1024	// Initial number of vertices and triangles allocated, doubled whenever they are full
+
+
+// Type definitions
+
+// Position of the reader within the mapped mesh file
+typedef struct {
+				const char *Next;			// Start of the next line
+				const char *End;			// End of the file
+				const char *LineStart;
+				const char *LineEnd;
+				const char *Cursor;			// Position of the next token on the line
+				int Line;
+				char *Filename;
+				} MeshReader;
+
+
+// Function prototypes
+bool NextMeshLine(MeshReader *Reader);
+bool NextMeshToken(MeshReader *Reader, const char **Token, int *Length);
+bool ReadMeshVertex(MeshReader *Reader, Mesh *MeshPtr);
+bool ReadMeshFace(MeshReader *Reader, Mesh *MeshPtr, int Material, int **FaceVertices, int *FaceSize);
+int AddMeshMaterial(Mesh *MeshPtr, const char *Name, int Length);
+void MeshError(MeshReader *Reader, const char *Position, const char *Message);
+
+
+// Read the vertices, faces and materials of a Wavefront OBJ file. Texture coordinates, normals, groups and smoothing are
+// ignored, returns NULL if the file cannot be read
+Mesh *ReadMeshFile(char *Filename)
+{
+	MeshReader Reader;
+	Mesh *MeshPtr;
+	HANDLE hFile, hMapping = NULL;
+	LARGE_INTEGER FileSize;
+	const char *View = NULL;
+	const char *Token;
+	int Length;
+	int Material = -1;
+	int *FaceVertices = NULL;		// Vertices of the face being read, kept between faces
+	int FaceSize = 0;
+	bool SuccessfulRead = true;
+
+	// Attempt to open and map the mesh file, an empty file has no mapping
+	hFile = CreateFile(Filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		printf("Could not open mesh file '%s'\n", Filename);
+		return NULL;
+	}
+	GetFileSizeEx(hFile, &FileSize);
+	if (FileSize.QuadPart > 0) {
+		hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (hMapping != NULL) {
+			View = (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+		}
+		if (View == NULL) {
+			printf("Could not map mesh file '%s'\n", Filename);
+			if (hMapping != NULL) {
+				CloseHandle(hMapping);
+			}
+			CloseHandle(hFile);
+			return NULL;
+		}
+	}
+
+	printf("Reading mesh file '%s'\n", Filename);
+
+	MeshPtr = (Mesh*)calloc(1, sizeof(Mesh));
+	MeshPtr->Filename = _strdup(Filename);
+
+	Reader.Next = View;
+	Reader.End = View + (SIZE_T)FileSize.QuadPart;
+	Reader.Line = 0;
+	Reader.Filename = Filename;
+
+	while (SuccessfulRead == true && NextMeshLine(&Reader) == true) {
+		if (NextMeshToken(&Reader, &Token, &Length) == false) {
+			continue;
+		}
+		if (Length == 1 && Token[0] == 'v') {
+			SuccessfulRead = ReadMeshVertex(&Reader, MeshPtr);
+		}
+		else if (Length == 1 && Token[0] == 'f') {
+			SuccessfulRead = ReadMeshFace(&Reader, MeshPtr, Material, &FaceVertices, &FaceSize);
+		}
+		else if (Length == 6 && strncmp(Token, "usemtl", 6) == 0) {
+			if (NextMeshToken(&Reader, &Token, &Length) == false) {
+				MeshError(&Reader, Reader.Cursor, "missing material name");
+				SuccessfulRead = false;
+			}
+			else {
+				Material = AddMeshMaterial(MeshPtr, Token, Length);
+			}
+		}
+	}
+	free(FaceVertices);
+
+	// Faces may refer to vertices given after them, so the indices are checked once every vertex is read
+	for (int t=0; t<3*MeshPtr->nTriangles && SuccessfulRead == true; t++) {
+		if (MeshPtr->Triangles[t] < 0 || MeshPtr->Triangles[t] >= MeshPtr->nVertices) {
+			printf("Error in mesh file '%s': face refers to vertex %d of %d\n", Filename, MeshPtr->Triangles[t]+1, MeshPtr->nVertices);
+			SuccessfulRead = false;
+		}
+	}
+
+	if (View != NULL) {
+		UnmapViewOfFile(View);
+		CloseHandle(hMapping);
+	}
+	CloseHandle(hFile);
+
+	if (SuccessfulRead == false) {
+		FreeMesh(MeshPtr);
+		return NULL;
+	}
+	printf("Read %d vertices, %d triangles and %d materials\n", MeshPtr->nVertices, MeshPtr->nTriangles, MeshPtr->nMaterials);
+
+	return MeshPtr;
+}
+
+
+// Move the reader to the next line of the file, returns false at the end of the file. Comments are left out of the line
+bool NextMeshLine(MeshReader *Reader)
+{
+	const char *p;
+
+	if (Reader->Next >= Reader->End) {
+		return false;
+	}
+
+	Reader->LineStart = Reader->Next;
+	Reader->Cursor = Reader->Next;
+	Reader->Line++;
+	for (p = Reader->Next; p < Reader->End && *p != '\n'; p++);
+	Reader->Next = p < Reader->End ? p+1 : p;
+
+	Reader->LineEnd = Reader->LineStart;
+	while (Reader->LineEnd < p && *Reader->LineEnd != '#') {
+		Reader->LineEnd++;
+	}
+
+	return true;
+}
+
+
+// Find the next token of the line without copying it, returns false if there are none left
+bool NextMeshToken(MeshReader *Reader, const char **Token, int *Length)
+{
+	const char *p = Reader->Cursor;
+
+	while (p < Reader->LineEnd && (*p == ' ' || *p == '\t' || *p == '\r')) {
+		p++;
+	}
+	if (p == Reader->LineEnd) {
+		Reader->Cursor = p;
+		return false;
+	}
+
+	*Token = p;
+	while (p < Reader->LineEnd && *p != ' ' && *p != '\t' && *p != '\r') {
+		p++;
+	}
+	*Length = (int)(p - *Token);
+	Reader->Cursor = p;
+
+	return true;
+}
+
+
+// Read the coordinates of a vertex, any weight following them is ignored
+bool ReadMeshVertex(MeshReader *Reader, Mesh *MeshPtr)
+{
+	const char *Token;
+	int Length;
+	char Buffer[64];
+	char *NumberEnd;
+	double Values[3];
+
+	for (int i=0; i<3; i++) {
+		if (NextMeshToken(Reader, &Token, &Length) == false) {
+			MeshError(Reader, Reader->Cursor, "a vertex needs 3 coordinates");
+			return false;
+		}
+		if (Length >= (int)sizeof(Buffer)) {
+			MeshError(Reader, Token, "coordinate is not a number");
+			return false;
+		}
+		memcpy(Buffer, Token, Length);
+		Buffer[Length] = 0;
+		Values[i] = strtod(Buffer, &NumberEnd);
+		if (NumberEnd != Buffer + Length) {
+			MeshError(Reader, Token, "coordinate is not a number");
+			return false;
+		}
+	}
+
+	// The arrays are doubled whenever their length reaches a power of two
+	if (MeshPtr->nVertices%MESH_GROWTH == 0 && (MeshPtr->nVertices & (MeshPtr->nVertices-1)) == 0) {
+		MeshPtr->Vertices = (Coordinate*)realloc(MeshPtr->Vertices, MAX(2*MeshPtr->nVertices, MESH_GROWTH)*sizeof(Coordinate));
+	}
+	MeshPtr->Vertices[MeshPtr->nVertices].X = Values[0];
+	MeshPtr->Vertices[MeshPtr->nVertices].Y = Values[1];
+	MeshPtr->Vertices[MeshPtr->nVertices].Z = Values[2];
+	MeshPtr->nVertices++;
+
+	return true;
+}
+
+
+// Read a face, given as vertex, vertex/texture, vertex//normal or vertex/texture/normal indices, and split it into a fan
+// of triangles. Negative indices count back from the last vertex read
+bool ReadMeshFace(MeshReader *Reader, Mesh *MeshPtr, int Material, int **FaceVertices, int *FaceSize)
+{
+	const char *Token;
+	int Length;
+	char Buffer[16];
+	char *NumberEnd;
+	int nFaceVertices = 0;
+	long Index;
+
+	while (NextMeshToken(Reader, &Token, &Length) == true) {
+		// Only the vertex index, before the first '/', is used
+		int IndexLength = 0;
+		while (IndexLength < Length && Token[IndexLength] != '/') {
+			IndexLength++;
+		}
+		if (IndexLength == 0 || IndexLength >= (int)sizeof(Buffer)) {
+			MeshError(Reader, Token, "vertex index is not a number");
+			return false;
+		}
+		memcpy(Buffer, Token, IndexLength);
+		Buffer[IndexLength] = 0;
+		Index = strtol(Buffer, &NumberEnd, 10);
+		if (NumberEnd != Buffer + IndexLength || Index == 0) {
+			MeshError(Reader, Token, "vertex index is not a number");
+			return false;
+		}
+		if (nFaceVertices == *FaceSize) {
+			*FaceSize = MAX(2*(*FaceSize), 16);
+			*FaceVertices = (int*)realloc(*FaceVertices, *FaceSize*sizeof(int));
+		}
+		(*FaceVertices)[nFaceVertices++] = Index > 0 ? Index-1 : MeshPtr->nVertices + Index;
+	}
+	if (nFaceVertices < 3) {
+		MeshError(Reader, Reader->LineStart, "a face needs at least 3 vertices");
+		return false;
+	}
+
+	for (int i=1; i<nFaceVertices-1; i++) {
+		if (MeshPtr->nTriangles%MESH_GROWTH == 0 && (MeshPtr->nTriangles & (MeshPtr->nTriangles-1)) == 0) {
+			MeshPtr->Triangles = (int*)realloc(MeshPtr->Triangles, 3*MAX(2*MeshPtr->nTriangles, MESH_GROWTH)*sizeof(int));
+			MeshPtr->TriangleMaterials = (int*)realloc(MeshPtr->TriangleMaterials, MAX(2*MeshPtr->nTriangles, MESH_GROWTH)*sizeof(int));
+		}
+		MeshPtr->Triangles[3*MeshPtr->nTriangles] = (*FaceVertices)[0];
+		MeshPtr->Triangles[3*MeshPtr->nTriangles+1] = (*FaceVertices)[i];
+		MeshPtr->Triangles[3*MeshPtr->nTriangles+2] = (*FaceVertices)[i+1];
+		MeshPtr->TriangleMaterials[MeshPtr->nTriangles] = Material;
+		MeshPtr->nTriangles++;
+	}
+
+	return true;
+}
+
+
+// Find a material of the mesh by name, adding it if it has not been used before, returns its index
+int AddMeshMaterial(Mesh *MeshPtr, const char *Name, int Length)
+{
+	for (int m=0; m<MeshPtr->nMaterials; m++) {
+		if ((int)strlen(MeshPtr->Materials[m]) == Length && strncmp(MeshPtr->Materials[m], Name, Length) == 0) {
+			return m;
+		}
+	}
+
+	MeshPtr->Materials = (char**)realloc(MeshPtr->Materials, (MeshPtr->nMaterials+1)*sizeof(char*));
+	MeshPtr->Materials[MeshPtr->nMaterials] = (char*)malloc(Length+1);
+	memcpy(MeshPtr->Materials[MeshPtr->nMaterials], Name, Length);
+	MeshPtr->Materials[MeshPtr->nMaterials][Length] = 0;
+
+	return MeshPtr->nMaterials++;
+}
+
+
+// Find the index of a material of the mesh, returns -1 if no triangle uses it
+int FindMeshMaterial(Mesh *MeshPtr, const char *Name)
+{
+	for (int m=0; m<MeshPtr->nMaterials; m++) {
+		if (strcmp(MeshPtr->Materials[m], Name) == 0) {
+			return m;
+		}
+	}
+
+	return -1;
+}
+
+
+// Print an error at a position within the current line
+void MeshError(MeshReader *Reader, const char *Position, const char *Message)
+{
+	printf("Error in mesh file '%s', line %d, column %d: %s\n", Reader->Filename, Reader->Line, (int)(Position - Reader->LineStart)+1, Message);
+}
+
+
+// Free the memory allocated to a mesh
+void FreeMesh(Mesh *MeshPtr)
+{
+	for (int m=0; m<MeshPtr->nMaterials; m++) {
+		free(MeshPtr->Materials[m]);
+	}
+	free(MeshPtr->Materials);
+	free(MeshPtr->Vertices);
+	free(MeshPtr->Triangles);
+	free(MeshPtr->TriangleMaterials);
+	free(MeshPtr->Filename);
+	free(MeshPtr);
+}
@@ -0,0 +1,34 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMMesh.h
+//
+/*********************************************************************************************/
+
+#ifndef TLM_MESH_H
+#define TLM_MESH_H
+
+// Type definitions
+
+// Triangle mesh read from a Wavefront OBJ file, faces of more than three vertices are split into triangles
+struct Mesh {
+				char *Filename;
+				Coordinate *Vertices;
+				int nVertices;
+				int *Triangles;				// Three vertex indices per triangle
+				int *TriangleMaterials;		// Material of each triangle, -1 before the first usemtl
+				int nTriangles;
+				char **Materials;			// Names given by usemtl, in the order they first appear
+				int nMaterials;
+				Mesh *NextMesh;				// Used for lists of the meshes read by a scene
+				};
+
+// Function prototypes
+Mesh *ReadMeshFile(char *Filename);
+int FindMeshMaterial(Mesh *MeshPtr, const char *Name);
+void FreeMesh(Mesh *MeshPtr);
+
+#endif //TLM_MESH_H
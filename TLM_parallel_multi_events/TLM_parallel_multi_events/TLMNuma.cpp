@@ -0,0 +1,386 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMNuma.cpp
+//
+/*********************************************************************************************/
+
+#include "stdafx.h"
+#include "TLM.h"
+#include "TLMMaths.h"
+#include "TLMNuma.h"
+#include "TLMScene.h"
+#include "TLMAlgorithm.h"
+#include "TLMDomain.h"
+
+
+// Definitions
+#define INTERLEAVE_PAGES	16		// Number of pages placed on each NUMA node in turn when interleaving
+
+
+// Type definitions
+
+// Parameters passed to the threads initialising the grid
+typedef struct {
+				int Worker;
+				int nWorkers;
+				} FirstTouchData_t;
+
+
+// Global variables
+static int nNumaNodes = 0;				// Number of NUMA nodes with processors attached
+static UCHAR *NumaNodes;				// Node numbers of the NUMA nodes with processors attached
+static ULONGLONG *NodeProcessorMasks;	// Processors attached to each NUMA node
+static Node *GridBlock;					// Contiguous block of memory holding every node in the grid
+static UCHAR **RowNode;					// The NUMA node each row of nodes in the z-direction was placed on, as requested rather than measured
+
+extern Node ***Grid;
+extern int xSize, ySize, zSize;
+extern NumaPolicy GridPlacement;
+extern InputFlags InputData;
+extern char *FolderName;
+extern char *ProjectName;
+
+
+// Function prototypes
+DWORD WINAPI FirstTouchThread(LPVOID lpParam);
+void InitialiseInterleavedSlab(int xMin, int xMax, void *Context);
+void InitialiseLocalSlab(int xMin, int xMax, void *Context);
+int WorkerNodeIndex(int Worker, int nWorkers);
+DWORD_PTR WorkerProcessorMask(int Worker, int nWorkers);
+UCHAR CurrentNumaNode(void);
+void PrintFileHeader(FILE *File);
+
+
+// Find the NUMA nodes of the machine and the processors attached to each of them
+void InitialiseNumaTopology(void)
+{
+	ULONG HighestNode;
+	ULONGLONG Mask;
+
+	// Only read the topology once
+	if (nNumaNodes > 0) {
+		return;
+	}
+
+	if (GetNumaHighestNodeNumber(&HighestNode) == 0) {
+		HighestNode = 0;
+	}
+
+	NumaNodes = (UCHAR*)malloc((HighestNode+1)*sizeof(UCHAR));
+	NodeProcessorMasks = (ULONGLONG*)malloc((HighestNode+1)*sizeof(ULONGLONG));
+
+	// Ignore any nodes without processors, these cannot own a section of the grid
+	for (ULONG i=0; i<=HighestNode; i++) {
+		if (GetNumaNodeProcessorMask((UCHAR)i, &Mask) != 0 && Mask != 0) {
+			NumaNodes[nNumaNodes] = (UCHAR)i;
+			NodeProcessorMasks[nNumaNodes] = Mask;
+			nNumaNodes++;
+		}
+	}
+
+	// Treat the machine as a single node if the topology could not be read
+	if (nNumaNodes == 0) {
+		NumaNodes[0] = 0;
+		NodeProcessorMasks[0] = (ULONGLONG)-1;
+		nNumaNodes = 1;
+	}
+
+	printf("NUMA topology: %d node%s\n", nNumaNodes, nNumaNodes == 1 ? "" : "s");
+	for (int i=0; i<nNumaNodes; i++) {
+		printf("\tNode %d:\tprocessor mask 0x%I64x\n", NumaNodes[i], NodeProcessorMasks[i]);
+	}
+}
+
+
+// Allocate the TLM grid as a single block, placing and initialising its pages according to the NUMA policy. When the grid is
+// split between processes only the rows of this process and its halo are held, the other row pointers are left NULL
+void AllocateNumaGrid(void)
+{
+	int xFirst = FirstAllocatedRow();
+	int xLast = LastAllocatedRow();
+	SIZE_T GridBytes = (SIZE_T)(xLast-xFirst+1)*ySize*zSize*sizeof(Node);
+
+	InitialiseNumaTopology();
+
+	// Allocate memory for the row pointers and the record of where each row is placed
+	Grid = (Node***) calloc(xSize, sizeof(Node**));
+	RowNode = (UCHAR**) calloc(xSize, sizeof(UCHAR*));
+	for (int x = xFirst; x <= xLast; x++) {
+		Grid[x] = (Node**) malloc(ySize * sizeof(Node*));
+		RowNode[x] = (UCHAR*) malloc(ySize * sizeof(UCHAR));
+	}
+
+	// Reserve address space for the nodes, physical pages are not placed until they are first written
+	GridBlock = (Node*)VirtualAlloc(NULL, GridBytes, MEM_RESERVE, PAGE_READWRITE);
+	if (GridBlock == NULL) {
+		printf("Could not reserve memory for the TLM grid\n");
+		exit(1);
+	}
+	for (int x = xFirst; x <= xLast; x++) {
+		for (int y = 0; y < ySize; y++) {
+			Grid[x][y] = &GridBlock[((SIZE_T)(x-xFirst)*ySize + y)*zSize];
+		}
+	}
+
+	switch (GridPlacement) {
+		// Initialise each row from a thread on the processor of the worker that will own it
+		case NUMA_FIRST_TOUCH: {
+			int nWorkers;
+			HANDLE *hThreads;
+			FirstTouchData_t *Data;
+
+			VirtualAlloc(GridBlock, GridBytes, MEM_COMMIT, PAGE_READWRITE);
+
+			// The decomposition is needed before the workers exist, the box and radial decompositions do not depend on the scene
+			CalculateSectionIndices();
+			nWorkers = SectionWorkerCount();
+
+			hThreads = (HANDLE*)malloc(nWorkers*sizeof(HANDLE));
+			Data = (FirstTouchData_t*)malloc(nWorkers*sizeof(FirstTouchData_t));
+			for (int i=0; i<nWorkers; i++) {
+				Data[i].Worker = i;
+				Data[i].nWorkers = nWorkers;
+				hThreads[i] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)FirstTouchThread, (LPVOID)&Data[i], CREATE_SUSPENDED, NULL);
+				if (hThreads[i] == NULL) {
+					printf("Grid initialisation thread %d could not be started\n", i+1);
+					exit(1);
+				}
+				SetThreadAffinityMask(hThreads[i], WorkerProcessorMask(i, nWorkers));
+				ResumeThread(hThreads[i]);
+			}
+			WaitForAllObjects(nWorkers, hThreads);
+
+			for (int i=0; i<nWorkers; i++) {
+				CloseHandle(hThreads[i]);
+			}
+			free(hThreads);
+			free(Data);
+			break;
+		}
+
+		// Spread the pages over all of the NUMA nodes in turn
+		case NUMA_INTERLEAVE: {
+			SYSTEM_INFO SystemInfo;
+			SIZE_T ChunkBytes;
+			SIZE_T Offset;
+			int Chunk;
+
+			GetSystemInfo(&SystemInfo);
+			ChunkBytes = INTERLEAVE_PAGES*SystemInfo.dwPageSize;
+
+			for (Offset = 0, Chunk = 0; Offset < GridBytes; Offset += ChunkBytes, Chunk++) {
+				if (VirtualAllocExNuma(GetCurrentProcess(), (char*)GridBlock + Offset, MIN(ChunkBytes, GridBytes - Offset), MEM_COMMIT, PAGE_READWRITE, NumaNodes[Chunk%nNumaNodes]) == NULL) {
+					VirtualAlloc((char*)GridBlock + Offset, MIN(ChunkBytes, GridBytes - Offset), MEM_COMMIT, PAGE_READWRITE);
+				}
+			}
+			ParallelSlabs(xFirst, xLast, InitialiseInterleavedSlab, (void*)&ChunkBytes);
+			break;
+		}
+
+		// Initialise the rows in parallel slabs, leaving the operating system to place the pages
+		default: {
+			VirtualAlloc(GridBlock, GridBytes, MEM_COMMIT, PAGE_READWRITE);
+			ParallelSlabs(xFirst, xLast, InitialiseLocalSlab, NULL);
+			break;
+		}
+	}
+}
+
+
+// Thread function initialising the rows of nodes owned by a single worker, so that their pages are placed on its NUMA node
+DWORD WINAPI FirstTouchThread(LPVOID lpParam)
+{
+	FirstTouchData_t *Data = (FirstTouchData_t*)lpParam;
+	UCHAR Node = (UCHAR)WorkerNumaNode(Data->Worker, Data->nWorkers);
+
+	// The sections are not split along z under first touch, so each row belongs to a single section
+	for (int x = FirstAllocatedRow(); x <= LastAllocatedRow(); x++) {
+		for (int y = 0; y < ySize; y++) {
+			if (SectionWorker(x, y, 0) == Data->Worker) {
+				InitialiseGridRow(x, y);
+				RowNode[x][y] = Node;
+			}
+		}
+	}
+
+	return 0;
+}
+
+
+// Initialise a slab of rows whose pages have been interleaved over the NUMA nodes in chunks of the size given
+void InitialiseInterleavedSlab(int xMin, int xMax, void *Context)
+{
+	SIZE_T ChunkBytes = *(SIZE_T*)Context;
+
+	for (int x = xMin; x <= xMax; x++) {
+		for (int y = 0; y < ySize; y++) {
+			InitialiseGridRow(x, y);
+			RowNode[x][y] = NumaNodes[(((char*)Grid[x][y] - (char*)GridBlock)/ChunkBytes)%nNumaNodes];
+		}
+	}
+}
+
+
+// Initialise a slab of rows from the calling thread, which places their pages on its own NUMA node
+void InitialiseLocalSlab(int xMin, int xMax, void *Context)
+{
+	UCHAR Node = CurrentNumaNode();
+
+	for (int x = xMin; x <= xMax; x++) {
+		for (int y = 0; y < ySize; y++) {
+			InitialiseGridRow(x, y);
+			RowNode[x][y] = Node;
+		}
+	}
+}
+
+
+// Free the memory allocated to the TLM grid
+void FreeNumaGrid(void)
+{
+	VirtualFree(GridBlock, 0, MEM_RELEASE);
+	for (int x = 0; x < xSize; x++) {
+		free(Grid[x]);
+		free(RowNode[x]);
+	}
+	free(Grid);
+	free(RowNode);
+}
+
+
+// Return the index into the NUMA node list of the node that a worker is assigned to. Consecutive workers share a node, so neighbouring sections share a socket
+int WorkerNodeIndex(int Worker, int nWorkers)
+{
+	InitialiseNumaTopology();
+
+	return Worker*nNumaNodes/nWorkers;
+}
+
+
+// Return the NUMA node that a worker is assigned to
+int WorkerNumaNode(int Worker, int nWorkers)
+{
+	return NumaNodes[WorkerNodeIndex(Worker, nWorkers)];
+}
+
+
+// Return whether a worker of the pool is assigned to the NUMA node that the rows of a section were placed on
+bool SameNumaNode(int Section, int nSections, int Worker, int nWorkers)
+{
+	return WorkerNodeIndex(Section, nSections) == WorkerNodeIndex(Worker, nWorkers);
+}
+
+
+// Return an affinity mask containing the single processor a worker is assigned to
+DWORD_PTR WorkerProcessorMask(int Worker, int nWorkers)
+{
+	int Node = WorkerNodeIndex(Worker, nWorkers);
+	int FirstWorker = 0;
+	int nProcessors = 0;
+	int Processor;
+
+	// Find the position of the worker amongst those sharing its node
+	while (WorkerNodeIndex(FirstWorker, nWorkers) != Node) {
+		FirstWorker++;
+	}
+	for (int i=0; i<64; i++) {
+		if ((NodeProcessorMasks[Node] >> i) & 1) {
+			nProcessors++;
+		}
+	}
+	Processor = (Worker - FirstWorker)%nProcessors;
+
+	// Find the processor in the node's mask
+	for (int i=0; i<64; i++) {
+		if ((NodeProcessorMasks[Node] >> i) & 1) {
+			if (Processor == 0) {
+				return (DWORD_PTR)1 << i;
+			}
+			Processor--;
+		}
+	}
+
+	return (DWORD_PTR)NodeProcessorMasks[Node];
+}
+
+
+// Pin a worker thread to a processor on its NUMA node
+void PinWorkerThread(HANDLE hThread, int Worker, int nWorkers)
+{
+	DWORD_PTR Mask = WorkerProcessorMask(Worker, nWorkers);
+
+	if (SetThreadAffinityMask(hThread, Mask) == 0) {
+		printf("Worker thread %d could not be pinned to processor mask 0x%Ix\n", Worker+1, Mask);
+	}
+	else {
+		printf("Worker thread %d pinned to processor mask 0x%Ix on NUMA node %d\n", Worker+1, Mask, WorkerNumaNode(Worker, nWorkers));
+	}
+}
+
+
+// Return the NUMA node of the processor the calling thread is running on
+UCHAR CurrentNumaNode(void)
+{
+	UCHAR Node;
+
+	if (GetNumaProcessorNode((UCHAR)GetCurrentProcessorNumber(), &Node) == 0) {
+		Node = NumaNodes[0];
+	}
+
+	return Node;
+}
+
+
+// Record whether a row of nodes read by a worker is held on the worker's own NUMA node
+void RecordRowAccess(NumaTraffic *Traffic, int x, int y)
+{
+	if (RowNode[x][y] == Traffic->NumaNode) {
+		Traffic->LocalAccesses++;
+	}
+	else {
+		Traffic->RemoteAccesses++;
+	}
+}
+
+
+// Print the local and remote memory traffic of each section to the display and to a text file
+void PrintNumaReport(NumaTraffic *Traffic, int nWorkers)
+{
+	FILE *NumaFile;
+	char *FilenameBuffer;
+	__int64 TotalLocal = 0;
+	__int64 TotalRemote = 0;
+
+	FilenameBuffer = (char*)malloc(100*sizeof(char));
+
+	sprintf_s(FilenameBuffer, 100*sizeof(char), "%s/%s_%s", FolderName, ProjectName, "Numa.txt");
+
+	if (fopen_s(&NumaFile, FilenameBuffer, "w") != 0) {
+		printf("Could not open file '%s'\n", "Numa.txt");
+	}
+	else {
+		printf("Printing NUMA traffic to '%s'\n", "Numa.txt");
+		PrintFileHeader(NumaFile);
+
+		fprintf(NumaFile, "Grid placement = %s, row nodes are nominal as requested rather than measured\nWorker threads %s\n\n", GridPlacement == NUMA_FIRST_TOUCH ? "first touch" : GridPlacement == NUMA_INTERLEAVE ? "interleave" : "none", InputData.PinThreads.Flag == true ? "pinned" : "not pinned, NUMA nodes are nominal");
+		fprintf(NumaFile, "Section\t\tNode\tLocal\t\tRemote\t\tRemote (%%)\n");
+		for (int i=0; i<nWorkers; i++) {
+			__int64 Total = Traffic[i].LocalAccesses + Traffic[i].RemoteAccesses;
+
+			fprintf(NumaFile, "(%d,%d,%d)\t\t%d\t%I64d\t\t%I64d\t\t%.1f\n", Traffic[i].SectionX+1, Traffic[i].SectionY+1, Traffic[i].SectionZ+1, Traffic[i].NumaNode, Traffic[i].LocalAccesses, Traffic[i].RemoteAccesses, Total == 0 ? 0.0 : 100.0*Traffic[i].RemoteAccesses/Total);
+			printf("\tSection (%d,%d,%d):\tnode %d, %.1f%% nominally remote row accesses\n", Traffic[i].SectionX+1, Traffic[i].SectionY+1, Traffic[i].SectionZ+1, Traffic[i].NumaNode, Total == 0 ? 0.0 : 100.0*Traffic[i].RemoteAccesses/Total);
+			TotalLocal += Traffic[i].LocalAccesses;
+			TotalRemote += Traffic[i].RemoteAccesses;
+		}
+		fprintf(NumaFile, "\nTotal\t\t\t%I64d\t\t%I64d\t\t%.1f\n", TotalLocal, TotalRemote, TotalLocal + TotalRemote == 0 ? 0.0 : 100.0*TotalRemote/(TotalLocal + TotalRemote));
+
+		if (fclose(NumaFile)) {
+			printf("NUMA file close unsuccessful\n");
+		}
+	}
+	free(FilenameBuffer);
+}
@@ -0,0 +1,45 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMNuma.h
+//
+/*********************************************************************************************/
+
+#ifndef TLM_NUMA_H
+#define TLM_NUMA_H
+
+// Definitions
+
+// Record the local and remote row accesses of each section for the NUMA report. The recording sits in the scatter and connect
+// loops, so it is only built in when set here or for the project
+#ifndef NUMA_STATISTICS
+#define NUMA_STATISTICS		0
+#endif
+
+
+// Type definitions
+
+// Structure to hold the local and remote memory traffic of a single worker thread
+typedef struct {
+				int SectionX;
+				int SectionY;
+				int SectionZ;
+				int NumaNode;
+				__int64 LocalAccesses;
+				__int64 RemoteAccesses;
+				} NumaTraffic;
+
+// Function prototypes
+void InitialiseNumaTopology(void);
+void AllocateNumaGrid(void);
+void FreeNumaGrid(void);
+int WorkerNumaNode(int Worker, int nWorkers);
+bool SameNumaNode(int Section, int nSections, int Worker, int nWorkers);
+void PinWorkerThread(HANDLE hThread, int Worker, int nWorkers);
+void RecordRowAccess(NumaTraffic *Traffic, int x, int y);
+void PrintNumaReport(NumaTraffic *Traffic, int nWorkers);
+
+#endif //TLM_NUMA_H
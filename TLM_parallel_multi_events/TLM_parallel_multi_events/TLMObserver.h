@@ -0,0 +1,117 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMObserver.h
+//
+/*********************************************************************************************/
+
+#ifndef TLM_OBSERVER_H
+#define TLM_OBSERVER_H
+
+// Update the observers of a junction from the voltage it has been given at an iteration. Its pulse energy and peak pulse
+// energy have already been updated. Observers that are not built in leave nothing to run
+inline void ObserveJunction(Node *NodePtr, double Value, int Iteration)
+{
+#if OBSERVE_DELAY_SPREAD
+	NodePtr->Em += Iteration * Value*Value;
+	NodePtr->Emm += (double)Iteration*Iteration * Value*Value;
+#endif
+
+#if OBSERVE_DELAY_SPREAD == DELAY_SPREAD_PULSE
+	// The arrival time moments of the pulse of peak energy are kept along with its energy
+	if (NodePtr->Epulse >= NodePtr->Emax) {
+		NodePtr->Em_max = NodePtr->Em;
+		NodePtr->Emm_max = NodePtr->Emm;
+	}
+#endif
+
+#if OBSERVE_AVERAGE
+	NodePtr->Vavg = (fabs(Value) + NodePtr->Vavg)/2.0;
+	if (NodePtr->Vavg > NodePtr->Vmax) {
+		NodePtr->Vmax = NodePtr->Vavg;
+	}
+#endif
+
+#if OBSERVE_RUN_ENERGY
+	NodePtr->Energy += Value*Value;
+#endif
+
+#if OBSERVE_REMOVAL == REMOVE_PEAK_VOLTAGE
+	if (fabs(Value) > NodePtr->Vpeak) {
+		NodePtr->Vpeak = fabs(Value);
+	}
+#endif
+}
+
+
+// Energy of a junction over its previous and new voltages, compared with the thresholds to remove it from the active set
+inline double RemovalEnergy(Node *NodePtr, double Value)
+{
+#if OBSERVE_REMOVAL == REMOVE_PEAK_VOLTAGE
+	return SQUARE(fabs(Value) + fabs(NodePtr->V));
+#else
+	return SQUARE(Value) + SQUARE(NodePtr->V);
+#endif
+}
+
+
+// Energy the relative threshold of a junction is taken from
+inline double RemovalReference(Node *NodePtr)
+{
+#if OBSERVE_REMOVAL == REMOVE_PEAK_VOLTAGE
+	return SQUARE(NodePtr->Vpeak);
+#elif OBSERVE_REMOVAL == REMOVE_RUN_ENERGY
+	return NodePtr->Energy;
+#else
+	return NodePtr->Emax;
+#endif
+}
+
+
+// Clear the observers of a junction leaving the active set along with its pulse energy, the peaks and totals of the run are
+// kept
+inline void ResetJunctionObservers(Node *NodePtr)
+{
+#if OBSERVE_DELAY_SPREAD == DELAY_SPREAD_PULSE
+	NodePtr->Em = 0;
+	NodePtr->Emm = 0;
+#endif
+
+#if OBSERVE_AVERAGE
+	NodePtr->Vavg = 0;
+#endif
+}
+
+
+// Clear every observer of a node before a run
+inline void ClearNodeObservers(Node *NodePtr)
+{
+	ResetJunctionObservers(NodePtr);
+
+#if OBSERVE_DELAY_SPREAD
+	NodePtr->Em = 0;
+	NodePtr->Emm = 0;
+#endif
+
+#if OBSERVE_DELAY_SPREAD == DELAY_SPREAD_PULSE
+	NodePtr->Em_max = 0;
+	NodePtr->Emm_max = 0;
+#endif
+
+#if OBSERVE_AVERAGE
+	NodePtr->Vmax = 0;
+#endif
+
+#if OBSERVE_RUN_ENERGY
+	NodePtr->Energy = 0;
+#endif
+
+#if OBSERVE_REMOVAL == REMOVE_PEAK_VOLTAGE
+	NodePtr->Vpeak = 0;
+#endif
+}
+
+#endif //TLM_OBSERVER_H
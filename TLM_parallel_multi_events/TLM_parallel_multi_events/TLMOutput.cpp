@@ -13,9 +13,47 @@
 #include "TLMMaths.h"
 #include "TLMTiming.h"
 #include "TLMScene.h"
+#include "TLMOutput.h"
+#include "TLMProbe.h"
+#include "TLMCheckpoint.h"
+#include "TLMSnapshot.h"
 
 
 // Definitions
+#define OUTPUT_QUEUE_SLOTS	64		// Records a producer can post before the output thread has handled the oldest
+#define MAX_OUTPUT_QUEUES	8		// Producers that can hand records to the output thread
+#define OUTPUT_WAKE_PERIOD	100		// Longest time in ms the output thread sleeps before checking the queues
+#define PL_FILE_MAGIC		"TLMPLOSS"
+#define PL_FILE_VERSION		1
+
+
+// Type definitions
+
+// Nodes of the path loss samples along each axis. The x and y nodes of a route are those of each of its samples in turn, and 
+// it has one y sample
+typedef struct {
+				int n[3];
+				int *Nodes[3];
+				bool Route;
+				} PathLossSamples;
+
+// Header at the start of a binary path loss file. The positions of the samples in metres follow as doubles, those along x, 
+// then y and the heights, with one y position for each sample of a route. The path loss of each sample in dB follows as a
+// float, x varying fastest then y
+typedef struct {
+				char Magic[8];				// Written last, so an interrupted write is never read
+				int Version;
+				int HeaderSize;				// Bytes before the positions of the samples
+				int Type;					// Point, route, grid or cube, as given by PLType
+				int nSamples[3];			// Samples along each axis
+				double Start[3];			// Extent of the samples requested
+				double End[3];
+				double Spacing[3];			// Spacing of the samples requested along each axis
+				double GridSpacing;
+				double Frequency;
+				double NoiseFloor;			// Path loss given to nodes the pulse never reached
+				char Units[8];				// Units of the path loss values
+				} PathLossFileHeader;
 
 
 /* Global variables */
@@ -25,8 +63,15 @@ extern Node ***Grid;			// The main TLM grid
 extern int xSize;			// The number of nodes in each direction in the grid
 extern int ySize;
 extern int zSize;			// Maximum number of iterations to be completed
-extern TimeVariationSet *TimeVariation;		// For storing time variations of individual nodes
 extern TimingInformation TimingData;
+extern double *DomainResults;			// Peak energies gathered from the processes sharing the grid
+
+// Output thread
+static OutputQueue *OutputQueues[MAX_OUTPUT_QUEUES];
+static volatile LONG nOutputQueues = 0;
+static HANDLE hOutputThread = NULL;
+static HANDLE hOutputEvent;
+static volatile LONG StopOutput = 0;
 
 // Input file parameters
 extern char *FolderName;
@@ -34,12 +79,38 @@ extern char *ProjectName;
 extern char *OutputFilename;
 extern char *SceneFilename;
 extern char *PathLossFilename;
-extern char *TimeVariationFilename;
+extern char *ObserverFilename;
 extern char *TimingFilename;
 extern double GridSpacing;
 extern double Frequency;
 extern Source ImpulseSource;
 extern PLParams PathLossParameters;
+extern PLFormat PathLossFormat;
+extern double MaxPathLoss;
+extern int Processes;
+
+
+// Function prototypes
+int SamplePathLossAxis(double Start, double End, double Spacing, int (*NearestNode)(double), int *Nodes);
+void FindPathLossSamples(PathLossSamples *Samples);
+void FreePathLossSamples(PathLossSamples *Samples);
+void FindPathLossRow(PathLossSamples *Samples, int j, int k, double *PathLoss);
+void PrintObserverValues(FILE *ObserverFile, Node *NodePtr);
+void PrintPathLossText(char *Filename, PathLossSamples *Samples);
+void WritePathLossBinary(char *Filename, PathLossSamples *Samples);
+DWORD WINAPI OutputThread(LPVOID lpParam);
+void DrainOutputQueues(void);
+void WriteOutputRecord(OutputRecord *Record);
+
+
+// Return the peak pulse energy of a node, read from the results gathered from the processes when the grid was split
+double NodeEmax(int x, int y, int z)
+{
+	if (DomainResults != NULL) {
+		return DomainResults[((SIZE_T)x*ySize + y)*zSize + z];
+	}
+	return Grid[x][y][z].Emax;
+}
 
 
 // Print the project name and a time and date stamp to the top of a file 
@@ -60,182 +131,296 @@ void PrintFileHeader(FILE *File)
 }
 
 
-// Print the estimated path loss to a text file. Either print a point, route (line) or grid of estimates
-void PrintPathLossToFile(void)
-{	
-	FILE *PathLossFile;
-	char *FilenameBuffer;
+// Find the nodes sampled along one axis, from Start to End at the given spacing, with a last sample at End that may not be a
+// whole spacing from the one before. Returns the number of samples
+int SamplePathLossAxis(double Start, double End, double Spacing, int (*NearestNode)(double), int *Nodes)
+{
+	double nSamples = (End - Start)/Spacing;
+	double Step = (End - Start)/nSamples;
+	int n = 0;
 
-	FilenameBuffer = (char*)malloc(100*sizeof(char));
+	for (int i = 0; i < nSamples; i++) {
+		Nodes[n++] = NearestNode(Start + Step*i);
+	}
+	Nodes[n++] = NearestNode(End);
 
-	sprintf_s(FilenameBuffer, 100*sizeof(char), "%s/%s_%s", FolderName, ProjectName, PathLossFilename);
+	return n;
+}
 
-	if (fopen_s(&PathLossFile, FilenameBuffer, "w") != 0) {
-		printf("Could not open file '%s'\n", PathLossFilename);
+
+// Find the nodes of the path loss samples requested. A point, grid or cube is sampled on each axis apart, while the x and y 
+// nodes of a route are those of each sample in turn
+void FindPathLossSamples(PathLossSamples *Samples)
+{
+	double nSamples[3] = {0, 0, 0};
+
+	Samples->Route = PathLossParameters.Type == ROUTE;
+	if (Samples->Route == true) {
+		nSamples[0] = sqrt(SQUARE(PathLossParameters.X2 - PathLossParameters.X1)+SQUARE(PathLossParameters.Y2 - PathLossParameters.Y1))/PathLossParameters.Spacing;
+		nSamples[1] = nSamples[0];
+	}
+	else if (PathLossParameters.Type != PL_POINT) {
+		nSamples[0] = (PathLossParameters.X2 - PathLossParameters.X1)/PathLossParameters.Spacing;
+		nSamples[1] = (PathLossParameters.Y2 - PathLossParameters.Y1)/PathLossParameters.SpacingY;
+	}
+	if (PathLossParameters.Type == CUBE) {
+		nSamples[2] = (PathLossParameters.Z2 - PathLossParameters.Z1)/PathLossParameters.SpacingZ;
+	}
+	for (int d=0; d<3; d++) {
+		Samples->Nodes[d] = (int*)malloc((nSamples[d] > 0 ? RoundUpwards(nSamples[d])+1 : 1)*sizeof(int));
+		Samples->n[d] = 1;
+	}
+
+	if (Samples->Route == true) {
+		double dx = (PathLossParameters.X2 - PathLossParameters.X1)/nSamples[0];
+		double dy = (PathLossParameters.Y2 - PathLossParameters.Y1)/nSamples[0];
+		int n = 0;
+
+		for (int i = 0; i < nSamples[0]; i++, n++) {
+			Samples->Nodes[0][n] = NearestNodeX(PathLossParameters.X1+dx*i);
+			Samples->Nodes[1][n] = NearestNodeY(PathLossParameters.Y1+dy*i);
+		}
+		Samples->Nodes[0][n] = NearestNodeX(PathLossParameters.X2);
+		Samples->Nodes[1][n] = NearestNodeY(PathLossParameters.Y2);
+		Samples->n[0] = n+1;
+	}
+	else if (PathLossParameters.Type == PL_POINT) {
+		Samples->Nodes[0][0] = NearestNodeX(PathLossParameters.X1);
+		Samples->Nodes[1][0] = NearestNodeY(PathLossParameters.Y1);
+	}
+	else {
+		Samples->n[0] = SamplePathLossAxis(PathLossParameters.X1, PathLossParameters.X2, PathLossParameters.Spacing, NearestNodeX, Samples->Nodes[0]);
+		Samples->n[1] = SamplePathLossAxis(PathLossParameters.Y1, PathLossParameters.Y2, PathLossParameters.SpacingY, NearestNodeY, Samples->Nodes[1]);
+	}
+	// Only a cube has more than one height
+	if (PathLossParameters.Type == CUBE) {
+		Samples->n[2] = SamplePathLossAxis(PathLossParameters.Z1, PathLossParameters.Z2, PathLossParameters.SpacingZ, NearestNodeZ, Samples->Nodes[2]);
 	}
 	else {
+		Samples->Nodes[2][0] = NearestNodeZ(PathLossParameters.Z1);
+	}
+}
 
-		printf("Printing path loss values to '%s'\n",PathLossFilename);
-		PrintFileHeader(PathLossFile);
 
-		int x, y, z;
-		double PathLoss;
+// Free the nodes of the path loss samples
+void FreePathLossSamples(PathLossSamples *Samples)
+{
+	for (int d=0; d<3; d++) {
+		free(Samples->Nodes[d]);
+	}
+}
 
-		// Z coordinate is constant
-		z = PlaceWithinGridZ(RoundToNearest(PathLossParameters.Z1/GridSpacing));
-		
-		switch (PathLossParameters.Type) {
-			// Print the path loss at a single point
-			case PL_POINT: {
-				// Details of the path loss estimates required and column titles
-				fprintf(PathLossFile, "Point Analysis\nHeight = %f\n\nX\t\tY\t\tPL(dB)\n", z*GridSpacing);
-				x = PlaceWithinGridX(RoundToNearest(PathLossParameters.X1/GridSpacing));
-				y = PlaceWithinGridY(RoundToNearest(PathLossParameters.Y1/GridSpacing));
-				PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-				fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-				break;
-			}
-			// Print the path loss along a route
-			case ROUTE: {
-				double length = sqrt(SQUARE(PathLossParameters.X2 - PathLossParameters.X1)+SQUARE(PathLossParameters.Y2 - PathLossParameters.Y1));
-				double nSamples = length/PathLossParameters.Spacing;
-				double dx = (PathLossParameters.X2 - PathLossParameters.X1)/nSamples;
-				double dy = (PathLossParameters.Y2 - PathLossParameters.Y1)/nSamples;
-
-				// Details of the path loss estimates required and column titles
-				fprintf(PathLossFile, "Route Analysis - %d samples\nHeight = %f\n\nX\t\tY\t\tPL(dB)\n", (int)nSamples == nSamples ? (int)nSamples+1 : (int)nSamples+2, z*GridSpacing);
-
-				for (int i = 0; i < nSamples; i++) {
-					x = PlaceWithinGridX(RoundToNearest((PathLossParameters.X1+dx*i)/GridSpacing));
-					y = PlaceWithinGridY(RoundToNearest((PathLossParameters.Y1+dy*i)/GridSpacing));
-					PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-					fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-				}
-				x = PlaceWithinGridX(RoundToNearest(PathLossParameters.X2/GridSpacing));
-				y = PlaceWithinGridY(RoundToNearest(PathLossParameters.Y2/GridSpacing));
-				PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-				fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-				break;
-			}
 
-			// Print the path loss in a 2d grid
-			case GRID: {
-				double nSamplesX = (PathLossParameters.X2-PathLossParameters.X1)/PathLossParameters.Spacing;
-				double nSamplesY = (PathLossParameters.Y2-PathLossParameters.Y1)/PathLossParameters.SpacingY;
-				double dx = (PathLossParameters.X2 - PathLossParameters.X1)/nSamplesX;
-				double dy = (PathLossParameters.Y2 - PathLossParameters.Y1)/nSamplesY;
-
-				// Details of the path loss estimates required and column titles
-				fprintf(PathLossFile, "Grid Analysis - %d x %d samples\nHeight = %f\n\nX\t\tY\t\tPL(dB)\n", (int)nSamplesX == nSamplesX ? (int)nSamplesX+1 : (int)nSamplesX+2, (int)nSamplesY == nSamplesY ? (int)nSamplesY+1 : (int)nSamplesY+2, z*GridSpacing);
-				
-				for (int j=0; j < nSamplesY; j++) {
-					for (int i=0; i < nSamplesX; i++) {
-						x = PlaceWithinGridX(RoundToNearest((PathLossParameters.X1+dx*i)/GridSpacing));
-						y = PlaceWithinGridY(RoundToNearest((PathLossParameters.Y1+dy*j)/GridSpacing));
-						PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-						fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-					}
-					x = PlaceWithinGridX(RoundToNearest(PathLossParameters.X2/GridSpacing));
-					y = PlaceWithinGridY(RoundToNearest((PathLossParameters.Y1+dy*j)/GridSpacing));
-					PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-					fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-				}
-				// Print a path loss estimate of the outer X row nearest X2,Y2 on the grid (may not be a whole sample space apart)
-				for (int i=0; i < nSamplesX; i++) {
-					x = PlaceWithinGridX(RoundToNearest((PathLossParameters.X1+dx*i)/GridSpacing));
-					y = PlaceWithinGridY(RoundToNearest(PathLossParameters.Y2/GridSpacing));
-					PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-					fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-				}
-				x = PlaceWithinGridX(RoundToNearest(PathLossParameters.X2/GridSpacing));
-				y = PlaceWithinGridY(RoundToNearest(PathLossParameters.Y2/GridSpacing));
-				PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-				fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-				break;
+// Find the path loss of a row of samples along x, at the y sample j and height k. The peak energies of the row are gathered 
+// first, and converted to path loss two at a time with SSE2, in the same order of operations as VoltageToDB is given them 
+// elsewhere so that the results match to the bit. Only the logarithm is taken one sample at a time
+void FindPathLossRow(PathLossSamples *Samples, int j, int k, double *PathLoss)
+{
+	const int *xNodes = Samples->Nodes[0];
+	const int *yNodes = Samples->Nodes[1];
+	int z = Samples->Nodes[2][k];
+	int n = Samples->n[0];
+	int i;
+
+	// The y node of a route changes with each sample
+	for (i = 0; i < n; i++) {
+		PathLoss[i] = NodeEmax(xNodes[i], Samples->Route == true ? yNodes[i] : yNodes[j], z);
+	}
+
+	__m128d Wavelength = _mm_set1_pd(SPEED_OF_LIGHT/Frequency);
+	__m128d Kappa = _mm_set1_pd(KAPPA);
+	__m128d Four = _mm_set1_pd(4);
+	__m128d Pi = _mm_set1_pd(M_PI);
+	__m128d Spacing = _mm_set1_pd(GridSpacing);
+	for (i = 0; i+1 < n; i += 2) {
+		__m128d Voltage = _mm_mul_pd(Wavelength, _mm_sqrt_pd(_mm_loadu_pd(&PathLoss[i])));
+		Voltage = _mm_div_pd(_mm_div_pd(_mm_div_pd(_mm_mul_pd(Voltage, Kappa), Four), Pi), Spacing);
+		_mm_storeu_pd(&PathLoss[i], Voltage);
+	}
+	for (; i < n; i++) {
+		PathLoss[i] = SPEED_OF_LIGHT/Frequency * sqrt(PathLoss[i]) * KAPPA/4/M_PI/GridSpacing;
+	}
+	for (i = 0; i < n; i++) {
+		PathLoss[i] = VoltageToDB(PathLoss[i]);
+	}
+}
+
+
+// Print the estimated path loss to a text file. Either print a point, route (line), grid or cube of estimates
+void PrintPathLossText(char *Filename, PathLossSamples *Samples)
+{	
+	FILE *PathLossFile;
+	double *PathLoss;
+
+	if (fopen_s(&PathLossFile, Filename, "w") != 0) {
+		printf("Could not open file '%s'\n", PathLossFilename);
+		return;
+	}
+
+	printf("Printing path loss values to '%s'\n",PathLossFilename);
+	PrintFileHeader(PathLossFile);
+
+	// Details of the path loss estimates required and column titles
+	switch (PathLossParameters.Type) {
+		case PL_POINT:
+			fprintf(PathLossFile, "Point Analysis\nHeight = %f\n\nX\t\tY\t\tPL(dB)\n", NodePositionZ(Samples->Nodes[2][0]));
+			break;
+		case ROUTE:
+			fprintf(PathLossFile, "Route Analysis - %d samples\nHeight = %f\n\nX\t\tY\t\tPL(dB)\n", Samples->n[0], NodePositionZ(Samples->Nodes[2][0]));
+			break;
+		case GRID:
+			fprintf(PathLossFile, "Grid Analysis - %d x %d samples\nHeight = %f\n\nX\t\tY\t\tPL(dB)\n", Samples->n[0], Samples->n[1], NodePositionZ(Samples->Nodes[2][0]));
+			break;
+		case CUBE:
+			fprintf(PathLossFile, "Grid Analysis - %d x %d x %d samples\n", Samples->n[0], Samples->n[1], Samples->n[2]);
+			break;
+		default:
+			break;
+	}
+
+	PathLoss = (double*)malloc(Samples->n[0]*sizeof(double));
+	for (int k=0; k < Samples->n[2]; k++) {
+		// Each height of a cube is given its own titles
+		if (PathLossParameters.Type == CUBE) {
+			fprintf(PathLossFile, "\nHeight = %f\n\nX\t\tY\t\tPL(dB)\n", NodePositionZ(Samples->Nodes[2][k]));
+		}
+		for (int j=0; j < Samples->n[1]; j++) {
+			FindPathLossRow(Samples, j, k, PathLoss);
+			for (int i=0; i < Samples->n[0]; i++) {
+				fprintf(PathLossFile, "%f\t%f\t%f\n", NodePositionX(Samples->Nodes[0][i]), NodePositionY(Samples->Nodes[1][Samples->Route == true ? i : j]), PathLoss[i]);
 			}
+		}
+	}
+	free(PathLoss);
 
-			// Print the path loss in a set of 2d grids
-			case CUBE: {
-				double nSamplesX = (PathLossParameters.X2-PathLossParameters.X1)/PathLossParameters.Spacing;
-				double nSamplesY = (PathLossParameters.Y2-PathLossParameters.Y1)/PathLossParameters.SpacingY;
-				double nSamplesZ = (PathLossParameters.Z2-PathLossParameters.Z1)/PathLossParameters.SpacingZ;
-				double dx = (PathLossParameters.X2 - PathLossParameters.X1)/nSamplesX;
-				double dy = (PathLossParameters.Y2 - PathLossParameters.Y1)/nSamplesY;
-				double dz = (PathLossParameters.Z2 - PathLossParameters.Z1)/nSamplesZ;
-
-				// Details of the path loss estimates required and column titles
-				fprintf(PathLossFile, "Grid Analysis - %d x %d x %d samples\n", (int)nSamplesX == nSamplesX ? (int)nSamplesX+1 : (int)nSamplesX+2, (int)nSamplesY == nSamplesY ? (int)nSamplesY+1 : (int)nSamplesY+2, (int)nSamplesZ == nSamplesZ ? (int)nSamplesZ+1 : (int)nSamplesZ+2);
-				
-				for (int k=0; k < nSamplesZ; k++) {
-					z = PlaceWithinGridZ(RoundToNearest((PathLossParameters.Z1+dz*k)/GridSpacing));
-					fprintf(PathLossFile, "\nHeight = %f\n\nX\t\tY\t\tPL(dB)\n", z*GridSpacing);
-				
-					for (int j=0; j < nSamplesY; j++) {
-						for (int i=0; i < nSamplesX; i++) {
-							x = PlaceWithinGridX(RoundToNearest((PathLossParameters.X1+dx*i)/GridSpacing));
-							y = PlaceWithinGridY(RoundToNearest((PathLossParameters.Y1+dy*j)/GridSpacing));
-							PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-							fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-						}
-						x = PlaceWithinGridX(RoundToNearest(PathLossParameters.X2/GridSpacing));
-						y = PlaceWithinGridY(RoundToNearest((PathLossParameters.Y1+dy*j)/GridSpacing));
-						PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-						fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-					}
-					// Print a path loss estimate of the outer X row nearest X2,Y2 on the grid (may not be a whole sample space apart)
-					for (int i=0; i < nSamplesX; i++) {
-						x = PlaceWithinGridX(RoundToNearest((PathLossParameters.X1+dx*i)/GridSpacing));
-						y = PlaceWithinGridY(RoundToNearest(PathLossParameters.Y2/GridSpacing));
-						PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-						fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-					}
-					x = PlaceWithinGridX(RoundToNearest(PathLossParameters.X2/GridSpacing));
-					y = PlaceWithinGridY(RoundToNearest(PathLossParameters.Y2/GridSpacing));
-					PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-					fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-				}
+	if (fclose(PathLossFile)) {
+		printf("Path loss file close unsuccessful\n");
+	}
+}
 
-				z = PlaceWithinGridZ(RoundToNearest((PathLossParameters.Z2)/GridSpacing));
-				fprintf(PathLossFile, "\nHeight = %f\n\nX\t\tY\t\tPL(dB)\n", z*GridSpacing);
-				
-				for (int j=0; j < nSamplesY; j++) {
-					for (int i=0; i < nSamplesX; i++) {
-						x = PlaceWithinGridX(RoundToNearest((PathLossParameters.X1+dx*i)/GridSpacing));
-						y = PlaceWithinGridY(RoundToNearest((PathLossParameters.Y1+dy*j)/GridSpacing));
-						PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-						fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-					}
-					x = PlaceWithinGridX(RoundToNearest(PathLossParameters.X2/GridSpacing));
-					y = PlaceWithinGridY(RoundToNearest((PathLossParameters.Y1+dy*j)/GridSpacing));
-					PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-					fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-				}
-				// Print a path loss estimate of the outer X row nearest X2,Y2 on the grid (may not be a whole sample space apart)
-				for (int i=0; i < nSamplesX; i++) {
-					x = PlaceWithinGridX(RoundToNearest((PathLossParameters.X1+dx*i)/GridSpacing));
-					y = PlaceWithinGridY(RoundToNearest(PathLossParameters.Y2/GridSpacing));
-					PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-					fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-				}
-				x = PlaceWithinGridX(RoundToNearest(PathLossParameters.X2/GridSpacing));
-				y = PlaceWithinGridY(RoundToNearest(PathLossParameters.Y2/GridSpacing));
-				PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-				fprintf(PathLossFile, "%f\t%f\t%f\n", x*GridSpacing, y*GridSpacing, PathLoss);
-				break;
+
+// Write the estimated path loss to a binary file, through a view of the file mapped for writing. The header describes the 
+// samples, the node positions of the samples along each axis follow, then the path loss of each as a float
+void WritePathLossBinary(char *Filename, PathLossSamples *Samples)
+{
+	HANDLE hFile, hMapping;
+	char *View = NULL;
+	PathLossFileHeader *Header;
+	double *Positions;
+	float *Values;
+	double *PathLoss;
+	int nPositions[3] = {Samples->n[0], Samples->Route == true ? Samples->n[0] : Samples->n[1], Samples->n[2]};
+	ULONGLONG nValues = (ULONGLONG)Samples->n[0]*Samples->n[1]*Samples->n[2];
+	ULONGLONG Bytes = sizeof(PathLossFileHeader) + (nPositions[0]+nPositions[1]+nPositions[2])*sizeof(double) + nValues*sizeof(float);
+
+	hFile = CreateFile(Filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		printf("Could not open file '%s'\n", Filename);
+		return;
+	}
+	hMapping = CreateFileMapping(hFile, NULL, PAGE_READWRITE, (DWORD)(Bytes >> 32), (DWORD)Bytes, NULL);
+	if (hMapping != NULL) {
+		View = (char*)MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, 0);
+	}
+	if (View == NULL) {
+		printf("Could not map file '%s' for writing\n", Filename);
+		if (hMapping != NULL) {
+			CloseHandle(hMapping);
+		}
+		CloseHandle(hFile);
+		return;
+	}
+
+	printf("Writing binary path loss values to '%s'\n", Filename);
+	Header = (PathLossFileHeader*)View;
+	memset(Header, 0, sizeof(PathLossFileHeader));
+	Header->Version = PL_FILE_VERSION;
+	Header->HeaderSize = sizeof(PathLossFileHeader);
+	Header->Type = PathLossParameters.Type;
+	for (int d=0; d<3; d++) {
+		Header->nSamples[d] = Samples->n[d];
+	}
+	Header->Start[0] = PathLossParameters.X1;
+	Header->Start[1] = PathLossParameters.Y1;
+	Header->Start[2] = PathLossParameters.Z1;
+	Header->End[0] = PathLossParameters.Type == PL_POINT ? PathLossParameters.X1 : PathLossParameters.X2;
+	Header->End[1] = PathLossParameters.Type == PL_POINT ? PathLossParameters.Y1 : PathLossParameters.Y2;
+	Header->End[2] = PathLossParameters.Type == CUBE ? PathLossParameters.Z2 : PathLossParameters.Z1;
+	Header->Spacing[0] = PathLossParameters.Spacing;
+	Header->Spacing[1] = PathLossParameters.SpacingY;
+	Header->Spacing[2] = PathLossParameters.SpacingZ;
+	Header->GridSpacing = GridSpacing;
+	Header->Frequency = Frequency;
+	Header->NoiseFloor = MaxPathLoss;
+	strcpy_s(Header->Units, sizeof(Header->Units), "dB");
+
+	// Positions of the samples in metres, along x, then y and the heights
+	Positions = (double*)(View + sizeof(PathLossFileHeader));
+	for (int i=0; i < nPositions[0]; i++) {
+		*Positions++ = NodePositionX(Samples->Nodes[0][i]);
+	}
+	for (int j=0; j < nPositions[1]; j++) {
+		*Positions++ = NodePositionY(Samples->Nodes[1][j]);
+	}
+	for (int k=0; k < nPositions[2]; k++) {
+		*Positions++ = NodePositionZ(Samples->Nodes[2][k]);
+	}
+
+	// Path loss of each sample, x varying fastest
+	Values = (float*)Positions;
+	PathLoss = (double*)malloc(Samples->n[0]*sizeof(double));
+	for (int k=0; k < Samples->n[2]; k++) {
+		for (int j=0; j < Samples->n[1]; j++) {
+			FindPathLossRow(Samples, j, k, PathLoss);
+			for (int i=0; i < Samples->n[0]; i++) {
+				*Values++ = (float)PathLoss[i];
 			}
 		}
+	}
+	free(PathLoss);
+
+	// The magic is written last, so that an interrupted write is never read
+	memcpy(Header->Magic, PL_FILE_MAGIC, sizeof(Header->Magic));
+	FlushViewOfFile(View, 0);
+	UnmapViewOfFile(View);
+	CloseHandle(hMapping);
+	CloseHandle(hFile);
+}
 
-		if (fclose(PathLossFile)) {
-			printf("Path loss file close unsuccessful\n");
+
+// Output the estimated path loss in the format requested. A binary file takes the name of the path loss file with its 
+// extension replaced by .bin
+void PrintPathLossToFile(void)
+{
+	PathLossSamples Samples;
+	char Filename[MAX_PATH];
+	char *Extension;
+
+	FindPathLossSamples(&Samples);
+	sprintf_s(Filename, sizeof(Filename), "%s/%s_%s", FolderName, ProjectName, PathLossFilename);
+	if (PathLossFormat == PL_BINARY) {
+		Extension = strrchr(Filename, '.');
+		if (Extension != NULL && strchr(Extension, '/') == NULL && strchr(Extension, '\\') == NULL) {
+			*Extension = '\0';
 		}
+		strcat_s(Filename, sizeof(Filename), ".bin");
+		WritePathLossBinary(Filename, &Samples);
 	}
-	free(FilenameBuffer);	
+	else {
+		PrintPathLossText(Filename, &Samples);
+	}
+	FreePathLossSamples(&Samples);
 }
 
+
+// Print the estimated path loss at the same samples as the path loss file, laid out for Matlab. Each y sample gives a line
+// of the x samples, and each height is followed by a blank line
 void PrintPathLossMatlabFriendly(void)
 {
 	FILE *PathLossFile;
 	char *FilenameBuffer;
+	PathLossSamples Samples;
+	double *PathLoss;
 
 	FilenameBuffer = (char*)malloc(100*sizeof(char));
 
@@ -248,39 +433,23 @@ void PrintPathLossMatlabFriendly(void)
 
 		printf("Printing path loss values to '%s'\n",PathLossFilename);
 
-		int x, y, z;
-		double PathLoss;
-
-		// Z coordinate is constant
-		z = PlaceWithinGridZ(RoundToNearest(PathLossParameters.Z1/GridSpacing));
+		FindPathLossSamples(&Samples);
 
-		double nSamplesX = (PathLossParameters.X2-PathLossParameters.X1)/PathLossParameters.Spacing;
-		double nSamplesY = (PathLossParameters.Y2-PathLossParameters.Y1)/PathLossParameters.SpacingY;
-		double nSamplesZ = (PathLossParameters.Z2-PathLossParameters.Z1)/PathLossParameters.SpacingZ;
-		double dx = (PathLossParameters.X2 - PathLossParameters.X1)/nSamplesX;
-		double dy = (PathLossParameters.Y2 - PathLossParameters.Y1)/nSamplesY;
-		double dz = (PathLossParameters.Z2 - PathLossParameters.Z1)/nSamplesZ;
+		// Details of the path loss estimates required
+		fprintf(PathLossFile, "Grid Analysis - %d x %d x %d samples\n", Samples.n[0], Samples.n[1], Samples.n[2]);
 
-		// Details of the path loss estimates required and column titles
-		fprintf(PathLossFile, "Grid Analysis - %d x %d x %d samples\n", (int)nSamplesX == nSamplesX ? (int)nSamplesX+1 : (int)nSamplesX+2, (int)nSamplesY == nSamplesY ? (int)nSamplesY+1 : (int)nSamplesY+2, (int)nSamplesZ == nSamplesZ ? (int)nSamplesZ+1 : (int)nSamplesZ+2);
-				
-		for (int k=0; k <= nSamplesZ; k++) {
-			z = PlaceWithinGridZ(RoundToNearest((PathLossParameters.Z1+dz*k)/GridSpacing));
-		
-			for (int j=0; j <= nSamplesY; j++) {
-				for (int i=0; i < nSamplesX; i++) {
-					x = PlaceWithinGridX(RoundToNearest((PathLossParameters.X1+dx*i)/GridSpacing));
-					y = PlaceWithinGridY(RoundToNearest((PathLossParameters.Y1+dy*j)/GridSpacing));
-					PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-					fprintf(PathLossFile, "%f\t", PathLoss);
+		PathLoss = (double*)malloc(Samples.n[0]*sizeof(double));
+		for (int k=0; k < Samples.n[2]; k++) {
+			for (int j=0; j < Samples.n[1]; j++) {
+				FindPathLossRow(&Samples, j, k, PathLoss);
+				for (int i=0; i < Samples.n[0]; i++) {
+					fprintf(PathLossFile, i+1 < Samples.n[0] ? "%f\t" : "%f\n", PathLoss[i]);
 				}
-				x = PlaceWithinGridX(RoundToNearest((PathLossParameters.X1+dx*nSamplesX)/GridSpacing));
-				y = PlaceWithinGridY(RoundToNearest((PathLossParameters.Y1+dy*j)/GridSpacing));
-				PathLoss = VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(Grid[x][y][z].Emax) * KAPPA/4/M_PI/GridSpacing);
-				fprintf(PathLossFile, "%f\n", PathLoss);
 			}
 			fprintf(PathLossFile, "\n");
 		}
+		free(PathLoss);
+		FreePathLossSamples(&Samples);
 
 		if (fclose(PathLossFile)) {
 			printf("Path loss file close unsuccessful\n");
@@ -290,6 +459,106 @@ void PrintPathLossMatlabFriendly(void)
 }
 
 
+// Print the values of the observers built in at the path loss samples, each observer giving its columns in turn. The 
+// observers are held by the nodes of the grid, which a single process holds
+void PrintObserverResults(void)
+{
+	PathLossSamples Samples;
+	FILE *ObserverFile;
+	char Filename[MAX_PATH];
+	char Titles[128] = "X\t\tY";
+
+	if (OBSERVE_ANY == false || PathLossParameters.Type == NONE) {
+		return;
+	}
+	if (Processes > 1) {
+		printf("Observer values are not printed when the grid is split between processes\n");
+		return;
+	}
+
+	sprintf_s(Filename, sizeof(Filename), "%s/%s_%s", FolderName, ProjectName, ObserverFilename);
+	if (fopen_s(&ObserverFile, Filename, "w") != 0) {
+		printf("Could not open file '%s'\n", Filename);
+		return;
+	}
+
+	printf("Printing observer values to '%s'\n", Filename);
+	PrintFileHeader(ObserverFile);
+
+	if (OBSERVE_DELAY_SPREAD) {
+		strcat_s(Titles, sizeof(Titles), "\t\tDelay(ns)\tSpread(ns)");
+	}
+	if (OBSERVE_AVERAGE) {
+		strcat_s(Titles, sizeof(Titles), "\t\tAvgPL(dB)");
+	}
+	if (OBSERVE_ENERGY) {
+		strcat_s(Titles, sizeof(Titles), "\t\tEnergyPL(dB)");
+	}
+	if (OBSERVE_REMOVAL == REMOVE_PEAK_VOLTAGE) {
+		strcat_s(Titles, sizeof(Titles), "\t\tPeakPL(dB)");
+	}
+
+	FindPathLossSamples(&Samples);
+	for (int k=0; k < Samples.n[2]; k++) {
+		fprintf(ObserverFile, "\nHeight = %f\n\n%s\n", NodePositionZ(Samples.Nodes[2][k]), Titles);
+		for (int j=0; j < Samples.n[1]; j++) {
+			for (int i=0; i < Samples.n[0]; i++) {
+				int x = Samples.Nodes[0][i];
+				int y = Samples.Nodes[1][Samples.Route == true ? i : j];
+
+				fprintf(ObserverFile, "%f\t%f", NodePositionX(x), NodePositionY(y));
+				PrintObserverValues(ObserverFile, &Grid[x][y][Samples.Nodes[2][k]]);
+				fprintf(ObserverFile, "\n");
+			}
+		}
+	}
+	FreePathLossSamples(&Samples);
+
+	if (fclose(ObserverFile)) {
+		printf("Observer file close unsuccessful\n");
+	}
+}
+
+
+// Print the values of the observers built in for a node. The delay is measured from the start of the run to the mean arrival 
+// of the peak pulse, or of the whole run, and the spread is the rms delay spread of the same energy
+void PrintObserverValues(FILE *ObserverFile, Node *NodePtr)
+{
+#if OBSERVE_DELAY_SPREAD
+	double TimeStep = GridSpacing/SPEED_OF_LIGHT;
+	double AvgDelay = 0;
+	double DelaySpread = 0;
+#if OBSERVE_DELAY_SPREAD == DELAY_SPREAD_RUN
+	double Energy = NodePtr->Energy;
+	double Em = NodePtr->Em;
+	double Emm = NodePtr->Emm;
+#else
+	double Energy = NodePtr->Emax;
+	double Em = NodePtr->Em_max;
+	double Emm = NodePtr->Emm_max;
+#endif
+
+	if (Energy > 0) {
+		AvgDelay = Em/Energy;
+		DelaySpread = sqrt(MAX(Emm/Energy - SQUARE(AvgDelay), 0));
+	}
+	fprintf(ObserverFile, "\t%f\t%f", AvgDelay*TimeStep*1e9, DelaySpread*TimeStep*1e9);
+#endif
+
+#if OBSERVE_AVERAGE
+	fprintf(ObserverFile, "\t%f", VoltageToDB(SPEED_OF_LIGHT/Frequency * NodePtr->Vmax * KAPPA/4/M_PI/GridSpacing));
+#endif
+
+#if OBSERVE_ENERGY
+	fprintf(ObserverFile, "\t%f", VoltageToDB(SPEED_OF_LIGHT/Frequency * sqrt(NodePtr->Energy) * KAPPA/4/M_PI/GridSpacing));
+#endif
+
+#if OBSERVE_REMOVAL == REMOVE_PEAK_VOLTAGE
+	fprintf(ObserverFile, "\t%f", VoltageToDB(SPEED_OF_LIGHT/Frequency * NodePtr->Vpeak * KAPPA/4/M_PI/GridSpacing));
+#endif
+}
+
+
 // Print the impedances of nodes to a text file
 void PrintImpedances(void)
 {
@@ -313,10 +582,10 @@ void PrintImpedances(void)
 				if (x == ImpulseSource.X && y == ImpulseSource.Y) {
 					fputc('i',OutputFile);
 				}
-				else if (x==PlaceWithinGridX(RoundToNearest(PathLossParameters.X1/GridSpacing)) && y == PlaceWithinGridY(RoundToNearest(PathLossParameters.Y1/GridSpacing))) {
+				else if (x==NearestNodeX(PathLossParameters.X1) && y == NearestNodeY(PathLossParameters.Y1)) {
 					fputc('1',OutputFile);
 				}
-				else if (PathLossParameters.Type != PL_POINT && x==PlaceWithinGridX(RoundToNearest(PathLossParameters.X2/GridSpacing)) && y == PlaceWithinGridY(RoundToNearest(PathLossParameters.Y2/GridSpacing))) {
+				else if (PathLossParameters.Type != PL_POINT && x==NearestNodeX(PathLossParameters.X2) && y == NearestNodeY(PathLossParameters.Y2)) {
 					fputc('2',OutputFile);
 				}
 				// E = 1
@@ -347,49 +616,6 @@ void PrintImpedances(void)
 }
 
 
-
-// Save the variation of a row of nodes over time
-void SaveTimeVariation(TimeVariationSet *CurrentSet)
-{
-	CurrentSet->V = (double*)malloc(xSize*sizeof(double));
-	for (int x = 0; x < xSize; x++) {
-		CurrentSet->V[x] = Grid[x][ySize/2][zSize/2].V;
-	}
-}
-
-// Print the variation of a row of nodes over time
-void PrintTimeVariation(void)
-{
-	FILE *OutputFile;
-	TimeVariationSet *CurrentTimeVariation;
-	char *FilenameBuffer;
-
-	FilenameBuffer = (char*)malloc(100*sizeof(char));
-
-	sprintf_s(FilenameBuffer, 100*sizeof(char), "%s/%s_%s", FolderName, ProjectName, TimeVariationFilename);
-	
-	if (fopen_s(&OutputFile, FilenameBuffer, "w") != 0) {
-		printf("Could not open file '%s'\n", TimeVariationFilename);
-	}
-	else {
-		printf("Printing time variation to output file %s\n", TimeVariationFilename);
-		PrintFileHeader(OutputFile);
-		CurrentTimeVariation = TimeVariation;
-		while (CurrentTimeVariation != NULL) {
-			for (int x = 0; x < xSize; x++) {
-				fprintf(OutputFile, "%f\t", CurrentTimeVariation->V[x]);
-			}
-			fprintf(OutputFile, "\n");
-			CurrentTimeVariation = CurrentTimeVariation->NextSet;
-		}
-
-		if (fclose(OutputFile)) {
-			printf("Output file close unsuccessful\n");
-		}
-	}
-	free(FilenameBuffer);
-}
-
 // Print information required to estimate the path loss error constant kappa to a text file
 void PrintKappaData(void) 
 {
@@ -418,7 +644,7 @@ void PrintKappaData(void)
 					y = RoundToNearest(ImpulseSource.Y + 9*yy*GridSpacing);
 					z = RoundToNearest(ImpulseSource.Z + 9*zz*GridSpacing);
 					d = 9*sqrt((double)(SQUARE(xx)+SQUARE(yy)+SQUARE(zz)));
-					fprintf(OutputFile,"%f\t%f\t%f\t%f\n", Grid[x][y][z].Emax, d, asin((9.0*zz)/d), atan((double)(yy)/xx));
+					fprintf(OutputFile,"%f\t%f\t%f\t%f\n", NodeEmax(x, y, z), d, asin((9.0*zz)/d), atan((double)(yy)/xx));
 				}
 			}
 		}
@@ -450,6 +676,199 @@ void PrintTimingInformation(void)
 		PrintFileHeader(TimingFile);
 		fprintf(TimingFile, "Timing information for scene file '%s'\n", SceneFilename);
 		fprintf(TimingFile, "TotalTime = %dms\nScene parsing time = %dms\nAlgorithm time = %dms\n", TimingData.FinishTime - TimingData.StartTime, TimingData.SceneParsingFinishTime - TimingData.SceneParsingStartTime, TimingData.AlgorithmFinishTime - TimingData.AlgorithmStartTime);
+		fprintf(TimingFile, "\nScene parsing stages:\nFile reading time = %dms\nGrid allocation time = %dms\nRasterisation time = %dms\nCoefficient time = %dms\n", TimingData.SceneFileReadTime - TimingData.SceneParsingStartTime, TimingData.GridAllocatedTime - TimingData.SceneFileReadTime, TimingData.GridRasterisedTime - TimingData.GridAllocatedTime, TimingData.SceneParsingFinishTime - TimingData.GridRasterisedTime);
 	}
 	free(FilenameBuffer);
-}
\ No newline at end of file
+}
+
+
+// Start the thread that writes the records handed over by the compute threads, so they never wait on the console or files
+void StartOutputThread(void)
+{
+	hOutputEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	StopOutput = 0;
+
+	hOutputThread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)OutputThread, NULL, 0, NULL);
+	if (hOutputThread == NULL) {
+		printf("Output thread could not be started\n");
+		exit(1);
+	}
+}
+
+
+// Write the remaining records, stop the output thread and free the queues
+void StopOutputThread(void)
+{
+	InterlockedExchange(&StopOutput, 1);
+	SetEvent(hOutputEvent);
+	WaitForSingleObject(hOutputThread, INFINITE);
+	CloseHandle(hOutputThread);
+	CloseHandle(hOutputEvent);
+	hOutputThread = NULL;
+
+	for (int q=0; q<nOutputQueues; q++) {
+		if (OutputQueues[q]->Dropped > 0) {
+			printf("%d status records dropped while the output thread was busy\n", OutputQueues[q]->Dropped);
+		}
+		for (int i=0; i<OUTPUT_QUEUE_SLOTS; i++) {
+			free(OutputQueues[q]->Records[i].Values);
+		}
+		free(OutputQueues[q]->Records);
+		free(OutputQueues[q]);
+	}
+	nOutputQueues = 0;
+}
+
+
+// Create a queue for a single producer thread, whose records hold up to the number of values given
+OutputQueue *OpenOutputQueue(int MaxValues)
+{
+	OutputQueue *Queue;
+
+	if (nOutputQueues >= MAX_OUTPUT_QUEUES) {
+		printf("No more than %d output queues can be opened\n", MAX_OUTPUT_QUEUES);
+		exit(1);
+	}
+
+	Queue = (OutputQueue*)malloc(sizeof(OutputQueue));
+	Queue->Records = (OutputRecord*)malloc(OUTPUT_QUEUE_SLOTS*sizeof(OutputRecord));
+	for (int i=0; i<OUTPUT_QUEUE_SLOTS; i++) {
+		Queue->Records[i].Values = (double*)malloc(MAX(MaxValues, 1)*sizeof(double));
+	}
+	Queue->MaxValues = MaxValues;
+	Queue->Written = 0;
+	Queue->Read = 0;
+	Queue->Dropped = 0;
+
+	// The output thread only reads the queues below the count, so publish the queue before counting it
+	OutputQueues[nOutputQueues] = Queue;
+	MemoryBarrier();
+	InterlockedIncrement(&nOutputQueues);
+
+	return Queue;
+}
+
+
+// Return the next free record of a queue for the producer to fill. If the queue is full either wait for the output thread or
+// drop the record and return NULL
+OutputRecord *ReserveOutputRecord(OutputQueue *Queue, bool Wait)
+{
+	while (Queue->Written - Queue->Read >= OUTPUT_QUEUE_SLOTS) {
+		if (Wait == false) {
+			Queue->Dropped++;
+			return NULL;
+		}
+		SetEvent(hOutputEvent);
+		Sleep(0);
+	}
+
+	return &Queue->Records[Queue->Written%OUTPUT_QUEUE_SLOTS];
+}
+
+
+// Hand the record filled by the producer to the output thread
+void PostOutputRecord(OutputQueue *Queue)
+{
+	MemoryBarrier();
+	InterlockedIncrement(&Queue->Written);
+	SetEvent(hOutputEvent);
+}
+
+
+// Wait until the output thread has written every record posted so far, so that following output appears after it
+void FlushOutput(void)
+{
+	bool Pending = true;
+
+	while (Pending == true) {
+		Pending = false;
+		for (int q=0; q<nOutputQueues; q++) {
+			if (OutputQueues[q]->Read < OutputQueues[q]->Written) {
+				Pending = true;
+			}
+		}
+		if (Pending == true) {
+			SetEvent(hOutputEvent);
+			Sleep(1);
+		}
+	}
+}
+
+
+// Thread function writing the records of every queue as they are posted, until stopped
+DWORD WINAPI OutputThread(LPVOID lpParam)
+{
+	LONG Stopping;
+
+	while (1) {
+		WaitForSingleObject(hOutputEvent, OUTPUT_WAKE_PERIOD);
+
+		// Read the stop flag first, so that records posted before it was set are still written
+		Stopping = StopOutput;
+		DrainOutputQueues();
+		if (Stopping != 0) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+
+// Write every record posted to the queues
+void DrainOutputQueues(void)
+{
+	OutputQueue *Queue;
+	LONG nQueues = nOutputQueues;
+	bool Written = false;
+
+	MemoryBarrier();
+	for (int q=0; q<nQueues; q++) {
+		Queue = OutputQueues[q];
+		while (Queue->Read < Queue->Written) {
+			MemoryBarrier();
+			WriteOutputRecord(&Queue->Records[Queue->Read%OUTPUT_QUEUE_SLOTS]);
+			InterlockedIncrement(&Queue->Read);
+			Written = true;
+		}
+	}
+	if (Written == true) {
+		fflush(stdout);
+	}
+}
+
+
+// Write a single record to the display or the output files
+void WriteOutputRecord(OutputRecord *Record)
+{
+	int n = 0;
+
+	switch (Record->Type) {
+		case OUTPUT_SECTION_STATUS:
+			printf("Completed %d iterations\n", Record->Iteration);
+			for (int i=0; i<Record->Shape[0]; i++) {
+				for (int j=0; j<Record->Shape[1]; j++) {
+					for (int k=0; k<Record->Shape[2]; k++) {
+						printf("\tSection (%d,%d,%d):\t%d active junctions\n", i+1, j+1, k+1, (int)Record->Values[n++]);
+					}
+				}
+			}
+			break;
+
+		case OUTPUT_DOMAIN_STATUS:
+			printf("Completed %d iterations\n\tAll processes:\t%d active junctions\n", Record->Iteration, (int)Record->Values[0]);
+			break;
+
+		case OUTPUT_PROBE_CHUNK:
+			WriteProbeChunk(Record->Iteration, Record->nValues);
+			break;
+
+		case OUTPUT_CHECKPOINT:
+			WriteCheckpoint();
+			break;
+
+		case OUTPUT_SNAPSHOT:
+			WriteSnapshot(Record->nValues, Record->Iteration);
+			break;
+	}
+}
@@ -11,12 +11,48 @@
 #ifndef TLM_OUTPUT_H
 #define TLM_OUTPUT_H
 
+// Type definitions
+
+// Kinds of record handed to the output thread
+typedef enum {
+				OUTPUT_SECTION_STATUS,		// Active junctions of each section
+				OUTPUT_DOMAIN_STATUS,		// Active junctions of all of the processes sharing the grid
+				OUTPUT_PROBE_CHUNK,			// Rows of the ring of probe samples ready to be written
+				OUTPUT_CHECKPOINT,			// State of the grid to append to the checkpoint file
+				OUTPUT_SNAPSHOT				// Buffer of sampled nodes to write as a snapshot file
+				} OutputRecordType;
+
+// A snapshot handed from a compute thread to the output thread, the values are held by the queue
+typedef struct {
+				OutputRecordType Type;
+				int Iteration;				// First row of a chunk of probe samples
+				int Shape[3];				// Number of sections in each direction of a section status
+				int nValues;				// Values held, rows of a chunk of probe samples, or the buffer of a snapshot
+				double *Values;
+				} OutputRecord;
+
+// Single producer queue of records read by the output thread
+typedef struct {
+				OutputRecord *Records;
+				int MaxValues;
+				volatile LONG Written;		// Records posted by the producer
+				volatile LONG Read;			// Records handled by the output thread
+				LONG Dropped;				// Records the producer dropped because the queue was full
+				} OutputQueue;
+
 // Function prototypes
+void StartOutputThread(void);
+void StopOutputThread(void);
+OutputQueue *OpenOutputQueue(int MaxValues);
+OutputRecord *ReserveOutputRecord(OutputQueue *Queue, bool Wait);
+void PostOutputRecord(OutputQueue *Queue);
+void FlushOutput(void);
+double NodeEmax(int x, int y, int z);
+void PrintFileHeader(FILE *File);
 void PrintPathLossToFile(void);
 void PrintPathLossMatlabFriendly(void);
+void PrintObserverResults(void);
 void PrintImpedances(void);
-void SaveTimeVariation(TimeVariationSet *CurrentSet);
-void PrintTimeVariation(void);
 void PrintKappaData(void);
 void PrintTimingInformation(void);
 
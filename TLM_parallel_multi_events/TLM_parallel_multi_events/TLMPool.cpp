@@ -0,0 +1,198 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMPool.cpp
+//
+/*********************************************************************************************/
+
+#include "stdafx.h"
+#include "TLM.h"
+#include "TLMPool.h"
+
+
+// Definitions
+#define NODE_SLAB_BYTES		65536	// Size of the block of records allocated at once by a pool, the allocation granularity of VirtualAlloc
+#define NODE_SLAB_SIZE		(NODE_SLAB_BYTES/sizeof(ActiveNode))	// Records in a slab, including the one heading it
+#define NODE_RETURN_BATCH	256		// Number of records freed by another section before they are sent back to their pool
+
+
+// Global variables
+static NodePool *Pools = NULL;
+static int nNodePools = 0;
+
+
+// Function prototypes
+void AllocateNodeSlab(NodePool *Pool);
+void ReturnNodeBatch(NodePool *Pool, int Owner);
+int NodeOwner(ActiveNode *Node);
+
+
+// Create a pool of active junction records for each section
+NodePool *CreateNodePools(int nPools)
+{
+	nNodePools = nPools;
+	Pools = (NodePool*)calloc(nPools, sizeof(NodePool));
+	for (int p=0; p<nPools; p++) {
+		Pools[p].Index = p;
+		Pools[p].Outgoing = (ActiveNode**)calloc(nPools, sizeof(ActiveNode*));
+		Pools[p].OutgoingTail = (ActiveNode**)calloc(nPools, sizeof(ActiveNode*));
+		Pools[p].nOutgoing = (int*)calloc(nPools, sizeof(int));
+	}
+
+	return Pools;
+}
+
+
+// Free every slab of every pool, along with any records still in use
+void FreeNodePools(void)
+{
+	ActiveNode *Slab;
+
+	for (int p=0; p<nNodePools; p++) {
+		while (Pools[p].Slabs != NULL) {
+			Slab = Pools[p].Slabs;
+			Pools[p].Slabs = Slab->NextActiveNode;
+			VirtualFree(Slab, 0, MEM_RELEASE);
+		}
+		free(Pools[p].Outgoing);
+		free(Pools[p].OutgoingTail);
+		free(Pools[p].nOutgoing);
+	}
+	free(Pools);
+	Pools = NULL;
+	nNodePools = 0;
+}
+
+
+// Take a record from the pool, using the records sent back by other sections before allocating a new slab
+ActiveNode *AllocateActiveNode(NodePool *Pool)
+{
+	ActiveNode *NewNode;
+
+	if (Pool->FreeList == NULL) {
+		Pool->FreeList = (ActiveNode*)InterlockedExchangePointer((void* volatile*)&Pool->Returned, NULL);
+		if (Pool->FreeList == NULL) {
+			AllocateNodeSlab(Pool);
+		}
+	}
+
+	NewNode = Pool->FreeList;
+	Pool->FreeList = NewNode->NextActiveNode;
+	Pool->Allocations++;
+
+	return NewNode;
+}
+
+
+// Put a record back in the pool, a record allocated by another section joins the batch being returned to it
+void FreeActiveNode(NodePool *Pool, ActiveNode *Node)
+{
+	int Owner = NodeOwner(Node);
+
+	if (Owner == Pool->Index) {
+		Node->NextActiveNode = Pool->FreeList;
+		Pool->FreeList = Node;
+		Pool->LocalFrees++;
+		return;
+	}
+
+	Node->NextActiveNode = Pool->Outgoing[Owner];
+	if (Pool->Outgoing[Owner] == NULL) {
+		Pool->OutgoingTail[Owner] = Node;
+	}
+	Pool->Outgoing[Owner] = Node;
+	Pool->RemoteFrees++;
+	if (++Pool->nOutgoing[Owner] == NODE_RETURN_BATCH) {
+		ReturnNodeBatch(Pool, Owner);
+	}
+}
+
+
+// Send back every partial batch of records freed by the section, so that records are not held away from their pools between
+// iterations. Called by the thread running the section once it has connected
+void FlushNodePool(NodePool *Pool)
+{
+	for (int Owner=0; Owner<nNodePools; Owner++) {
+		if (Pool->nOutgoing[Owner] > 0) {
+			ReturnNodeBatch(Pool, Owner);
+		}
+	}
+}
+
+
+// Allocate a slab of records and add them to the free list of the pool. The slab is aligned to its size, and its first record
+// links the slabs of the pool and holds the pool's index, so the owner of a record is found from its address
+void AllocateNodeSlab(NodePool *Pool)
+{
+	ActiveNode *Slab = (ActiveNode*)VirtualAlloc(NULL, NODE_SLAB_BYTES, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+	if (Slab == NULL) {
+		printf("Error allocating memory for %d active junctions\n", (int)NODE_SLAB_SIZE);
+		exit(1);
+	}
+
+	Slab[0].X = Pool->Index;
+	Slab[0].NextActiveNode = Pool->Slabs;
+	Pool->Slabs = Slab;
+	for (int n=1; n<(int)NODE_SLAB_SIZE; n++) {
+		Slab[n].NextActiveNode = n < (int)NODE_SLAB_SIZE-1 ? &Slab[n+1] : Pool->FreeList;
+	}
+	Pool->FreeList = &Slab[1];
+	Pool->SlabCount++;
+}
+
+
+// Push a batch of records onto the returned list of the pool they came from, retrying if its owner or another section
+// changed the list at the same time
+void ReturnNodeBatch(NodePool *Pool, int Owner)
+{
+	ActiveNode *Head = Pool->Outgoing[Owner];
+	ActiveNode *Tail = Pool->OutgoingTail[Owner];
+	ActiveNode *Returned;
+
+	for (;;) {
+		Returned = Pools[Owner].Returned;
+		Tail->NextActiveNode = Returned;
+		if (InterlockedCompareExchangePointer((void* volatile*)&Pools[Owner].Returned, Head, Returned) == Returned) {
+			break;
+		}
+		Pool->ContendedReturns++;
+	}
+
+	Pool->Outgoing[Owner] = NULL;
+	Pool->nOutgoing[Owner] = 0;
+	Pool->BatchesReturned++;
+}
+
+
+// Return the index of the pool a record was allocated by, held in the first record of its slab
+int NodeOwner(ActiveNode *Node)
+{
+	return ((ActiveNode*)((ULONG_PTR)Node & ~(ULONG_PTR)(NODE_SLAB_BYTES-1)))->X;
+}
+
+
+// Print the use of the active junction records by all of the sections
+void PrintNodePoolStats(void)
+{
+	__int64 Allocations = 0, SlabCount = 0, LocalFrees = 0, RemoteFrees = 0, Batches = 0, Contended = 0;
+
+	for (int p=0; p<nNodePools; p++) {
+		Allocations += Pools[p].Allocations;
+		SlabCount += Pools[p].SlabCount;
+		LocalFrees += Pools[p].LocalFrees;
+		RemoteFrees += Pools[p].RemoteFrees;
+		Batches += Pools[p].BatchesReturned;
+		Contended += Pools[p].ContendedReturns;
+	}
+
+	printf("Active junction records: %I64d allocations from %I64d slabs (%.1fMB)\n", Allocations, SlabCount,
+		(double)SlabCount*NODE_SLAB_BYTES/(1024*1024));
+	if (nNodePools > 1) {
+		printf("Records freed by another section: %.1f%%, returned in %I64d batches, %I64d contended\n",
+			LocalFrees+RemoteFrees > 0 ? 100.0*RemoteFrees/(LocalFrees+RemoteFrees) : 0.0, Batches, Contended);
+	}
+}
@@ -0,0 +1,42 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMPool.h
+//
+/*********************************************************************************************/
+
+#ifndef TLM_POOL_H
+#define TLM_POOL_H
+
+// Type definitions
+
+// Structure to hold the active junction records of a single section. Only the thread running the section takes records from
+// the pool, records freed by other sections are collected into batches and pushed back onto the returned list
+typedef struct {
+				int Index;
+				ActiveNode *FreeList;					// Records ready to be handed out
+				ActiveNode * volatile Returned;			// Records sent back by other sections
+				ActiveNode *Slabs;						// Blocks of records allocated by the pool, linked through their first record
+				ActiveNode **Outgoing;					// Batch of records being returned to each other pool
+				ActiveNode **OutgoingTail;
+				int *nOutgoing;
+				__int64 Allocations;
+				__int64 SlabCount;
+				__int64 LocalFrees;
+				__int64 RemoteFrees;
+				__int64 BatchesReturned;
+				__int64 ContendedReturns;				// Batches that had to be pushed again because the list changed
+				} NodePool;
+
+// Function prototypes
+NodePool *CreateNodePools(int nPools);
+void FreeNodePools(void);
+ActiveNode *AllocateActiveNode(NodePool *Pool);
+void FreeActiveNode(NodePool *Pool, ActiveNode *Node);
+void FlushNodePool(NodePool *Pool);
+void PrintNodePoolStats(void);
+
+#endif //TLM_POOL_H
@@ -0,0 +1,309 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMProbe.cpp
+//
+/*********************************************************************************************/
+
+#include "stdafx.h"
+#include "TLM.h"
+#include "TLMMaths.h"
+#include "TLMScene.h"
+#include "TLMOutput.h"
+#include "TLMProbe.h"
+
+
+// Definitions
+#define PROBE_CHUNKS	4		// Chunks in the ring of samples, the iterations fill one while the output thread writes the others
+
+
+// Global variables
+static Probe *Probes = NULL;
+static Probe *LastProbe = NULL;
+
+// Samples of the run in progress. The ring holds PROBE_CHUNKS chunks of ProbeChunk rows, a row holding the voltage of every
+// probe node at the end of an iteration
+static Node **ProbeNodes = NULL;
+static int nProbeNodes = 0;
+static double *ProbeRing = NULL;
+static int *ProbeIterations = NULL;		// Iteration of each row of the ring
+static int RingRows;
+static LONG RowsRecorded;				// Rows filled by the iterations, only changed by the main thread
+static volatile LONG ChunksWritten;		// Chunks written to the file by the output thread
+static OutputQueue *ProbeQueue = NULL;
+static FILE *ProbeFile = NULL;
+
+extern Node ***Grid;
+extern int xSize, ySize, zSize;
+extern char *FolderName;
+extern char *ProjectName;
+extern char *TimeVariationFilename;
+extern int ProbeChunk;
+
+
+// Function prototypes
+void FindProbeNodes(Probe *ProbePtr, Node **Nodes);
+void PostProbeChunk(LONG FirstRow, LONG nRows);
+
+
+// Add a probe read from the input file, a line runs from Start to End
+void AddProbe(bool Line, double *Start, double *End)
+{
+	Probe *NewProbe = (Probe*)malloc(sizeof(Probe));
+
+	NewProbe->Line = Line;
+	NewProbe->CentreRow = false;
+	for (int d=0; d<3; d++) {
+		NewProbe->Start[d] = Start[d];
+		NewProbe->End[d] = Line == true ? End[d] : Start[d];
+	}
+	NewProbe->FirstColumn = 0;
+	NewProbe->nNodes = 0;
+	NewProbe->NextProbe = NULL;
+
+	if (Probes == NULL) {
+		Probes = NewProbe;
+	}
+	else {
+		LastProbe->NextProbe = NewProbe;
+	}
+	LastProbe = NewProbe;
+}
+
+
+// Add the row of nodes along x through the centre of the grid recorded by the time variation, ahead of the probes of the 
+// input file
+void AddCentreRowProbe(void)
+{
+	Probe *NewProbe = (Probe*)malloc(sizeof(Probe));
+
+	NewProbe->Line = true;
+	NewProbe->CentreRow = true;
+	for (int d=0; d<3; d++) {
+		NewProbe->Start[d] = 0;
+		NewProbe->End[d] = 0;
+	}
+	NewProbe->FirstColumn = 0;
+	NewProbe->nNodes = 0;
+	NewProbe->NextProbe = Probes;
+
+	Probes = NewProbe;
+	if (LastProbe == NULL) {
+		LastProbe = NewProbe;
+	}
+}
+
+
+bool ProbesDefined(void)
+{
+	return Probes != NULL;
+}
+
+
+// Display the probes read from the input file
+void DisplayProbes(void)
+{
+	int n = 1;
+
+	for (Probe *ProbePtr = Probes; ProbePtr != NULL; ProbePtr = ProbePtr->NextProbe, n++) {
+		if (ProbePtr->Line == true) {
+			printf("Probe %d = line from %f, %f, %f to %f, %f, %f\n", n, ProbePtr->Start[0], ProbePtr->Start[1], ProbePtr->Start[2], ProbePtr->End[0], ProbePtr->End[1], ProbePtr->End[2]);
+		}
+		else {
+			printf("Probe %d = point at %f, %f, %f\n", n, ProbePtr->Start[0], ProbePtr->Start[1], ProbePtr->Start[2]);
+		}
+	}
+}
+
+
+void FreeProbes(void)
+{
+	while (Probes != NULL) {
+		Probe *NextProbe = Probes->NextProbe;
+		free(Probes);
+		Probes = NextProbe;
+	}
+	LastProbe = NULL;
+}
+
+
+// Find the nodes of a probe, or only count them if Nodes is NULL. A line takes the nearest node at each step along its longest
+// axis
+void FindProbeNodes(Probe *ProbePtr, Node **Nodes)
+{
+	int First[3], Last[3];
+	int x, y, z;
+	int Steps = 0;
+
+	if (ProbePtr->CentreRow == true) {
+		First[0] = 0;
+		Last[0] = xSize-1;
+		First[1] = Last[1] = ySize/2;
+		First[2] = Last[2] = zSize/2;
+	}
+	else {
+		First[0] = NearestNodeX(ProbePtr->Start[0]);
+		First[1] = NearestNodeY(ProbePtr->Start[1]);
+		First[2] = NearestNodeZ(ProbePtr->Start[2]);
+		Last[0] = NearestNodeX(ProbePtr->End[0]);
+		Last[1] = NearestNodeY(ProbePtr->End[1]);
+		Last[2] = NearestNodeZ(ProbePtr->End[2]);
+	}
+	for (int d=0; d<3; d++) {
+		Steps = MAX(Steps, abs(Last[d]-First[d]));
+	}
+	ProbePtr->nNodes = Steps+1;
+
+	if (Nodes != NULL) {
+		for (int i=0; i<=Steps; i++) {
+			x = Steps == 0 ? First[0] : First[0] + RoundToNearest((double)(Last[0]-First[0])*i/Steps);
+			y = Steps == 0 ? First[1] : First[1] + RoundToNearest((double)(Last[1]-First[1])*i/Steps);
+			z = Steps == 0 ? First[2] : First[2] + RoundToNearest((double)(Last[2]-First[2])*i/Steps);
+			Nodes[i] = &Grid[x][y][z];
+		}
+	}
+}
+
+
+// Find the nodes of the probes, allocate the ring of samples and open the output file, before the first iteration. Returns
+// false if there are no probes or the file cannot be opened
+bool StartProbes(void)
+{
+	char Filename[MAX_PATH];
+	int n;
+
+	if (Probes == NULL) {
+		return false;
+	}
+
+	sprintf_s(Filename, sizeof(Filename), "%s/%s_%s", FolderName, ProjectName, TimeVariationFilename);
+	if (fopen_s(&ProbeFile, Filename, "w") != 0) {
+		printf("Could not open file '%s'\n", TimeVariationFilename);
+		ProbeFile = NULL;
+		return false;
+	}
+	printf("Recording probes to output file %s\n", TimeVariationFilename);
+
+	nProbeNodes = 0;
+	for (Probe *ProbePtr = Probes; ProbePtr != NULL; ProbePtr = ProbePtr->NextProbe) {
+		FindProbeNodes(ProbePtr, NULL);
+		ProbePtr->FirstColumn = nProbeNodes+2;
+		nProbeNodes += ProbePtr->nNodes;
+	}
+	ProbeNodes = (Node**)malloc(nProbeNodes*sizeof(Node*));
+	n = 0;
+	for (Probe *ProbePtr = Probes; ProbePtr != NULL; ProbePtr = ProbePtr->NextProbe) {
+		FindProbeNodes(ProbePtr, &ProbeNodes[n]);
+		n += ProbePtr->nNodes;
+	}
+
+	RingRows = PROBE_CHUNKS*ProbeChunk;
+	ProbeRing = (double*)malloc((SIZE_T)RingRows*nProbeNodes*sizeof(double));
+	ProbeIterations = (int*)malloc(RingRows*sizeof(int));
+	RowsRecorded = 0;
+	ChunksWritten = 0;
+	ProbeQueue = OpenOutputQueue(0);
+
+	// Describe the columns of the file, the iteration comes first
+	PrintFileHeader(ProbeFile);
+	n = 1;
+	for (Probe *ProbePtr = Probes; ProbePtr != NULL; ProbePtr = ProbePtr->NextProbe, n++) {
+		fprintf(ProbeFile, "Probe %d: columns %d to %d, ", n, ProbePtr->FirstColumn, ProbePtr->FirstColumn+ProbePtr->nNodes-1);
+		if (ProbePtr->CentreRow == true) {
+			fprintf(ProbeFile, "row through the centre of the grid\n");
+		}
+		else if (ProbePtr->Line == true) {
+			fprintf(ProbeFile, "line from %f, %f, %f to %f, %f, %f\n", ProbePtr->Start[0], ProbePtr->Start[1], ProbePtr->Start[2], ProbePtr->End[0], ProbePtr->End[1], ProbePtr->End[2]);
+		}
+		else {
+			fprintf(ProbeFile, "point at %f, %f, %f\n", ProbePtr->Start[0], ProbePtr->Start[1], ProbePtr->Start[2]);
+		}
+	}
+	fprintf(ProbeFile, "\nIteration\tV\n");
+
+	return true;
+}
+
+
+// Copy the voltages of the probe nodes into the ring at the end of an iteration, handing each chunk to the output thread as
+// it fills. Only waits if the output thread is a whole ring behind
+void RecordProbes(int Iteration)
+{
+	LONG Row = RowsRecorded%RingRows;
+	double *Values = &ProbeRing[(SIZE_T)Row*nProbeNodes];
+
+	// The chunk about to be filled must have been written since it was last used
+	if (RowsRecorded%ProbeChunk == 0) {
+		while (RowsRecorded/ProbeChunk - ChunksWritten >= PROBE_CHUNKS) {
+			Sleep(0);
+		}
+	}
+
+	ProbeIterations[Row] = Iteration;
+	for (int i=0; i<nProbeNodes; i++) {
+		Values[i] = ProbeNodes[i]->V;
+	}
+	RowsRecorded++;
+
+	if (RowsRecorded%ProbeChunk == 0) {
+		PostProbeChunk(RowsRecorded-ProbeChunk, ProbeChunk);
+	}
+}
+
+
+// Hand rows of the ring to the output thread to write
+void PostProbeChunk(LONG FirstRow, LONG nRows)
+{
+	OutputRecord *Record = ReserveOutputRecord(ProbeQueue, true);
+
+	Record->Type = OUTPUT_PROBE_CHUNK;
+	Record->Iteration = FirstRow;
+	Record->nValues = nRows;
+	PostOutputRecord(ProbeQueue);
+}
+
+
+// Write rows of the ring to the output file, called by the output thread
+void WriteProbeChunk(int FirstRow, int nRows)
+{
+	for (int r=FirstRow; r<FirstRow+nRows; r++) {
+		double *Values = &ProbeRing[(SIZE_T)(r%RingRows)*nProbeNodes];
+
+		fprintf(ProbeFile, "%d", ProbeIterations[r%RingRows]);
+		for (int i=0; i<nProbeNodes; i++) {
+			fprintf(ProbeFile, "\t%f", Values[i]);
+		}
+		fprintf(ProbeFile, "\n");
+	}
+
+	MemoryBarrier();
+	InterlockedIncrement(&ChunksWritten);
+}
+
+
+// Write the rows left in the ring once the iterations have finished, and close the output file
+void StopProbes(void)
+{
+	if (ProbeFile == NULL) {
+		return;
+	}
+
+	if (RowsRecorded%ProbeChunk != 0) {
+		PostProbeChunk(RowsRecorded - RowsRecorded%ProbeChunk, RowsRecorded%ProbeChunk);
+	}
+	FlushOutput();
+
+	if (fclose(ProbeFile)) {
+		printf("Probe file close unsuccessful\n");
+	}
+	ProbeFile = NULL;
+	free(ProbeNodes);
+	free(ProbeRing);
+	free(ProbeIterations);
+	ProbeNodes = NULL;
+	ProbeRing = NULL;
+	ProbeIterations = NULL;
+}
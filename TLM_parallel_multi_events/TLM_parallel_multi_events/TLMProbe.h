@@ -0,0 +1,38 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMProbe.h
+//
+/*********************************************************************************************/
+
+#ifndef TLM_PROBE_H
+#define TLM_PROBE_H
+
+// Type definitions
+
+// A point or a line of nodes whose voltages are recorded at the end of every iteration
+struct Probe {
+				bool Line;
+				bool CentreRow;				// The row along x through the centre of the grid, found once the grid is built
+				double Start[3];			// Position of the point, or the ends of the line, in metres
+				double End[3];
+				int FirstColumn;			// Column of the first node of the probe in the output file
+				int nNodes;
+				Probe *NextProbe;
+				};
+
+// Function prototypes
+void AddProbe(bool Line, double *Start, double *End);
+void AddCentreRowProbe(void);
+bool ProbesDefined(void);
+void DisplayProbes(void);
+void FreeProbes(void);
+bool StartProbes(void);
+void RecordProbes(int Iteration);
+void StopProbes(void);
+void WriteProbeChunk(int FirstRow, int nRows);
+
+#endif //TLM_PROBE_H
@@ -13,6 +13,17 @@
 #include "TLMScene.h"
 #include "TLMMaths.h"
 #include "TLM.h"
+#include "TLMNuma.h"
+#include "TLMDomain.h"
+#include "TLMTiming.h"
+#include "TLMCache.h"
+#include "TLMMesh.h"
+#include "TLMObserver.h"
+
+
+// Definitions
+#define SCENE_ARENA_BLOCK	(1024*1024)	// Minimum size of a block of the scene arena
+#define MESH_CHUNK			64			// Triangles of a mesh held by each polygon, and so rasterised by a single operation
 
 
 // Type definitions
@@ -29,10 +40,33 @@ struct Polygon_t {
 // Type definition to describe the orientation of the group of polygons
 typedef enum {
 				Horizontal,
-				Vertical
+				Vertical,
+				Triangulated		// Triangles of a mesh, each polygon holding three vertices per triangle
 			 } PolygonType;
 
 
+// Nodes covered by the polygons of a group of a block definition, rasterised at the first instance placed. Each polygon is 
+// numbered from 1, in the order of the group
+typedef struct {
+				int Shift[3];			// Position of the instance rasterised
+				int Min[3];				// Box of the stamps, in grid spacings from the origin of the scene
+				int Max[3];
+				LONG *NodeStamp;		// Last polygon to cover each node
+				LONG *ThinStamp[3];		// Last thin polygon to cross the link from each node to the next in x, y and z
+				} RasterTemplate;
+
+
+// Stamps of a box of nodes being rasterised, either the nodes of the grid or the box of a block template
+typedef struct {
+				volatile LONG *ImpedanceStamp;	// Latest operation, counted from 1, to cover each node
+				volatile LONG *PropagateStamp;	// Latest vertical operation, counted from 1, to cover each node
+				volatile LONG *ThinStamp[3];	// Latest thin operation to cross the link from each node to the next in x, y and z
+				int Min[3];						// Nodes covered by the stamps
+				int Max[3];
+				int Origin[3];					// Node of the scene at the origin of the stamps, 0 for a block template
+				} RasterContext;
+
+
 // Container for groups of polygons
 struct PolygonGroup {
 						PolygonType Type;
@@ -42,41 +76,237 @@ struct PolygonGroup {
 						bool PropagateFlag;
 						double Thickness;
 						int Priority;
+						int Number;							// Position of the group in the scene file, counted from 1, by which updates refer to it, -1 within a block
 						Polygon_t *PolygonList;				// Pointer to alinked list of polygon structures
+						PolygonGroup *Block;				// Group of a block definition placed by an instance, whose polygons it shares
+						Coordinate Position;				// Position of the instance, from the origin of the block
+						int Shift[3];						// Position of the instance in grid spacings
+						RasterTemplate *Template;			// Rasterisation of a group of a block definition, made at its first instance
 						PolygonGroup *NextPolygonGroup;		// Used for linked lists of polygon groups
 					};
 
 
+// Polygon groups defined once by a block of the scene file, and placed in the scene by each of its instances
+struct SceneBlock {
+					char *Name;
+					PolygonGroup *Groups;
+					SceneBlock *NextBlock;
+					};
+
+
+// A single polygon to be rasterised into the grid, operations are numbered in the order they overwrite each other
+typedef struct {
+				PolygonType Type;
+				Polygon_t *Polygon;
+				double Thickness;
+				double Impedance;
+				double TransmissionLoss;	// Loss in dB per cm, applied to the links crossed by a thin wall
+				bool PropagateFlag;
+				bool Intersection;		// The polygon is an air gap found from an intersection, freed once rasterised
+				bool Copy;				// The polygon is a copy of a block polygon moved to its instance, freed once rasterised
+				bool Thin;				// Thinner than the grid spacing, added to the links it crosses rather than to the nodes
+				int Min[3];				// Nodes the polygon may cover, in grid spacings from the origin of the scene
+				int Max[3];
+				RasterTemplate *Template;	// Stamped for the polygons of an instance by the first of their operations, moved by Shift
+				int Shift[3];
+				} RasterOperation;
+
+
+// A wall thinner than the grid spacing, folded into the coefficients of the links between the nodes either side of it
+typedef struct {
+				double Impedance;
+				double Thickness;
+				double TransmissionLoss;
+				} ThinSheet;
+
+
+// Position of the scene parser within the mapped scene file
+typedef struct {
+				const char *Next;			// Start of the next line
+				const char *End;			// End of the file
+				const char *LineStart;
+				const char *StatementEnd;	// End of the statement on the current line
+				const char *Cursor;			// Position of the next token in the statement
+				int Line;
+				HANDLE hFile;
+				HANDLE hMapping;
+				const char *View;			// Mapping of the file, NULL for an empty file
+				} SceneParser;
+
+
+// Block of the arena holding the polygon groups, polygons and vertices of the scene
+struct SceneArenaBlock {
+						SIZE_T Size;
+						SIZE_T Used;
+						SceneArenaBlock *Next;
+						};
+
+
+// A vertical polygon of the wall index, with its extent widened by the thickness of its group
+typedef struct {
+				Polygon_t *Polygon;
+				int Group;				// Position of the polygon group in the list
+				double Thickness;
+				double xMin;
+				double xMax;
+				double yMin;
+				double yMax;
+				int Query;				// Last query to return the wall, so a wall spanning several cells is returned once
+				bool Copy;				// Polygon of a block copied to the position of an instance, freed with the index
+				} IndexedWall;
+
+
+// Changes read from a scene update file. The groups it adds, or that replace a group of the scene, are read into a list of
+// their own
+typedef struct {
+				PolygonGroup *Groups;
+				int *Removed;			// Numbers of the scene groups removed
+				int nRemoved;
+				int Replace;			// Scene group replaced by the next group started, 0 for none
+				} SceneUpdate;
+
+
+// Nodes whose coefficients are calculated, each slab covers the rows given to it within these bounds
+typedef struct {
+				int yMin, yMax;
+				int zMin, zMax;
+				bool Replace;			// The nodes already hold coefficients, which are freed first
+				volatile LONG Boundaries;	// Material boundaries found
+				} CoefficientRegion;
+
+
+// Parameters passed to the threads of a parallel setup stage
+typedef struct {
+				SlabFunction Function;
+				void *Context;
+				int xMin;
+				int xMax;
+				} SlabData_t;
+
+
 // Reference Global variables
 extern Node ***Grid;
 extern int xSize, ySize, zSize;
+extern int xOffset, yOffset, zOffset;
+extern Source ImpulseSource;
+extern PLParams PathLossParameters;
 
 // Input parameters
 extern char *SceneFilename;
+extern char *SceneUpdateFilename;
 extern double GridSpacing;
 extern InputFlags InputData;
+extern int Workers;
+extern double CropMargin;
+extern double Frequency;
+
+// Extent of the scene, in grid spacings from its origin
+static int SceneMin[3];
+static int SceneMax[3];
+
+// Rasterisation state
+static RasterOperation *RasterOperations;		// Operations in the order they overwrite each other
+static int nRasterOperations;
+static volatile LONG NextRasterOperation;		// Next operation to be taken by a rasterisation thread
+static RasterContext GridRaster;				// Stamps of the grid, all the nodes held by this process unless updating the scene
+
+// Thin walls, the thin stamps of the grid are kept from rasterisation until the coefficients are calculated
+static ThinSheet *ThinSheets;					// Impedance and thickness of each operation, indexed as the stamps
+
+// Scene arena, the polygons read from the scene file are freed together once rasterised
+static SceneArenaBlock *SceneArena = NULL;
+
+// Polygon groups of the scene, kept in the arena when the scene is to be updated
+static PolygonGroup *SceneGroups = NULL;
+static int nSceneGroups = 0;					// Groups numbered so far, in the order they are read
+static SceneBlock *SceneBlocks = NULL;			// Blocks defined by the scene file, kept with its groups
+
+// Meshes read for the scene file, freed once their triangles are copied into the arena
+static Mesh *SceneMeshes = NULL;
+
+// Wall index, a uniform grid in xy of the vertical polygons used to find the walls a new wall may overlap
+static IndexedWall *Walls;
+static int nWalls;
+static int **CellWalls;							// Walls whose extent touches each cell
+static int *nCellWalls;
+static int xWallCells, yWallCells;
+static double WallCellOriginX, WallCellOriginY;
+static double WallCellSize;
+static int *WallCandidates;						// Walls returned by the last query, in the order of the polygon list
+static int nWallQueries;
 
 
 // Function prototypes
-bool ReadParameters(char **Context, PolygonGroup *PolygonGroupBuffer);
-bool ReadThickness(char **Context, PolygonGroup *PolygonGroupBuffer);
-bool ReadPriority(char **Context, PolygonGroup *PolygonGroupBuffer);
-bool ReadCoordinates(char **Context, Coordinate *CoordinateBuffer);
-bool ReadVertices(char *Buffer, Polygon_t *PolygonBuffer);
+bool ParseSceneFile(char *Filename, PolygonGroup **pHead, int *nPolygons, SceneUpdate *Update);
+bool ReadGroupNumbers(SceneParser *Parser, const char *Token, SceneUpdate *Update, bool Replace);
+bool OpenSceneParser(SceneParser *Parser, char *Filename);
+void CloseSceneParser(SceneParser *Parser);
+bool NextSceneStatement(SceneParser *Parser);
+bool NextSceneToken(SceneParser *Parser, const char **Token, int *Length);
+int CountSceneTokens(SceneParser *Parser);
+bool ReadSceneNumber(SceneParser *Parser, double *Value, const char *Name);
+void SceneError(SceneParser *Parser, const char *Position, const char *Message);
+bool ReadParameters(SceneParser *Parser, PolygonGroup *PolygonGroupBuffer);
+bool ReadThickness(SceneParser *Parser, PolygonGroup *PolygonGroupBuffer);
+bool ReadPriority(SceneParser *Parser, PolygonGroup *PolygonGroupBuffer);
+bool ReadCoordinates(SceneParser *Parser, Coordinate *CoordinateBuffer, Coordinate *Offset);
+bool ReadMeshTriangles(SceneParser *Parser, Coordinate *Offset, Polygon_t ***pPolygonListTail, int *nPolygons);
+bool ReadMeshFilename(SceneParser *Parser, char *Filename, size_t FilenameSize);
+bool BeginSceneBlock(SceneParser *Parser, SceneBlock **pBlock);
+bool ReadInstance(SceneParser *Parser, Coordinate *Offset, PolygonGroup **pHead, SceneUpdate *Update);
+void *AllocateSceneMemory(SIZE_T Bytes);
+void FreeSceneArena(void);
 PolygonGroup *NewPolygonGroup(PolygonGroup *PolygonGroupBuffer);
-Polygon_t *NewPolygon(void);
+Polygon_t *NewPolygon(int nVertices);
 void AddPolygonGroupToList(PolygonGroup **pHead, PolygonGroup *Buffer);
+PolygonGroup **FindPolygonGroup(PolygonGroup **pHead, int Number);
+void PolygonGroupBounds(PolygonGroup *Group, int *Min, int *Max);
+void PolygonBounds(Polygon_t *Polygon, double Thickness, int *Min, int *Max);
 void PrintPolygonGroupList(PolygonGroup *Head);
-void FreePolygonGroupList(PolygonGroup *Head);
-void FreePolygonList(Polygon_t *Head);
-Coordinate FindMaxSize(PolygonGroup *Head);
-void AllocateGridMemory(Coordinate MaxCoordinates);
+void FindSceneExtent(PolygonGroup *Head);
+void CropGridExtent(int *GridMin, int *GridMax);
+void AllocateGridMemory(void);
 void AddPolygonsToGrid(PolygonGroup *Head);
+void BuildRasterOperations(PolygonGroup *Head);
+void RasteriseRegion(int *Min, int *Max);
+void FreeRasterOperations(void);
+SIZE_T RasterIndex(RasterContext *Raster, int x, int y, int z);
+void ResetGridSlab(int xMin, int xMax, void *Context);
 Polygon_t *FindIntersection(Polygon_t *A, Polygon_t *B, double Thickness);
-void AddVerticalPolygon(Polygon_t *VPolygon, double Thickness, double Permittivity, bool PropagateFlag);
-void AddHorizontalPolygon(Polygon_t *HPolygon, double Thickness, double Permittivity, bool PropagateFlag);
-void FillTriangle(xyCoordinate P1, xyCoordinate P2, xyCoordinate P3, double Z, double Thickness, double Permittivity);
+void BuildWallIndex(PolygonGroup *Head);
+int FindWallCandidates(Polygon_t *Polygon, int nGroups);
+void FreeWallIndex(void);
+int CompareWallIndex(const void *Wall1, const void *Wall2);
+void AddRasterOperation(PolygonType Type, Polygon_t *Polygon, double Thickness, double Permittivity, double TransmissionLoss, bool PropagateFlag, bool Intersection);
+void AddWallIntersections(Polygon_t *Polygon, int nTestGroups);
+bool CrossesThickerWall(Polygon_t *Polygon, int nTestGroups);
+void AddInstanceOperations(PolygonGroup *Instance, int nTestGroups);
+void BuildRasterTemplate(PolygonGroup *Instance, RasterOperation Operation);
+Polygon_t *NewPolygonCopy(Polygon_t *Polygon, Coordinate *Position);
+DWORD WINAPI RasteriseThread(LPVOID lpParam);
+void RasterisePolygon(RasterContext *Raster, RasterOperation *Operation, LONG Index);
+void StampTemplate(RasterContext *Raster, RasterOperation *Operation, LONG Index);
+void RasterBounds(RasterContext *Raster, int *Low, int *High);
+void ResolveRasterSlab(int xMin, int xMax, void *Context);
+void MarkNode(RasterContext *Raster, int x, int y, int z, LONG Operation, bool Vertical);
+void MarkLink(RasterContext *Raster, int Axis, int x, int y, int z, LONG Operation);
+void AddThinPolygon(RasterContext *Raster, RasterOperation *Operation, LONG Index);
+void AddThinTriangle(RasterContext *Raster, Coordinate *Triangle, LONG Operation);
+void AddThinHorizontalPolygon(RasterContext *Raster, Polygon_t *HPolygon, LONG Operation);
+void AddVerticalPolygon(RasterContext *Raster, Polygon_t *VPolygon, double Thickness, LONG Operation);
+void AddHorizontalPolygon(RasterContext *Raster, Polygon_t *HPolygon, double Thickness, LONG Operation);
+void FillTriangle(RasterContext *Raster, xyCoordinate P1, xyCoordinate P2, xyCoordinate P3, double Z, double Thickness, LONG Operation);
+void AddTriangulatedPolygon(RasterContext *Raster, Polygon_t *TPolygon, double Thickness, LONG Operation);
+void VoxeliseTriangle(RasterContext *Raster, Coordinate *Triangle, double HalfSize, LONG Operation);
 void CalculateReflectionTransmissionCoefficients(void);
+void CalculateCoefficientSlab(int xMin, int xMax, void *Context);
+bool FindThinLinks(int x, int y, int z, LONG *Sheets);
+void ApplyThinLinks(int x, int y, int z, LONG *Sheets);
+double ThinSheetReflection(double Z, ThinSheet *Sheet);
+double ThinSheetAttenuation(ThinSheet *Sheet);
+void FreeThinLinks(void);
+int SetupThreadCount(void);
+DWORD WINAPI SlabThread(LPVOID lpParam);
 
 
 // The main setup function
@@ -84,716 +314,2268 @@ void CalculateReflectionTransmissionCoefficients(void);
 // Reads the scene file and stores the information as PolygonGroup and Polygon structures
 bool ReadSceneFile(void) 
 {
-	FILE *SceneFile;				// File pointer for the scene file
 	PolygonGroup *Head = NULL;		// Head of the linked list of polygon groups
 	int nPolygons = 0;				// Number of polygons read from the scene file
-	Coordinate MaxCoordinates;		// The maximum coordinates observed in the scene
 
-	// Attempt to open the scene file
-	if (fopen_s(&SceneFile, SceneFilename, "r") != 0) {
-		printf("Could not open scene file '%s'\n", SceneFilename);
-		return false;
+	// A scene rasterised before at the same grid spacing is read from its cache, unless its polygons are needed for an update
+	if (InputData.SceneCache.Flag == true && SceneUpdateFilename == NULL && LoadSceneCache() == true) {
+		return true;
 	}
-	else {
-		// Flags used whilst reading scene file data
-		bool EndOfFile;
-		bool ReadingParameters;
-		bool SuccessfulRead;
-		bool FirstGroup;
-		
-		char *Buffer;				// Text buffer for reading strings from the scene file
-		char *Context = NULL;		// Used for getting tokens from the buffer string
-		char *Parameter;			// Stores the identifier letter at the start of each scene file string
-		char *Comment;				// Used in removing comments from strings
-		int LineCount;					// Used for monitoring the position of errors in the scene file
-		Coordinate CoordinateBuffer;	// Stores coordinates read from the buffer
-		Coordinate Offset;						// Stores the current coordinate offset
-		PolygonGroup *PolygonGroupBuffer;		// Stores polygon group parameters as they are read from the file
-		Polygon_t *PolygonBuffer;					// Stores polygon parameters as they are read from the file
-		Polygon_t **PolygonListTail;				// Tail of the linked list of polygons
-
-		// Allocate memory for a new polygon group and the coordinate buffer
-		PolygonGroupBuffer = NewPolygonGroup(NULL);
-		PolygonListTail = &PolygonGroupBuffer->PolygonList;
-		
-		// Initiate the buffers
-		CoordinateBuffer.X = 0;
-		CoordinateBuffer.Y = 0;
-		CoordinateBuffer.Z = 0;
-		Offset.X = 0;
-		Offset.Y = 0;
-		Offset.Z = 0;
-
-		// Allocate memory for the buffer
-		Buffer = (char*) malloc(200*sizeof(char));
-
-		// Initialise the flags
-		EndOfFile = false;
-		ReadingParameters = false;
-		SuccessfulRead = true;
-		FirstGroup = true;
-
-		// Initialise the line count to 0
-		LineCount = 0;
-
-		printf("\nReading polygon information from scene file '%s'\n\n", SceneFilename);
-
-		// Read the scene file, one line at a time
-		do {
-			if (fgets(Buffer, 200, SceneFile) != NULL) {
-								
-				// Keep track of the line number
-				LineCount++;
-				// Search for and remove comments				
-				Comment = strstr(Buffer, "//");
-				if (Comment != NULL) {
-					Comment[0] = NULL;	// Replace with 0 to mark a new end of the string
-				}
 
-				// Remove leading whitespace and read the parameter type character (p,t,z,o,h,v)
-				Parameter = strtok_s(Buffer, "\t ", &Context);
-				if (Parameter != NULL) {
-					switch (Parameter[0]) {
-						
-						// Read the electrical parameters
-						case 'p':
-							// Set the reading parameters flag, create a new polygon group and add the old one to the list
-							ReadingParameters = true;
-							// Add the polygon buffer to the list if this is not the first read
-							if (FirstGroup == true) {
-								FirstGroup = false;
-							}
-							else {
-								AddPolygonGroupToList(&Head, PolygonGroupBuffer);
-								PolygonGroupBuffer = NewPolygonGroup(PolygonGroupBuffer);						
-								PolygonListTail = &PolygonGroupBuffer->PolygonList;
-								// FIXME: Should the offset be reset upon reading a 'p'?
-								//Offset.X = 0;
-								//Offset.Y = 0;
-								//Offset.Z = 0;
-							}
-							SuccessfulRead = ReadParameters(&Context, PolygonGroupBuffer);
-							break;
-						
-						// Read the wall thickness
-						case 't':
-							// If not currently reading parameters (i.e. not just read a p, z or t) create a new polygon group and add the old one to the list
-							if (ReadingParameters == false) {
-								ReadingParameters = true;
-								AddPolygonGroupToList(&Head, PolygonGroupBuffer);
-								PolygonGroupBuffer = NewPolygonGroup(PolygonGroupBuffer);
-								PolygonListTail = &PolygonGroupBuffer->PolygonList;
-								// FIXME: Should the offset be reset upon reading a 't'?
-								//Offset.X = 0;
-								//Offset.Y = 0;
-								//Offset.Z = 0;
-							}
-							SuccessfulRead = ReadThickness(&Context, PolygonGroupBuffer);
-							break;
-						
-						// Read the priority
-						case 'z':
-							// If not currently reading parameters (i.e. not just read a p, z or t) create a new polygon group and add the old one to the list
-							if (ReadingParameters == false) {
-								ReadingParameters = true;
-								AddPolygonGroupToList(&Head, PolygonGroupBuffer);
-								PolygonGroupBuffer = NewPolygonGroup(PolygonGroupBuffer);
-								PolygonListTail = &PolygonGroupBuffer->PolygonList;
-								// FIXME: Should the offset be reset upon reading a 'z'?
-								//Offset.X = 0;
-								//Offset.Y = 0;
-								//Offset.Z = 0;
-							}
-							SuccessfulRead = ReadPriority(&Context, PolygonGroupBuffer);
-							break;
-						
-						// Read the offset
-						case 'o':
-							SuccessfulRead = ReadCoordinates(&Context, &Offset);
-							break;
-
-						// Read a vertical polygon
-						case 'v':
-							// Ensure any previous polygons were also vertical
-							if (ReadingParameters == false && PolygonGroupBuffer->Type != Vertical) {
-								AddPolygonGroupToList(&Head, PolygonGroupBuffer);
-								PolygonGroupBuffer = NewPolygonGroup(PolygonGroupBuffer);
-								PolygonListTail = &PolygonGroupBuffer->PolygonList;
-							}
-							ReadingParameters = false;
-							PolygonGroupBuffer->Type = Vertical;
-							// Allocate memory for a new polygon structure with 2 vertices
-							PolygonBuffer = NewPolygon();
-							PolygonBuffer->Vertices = (Coordinate*)malloc(2*sizeof(Coordinate));
-							// Read in 2 sets of coordinates
-							while (ReadCoordinates(&Context, &CoordinateBuffer) == true) {
-								// Increment the number of vertices and  ensure only 2 are read for a vertical polygon
-								if (PolygonBuffer->nVertices < 2) {
-									PolygonBuffer->Vertices[PolygonBuffer->nVertices].X = CoordinateBuffer.X + Offset.X;
-									PolygonBuffer->Vertices[PolygonBuffer->nVertices].Y = CoordinateBuffer.Y + Offset.Y;
-									PolygonBuffer->Vertices[PolygonBuffer->nVertices].Z = CoordinateBuffer.Z + Offset.Z;
-								}	
-								PolygonBuffer->nVertices++;
-							}
-							// Ensure both both vertices have been read
-							if (PolygonBuffer->nVertices != 2) {
-								SuccessfulRead = false;
-							}
-							else {
-								nPolygons++;
-								*PolygonListTail = PolygonBuffer;
-								PolygonListTail = &(*PolygonListTail)->NextPolygon;
-							}
-							break;
-
-						// Read a horizontal polygon
-						case 'h':
-							// Ensure any previous polygons were also horizontal
-							if (ReadingParameters == false && PolygonGroupBuffer->Type != Horizontal) {
-								AddPolygonGroupToList(&Head, PolygonGroupBuffer);
-								PolygonGroupBuffer = NewPolygonGroup(PolygonGroupBuffer);
-								PolygonListTail = &PolygonGroupBuffer->PolygonList;
-							}
-							ReadingParameters = false;
-							PolygonGroupBuffer->Type = Horizontal;
-							// Allocate memory for a new polygon structure with 2 vertices
-							PolygonBuffer = NewPolygon();
-							PolygonBuffer->Vertices = (Coordinate*)malloc(50*sizeof(Coordinate));
-							// Read in at least 3 sets of coordinates
-							while (ReadCoordinates(&Context, &CoordinateBuffer) == true) {
-								// Increment the number of vertices and ensure there is enough memory for all of the vertices, reallocating 10 vertices at a time
-								PolygonBuffer->Vertices[PolygonBuffer->nVertices].X = CoordinateBuffer.X + Offset.X;
-								PolygonBuffer->Vertices[PolygonBuffer->nVertices].Y = CoordinateBuffer.Y + Offset.Y;
-								PolygonBuffer->Vertices[PolygonBuffer->nVertices].Z = CoordinateBuffer.Z + Offset.Z;
-								PolygonBuffer->nVertices++;
-							}
-							// Ensure at least 3 vertices have been read
-							if (PolygonBuffer->nVertices < 3) {
-								SuccessfulRead = false;
-							}
-							else {
-								nPolygons++;
-								*PolygonListTail = PolygonBuffer;
-								PolygonListTail = &(*PolygonListTail)->NextPolygon;
-							}
-							PolygonBuffer->Vertices = (Coordinate*)realloc(PolygonBuffer->Vertices, PolygonBuffer->nVertices*sizeof(Coordinate));
-							break;
-					}
-				}
-			}
-			else if (feof(SceneFile) != 0) {
-				EndOfFile = true;
-			}
-		}
-		while (EndOfFile == false && SuccessfulRead == true);
-
-		// Add the final group to the list
-		AddPolygonGroupToList(&Head, PolygonGroupBuffer);
-								
-		// Free allocated memory
-		free(Buffer);
-		fclose(SceneFile);
+	// Read the polygons from the scene file
+	if (ParseSceneFile(SceneFilename, &Head, &nPolygons, NULL) == false) {
+		FreeSceneArena();
+		return false;
+	}
+	printf("Scene file parsed successfully\nRead %d polygons\n\n", nPolygons);
 
-		// Check to see if there were any errors in the scene file
-		if (SuccessfulRead == false) {
-			printf("Error in scene file, line %d\n", LineCount);
-			// Free memory allocated to the polygons
-			FreePolygonGroupList(Head);
-			return false;
-		}
-		else {
-			printf("Scene file parsed successfully\nRead %d polygons\n\n", nPolygons);
-		}
+	if (InputData.PrintTimingInformation.Flag == true) {
+		SetSceneFileReadTime();
 	}
 
-	// Find the maximum coordinates in the system and allocate enough memory for a rectangle of this size
-	MaxCoordinates = FindMaxSize(Head);
+	// Find the bounds of the polygons, the grid covers them unless it is cropped
+	FindSceneExtent(Head);
 	// Print information on the polygons to the display
 	if (InputData.DisplayPolygonInformation.Flag == true) {
 		PrintPolygonGroupList(Head);
 	}
 	// Allocate memory for the TLM grid
-	AllocateGridMemory(MaxCoordinates);
+	AllocateGridMemory();
+	if (InputData.PrintTimingInformation.Flag == true) {
+		SetGridAllocatedTime();
+	}
+	// The coordinator of a split grid only needs its size, each process it starts builds its own slab
+	if (DomainCoordinator() == true) {
+		FreeSceneArena();
+		return true;
+	}
 	// Add the polygons into the grid
 	AddPolygonsToGrid(Head);
-	// Free memory allocated to the polygons
-	FreePolygonGroupList(Head);
+	// Free memory allocated to the polygons, unless they are kept for an update of the scene
+	if (SceneUpdateFilename == NULL) {
+		FreeSceneArena();
+	}
+	else {
+		SceneGroups = Head;
+	}
+	if (InputData.PrintTimingInformation.Flag == true) {
+		SetGridRasterisedTime();
+	}
 	// Calculate the reflection and transmission coefficients based on their impedances
 	CalculateReflectionTransmissionCoefficients();
+	// Keep the rasterised scene for later runs, when this process holds the whole grid
+	if (InputData.SceneCache.Flag == true && DomainMember() == false) {
+		SaveSceneCache();
+	}
 
 	return true;
 }
 
-// Read a string containing polygon parameters and store in PolygonGroupBuffer 
-bool ReadParameters(char **Context, PolygonGroup *PolygonGroupBuffer)
-{
-	bool Successful;
-	char *Parameter;
-
-	Successful = true;
 
-	// Read conductivity
-	Parameter = strtok_s(NULL, "\t ", Context);
-	if (Parameter != NULL) {
-		PolygonGroupBuffer->Conductivity = atof(Parameter);
-		if (PolygonGroupBuffer->Conductivity < 0) {
-			Successful = false;
-		}
+// Apply the changes of the scene update file to the grid of the scene read before, clearing the results of the last run. Only
+// the nodes that the groups removed, added or replaced may cover are rasterised again, and only they and the nodes next to
+// them have their coefficients calculated again
+bool ApplySceneUpdate(void)
+{
+	SceneUpdate Update = {NULL, NULL, 0, 0};
+	PolygonGroup **pGroup;
+	PolygonGroup *Group;
+	PolygonGroup *NextGroup;
+	int *ChangeMin;					// Nodes each change may cover, in grid spacings from the origin of the scene
+	int *ChangeMax;
+	int nChanges = 0;
+	int nGroups = 0;
+	int nPolygons = 0;
+	int nNodes = 0;
+	int Offset[3] = {xOffset, yOffset, zOffset};
+	int Size[3] = {xSize, ySize, zSize};
+	clock_t StartTime = clock();
+
+	// Read the changes, the groups added are numbered after those of the scene
+	if (ParseSceneFile(SceneUpdateFilename, &Update.Groups, &nPolygons, &Update) == false) {
+		free(Update.Removed);
+		return false;
 	}
-	else {
-		Successful = false;
+	for (Group = Update.Groups; Group != NULL; Group = Group->NextPolygonGroup) {
+		nGroups++;
 	}
-	// Read permittivity
-	Parameter = strtok_s(NULL, "\t ", Context);
-	if (Parameter != NULL) {
-		PolygonGroupBuffer->Permittivity = atof(Parameter);
-		if (PolygonGroupBuffer->Permittivity < 0) {
-			Successful = false;
+	printf("Scene update parsed successfully\nRead %d polygons, removing %d groups\n\n", nPolygons, Update.nRemoved);
+
+	// Clear the results of the last run
+	ParallelSlabs(FirstAllocatedRow(), LastAllocatedRow(), ResetGridSlab, NULL);
+
+	ChangeMin = (int*)malloc(3*MAX(Update.nRemoved + 2*nGroups, 1)*sizeof(int));
+	ChangeMax = (int*)malloc(3*MAX(Update.nRemoved + 2*nGroups, 1)*sizeof(int));
+
+	// Take the groups removed out of the scene
+	for (int i=0; i<Update.nRemoved; i++) {
+		pGroup = FindPolygonGroup(&SceneGroups, Update.Removed[i]);
+		if (*pGroup == NULL) {
+			printf("Group %d has already been taken out of the scene\n", Update.Removed[i]);
+			continue;
 		}
-	}
-	else {
-		Successful = false;
+		Group = *pGroup;
+		*pGroup = Group->NextPolygonGroup;
+		PolygonGroupBounds(Group, &ChangeMin[3*nChanges], &ChangeMax[3*nChanges]);
+		nChanges++;
 	}
 
-	// Read transmission loss
-	Parameter = strtok_s(NULL, "\t ", Context);
-	if (Parameter != NULL) {
-		PolygonGroupBuffer->TransmissionLoss = atof(Parameter);
-		if (PolygonGroupBuffer->TransmissionLoss < 0) {
-			Successful = false;
+	// Add the new groups to the scene. A group replacing one of the same priority takes its place in the list, so that it
+	// overwrites the same groups
+	for (Group = Update.Groups; Group != NULL; Group = NextGroup) {
+		NextGroup = Group->NextPolygonGroup;
+		pGroup = FindPolygonGroup(&SceneGroups, Group->Number);
+		if (*pGroup != NULL) {
+			PolygonGroupBounds(*pGroup, &ChangeMin[3*nChanges], &ChangeMax[3*nChanges]);
+			nChanges++;
+			if ((*pGroup)->Priority == Group->Priority) {
+				Group->NextPolygonGroup = (*pGroup)->NextPolygonGroup;
+				*pGroup = Group;
+			}
+			else {
+				*pGroup = (*pGroup)->NextPolygonGroup;
+				AddPolygonGroupToList(&SceneGroups, Group);
+			}
+		}
+		else {
+			AddPolygonGroupToList(&SceneGroups, Group);
 		}
+		PolygonGroupBounds(Group, &ChangeMin[3*nChanges], &ChangeMax[3*nChanges]);
+		nChanges++;
 	}
-	else {
-		Successful = false;
+	free(Update.Removed);
+
+	if (InputData.DisplayPolygonInformation.Flag == true) {
+		PrintPolygonGroupList(SceneGroups);
 	}
 
-	// Read propagate flag
-	Parameter = strtok_s(NULL, "\t ", Context);
-	if (Parameter != NULL) {
-		if (Parameter[0] == '1') {
-			PolygonGroupBuffer->PropagateFlag = true;
-		}
-		else if (Parameter[0] == '0') {
-			PolygonGroupBuffer->PropagateFlag = false;
-		}	
-		else {
-			Successful = false;
+	// Rasterise the nodes around each change from every operation of the scene that reaches them. The box rasterised is two 
+	// nodes wider than the change, so that the thin walls are known for both links of each node whose coefficients change
+	BuildRasterOperations(SceneGroups);
+	for (int i=0; i<nChanges; i++) {
+		int Min[3], Max[3];
+		CoefficientRegion Region;
+		int xMin, xMax;
+		bool Outside = false;
+
+		for (int d=0; d<3; d++) {
+			Min[d] = MAX(ChangeMin[3*i+d]-Offset[d]-2, 0);
+			Max[d] = MIN(ChangeMax[3*i+d]-Offset[d]+2, Size[d]-1);
+			if (ChangeMax[3*i+d]-Offset[d]+1 < 0 || ChangeMin[3*i+d]-Offset[d]-1 > Size[d]-1) {
+				Outside = true;
+			}
 		}
+		if (Outside == true) {
+			continue;
+		}
+		RasteriseRegion(Min, Max);
+
+		// Calculate the coefficients of the nodes within a node of the change
+		xMin = MAX(ChangeMin[3*i]-Offset[0]-1, 0);
+		xMax = MIN(ChangeMax[3*i]-Offset[0]+1, Size[0]-1);
+		Region.yMin = MAX(ChangeMin[3*i+1]-Offset[1]-1, 0);
+		Region.yMax = MIN(ChangeMax[3*i+1]-Offset[1]+1, Size[1]-1);
+		Region.zMin = MAX(ChangeMin[3*i+2]-Offset[2]-1, 0);
+		Region.zMax = MIN(ChangeMax[3*i+2]-Offset[2]+1, Size[2]-1);
+		Region.Replace = true;
+		Region.Boundaries = 0;
+		ParallelSlabs(xMin, xMax, CalculateCoefficientSlab, (void*)&Region);
+		FreeThinLinks();
+		nNodes += (xMax-xMin+1)*(Region.yMax-Region.yMin+1)*(Region.zMax-Region.zMin+1);
 	}
-	else {
-		Successful = false;
-	}
+	FreeRasterOperations();
+	free(ChangeMin);
+	free(ChangeMax);
 
-	return Successful;
+	printf("Scene updated in %dms, %d nodes of %d changes set again\n\n", (int)((clock()-StartTime)*1000/CLOCKS_PER_SEC), nNodes, nChanges);
+
+	return true;
 }
 
 
-// Read a string containing polygon thickness parameter and store in PolygonGroupBuffer
-bool ReadThickness(char **Context, PolygonGroup *PolygonGroupBuffer)
+// Map the scene file and read the polygon groups it describes into the scene arena. Each line holds one statement, a
+// letter and its values, ended by the end of the line, a ';' or a comment. A scene update may also remove groups of the
+// scene (r) and replace them (c) by the group that follows, given by their numbers. The groups between a block statement (b)
+// and its end (e) define a block, at its own origin, which is placed in the scene by each of its instances (i)
+bool ParseSceneFile(char *Filename, PolygonGroup **pHead, int *nPolygons, SceneUpdate *Update)
 {
-	bool Successful;
-	char *Parameter;
+	SceneParser Parser;
+	bool ReadingParameters = false;
+	bool SuccessfulRead = true;
+	bool FirstGroup = true;
+	const char *Token;
+	int Length;
+	int nValues;
+	Coordinate Offset = {0, 0, 0};				// Stores the current coordinate offset
+	PolygonGroup *PolygonGroupBuffer;			// Stores polygon group parameters as they are read from the file
+	Polygon_t *PolygonBuffer;					// Stores polygon parameters as they are read from the file
+	Polygon_t **PolygonListTail;				// Tail of the linked list of polygons
+	PolygonGroup **pList = pHead;				// List the groups read are added to, that of the block being defined
+	SceneBlock *Block = NULL;					// Block being defined
+	PolygonGroup *SceneGroupBuffer = NULL;		// State of the scene while a block is defined, restored at its end
+	Polygon_t **SceneListTail = NULL;
+	Coordinate SceneOffset = {0, 0, 0};
+	bool SceneReadingParameters = false;
+	bool SceneFirstGroup = true;
+
+	if (OpenSceneParser(&Parser, Filename) == false) {
+		printf("Could not open scene file '%s'\n", Filename);
+		return false;
+	}
+
+	printf("\nReading polygon information from scene file '%s'\n\n", Filename);
+
+	PolygonGroupBuffer = NewPolygonGroup(NULL);
+	PolygonListTail = &PolygonGroupBuffer->PolygonList;
+
+	// Read the scene file, one statement at a time
+	while (SuccessfulRead == true && NextSceneStatement(&Parser) == true) {
+		// Read the statement type character (p,t,z,o,h,v,m,r,c,b,e,i), the rest of the first token is a label
+		if (NextSceneToken(&Parser, &Token, &Length) == false) {
+			continue;
+		}
+		switch (Token[0]) {
+			
+			// Read the electrical parameters
+			case 'p':
+				// Set the reading parameters flag, create a new polygon group and add the old one to the list
+				ReadingParameters = true;
+				// Add the polygon buffer to the list if this is not the first read
+				if (FirstGroup == true) {
+					FirstGroup = false;
+				}
+				else {
+					AddPolygonGroupToList(pList, PolygonGroupBuffer);
+					PolygonGroupBuffer = NewPolygonGroup(PolygonGroupBuffer);
+					PolygonListTail = &PolygonGroupBuffer->PolygonList;
+				}
+				if (Update != NULL && Block == NULL) {
+					PolygonGroupBuffer->Number = Update->Replace;
+					Update->Replace = 0;
+				}
+				SuccessfulRead = ReadParameters(&Parser, PolygonGroupBuffer);
+				break;
+			
+			// Read the wall thickness
+			case 't':
+				// If not currently reading parameters (i.e. not just read a p, z or t) create a new polygon group and add the old one to the list
+				if (ReadingParameters == false) {
+					ReadingParameters = true;
+					AddPolygonGroupToList(pList, PolygonGroupBuffer);
+					PolygonGroupBuffer = NewPolygonGroup(PolygonGroupBuffer);
+					PolygonListTail = &PolygonGroupBuffer->PolygonList;
+					if (Update != NULL && Block == NULL) {
+						PolygonGroupBuffer->Number = Update->Replace;
+						Update->Replace = 0;
+					}
+				}
+				SuccessfulRead = ReadThickness(&Parser, PolygonGroupBuffer);
+				break;
+			
+			// Read the priority
+			case 'z':
+				// If not currently reading parameters (i.e. not just read a p, z or t) create a new polygon group and add the old one to the list
+				if (ReadingParameters == false) {
+					ReadingParameters = true;
+					AddPolygonGroupToList(pList, PolygonGroupBuffer);
+					PolygonGroupBuffer = NewPolygonGroup(PolygonGroupBuffer);
+					PolygonListTail = &PolygonGroupBuffer->PolygonList;
+					if (Update != NULL && Block == NULL) {
+						PolygonGroupBuffer->Number = Update->Replace;
+						Update->Replace = 0;
+					}
+				}
+				SuccessfulRead = ReadPriority(&Parser, PolygonGroupBuffer);
+				break;
+			
+			// Read the offset
+			case 'o':
+				SuccessfulRead = ReadCoordinates(&Parser, &Offset, NULL);
+				break;
+
+			// Read a vertical polygon, from exactly 2 vertices
+			case 'v':
+				// Ensure any previous polygons were also vertical
+				if (ReadingParameters == false && PolygonGroupBuffer->Type != Vertical) {
+					AddPolygonGroupToList(pList, PolygonGroupBuffer);
+					PolygonGroupBuffer = NewPolygonGroup(PolygonGroupBuffer);
+					PolygonListTail = &PolygonGroupBuffer->PolygonList;
+				}
+				ReadingParameters = false;
+				PolygonGroupBuffer->Type = Vertical;
+				nValues = CountSceneTokens(&Parser);
+				if (nValues != 6) {
+					SceneError(&Parser, Token, "a vertical polygon needs 2 vertices");
+					SuccessfulRead = false;
+				}
+				else {
+					PolygonBuffer = NewPolygon(2);
+					SuccessfulRead = ReadCoordinates(&Parser, &PolygonBuffer->Vertices[0], &Offset) && ReadCoordinates(&Parser, &PolygonBuffer->Vertices[1], &Offset);
+					(*nPolygons)++;
+					*PolygonListTail = PolygonBuffer;
+					PolygonListTail = &PolygonBuffer->NextPolygon;
+				}
+				break;
+
+			// Read a horizontal polygon, from at least 3 vertices
+			case 'h':
+				// Ensure any previous polygons were also horizontal
+				if (ReadingParameters == false && PolygonGroupBuffer->Type != Horizontal) {
+					AddPolygonGroupToList(pList, PolygonGroupBuffer);
+					PolygonGroupBuffer = NewPolygonGroup(PolygonGroupBuffer);
+					PolygonListTail = &PolygonGroupBuffer->PolygonList;
+				}
+				ReadingParameters = false;
+				PolygonGroupBuffer->Type = Horizontal;
+				nValues = CountSceneTokens(&Parser);
+				if (nValues < 9 || nValues%3 != 0) {
+					SceneError(&Parser, Token, "a horizontal polygon needs at least 3 vertices of 3 coordinates");
+					SuccessfulRead = false;
+				}
+				else {
+					PolygonBuffer = NewPolygon(nValues/3);
+					for (int i=0; i<PolygonBuffer->nVertices && SuccessfulRead == true; i++) {
+						SuccessfulRead = ReadCoordinates(&Parser, &PolygonBuffer->Vertices[i], &Offset);
+					}
+					(*nPolygons)++;
+					*PolygonListTail = PolygonBuffer;
+					PolygonListTail = &PolygonBuffer->NextPolygon;
+				}
+				break;
+
+			// Read the triangles of a mesh file, either all of them or those of a single material
+			case 'm':
+				// Ensure any previous polygons were also triangulated
+				if (ReadingParameters == false && PolygonGroupBuffer->Type != Triangulated) {
+					AddPolygonGroupToList(pList, PolygonGroupBuffer);
+					PolygonGroupBuffer = NewPolygonGroup(PolygonGroupBuffer);
+					PolygonListTail = &PolygonGroupBuffer->PolygonList;
+				}
+				ReadingParameters = false;
+				PolygonGroupBuffer->Type = Triangulated;
+				SuccessfulRead = ReadMeshTriangles(&Parser, &Offset, &PolygonListTail, nPolygons);
+				break;
+
+			// Remove groups of the scene, or replace one by the next group
+			case 'r':
+			case 'c':
+				if (Update == NULL) {
+					SceneError(&Parser, Token, "groups may only be removed or replaced by a scene update");
+					SuccessfulRead = false;
+				}
+				else {
+					SuccessfulRead = ReadGroupNumbers(&Parser, Token, Update, Token[0] == 'c');
+				}
+				break;
+
+			// Begin the definition of a block, its groups are read into a list of their own from the default parameters
+			case 'b':
+				if (Block != NULL) {
+					SceneError(&Parser, Token, "a block cannot be defined within another");
+					SuccessfulRead = false;
+				}
+				else {
+					SuccessfulRead = BeginSceneBlock(&Parser, &Block);
+				}
+				if (SuccessfulRead == true && Block != NULL) {
+					SceneGroupBuffer = PolygonGroupBuffer;
+					SceneListTail = PolygonListTail;
+					SceneOffset = Offset;
+					SceneReadingParameters = ReadingParameters;
+					SceneFirstGroup = FirstGroup;
+					pList = &Block->Groups;
+					PolygonGroupBuffer = NewPolygonGroup(NULL);
+					PolygonGroupBuffer->Number = -1;
+					PolygonListTail = &PolygonGroupBuffer->PolygonList;
+					Offset.X = Offset.Y = Offset.Z = 0;
+					ReadingParameters = false;
+					FirstGroup = true;
+				}
+				break;
 
-	Successful = true;
+			// End the definition of a block, the group of the scene carries on as before the block
+			case 'e':
+				if (Block == NULL) {
+					SceneError(&Parser, Token, "no block is being defined");
+					SuccessfulRead = false;
+				}
+				else {
+					AddPolygonGroupToList(pList, PolygonGroupBuffer);
+					PolygonGroupBuffer = SceneGroupBuffer;
+					PolygonListTail = SceneListTail;
+					Offset = SceneOffset;
+					ReadingParameters = SceneReadingParameters;
+					FirstGroup = SceneFirstGroup;
+					pList = pHead;
+					Block = NULL;
+				}
+				break;
 
-	// Read thickness
-	Parameter = strtok_s(NULL, "\t ", Context);
-	if (Parameter != NULL) {
-		PolygonGroupBuffer->Thickness = atof(Parameter);
-		if (PolygonGroupBuffer->Thickness < 0) {
-			Successful = false;
+			// Place an instance of a block
+			case 'i':
+				if (Block != NULL) {
+					SceneError(&Parser, Token, "a block cannot be placed within a block");
+					SuccessfulRead = false;
+				}
+				else {
+					SuccessfulRead = ReadInstance(&Parser, &Offset, pHead, Update);
+				}
+				break;
 		}
 	}
-	else {
-		Successful = false;
+
+	if (SuccessfulRead == true && Block != NULL) {
+		printf("Error in scene file '%s': block '%s' has no end\n", Filename, Block->Name);
+		SuccessfulRead = false;
 	}
 
-	return Successful;
+	// Add the final group to the list
+	AddPolygonGroupToList(pList, PolygonGroupBuffer);
+
+	CloseSceneParser(&Parser);
+
+	// The triangles of the meshes have been copied into the arena
+	while (SceneMeshes != NULL) {
+		Mesh *NextMesh = SceneMeshes->NextMesh;
+		FreeMesh(SceneMeshes);
+		SceneMeshes = NextMesh;
+	}
+
+	return SuccessfulRead;
 }
 
 
-// Read a string containing polygon priority parameter and store in PolygonGroupBuffer
-bool ReadPriority(char **Context, PolygonGroup *PolygonGroupBuffer)
+// Read the numbers of the scene groups removed, or the single group replaced by the next group of a scene update
+bool ReadGroupNumbers(SceneParser *Parser, const char *Token, SceneUpdate *Update, bool Replace)
 {
-	bool Successful;
-	char *Parameter;
+	int nValues = CountSceneTokens(Parser);
+	double Number;
 
-	Successful = true;
-
-	// Read priority
-	Parameter = strtok_s(NULL, "\t ", Context);
-	if (Parameter != NULL) {
-		PolygonGroupBuffer->Priority = atoi(Parameter);
-		if (PolygonGroupBuffer->Priority < 0) {
-			Successful = false;
-		}
+	if (nValues == 0 || (Replace == true && nValues != 1)) {
+		SceneError(Parser, Token, Replace == true ? "a replacement needs the number of a single group" : "a removal needs the numbers of its groups");
+		return false;
 	}
-	else {
-		Successful = false;
+	if (Replace == false) {
+		Update->Removed = (int*)realloc(Update->Removed, (Update->nRemoved+nValues)*sizeof(int));
+	}
+	for (int i=0; i<nValues; i++) {
+		if (ReadSceneNumber(Parser, &Number, "group number") == false) {
+			return false;
+		}
+		if (Number < 1 || Number > nSceneGroups || Number != floor(Number)) {
+			SceneError(Parser, Token, "not the number of a group of the scene");
+			return false;
+		}
+		if (Replace == true) {
+			Update->Replace = (int)Number;
+		}
+		else {
+			Update->Removed[Update->nRemoved++] = (int)Number;
+		}
 	}
 
-	return Successful;
+	return true;
 }
 
 
-// Read a string containing a set of coordinates and store in CoordinateBuffer
-bool ReadCoordinates(char **Context, Coordinate *CoordinateBuffer)
+// Open and map a scene file for the parser, an empty file has no mapping
+bool OpenSceneParser(SceneParser *Parser, char *Filename)
 {
-	bool Successful;
-	char *Parameter;
+	LARGE_INTEGER FileSize;
 
-	Successful = true;
-				
-	// Read x coordinate
-	Parameter = strtok_s(NULL, "\t ", Context);
-	if (Parameter != NULL) {
-		CoordinateBuffer->X = atof(Parameter);
+	Parser->hMapping = NULL;
+	Parser->View = NULL;
+	Parser->hFile = CreateFile(Filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (Parser->hFile == INVALID_HANDLE_VALUE) {
+		return false;
 	}
-	else {
-		Successful = false;
+	GetFileSizeEx(Parser->hFile, &FileSize);
+	if (FileSize.QuadPart > 0) {
+		Parser->hMapping = CreateFileMapping(Parser->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (Parser->hMapping != NULL) {
+			Parser->View = (const char*)MapViewOfFile(Parser->hMapping, FILE_MAP_READ, 0, 0, 0);
+		}
+		if (Parser->View == NULL) {
+			CloseSceneParser(Parser);
+			return false;
+		}
 	}
-	// Read y coordinate
-	Parameter = strtok_s(NULL, "\t ", Context);
-	if (Parameter != NULL) {
-		CoordinateBuffer->Y = atof(Parameter);
+
+	Parser->Next = Parser->View;
+	Parser->End = Parser->View + (SIZE_T)FileSize.QuadPart;
+	Parser->Line = 0;
+
+	return true;
+}
+
+
+// Unmap and close the scene file
+void CloseSceneParser(SceneParser *Parser)
+{
+	if (Parser->View != NULL) {
+		UnmapViewOfFile(Parser->View);
 	}
-	else {
-		Successful = false;
+	if (Parser->hMapping != NULL) {
+		CloseHandle(Parser->hMapping);
 	}
-	// Read z coordinate
-	Parameter = strtok_s(NULL, "\t ", Context);
-	if (Parameter != NULL) {
-		CoordinateBuffer->Z = atof(Parameter);
+	CloseHandle(Parser->hFile);
+}
+
+
+// Move the parser to the next statement of the file, returns false at the end of the file. The statement ends at the
+// end of its line, a ';' or a comment, and the rest of the line after it is skipped
+bool NextSceneStatement(SceneParser *Parser)
+{
+	const char *p;
+
+	if (Parser->Next >= Parser->End) {
+		return false;
 	}
-	else {
-		Successful = false;
+
+	Parser->LineStart = Parser->Next;
+	Parser->Cursor = Parser->Next;
+	Parser->Line++;
+	for (p = Parser->Next; p < Parser->End && *p != '\n'; p++);
+	Parser->Next = p < Parser->End ? p+1 : p;
+
+	Parser->StatementEnd = Parser->LineStart;
+	while (Parser->StatementEnd < p && *Parser->StatementEnd != ';' && 
+		(*Parser->StatementEnd != '/' || Parser->StatementEnd+1 >= p || Parser->StatementEnd[1] != '/'))
+	{
+		Parser->StatementEnd++;
 	}
 
-	return Successful;
+	return true;
 }
 
 
-// Allocate memory for and initiate a polygon group structure, initialising to PolygonGroupBuffer or default values if PolygonGroupBuffer is NULL
-PolygonGroup *NewPolygonGroup(PolygonGroup *PolygonGroupBuffer)
+// Find the next token of the statement without copying it, returns false if there are none left
+bool NextSceneToken(SceneParser *Parser, const char **Token, int *Length)
 {
-	PolygonGroup *NewPolygonGroup;
+	const char *p = Parser->Cursor;
 
-	NewPolygonGroup = (PolygonGroup*) malloc(sizeof(PolygonGroup));
-
-	// New Polygon required
-	if (PolygonGroupBuffer == NULL) {
-		NewPolygonGroup->Type = Horizontal;
-		NewPolygonGroup->Permittivity = 0;
-		NewPolygonGroup->Conductivity = 0;
-		NewPolygonGroup->TransmissionLoss = 0;
-		NewPolygonGroup->PropagateFlag = false;
-		NewPolygonGroup->Thickness = 0;
-		NewPolygonGroup->Priority = 0;
+	while (p < Parser->StatementEnd && (*p == ' ' || *p == '\t' || *p == '\r')) {
+		p++;
 	}
-	// Copy the polygon from another
-	else {
-		NewPolygonGroup->Type = PolygonGroupBuffer->Type;
-		NewPolygonGroup->Permittivity = PolygonGroupBuffer->Permittivity;
-		NewPolygonGroup->Conductivity = PolygonGroupBuffer->Conductivity;
-		NewPolygonGroup->TransmissionLoss = PolygonGroupBuffer->TransmissionLoss;
-		NewPolygonGroup->PropagateFlag = PolygonGroupBuffer->PropagateFlag;
-		NewPolygonGroup->Thickness = PolygonGroupBuffer->Thickness;
-		NewPolygonGroup->Priority = PolygonGroupBuffer->Priority;
+	if (p == Parser->StatementEnd) {
+		Parser->Cursor = p;
+		return false;
 	}
 
-	NewPolygonGroup->PolygonList = NULL;
-	NewPolygonGroup->NextPolygonGroup = NULL;
+	*Token = p;
+	while (p < Parser->StatementEnd && *p != ' ' && *p != '\t' && *p != '\r') {
+		p++;
+	}
+	*Length = (int)(p - *Token);
+	Parser->Cursor = p;
 
-	return NewPolygonGroup;
+	return true;
 }
 
 
-// Allocate memory for and initiate a polygon structure, initialising to default values
-Polygon_t *NewPolygon(void)
+// Count the tokens left in the statement
+int CountSceneTokens(SceneParser *Parser)
 {
-	Polygon_t *NewPolygon;
+	const char *Cursor = Parser->Cursor;
+	const char *Token;
+	int Length;
+	int nTokens = 0;
 
-	NewPolygon = (Polygon_t*)malloc(sizeof(Polygon_t));
-	NewPolygon->nVertices = 0;
-	NewPolygon->Vertices = NULL;
-	NewPolygon->NextPolygon = NULL;
+	while (NextSceneToken(Parser, &Token, &Length) == true) {
+		nTokens++;
+	}
+	Parser->Cursor = Cursor;
 
-	return NewPolygon;
+	return nTokens;
 }
 
 
-// Add a polygon group to the linked list of polygon groups pHead. The list stores polygon groups in order of priority such that the head is of lowest priority (usually 0)
-void AddPolygonGroupToList(PolygonGroup **pHead, PolygonGroup *PolygonGroupBuffer) 
+// Read the next token of the statement as a number, reporting the position of a missing or malformed value
+bool ReadSceneNumber(SceneParser *Parser, double *Value, const char *Name)
 {
-	if (*pHead == NULL) {
-		*pHead = PolygonGroupBuffer;
-		(*pHead)->NextPolygonGroup = NULL;
+	const char *Token;
+	int Length;
+	char Buffer[64];
+	char *NumberEnd;
+	char Message[128];
+
+	if (NextSceneToken(Parser, &Token, &Length) == false) {
+		sprintf_s(Message, sizeof(Message), "missing %s", Name);
+		SceneError(Parser, Parser->Cursor, Message);
+		return false;
 	}
-	else {
-		PolygonGroup *PreviousPolygonGroup;
-		PolygonGroup *NextPolygonGroup;
-
-		NextPolygonGroup = *pHead;
-		PreviousPolygonGroup = *pHead;
 
-		// Search for the first polygon of equal or higher priority
-		while (PreviousPolygonGroup->NextPolygonGroup != NULL && NextPolygonGroup->Priority <= PolygonGroupBuffer->Priority) {
-			PreviousPolygonGroup = NextPolygonGroup;
-			NextPolygonGroup = PreviousPolygonGroup->NextPolygonGroup;
+	// Numbers are converted from a terminated copy, the file itself is never written
+	if (Length < (int)sizeof(Buffer)) {
+		memcpy(Buffer, Token, Length);
+		Buffer[Length] = 0;
+		*Value = strtod(Buffer, &NumberEnd);
+		if (NumberEnd == Buffer + Length && Length > 0) {
+			return true;
 		}
-		// Insert the new polygon into the list
-		PolygonGroupBuffer->NextPolygonGroup = PreviousPolygonGroup->NextPolygonGroup;
-		PreviousPolygonGroup->NextPolygonGroup = PolygonGroupBuffer;
 	}
+	sprintf_s(Message, sizeof(Message), "%s is not a number", Name);
+	SceneError(Parser, Token, Message);
+
+	return false;
 }
 
 
-// Free memory allocated to a linked list of polygon group structures, freeing each polygon group in turn
-void FreePolygonGroupList(PolygonGroup *Head)
+// Print an error at a position within the current statement
+void SceneError(SceneParser *Parser, const char *Position, const char *Message)
 {
-	PolygonGroup *PolygonGroupPtr;
-	PolygonGroup *NextPolygonGroup;
-	
-	// Free each polygon group in turn 
-	PolygonGroupPtr = Head;
-	while (PolygonGroupPtr != NULL) {
-		NextPolygonGroup = PolygonGroupPtr->NextPolygonGroup;
-		FreePolygonList(PolygonGroupPtr->PolygonList);
-		free(PolygonGroupPtr);
-		PolygonGroupPtr = NextPolygonGroup;
+	printf("Error in scene file '%s', line %d, column %d: %s\n", SceneFilename, Parser->Line, (int)(Position - Parser->LineStart)+1, Message);
+}
+
+
+// Read the electrical parameters of a polygon group, conductivity, permittivity, transmission loss and propagate flag
+bool ReadParameters(SceneParser *Parser, PolygonGroup *PolygonGroupBuffer)
+{
+	const char *Token;
+	int Length;
+
+	if (ReadSceneNumber(Parser, &PolygonGroupBuffer->Conductivity, "conductivity") == false ||
+		ReadSceneNumber(Parser, &PolygonGroupBuffer->Permittivity, "permittivity") == false ||
+		ReadSceneNumber(Parser, &PolygonGroupBuffer->TransmissionLoss, "transmission loss") == false)
+	{
+		return false;
+	}
+	if (PolygonGroupBuffer->Conductivity < 0 || PolygonGroupBuffer->Permittivity < 0 || PolygonGroupBuffer->TransmissionLoss < 0) {
+		SceneError(Parser, Parser->LineStart, "the electrical parameters cannot be negative");
+		return false;
+	}
+
+	// Read propagate flag
+	if (NextSceneToken(Parser, &Token, &Length) == false) {
+		SceneError(Parser, Parser->Cursor, "missing propagate flag");
+		return false;
+	}
+	if (Token[0] == '1') {
+		PolygonGroupBuffer->PropagateFlag = true;
+	}
+	else if (Token[0] == '0') {
+		PolygonGroupBuffer->PropagateFlag = false;
+	}	
+	else {
+		SceneError(Parser, Token, "the propagate flag must be 0 or 1");
+		return false;
 	}
+
+	return true;
 }
 
 
-// Free memory allocated to a linked list of polygon structures
-void FreePolygonList(Polygon_t *Head)
+// Read the thickness of a polygon group
+bool ReadThickness(SceneParser *Parser, PolygonGroup *PolygonGroupBuffer)
 {
-	Polygon_t *PolygonPtr;
-	Polygon_t *NextPolygon;
+	if (ReadSceneNumber(Parser, &PolygonGroupBuffer->Thickness, "thickness") == false) {
+		return false;
+	}
+	if (PolygonGroupBuffer->Thickness < 0) {
+		SceneError(Parser, Parser->LineStart, "the thickness cannot be negative");
+		return false;
+	}
 
-	// Free each polygon in turn
-	PolygonPtr = Head;
-	while (PolygonPtr != NULL) {
-		NextPolygon = PolygonPtr->NextPolygon;
-		free(PolygonPtr->Vertices);
-		free(PolygonPtr);
-		PolygonPtr = NextPolygon;
+	return true;
+}
+
+
+// Read the priority of a polygon group
+bool ReadPriority(SceneParser *Parser, PolygonGroup *PolygonGroupBuffer)
+{
+	double Priority;
+
+	if (ReadSceneNumber(Parser, &Priority, "priority") == false) {
+		return false;
+	}
+	PolygonGroupBuffer->Priority = (int)Priority;
+	if (PolygonGroupBuffer->Priority < 0) {
+		SceneError(Parser, Parser->LineStart, "the priority cannot be negative");
+		return false;
 	}
+
+	return true;
 }
 
 
-// Print the parameters of each polygon group to the display, followed by the details of any polygons in each group
-void PrintPolygonGroupList(PolygonGroup *Head)
+// Read a set of coordinates, adding the offset if one is given
+bool ReadCoordinates(SceneParser *Parser, Coordinate *CoordinateBuffer, Coordinate *Offset)
 {
-	int i = 1;
-	PolygonGroup *PolygonGroupPtr = Head;
-	while (PolygonGroupPtr != NULL) {
-		printf("\nPolygon group %d parameters:\n", i);
-		printf("Type = %s\nPerm = %f\nCond = %f\nTL = %f\nPropagate = %s\nThickness = %f\nPriority = %d\n\n", PolygonGroupPtr->Type == Horizontal ? "horizontal" : "vertical", PolygonGroupPtr->Permittivity,PolygonGroupPtr->Conductivity, PolygonGroupPtr->TransmissionLoss, PolygonGroupPtr->PropagateFlag == true ? "true" : "false", PolygonGroupPtr->Thickness, PolygonGroupPtr->Priority);
-		
-		// Print each of the polygons
-		Polygon_t *PolygonPtr = PolygonGroupPtr->PolygonList;
-		int j = 1;
-		while (PolygonPtr != NULL) {
-			printf("Polygon %d parameters:\n", j);
-			// Print each of the vertices in turn
-			for (int k = 0; k<PolygonPtr->nVertices; k++) {
-				printf("Vertex %d:\tX = %.3f\tY = %.3f\tZ = %.3f\n", k+1, PolygonPtr->Vertices[k].X, PolygonPtr->Vertices[k].Y, PolygonPtr->Vertices[k].Z);
+	if (ReadSceneNumber(Parser, &CoordinateBuffer->X, "x coordinate") == false ||
+		ReadSceneNumber(Parser, &CoordinateBuffer->Y, "y coordinate") == false ||
+		ReadSceneNumber(Parser, &CoordinateBuffer->Z, "z coordinate") == false)
+	{
+		return false;
+	}
+	if (Offset != NULL) {
+		CoordinateBuffer->X += Offset->X;
+		CoordinateBuffer->Y += Offset->Y;
+		CoordinateBuffer->Z += Offset->Z;
+	}
+
+	return true;
+}
+
+
+// Read the triangles of a mesh, adding the offset to each vertex. The mesh file is followed by the name of a material of
+// the mesh, without one every triangle is read
+bool ReadMeshTriangles(SceneParser *Parser, Coordinate *Offset, Polygon_t ***pPolygonListTail, int *nPolygons)
+{
+	char Filename[MAX_PATH];
+	char Material[256];
+	const char *Token;
+	int Length;
+	int MaterialIndex = -1;
+	Mesh *MeshPtr;
+	Polygon_t *PolygonBuffer = NULL;
+
+	if (ReadMeshFilename(Parser, Filename, sizeof(Filename)) == false) {
+		return false;
+	}
+
+	// Each mesh is only read once, however many of its materials are used
+	for (MeshPtr = SceneMeshes; MeshPtr != NULL && strcmp(MeshPtr->Filename, Filename) != 0; MeshPtr = MeshPtr->NextMesh);
+	if (MeshPtr == NULL) {
+		MeshPtr = ReadMeshFile(Filename);
+		if (MeshPtr == NULL) {
+			return false;
+		}
+		MeshPtr->NextMesh = SceneMeshes;
+		SceneMeshes = MeshPtr;
+	}
+
+	if (NextSceneToken(Parser, &Token, &Length) == true) {
+		if (Length >= (int)sizeof(Material)) {
+			SceneError(Parser, Token, "material name is too long");
+			return false;
+		}
+		memcpy(Material, Token, Length);
+		Material[Length] = 0;
+		MaterialIndex = FindMeshMaterial(MeshPtr, Material);
+		if (MaterialIndex < 0) {
+			SceneError(Parser, Token, "the mesh has no triangles of this material");
+			return false;
+		}
+	}
+
+	// Copy the triangles into polygons of up to MESH_CHUNK triangles, so that the rasterisation threads share a mesh
+	for (int t=0; t<MeshPtr->nTriangles; t++) {
+		if (MaterialIndex >= 0 && MeshPtr->TriangleMaterials[t] != MaterialIndex) {
+			continue;
+		}
+		if (PolygonBuffer == NULL || PolygonBuffer->nVertices == 3*MESH_CHUNK) {
+			PolygonBuffer = NewPolygon(3*MESH_CHUNK);
+			PolygonBuffer->nVertices = 0;
+			**pPolygonListTail = PolygonBuffer;
+			*pPolygonListTail = &PolygonBuffer->NextPolygon;
+		}
+		for (int i=0; i<3; i++) {
+			Coordinate *Vertex = &PolygonBuffer->Vertices[PolygonBuffer->nVertices++];
+			*Vertex = MeshPtr->Vertices[MeshPtr->Triangles[3*t+i]];
+			Vertex->X += Offset->X;
+			Vertex->Y += Offset->Y;
+			Vertex->Z += Offset->Z;
+		}
+		(*nPolygons)++;
+	}
+
+	return true;
+}
+
+
+// Read the name of a mesh file, relative to the directory of the scene file unless it is an absolute path
+bool ReadMeshFilename(SceneParser *Parser, char *Filename, size_t FilenameSize)
+{
+	const char *Token;
+	int Length;
+	size_t DirectoryLength = 0;
+
+	if (NextSceneToken(Parser, &Token, &Length) == false) {
+		SceneError(Parser, Parser->Cursor, "missing mesh file");
+		return false;
+	}
+
+	if (Token[0] != '/' && Token[0] != '\\' && (Length < 2 || Token[1] != ':')) {
+		for (size_t i=0; SceneFilename[i] != 0; i++) {
+			if (SceneFilename[i] == '/' || SceneFilename[i] == '\\') {
+				DirectoryLength = i+1;
+			}
+		}
+	}
+	if (DirectoryLength + Length >= FilenameSize) {
+		SceneError(Parser, Token, "mesh file name is too long");
+		return false;
+	}
+	memcpy(Filename, SceneFilename, DirectoryLength);
+	memcpy(Filename + DirectoryLength, Token, Length);
+	Filename[DirectoryLength + Length] = 0;
+
+	return true;
+}
+
+
+// Begin the definition of a block, given by the name that follows
+bool BeginSceneBlock(SceneParser *Parser, SceneBlock **pBlock)
+{
+	const char *Name;
+	int Length;
+	SceneBlock *Block;
+
+	if (NextSceneToken(Parser, &Name, &Length) == false) {
+		SceneError(Parser, Parser->Cursor, "missing block name");
+		return false;
+	}
+	for (Block = SceneBlocks; Block != NULL; Block = Block->NextBlock) {
+		if ((int)strlen(Block->Name) == Length && strncmp(Block->Name, Name, Length) == 0) {
+			SceneError(Parser, Name, "a block of this name is already defined");
+			return false;
+		}
+	}
+
+	Block = (SceneBlock*)AllocateSceneMemory(sizeof(SceneBlock) + Length + 1);
+	Block->Name = (char*)(Block+1);
+	memcpy(Block->Name, Name, Length);
+	Block->Name[Length] = 0;
+	Block->Groups = NULL;
+	Block->NextBlock = SceneBlocks;
+	SceneBlocks = Block;
+	*pBlock = Block;
+
+	return true;
+}
+
+
+// Place an instance of a block, given by its name and the position of its origin, adding a group to the scene for each group 
+// of the block. An instance a whole number of grid spacings from the origin of the block shares its polygons, and is 
+// rasterised by stamping the rasterisation of the block. Any other instance is given copies of the polygons, moved into place
+bool ReadInstance(SceneParser *Parser, Coordinate *Offset, PolygonGroup **pHead, SceneUpdate *Update)
+{
+	const char *Name;
+	int Length;
+	SceneBlock *Block;
+	Coordinate Position;
+	double Coordinates[3];
+	int Shift[3];
+	bool Aligned = true;
+
+	if (NextSceneToken(Parser, &Name, &Length) == false) {
+		SceneError(Parser, Parser->Cursor, "missing block name");
+		return false;
+	}
+	for (Block = SceneBlocks; Block != NULL; Block = Block->NextBlock) {
+		if ((int)strlen(Block->Name) == Length && strncmp(Block->Name, Name, Length) == 0) {
+			break;
+		}
+	}
+	if (Block == NULL) {
+		SceneError(Parser, Name, "no block of this name has been defined");
+		return false;
+	}
+	if (ReadCoordinates(Parser, &Position, Offset) == false) {
+		return false;
+	}
+
+	Coordinates[0] = Position.X;
+	Coordinates[1] = Position.Y;
+	Coordinates[2] = Position.Z;
+	for (int d=0; d<3; d++) {
+		double Steps = Coordinates[d]/GridSpacing;
+		Shift[d] = (int)floor(Steps + 0.5);
+		if (fabs(Steps - Shift[d]) > 1e-6) {
+			Aligned = false;
+		}
+	}
+
+	for (PolygonGroup *BlockGroup = Block->Groups; BlockGroup != NULL; BlockGroup = BlockGroup->NextPolygonGroup) {
+		PolygonGroup *Group;
+
+		if (BlockGroup->PolygonList == NULL) {
+			continue;
+		}
+		Group = NewPolygonGroup(BlockGroup);
+		Group->Number = 0;
+		if (Update != NULL) {
+			Group->Number = Update->Replace;
+			Update->Replace = 0;
+		}
+		if (Aligned == true) {
+			Group->Block = BlockGroup;
+			Group->Position = Position;
+			for (int d=0; d<3; d++) {
+				Group->Shift[d] = Shift[d];
+			}
+		}
+		else {
+			Polygon_t **PolygonListTail = &Group->PolygonList;
+			for (Polygon_t *PolygonPtr = BlockGroup->PolygonList; PolygonPtr != NULL; PolygonPtr = PolygonPtr->NextPolygon) {
+				Polygon_t *PolygonBuffer = NewPolygon(PolygonPtr->nVertices);
+				for (int i=0; i<PolygonPtr->nVertices; i++) {
+					PolygonBuffer->Vertices[i].X = PolygonPtr->Vertices[i].X + Position.X;
+					PolygonBuffer->Vertices[i].Y = PolygonPtr->Vertices[i].Y + Position.Y;
+					PolygonBuffer->Vertices[i].Z = PolygonPtr->Vertices[i].Z + Position.Z;
+				}
+				*PolygonListTail = PolygonBuffer;
+				PolygonListTail = &PolygonBuffer->NextPolygon;
+			}
+		}
+		AddPolygonGroupToList(pHead, Group);
+	}
+
+	return true;
+}
+
+
+// Hash the contents of each mesh file used by the scene file, so that the scene cache is rebuilt when a mesh changes
+bool HashSceneMeshes(ULONGLONG *Hash)
+{
+	SceneParser Parser;
+	const char *Token;
+	int Length;
+	char Filename[MAX_PATH];
+	bool Successful = true;
+
+	if (OpenSceneParser(&Parser, SceneFilename) == false) {
+		return false;
+	}
+	while (Successful == true && NextSceneStatement(&Parser) == true) {
+		if (NextSceneToken(&Parser, &Token, &Length) == true && Token[0] == 'm') {
+			Successful = ReadMeshFilename(&Parser, Filename, sizeof(Filename)) && HashFile(Filename, Hash);
+		}
+	}
+	CloseSceneParser(&Parser);
+
+	return Successful;
+}
+
+
+// Take memory for the scene from the arena, allocating a new block when the current one is full. Everything taken is
+// freed together by FreeSceneArena
+void *AllocateSceneMemory(SIZE_T Bytes)
+{
+	SceneArenaBlock *Block;
+	void *Memory;
+
+	// Keep every allocation aligned for doubles
+	Bytes = (Bytes + 7) & ~(SIZE_T)7;
+
+	if (SceneArena == NULL || SceneArena->Used + Bytes > SceneArena->Size) {
+		SIZE_T Size = MAX(Bytes, SCENE_ARENA_BLOCK);
+		Block = (SceneArenaBlock*)malloc(sizeof(SceneArenaBlock) + Size);
+		if (Block == NULL) {
+			printf("Error allocating memory for the scene\n");
+			exit(1);
+		}
+		Block->Size = Size;
+		Block->Used = 0;
+		Block->Next = SceneArena;
+		SceneArena = Block;
+	}
+
+	Memory = (char*)(SceneArena+1) + SceneArena->Used;
+	SceneArena->Used += Bytes;
+
+	return Memory;
+}
+
+
+// Free every polygon group, polygon and vertex of the scene
+void FreeSceneArena(void)
+{
+	SceneArenaBlock *Block;
+
+	while (SceneArena != NULL) {
+		Block = SceneArena;
+		SceneArena = Block->Next;
+		free(Block);
+	}
+	SceneBlocks = NULL;
+}
+
+
+// Initiate a polygon group structure in the arena, initialising to PolygonGroupBuffer or default values if PolygonGroupBuffer is NULL
+PolygonGroup *NewPolygonGroup(PolygonGroup *PolygonGroupBuffer)
+{
+	PolygonGroup *NewPolygonGroup;
+
+	NewPolygonGroup = (PolygonGroup*)AllocateSceneMemory(sizeof(PolygonGroup));
+
+	// New Polygon required
+	if (PolygonGroupBuffer == NULL) {
+		NewPolygonGroup->Type = Horizontal;
+		NewPolygonGroup->Permittivity = 0;
+		NewPolygonGroup->Conductivity = 0;
+		NewPolygonGroup->TransmissionLoss = 0;
+		NewPolygonGroup->PropagateFlag = false;
+		NewPolygonGroup->Thickness = 0;
+		NewPolygonGroup->Priority = 0;
+	}
+	// Copy the polygon from another
+	else {
+		NewPolygonGroup->Type = PolygonGroupBuffer->Type;
+		NewPolygonGroup->Permittivity = PolygonGroupBuffer->Permittivity;
+		NewPolygonGroup->Conductivity = PolygonGroupBuffer->Conductivity;
+		NewPolygonGroup->TransmissionLoss = PolygonGroupBuffer->TransmissionLoss;
+		NewPolygonGroup->PropagateFlag = PolygonGroupBuffer->PropagateFlag;
+		NewPolygonGroup->Thickness = PolygonGroupBuffer->Thickness;
+		NewPolygonGroup->Priority = PolygonGroupBuffer->Priority;
+	}
+
+	// The groups of a block are not numbered, only those placed by its instances
+	NewPolygonGroup->Number = PolygonGroupBuffer != NULL && PolygonGroupBuffer->Number < 0 ? -1 : 0;
+	NewPolygonGroup->PolygonList = NULL;
+	NewPolygonGroup->Block = NULL;
+	NewPolygonGroup->Position.X = NewPolygonGroup->Position.Y = NewPolygonGroup->Position.Z = 0;
+	NewPolygonGroup->Shift[0] = NewPolygonGroup->Shift[1] = NewPolygonGroup->Shift[2] = 0;
+	NewPolygonGroup->Template = NULL;
+	NewPolygonGroup->NextPolygonGroup = NULL;
+
+	return NewPolygonGroup;
+}
+
+
+// Initiate a polygon structure in the arena, with its vertices following it
+Polygon_t *NewPolygon(int nVertices)
+{
+	Polygon_t *NewPolygon;
+
+	NewPolygon = (Polygon_t*)AllocateSceneMemory(sizeof(Polygon_t) + nVertices*sizeof(Coordinate));
+	NewPolygon->nVertices = nVertices;
+	NewPolygon->Vertices = (Coordinate*)((char*)NewPolygon + ((sizeof(Polygon_t) + 7) & ~(SIZE_T)7));
+	NewPolygon->NextPolygon = NULL;
+
+	return NewPolygon;
+}
+
+
+// Add a polygon group to the linked list of polygon groups pHead. The list stores polygon groups in order of priority such that the head is of lowest priority (usually 0)
+void AddPolygonGroupToList(PolygonGroup **pHead, PolygonGroup *PolygonGroupBuffer) 
+{
+	// Number the group in the order it was read, unless it takes the place of a group of the scene
+	if (PolygonGroupBuffer->Number == 0) {
+		PolygonGroupBuffer->Number = ++nSceneGroups;
+	}
+
+	if (*pHead == NULL) {
+		*pHead = PolygonGroupBuffer;
+		(*pHead)->NextPolygonGroup = NULL;
+	}
+	else {
+		PolygonGroup *PreviousPolygonGroup;
+		PolygonGroup *NextPolygonGroup;
+
+		NextPolygonGroup = *pHead;
+		PreviousPolygonGroup = *pHead;
+
+		// Search for the first polygon of equal or higher priority
+		while (PreviousPolygonGroup->NextPolygonGroup != NULL && NextPolygonGroup->Priority <= PolygonGroupBuffer->Priority) {
+			PreviousPolygonGroup = NextPolygonGroup;
+			NextPolygonGroup = PreviousPolygonGroup->NextPolygonGroup;
+		}
+		// Insert the new polygon into the list
+		PolygonGroupBuffer->NextPolygonGroup = PreviousPolygonGroup->NextPolygonGroup;
+		PreviousPolygonGroup->NextPolygonGroup = PolygonGroupBuffer;
+	}
+}
+
+
+// Find the link to the polygon group of the number given in the linked list of polygon groups pHead, which holds NULL if the
+// group is not in the list
+PolygonGroup **FindPolygonGroup(PolygonGroup **pHead, int Number)
+{
+	while (*pHead != NULL && (*pHead)->Number != Number) {
+		pHead = &(*pHead)->NextPolygonGroup;
+	}
+
+	return pHead;
+}
+
+
+// Find the nodes that the polygons of a group may cover, in grid spacings from the origin of the scene, or of the block for
+// a group of a block definition. Min is above Max for a group without polygons
+void PolygonGroupBounds(PolygonGroup *Group, int *Min, int *Max)
+{
+	int PolygonMin[3], PolygonMax[3];
+	bool FirstPolygon = true;
+	Polygon_t *PolygonList = Group->Block != NULL ? Group->Block->PolygonList : Group->PolygonList;
+
+	for (int d=0; d<3; d++) {
+		Min[d] = 0;
+		Max[d] = -1;
+	}
+	for (Polygon_t *PolygonPtr = PolygonList; PolygonPtr != NULL; PolygonPtr = PolygonPtr->NextPolygon) {
+		PolygonBounds(PolygonPtr, Group->Thickness, PolygonMin, PolygonMax);
+		for (int d=0; d<3; d++) {
+			Min[d] = FirstPolygon == true ? PolygonMin[d] : MIN(Min[d], PolygonMin[d]);
+			Max[d] = FirstPolygon == true ? PolygonMax[d] : MAX(Max[d], PolygonMax[d]);
+		}
+		FirstPolygon = false;
+	}
+	// An instance covers the nodes of its block, moved to its position
+	if (FirstPolygon == false) {
+		for (int d=0; d<3; d++) {
+			Min[d] += Group->Shift[d];
+			Max[d] += Group->Shift[d];
+		}
+	}
+}
+
+
+// Find the nodes that a polygon may cover once rasterised, in grid spacings from the origin of the scene. The polygon is 
+// widened by half its thickness, which is at least the grid spacing, and by a node either side for the rounding of the 
+// rasterisation
+void PolygonBounds(Polygon_t *Polygon, double Thickness, int *Min, int *Max)
+{
+	double Low[3], High[3];
+	double HalfThickness = MAX(Thickness, GridSpacing)/2;
+
+	Low[0] = High[0] = Polygon->Vertices[0].X;
+	Low[1] = High[1] = Polygon->Vertices[0].Y;
+	Low[2] = High[2] = Polygon->Vertices[0].Z;
+	for (int i=1; i<Polygon->nVertices; i++) {
+		Low[0] = MIN(Low[0], Polygon->Vertices[i].X);
+		Low[1] = MIN(Low[1], Polygon->Vertices[i].Y);
+		Low[2] = MIN(Low[2], Polygon->Vertices[i].Z);
+		High[0] = MAX(High[0], Polygon->Vertices[i].X);
+		High[1] = MAX(High[1], Polygon->Vertices[i].Y);
+		High[2] = MAX(High[2], Polygon->Vertices[i].Z);
+	}
+	for (int d=0; d<3; d++) {
+		Min[d] = (int)floor((Low[d]-HalfThickness)/GridSpacing) - 1;
+		Max[d] = RoundUpwards((High[d]+HalfThickness)/GridSpacing) + 1;
+	}
+}
+
+
+// Print the parameters of each polygon group to the display, followed by the details of any polygons in each group
+void PrintPolygonGroupList(PolygonGroup *Head)
+{
+	PolygonGroup *PolygonGroupPtr = Head;
+	while (PolygonGroupPtr != NULL) {
+		printf("\nPolygon group %d parameters:\n", PolygonGroupPtr->Number);
+		printf("Type = %s\nPerm = %f\nCond = %f\nTL = %f\nPropagate = %s\nThickness = %f\nPriority = %d\n\n", PolygonGroupPtr->Type == Horizontal ? "horizontal" : PolygonGroupPtr->Type == Vertical ? "vertical" : "triangulated", PolygonGroupPtr->Permittivity,PolygonGroupPtr->Conductivity, PolygonGroupPtr->TransmissionLoss, PolygonGroupPtr->PropagateFlag == true ? "true" : "false", PolygonGroupPtr->Thickness, PolygonGroupPtr->Priority);
+		
+		// Print each of the polygons, those of an instance at its position
+		Polygon_t *PolygonPtr = PolygonGroupPtr->PolygonList;
+		Coordinate Shift = {0, 0, 0};
+		if (PolygonGroupPtr->Block != NULL) {
+			PolygonPtr = PolygonGroupPtr->Block->PolygonList;
+			Shift = PolygonGroupPtr->Position;
+			printf("Instance of a block group, moved by %d, %d, %d grid spacings\n", PolygonGroupPtr->Shift[0], PolygonGroupPtr->Shift[1], PolygonGroupPtr->Shift[2]);
+		}
+		int j = 1;
+		while (PolygonPtr != NULL) {
+			printf("Polygon %d parameters:\n", j);
+			// Print each of the vertices in turn
+			for (int k = 0; k<PolygonPtr->nVertices; k++) {
+				printf("Vertex %d:\tX = %.3f\tY = %.3f\tZ = %.3f\n", k+1, PolygonPtr->Vertices[k].X + Shift.X, PolygonPtr->Vertices[k].Y + Shift.Y, PolygonPtr->Vertices[k].Z + Shift.Z);
+			}
+			// Find the next polygon in the list
+			j++;
+			PolygonPtr = PolygonPtr->NextPolygon;
+		}
+		// find the next polygon group in the list
+		PolygonGroupPtr = PolygonGroupPtr->NextPolygonGroup;
+	}
+}
+
+
+// Find the bounds of all of the polygons, and hence the extent of the scene in grid spacings from its origin
+void FindSceneExtent(PolygonGroup *Head)
+{
+	Coordinate MinCoordinates = {0, 0, 0};
+	Coordinate MaxCoordinates = {0, 0, 0};
+	PolygonGroup *PolygonGroupPtr = Head;
+	bool FirstVertex = true;
+
+	while (PolygonGroupPtr != NULL) {
+		Polygon_t *PolygonPtr = PolygonGroupPtr->PolygonList;
+		Coordinate Shift = {0, 0, 0};
+
+		// The polygons of an instance are those of its block, moved to its position
+		if (PolygonGroupPtr->Block != NULL) {
+			PolygonPtr = PolygonGroupPtr->Block->PolygonList;
+			Shift = PolygonGroupPtr->Position;
+		}
+		while (PolygonPtr != NULL) {
+			for (int i=0; i<PolygonPtr->nVertices; i++) {
+				Coordinate Vertex = {PolygonPtr->Vertices[i].X + Shift.X, PolygonPtr->Vertices[i].Y + Shift.Y, PolygonPtr->Vertices[i].Z + Shift.Z};
+				if (FirstVertex == true) {
+					MinCoordinates = Vertex;
+					MaxCoordinates = Vertex;
+					FirstVertex = false;
+				}
+				MinCoordinates.X = MIN(MinCoordinates.X, Vertex.X);
+				MinCoordinates.Y = MIN(MinCoordinates.Y, Vertex.Y);
+				MinCoordinates.Z = MIN(MinCoordinates.Z, Vertex.Z);
+				MaxCoordinates.X = MAX(MaxCoordinates.X, Vertex.X);
+				MaxCoordinates.Y = MAX(MaxCoordinates.Y, Vertex.Y);
+				MaxCoordinates.Z = MAX(MaxCoordinates.Z, Vertex.Z);
+			}
+			PolygonPtr = PolygonPtr->NextPolygon;
+		}
+		PolygonGroupPtr = PolygonGroupPtr->NextPolygonGroup;
+	}
+	printf("Scene bounds:\tX = %.2f to %.2f\tY = %.2f to %.2f\tZ = %.2f to %.2f\n", MinCoordinates.X, MaxCoordinates.X, MinCoordinates.Y, MaxCoordinates.Y, MinCoordinates.Z, MaxCoordinates.Z);
+
+	SceneMin[0] = (int)floor(MinCoordinates.X/GridSpacing);
+	SceneMin[1] = (int)floor(MinCoordinates.Y/GridSpacing);
+	SceneMin[2] = (int)floor(MinCoordinates.Z/GridSpacing);
+	SceneMax[0] = RoundUpwards(MaxCoordinates.X/GridSpacing);
+	SceneMax[1] = RoundUpwards(MaxCoordinates.Y/GridSpacing);
+	SceneMax[2] = RoundUpwards(MaxCoordinates.Z/GridSpacing);
+}
+
+
+// Set the extent of the scene, in grid spacings from its origin, when it is read from the scene cache
+void SetSceneExtent(int *Min, int *Max)
+{
+	for (int d=0; d<3; d++) {
+		SceneMin[d] = Min[d];
+		SceneMax[d] = Max[d];
+	}
+}
+
+
+// Return the extent of the scene, in grid spacings from its origin
+void GetSceneExtent(int *Min, int *Max)
+{
+	for (int d=0; d<3; d++) {
+		Min[d] = SceneMin[d];
+		Max[d] = SceneMax[d];
+	}
+}
+
+
+// Find the extent of the grid, in grid spacings from the origin of the scene. This is the extent of the scene, unless the
+// grid is cropped to the region around the source and the path loss samples
+void FindGridExtent(int *GridMin, int *GridMax)
+{
+	for (int d=0; d<3; d++) {
+		GridMin[d] = SceneMin[d];
+		GridMax[d] = SceneMax[d];
+	}
+	if (InputData.CropGrid.Flag == true) {
+		CropGridExtent(GridMin, GridMax);
+	}
+}
+
+
+// Narrow the grid in x and y to the source and the path loss samples, widened by the crop margin. Pulses leaving the
+// edges of the grid are lost, so the cut edges absorb. The grid is not cropped in z, as the horizontal polygons at the top
+// and bottom of the scene are kept within it
+void CropGridExtent(int *GridMin, int *GridMax)
+{
+	double Low[2], High[2];
+	int CropMin, CropMax;
+
+	// The source is still in grid spacings from the origin of the scene
+	Low[0] = High[0] = ImpulseSource.X*GridSpacing;
+	Low[1] = High[1] = ImpulseSource.Y*GridSpacing;
+	if (PathLossParameters.Type != NONE) {
+		Low[0] = MIN(Low[0], PathLossParameters.X1);
+		High[0] = MAX(High[0], PathLossParameters.X1);
+		Low[1] = MIN(Low[1], PathLossParameters.Y1);
+		High[1] = MAX(High[1], PathLossParameters.Y1);
+		if (PathLossParameters.Type != PL_POINT) {
+			Low[0] = MIN(Low[0], PathLossParameters.X2);
+			High[0] = MAX(High[0], PathLossParameters.X2);
+			Low[1] = MIN(Low[1], PathLossParameters.Y2);
+			High[1] = MAX(High[1], PathLossParameters.Y2);
+		}
+	}
+
+	for (int d=0; d<2; d++) {
+		CropMin = MAX((int)floor((Low[d]-CropMargin)/GridSpacing), GridMin[d]);
+		CropMax = MIN(RoundUpwards((High[d]+CropMargin)/GridSpacing), GridMax[d]);
+		if (CropMin > CropMax) {
+			printf("The cropped region lies outside the scene in %c, the grid is not cropped in this direction\n", d == 0 ? 'x' : 'y');
+		}
+		else {
+			GridMin[d] = CropMin;
+			GridMax[d] = CropMax;
+		}
+	}
+}
+
+
+// Place the grid at the extent given, in grid spacings from the origin of the scene, and move the source into the grid
+void PlaceGrid(int *GridMin, int *GridMax)
+{
+	xOffset = GridMin[0];
+	yOffset = GridMin[1];
+	zOffset = GridMin[2];
+	xSize = GridMax[0]-GridMin[0]+1;
+	ySize = GridMax[1]-GridMin[1]+1;
+	zSize = GridMax[2]-GridMin[2]+1;
+	printf("Grid extent:\tX = %.2f to %.2f\tY = %.2f to %.2f\tZ = %.2f to %.2f\n", NodePositionX(0), NodePositionX(xSize-1), NodePositionY(0), NodePositionY(ySize-1), NodePositionZ(0), NodePositionZ(zSize-1));
+
+	ImpulseSource.X = PlaceWithinGridX(ImpulseSource.X - xOffset);
+	ImpulseSource.Y = PlaceWithinGridY(ImpulseSource.Y - yOffset);
+	ImpulseSource.Z = PlaceWithinGridZ(ImpulseSource.Z - zOffset);
+}
+
+
+// Allocate enough memory for all of the nodes in the TLM grid, once it is placed
+void AllocateGridMemory(void)
+{
+	int GridMin[3], GridMax[3];
+
+	FindGridExtent(GridMin, GridMax);
+	PlaceGrid(GridMin, GridMax);
+
+	// Allocate memory for the nodes and set them to 0, placing the memory according to the NUMA policy
+	if (DomainCoordinator() == false) {
+		AllocateNumaGrid();
+	}
+}
+
+
+// Set a row of nodes in the z-direction to their initial free space values
+void InitialiseGridRow(int x, int y)
+{
+	for (int z = 0; z < zSize; z++) {
+		Grid[x][y][z].V = 0;
+		Grid[x][y][z].VxpIn = 0;
+		Grid[x][y][z].VxnIn = 0;
+		Grid[x][y][z].VypIn = 0;
+		Grid[x][y][z].VynIn = 0;
+		Grid[x][y][z].VzpIn = 0;
+		Grid[x][y][z].VznIn = 0;
+		Grid[x][y][z].VxpOut = 0;
+		Grid[x][y][z].VxnOut = 0;
+		Grid[x][y][z].VypOut = 0;
+		Grid[x][y][z].VynOut = 0;
+		Grid[x][y][z].VzpOut = 0;
+		Grid[x][y][z].VznOut = 0;
+		Grid[x][y][z].Epulse = 0;
+		Grid[x][y][z].Emax = 0;
+		ClearNodeObservers(&Grid[x][y][z]);
+		Grid[x][y][z].Z = IMPEDANCE_OF_FREE_SPACE;
+		Grid[x][y][z].PropagateFlag = true;
+		Grid[x][y][z].Active = false;
+		Grid[x][y][z].Reset = false;
+	}
+}
+
+
+// Return a slab of nodes to rest after a run, keeping the scene
+void ResetGridSlab(int xMin, int xMax, void *Context)
+{
+	Node *NodePtr;
+
+	for (int x = xMin; x <= xMax; x++) {
+		for (int y = 0; y < ySize; y++) {
+			for (int z = 0; z < zSize; z++) {
+				NodePtr = &Grid[x][y][z];
+				NodePtr->V = 0;
+				NodePtr->VxpIn = NodePtr->VxnIn = NodePtr->VypIn = NodePtr->VynIn = NodePtr->VzpIn = NodePtr->VznIn = 0;
+				NodePtr->VxpOut = NodePtr->VxnOut = NodePtr->VypOut = NodePtr->VynOut = NodePtr->VzpOut = NodePtr->VznOut = 0;
+				NodePtr->Epulse = 0;
+				NodePtr->Emax = 0;
+				ClearNodeObservers(NodePtr);
+				NodePtr->Active = false;
+				NodePtr->Reset = false;
+			}
+		}
+	}
+}
+
+
+// Free the memory allocated to the TLM grid, including the reflection and transmission coefficients
+void FreeGridMemory(void)
+{
+	// Coefficients read from the scene cache are part of its mapping
+	if (SceneCacheMapped() == false) {
+		for (int x = FirstAllocatedRow(); x <= LastAllocatedRow(); x++) {
+			for (int y = 0; y < ySize; y++) {
+				for (int z = 0; z < zSize; z++) {
+					if (Grid[x][y][z].RT != NULL) {
+						free(Grid[x][y][z].RT);
+					}
+				}
+			}
+		}
+	}
+	FreeNumaGrid();
+	CloseSceneCache();
+	// The polygons kept for an update of the scene
+	FreeSceneArena();
+}
+
+
+// Use the list of polygons to generate the relevant impedances in the TLM grid. The polygons are rasterised in parallel, 
+// where they overlap the node takes the value of the polygon that would have been added last
+void AddPolygonsToGrid(PolygonGroup *Head)
+{
+	int Min[3] = {FirstAllocatedRow(), 0, 0};
+	int Max[3] = {LastAllocatedRow(), ySize-1, zSize-1};
+
+	BuildRasterOperations(Head);
+	RasteriseRegion(Min, Max);
+	FreeRasterOperations();
+}
+
+
+// Build the list of rasterisation operations from the polygon groups, in the order they overwrite each other. Air gaps are
+// added where a wall crosses a thicker wall of lower priority
+void BuildRasterOperations(PolygonGroup *Head)
+{
+	PolygonGroup *PolygonGroupPtr;
+	Polygon_t *PolygonPtr;
+	PolygonGroup *IntersectionTestGroup;
+	int nTestGroups;
+
+	RasterOperations = NULL;
+	nRasterOperations = 0;
+
+	// Index the walls so that each new wall is only tested against the walls near it
+	BuildWallIndex(Head);
+
+	PolygonGroupPtr = Head;
+
+	while (PolygonGroupPtr != NULL) {
+		PolygonPtr = PolygonGroupPtr->PolygonList;
+
+		// Only vertical polygons of lower priority and greater thickness are checked, from the start of the list
+		nTestGroups = 0;
+		if (PolygonGroupPtr->Type == Vertical) {
+			IntersectionTestGroup = Head;
+			while (IntersectionTestGroup != NULL && IntersectionTestGroup->Type == Vertical && IntersectionTestGroup->Priority < PolygonGroupPtr->Priority && IntersectionTestGroup->Thickness > PolygonGroupPtr->Thickness) {
+				nTestGroups++;
+				IntersectionTestGroup = IntersectionTestGroup->NextPolygonGroup;
+			}
+		}
+
+		if (PolygonGroupPtr->Block != NULL) {
+			AddInstanceOperations(PolygonGroupPtr, nTestGroups);
+		}
+		else if (PolygonGroupPtr->Type == Vertical) {
+			// Add vertical polygons into the grid
+			while (PolygonPtr != NULL) {
+				AddWallIntersections(PolygonPtr, nTestGroups);
+				AddRasterOperation(Vertical, PolygonPtr, PolygonGroupPtr->Thickness, PolygonGroupPtr->Permittivity, PolygonGroupPtr->TransmissionLoss, PolygonGroupPtr->PropagateFlag, false);
+				PolygonPtr = PolygonPtr->NextPolygon;
+			}
+		}
+		else {
+			// Add horizontal polygons and the triangles of meshes into the grid
+			while (PolygonPtr != NULL) {
+				AddRasterOperation(PolygonGroupPtr->Type, PolygonPtr, PolygonGroupPtr->Thickness, PolygonGroupPtr->Permittivity, PolygonGroupPtr->TransmissionLoss, PolygonGroupPtr->PropagateFlag, false);
+				PolygonPtr = PolygonPtr->NextPolygon;
+			}
+		}		
+		PolygonGroupPtr = PolygonGroupPtr->NextPolygonGroup;
+	}
+	FreeWallIndex();
+}
+
+
+// Add an air gap where a wall crosses a thicker wall of lower priority, which lies in the first groups of the list
+void AddWallIntersections(Polygon_t *Polygon, int nTestGroups)
+{
+	IndexedWall *IntersectionTest;
+	Polygon_t *Intersection;
+	int nCandidates = nTestGroups > 0 ? FindWallCandidates(Polygon, nTestGroups) : 0;
+
+	for (int i=0; i<nCandidates; i++) {
+		IntersectionTest = &Walls[WallCandidates[i]];
+		// Find the intersection of the two polygons, if there is one
+		Intersection = FindIntersection(IntersectionTest->Polygon, Polygon, IntersectionTest->Thickness);
+		if (Intersection != NULL) {
+			// Add an air gap the size of the intersection to the grid
+			AddRasterOperation(Vertical, Intersection, IntersectionTest->Thickness, 1.0, 0, true, true);
+		}
+	}
+}
+
+
+// Return true if a wall crosses a thicker wall of lower priority, which lies in the first groups of the list
+bool CrossesThickerWall(Polygon_t *Polygon, int nTestGroups)
+{
+	Polygon_t *Intersection;
+	int nCandidates = nTestGroups > 0 ? FindWallCandidates(Polygon, nTestGroups) : 0;
+
+	for (int i=0; i<nCandidates; i++) {
+		Intersection = FindIntersection(Walls[WallCandidates[i]].Polygon, Polygon, Walls[WallCandidates[i]].Thickness);
+		if (Intersection != NULL) {
+			free(Intersection->Vertices);
+			free(Intersection);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// Rasterise the operations into a box of nodes, from Min to Max, and write the impedance and propagate flag of each node in 
+// the box. The thin walls are kept until the coefficients of the box are calculated
+void RasteriseRegion(int *Min, int *Max)
+{
+	HANDLE *hThreads;
+	int nThreads;
+	SIZE_T nNodes;
+
+	// Stamp every node of the box with the last operation to cover it, the threads take the polygons in turn
+	for (int d=0; d<3; d++) {
+		GridRaster.Min[d] = Min[d];
+		GridRaster.Max[d] = Max[d];
+	}
+	GridRaster.Origin[0] = xOffset;
+	GridRaster.Origin[1] = yOffset;
+	GridRaster.Origin[2] = zOffset;
+	nNodes = (SIZE_T)(Max[0]-Min[0]+1)*(Max[1]-Min[1]+1)*(Max[2]-Min[2]+1);
+	GridRaster.ImpedanceStamp = (volatile LONG*)calloc(nNodes, sizeof(LONG));
+	GridRaster.PropagateStamp = (volatile LONG*)calloc(nNodes, sizeof(LONG));
+	if (GridRaster.ImpedanceStamp == NULL || GridRaster.PropagateStamp == NULL) {
+		printf("Could not allocate memory for rasterising the scene\n");
+		exit(1);
+	}
+	if (InputData.ThinWalls.Flag == true) {
+		for (int Axis=0; Axis<3; Axis++) {
+			GridRaster.ThinStamp[Axis] = (volatile LONG*)calloc(nNodes, sizeof(LONG));
+			if (GridRaster.ThinStamp[Axis] == NULL) {
+				printf("Could not allocate memory for the thin walls of the scene\n");
+				exit(1);
+			}
+		}
+	}
+	NextRasterOperation = 0;
+
+	nThreads = MAX(MIN(SetupThreadCount(), nRasterOperations), 1);
+	hThreads = (HANDLE*)malloc(nThreads*sizeof(HANDLE));
+	for (int i=0; i<nThreads; i++) {
+		hThreads[i] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)RasteriseThread, (LPVOID)&GridRaster, 0, NULL);
+		if (hThreads[i] == NULL) {
+			printf("Rasterisation thread %d could not be started\n", i+1);
+			exit(1);
+		}
+	}
+	WaitForAllObjects(nThreads, hThreads);
+	for (int i=0; i<nThreads; i++) {
+		CloseHandle(hThreads[i]);
+	}
+	free(hThreads);
+
+	// Write the impedance and propagate flag of the winning operation into each node
+	ParallelSlabs(GridRaster.Min[0], GridRaster.Max[0], ResolveRasterSlab, (void*)&GridRaster);
+
+	// Keep the sheets of the thin walls for the coefficients of the links they cross
+	if (GridRaster.ThinStamp[0] != NULL) {
+		ThinSheets = (ThinSheet*)malloc(MAX(nRasterOperations, 1)*sizeof(ThinSheet));
+		for (int i=0; i<nRasterOperations; i++) {
+			ThinSheets[i].Impedance = RasterOperations[i].Impedance;
+			ThinSheets[i].Thickness = RasterOperations[i].Thickness;
+			ThinSheets[i].TransmissionLoss = RasterOperations[i].TransmissionLoss;
+		}
+	}
+
+	free((void*)GridRaster.ImpedanceStamp);
+	free((void*)GridRaster.PropagateStamp);
+}
+
+
+// Free the rasterisation operations, with the air gaps found from the intersections and the polygons copied for instances
+void FreeRasterOperations(void)
+{
+	for (int i=0; i<nRasterOperations; i++) {
+		if (RasterOperations[i].Intersection == true || RasterOperations[i].Copy == true) {
+			free(RasterOperations[i].Polygon->Vertices);
+			free(RasterOperations[i].Polygon);
+		}
+	}
+	free(RasterOperations);
+	RasterOperations = NULL;
+	nRasterOperations = 0;
+}
+
+
+// Add a polygon to the end of the list of rasterisation operations
+void AddRasterOperation(PolygonType Type, Polygon_t *Polygon, double Thickness, double Permittivity, double TransmissionLoss, bool PropagateFlag, bool Intersection)
+{
+	RasterOperation *Operation;
+
+	// Reallocate the operations 100 at a time
+	if (nRasterOperations%100 == 0) {
+		RasterOperations = (RasterOperation*)realloc(RasterOperations, (nRasterOperations+100)*sizeof(RasterOperation));
+	}
+
+	Operation = &RasterOperations[nRasterOperations++];
+	Operation->Type = Type;
+	Operation->Polygon = Polygon;
+	Operation->Thickness = Thickness;
+	Operation->Impedance = IMPEDANCE_OF_FREE_SPACE/sqrt(Permittivity);
+	Operation->TransmissionLoss = TransmissionLoss;
+	Operation->PropagateFlag = PropagateFlag;
+	Operation->Intersection = Intersection;
+	// Walls given a thickness below the grid spacing may be kept as thin sheets, otherwise they are widened to a node
+	Operation->Thin = InputData.ThinWalls.Flag == true && Intersection == false && Thickness > 0 && Thickness < GridSpacing;
+	Operation->Copy = false;
+	Operation->Template = NULL;
+	// The polygons of an instance are stamped together, and given the bounds of the instance
+	if (Polygon != NULL) {
+		PolygonBounds(Polygon, Thickness, Operation->Min, Operation->Max);
+	}
+}
+
+
+// Add an operation for each polygon of an instance. The first stamps the rasterisation of the block group for all of them, 
+// which is made when the group is first placed. A horizontal slab reaching past the top or bottom of the grid is moved back 
+// within it, and a wall crossing a thicker wall of lower priority is given an air gap, both of which depend on where the 
+// instance lies. Such an instance is instead rasterised from copies of its polygons
+void AddInstanceOperations(PolygonGroup *Instance, int nTestGroups)
+{
+	PolygonGroup *BlockGroup = Instance->Block;
+	Polygon_t *Copy;
+	int First = nRasterOperations;
+	int Min[3], Max[3];
+	bool Stamped;
+
+	PolygonGroupBounds(Instance, Min, Max);
+	Stamped = BlockGroup->Type != Horizontal || (Min[2] >= zOffset && Max[2] <= zOffset+zSize-1);
+	for (Polygon_t *PolygonPtr = BlockGroup->PolygonList; PolygonPtr != NULL && Stamped == true && nTestGroups > 0; PolygonPtr = PolygonPtr->NextPolygon) {
+		Copy = NewPolygonCopy(PolygonPtr, &Instance->Position);
+		Stamped = CrossesThickerWall(Copy, nTestGroups) == false;
+		free(Copy->Vertices);
+		free(Copy);
+	}
+
+	for (Polygon_t *PolygonPtr = BlockGroup->PolygonList; PolygonPtr != NULL; PolygonPtr = PolygonPtr->NextPolygon) {
+		if (Stamped == true) {
+			AddRasterOperation(BlockGroup->Type, NULL, BlockGroup->Thickness, BlockGroup->Permittivity, BlockGroup->TransmissionLoss, BlockGroup->PropagateFlag, false);
+			for (int d=0; d<3; d++) {
+				RasterOperations[nRasterOperations-1].Min[d] = Min[d];
+				RasterOperations[nRasterOperations-1].Max[d] = Max[d];
+			}
+		}
+		else {
+			Copy = NewPolygonCopy(PolygonPtr, &Instance->Position);
+			if (BlockGroup->Type == Vertical) {
+				AddWallIntersections(Copy, nTestGroups);
+			}
+			AddRasterOperation(BlockGroup->Type, Copy, BlockGroup->Thickness, BlockGroup->Permittivity, BlockGroup->TransmissionLoss, BlockGroup->PropagateFlag, false);
+			RasterOperations[nRasterOperations-1].Copy = true;
+		}
+	}
+
+	if (Stamped == true && nRasterOperations > First) {
+		if (BlockGroup->Template == NULL) {
+			BuildRasterTemplate(Instance, RasterOperations[First]);
+		}
+		RasterOperations[First].Template = BlockGroup->Template;
+		for (int d=0; d<3; d++) {
+			RasterOperations[First].Shift[d] = Instance->Shift[d] - BlockGroup->Template->Shift[d];
+		}
+	}
+}
+
+
+// Rasterise the polygons of a group of a block definition at an instance, numbering them from 1 in the stamps of a template 
+// kept with the group. The instance lies within the grid if it holds horizontal polygons, so that no slab is moved. Each 
+// polygon of the group covers its nodes in the same way as Operation, so the propagate flag is stamped with the impedance
+void BuildRasterTemplate(PolygonGroup *Instance, RasterOperation Operation)
+{
+	RasterTemplate *Template = (RasterTemplate*)AllocateSceneMemory(sizeof(RasterTemplate));
+	RasterContext Raster;
+	Polygon_t *Copy;
+	SIZE_T nNodes;
+	LONG Index = 1;
+
+	PolygonGroupBounds(Instance, Template->Min, Template->Max);
+	nNodes = (SIZE_T)(Template->Max[0]-Template->Min[0]+1)*(Template->Max[1]-Template->Min[1]+1)*(Template->Max[2]-Template->Min[2]+1);
+	Template->NodeStamp = (LONG*)AllocateSceneMemory(nNodes*sizeof(LONG));
+	memset(Template->NodeStamp, 0, nNodes*sizeof(LONG));
+	for (int Axis=0; Axis<3; Axis++) {
+		Template->ThinStamp[Axis] = NULL;
+		if (InputData.ThinWalls.Flag == true) {
+			Template->ThinStamp[Axis] = (LONG*)AllocateSceneMemory(nNodes*sizeof(LONG));
+			memset(Template->ThinStamp[Axis], 0, nNodes*sizeof(LONG));
+		}
+	}
+
+	// Rasterise into the box of the template
+	for (int d=0; d<3; d++) {
+		Template->Shift[d] = Instance->Shift[d];
+		Raster.Min[d] = Template->Min[d];
+		Raster.Max[d] = Template->Max[d];
+		Raster.Origin[d] = 0;
+	}
+	Raster.ImpedanceStamp = Template->NodeStamp;
+	Raster.PropagateStamp = Template->NodeStamp;
+	for (int Axis=0; Axis<3; Axis++) {
+		Raster.ThinStamp[Axis] = Template->ThinStamp[Axis];
+	}
+	for (Polygon_t *PolygonPtr = Instance->Block->PolygonList; PolygonPtr != NULL; PolygonPtr = PolygonPtr->NextPolygon) {
+		Copy = NewPolygonCopy(PolygonPtr, &Instance->Position);
+		Operation.Polygon = Copy;
+		RasterisePolygon(&Raster, &Operation, Index++);
+		free(Copy->Vertices);
+		free(Copy);
+	}
+
+	Instance->Block->Template = Template;
+}
+
+
+// Copy a polygon of a block to the position of an instance. The copy is allocated apart from the scene arena, as are the air
+// gaps found from intersections
+Polygon_t *NewPolygonCopy(Polygon_t *Polygon, Coordinate *Position)
+{
+	Polygon_t *Copy = (Polygon_t*)malloc(sizeof(Polygon_t));
+
+	Copy->nVertices = Polygon->nVertices;
+	Copy->Vertices = (Coordinate*)malloc(Copy->nVertices*sizeof(Coordinate));
+	Copy->NextPolygon = NULL;
+	for (int i=0; i<Copy->nVertices; i++) {
+		Copy->Vertices[i].X = Polygon->Vertices[i].X + Position->X;
+		Copy->Vertices[i].Y = Polygon->Vertices[i].Y + Position->Y;
+		Copy->Vertices[i].Z = Polygon->Vertices[i].Z + Position->Z;
+	}
+
+	return Copy;
+}
+
+
+// Thread function rasterising polygons until none remain, those that cannot reach the box being rasterised are skipped
+DWORD WINAPI RasteriseThread(LPVOID lpParam)
+{
+	RasterContext *Raster = (RasterContext*)lpParam;
+	LONG Operation;
+	bool Outside;
+
+	while ((Operation = InterlockedIncrement(&NextRasterOperation)) <= nRasterOperations) {
+		Outside = false;
+		for (int d=0; d<3; d++) {
+			if (RasterOperations[Operation-1].Max[d] < Raster->Min[d]+Raster->Origin[d] || RasterOperations[Operation-1].Min[d] > Raster->Max[d]+Raster->Origin[d]) {
+				Outside = true;
+			}
+		}
+		if (Outside == true) {
+			continue;
+		}
+		// The polygons of an instance are all stamped by its first operation
+		if (RasterOperations[Operation-1].Template != NULL) {
+			StampTemplate(Raster, &RasterOperations[Operation-1], Operation);
+		}
+		else if (RasterOperations[Operation-1].Polygon != NULL) {
+			RasterisePolygon(Raster, &RasterOperations[Operation-1], Operation);
+		}
+	}
+
+	return 0;
+}
+
+
+// Rasterise the polygon of an operation into the stamps
+void RasterisePolygon(RasterContext *Raster, RasterOperation *Operation, LONG Index)
+{
+	if (Operation->Thin == true) {
+		AddThinPolygon(Raster, Operation, Index);
+	}
+	else if (Operation->Type == Vertical) {
+		AddVerticalPolygon(Raster, Operation->Polygon, Operation->Thickness, Index);
+	}
+	else if (Operation->Type == Triangulated) {
+		AddTriangulatedPolygon(Raster, Operation->Polygon, Operation->Thickness, Index);
+	}
+	else {
+		AddHorizontalPolygon(Raster, Operation->Polygon, Operation->Thickness, Index);
+	}
+}
+
+
+// Stamp the template of a block group at the position of an instance, the polygons of the group taking the operations that 
+// follow from Index. Only horizontal polygons leave the propagate flag
+void StampTemplate(RasterContext *Raster, RasterOperation *Operation, LONG Index)
+{
+	RasterTemplate *Template = Operation->Template;
+	int *Shift = Operation->Shift;
+	int Low[3], High[3];
+	int Min[3], Max[3];
+	bool Vertical = Operation->Type != Horizontal;
+	SIZE_T Stamp;
+
+	RasterBounds(Raster, Low, High);
+	for (int d=0; d<3; d++) {
+		Min[d] = MAX(Template->Min[d], Low[d]-Shift[d]);
+		Max[d] = MIN(Template->Max[d], High[d]-Shift[d]);
+	}
+
+	for (int x = Min[0]; x <= Max[0]; x++) {
+		for (int y = Min[1]; y <= Max[1]; y++) {
+			Stamp = ((SIZE_T)(x-Template->Min[0])*(Template->Max[1]-Template->Min[1]+1) + (y-Template->Min[1]))*(Template->Max[2]-Template->Min[2]+1) + (Min[2]-Template->Min[2]);
+			for (int z = Min[2]; z <= Max[2]; z++, Stamp++) {
+				if (Template->NodeStamp[Stamp] > 0) {
+					MarkNode(Raster, x+Shift[0], y+Shift[1], z+Shift[2], Index+Template->NodeStamp[Stamp]-1, Vertical);
+				}
+				if (Template->ThinStamp[0] != NULL) {
+					for (int Axis=0; Axis<3; Axis++) {
+						if (Template->ThinStamp[Axis][Stamp] > 0) {
+							MarkLink(Raster, Axis, x+Shift[0], y+Shift[1], z+Shift[2], Index+Template->ThinStamp[Axis][Stamp]-1);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+
+// Find the box being rasterised, in grid spacings from the origin of the scene
+void RasterBounds(RasterContext *Raster, int *Low, int *High)
+{
+	for (int d=0; d<3; d++) {
+		Low[d] = Raster->Min[d] + Raster->Origin[d];
+		High[d] = Raster->Max[d] + Raster->Origin[d];
+	}
+}
+
+
+// Record that an operation covers a node, keeping the latest operation. Horizontal polygons do not change the propagate flag
+void MarkNode(RasterContext *Raster, int x, int y, int z, LONG Operation, bool Vertical)
+{
+	SIZE_T Index;
+	LONG Previous;
+
+	// The node is given in grid spacings from the origin of the scene
+	x -= Raster->Origin[0];
+	y -= Raster->Origin[1];
+	z -= Raster->Origin[2];
+
+	// Nodes outside the box being rasterised are skipped, it lies within the rows held by this process
+	if (x < Raster->Min[0] || x > Raster->Max[0] || y < Raster->Min[1] || y > Raster->Max[1] || z < Raster->Min[2] || z > Raster->Max[2]) {
+		return;
+	}
+	Index = RasterIndex(Raster, x, y, z);
+
+	Previous = Raster->ImpedanceStamp[Index];
+	while (Previous < Operation) {
+		Previous = InterlockedCompareExchange(&Raster->ImpedanceStamp[Index], Operation, Previous);
+	}
+	if (Vertical == true) {
+		Previous = Raster->PropagateStamp[Index];
+		while (Previous < Operation) {
+			Previous = InterlockedCompareExchange(&Raster->PropagateStamp[Index], Operation, Previous);
+		}
+	}
+}
+
+
+// Record that a thin wall crosses the link from a node to the next node along an axis, keeping the latest operation
+void MarkLink(RasterContext *Raster, int Axis, int x, int y, int z, LONG Operation)
+{
+	SIZE_T Index;
+	LONG Previous;
+
+	// The node is given in grid spacings from the origin of the scene
+	x -= Raster->Origin[0];
+	y -= Raster->Origin[1];
+	z -= Raster->Origin[2];
+
+	// Both nodes of the link must be within the box being rasterised
+	if (x < Raster->Min[0] || x > Raster->Max[0] || y < Raster->Min[1] || y > Raster->Max[1] || z < Raster->Min[2] || z > Raster->Max[2]) {
+		return;
+	}
+	if (x+(Axis == 0) > Raster->Max[0] || y+(Axis == 1) > Raster->Max[1] || z+(Axis == 2) > Raster->Max[2]) {
+		return;
+	}
+	Index = RasterIndex(Raster, x, y, z);
+
+	Previous = Raster->ThinStamp[Axis][Index];
+	while (Previous < Operation) {
+		Previous = InterlockedCompareExchange(&Raster->ThinStamp[Axis][Index], Operation, Previous);
+	}
+}
+
+
+// Add a wall thinner than the grid spacing to the links it crosses
+void AddThinPolygon(RasterContext *Raster, RasterOperation *Operation, LONG Index)
+{
+	Polygon_t *Polygon = Operation->Polygon;
+
+	if (Operation->Type == Vertical) {
+		// Split the rectangle of the wall into two triangles, the corners are taken in turn around the rectangle
+		Coordinate Corners[4];
+		Coordinate Triangle[3];
+		Corners[0] = Corners[3] = Polygon->Vertices[0];
+		Corners[1] = Corners[2] = Polygon->Vertices[1];
+		Corners[0].Z = Corners[1].Z = MIN(Polygon->Vertices[0].Z, Polygon->Vertices[1].Z);
+		Corners[2].Z = Corners[3].Z = MAX(Polygon->Vertices[0].Z, Polygon->Vertices[1].Z);
+		for (int t=0; t<2; t++) {
+			Triangle[0] = Corners[0];
+			Triangle[1] = Corners[t+1];
+			Triangle[2] = Corners[t+2];
+			AddThinTriangle(Raster, Triangle, Index);
+		}
+	}
+	else if (Operation->Type == Triangulated) {
+		for (int t=0; t<Polygon->nVertices; t+=3) {
+			AddThinTriangle(Raster, &Polygon->Vertices[t], Index);
+		}
+	}
+	else {
+		AddThinHorizontalPolygon(Raster, Polygon, Index);
+	}
+}
+
+
+// Mark the links crossed by a triangle. For each axis the line of links through every node in the plane of the other two axes 
+// that lies within the triangle is crossed once, at the height of the plane of the triangle
+void AddThinTriangle(RasterContext *Raster, Coordinate *Triangle, LONG Operation)
+{
+	double P[3][3];
+	double Normal[3];
+	double Distance;
+	double Length;
+	int Low[3], High[3];
+
+	RasterBounds(Raster, Low, High);
+	for (int v=0; v<3; v++) {
+		P[v][0] = Triangle[v].X;
+		P[v][1] = Triangle[v].Y;
+		P[v][2] = Triangle[v].Z;
+	}
+	for (int a=0; a<3; a++) {
+		int b = (a+1)%3;
+		int c = (a+2)%3;
+		Normal[a] = (P[1][b]-P[0][b])*(P[2][c]-P[0][c]) - (P[1][c]-P[0][c])*(P[2][b]-P[0][b]);
+	}
+	Length = sqrt(SQUARE(Normal[0]) + SQUARE(Normal[1]) + SQUARE(Normal[2]));
+	if (Length == 0) {
+		return;
+	}
+	Distance = Normal[0]*P[0][0] + Normal[1]*P[0][1] + Normal[2]*P[0][2];
+
+	for (int Axis=0; Axis<3; Axis++) {
+		int b = (Axis+1)%3;
+		int c = (Axis+2)%3;
+		int Node[3];
+		int bMin, bMax;
+		int cMin, cMax;
+
+		// A triangle parallel to the axis crosses none of its links
+		if (fabs(Normal[Axis]) <= 1e-9*Length) {
+			continue;
+		}
+
+		bMin = MAX(RoundUpwards(MIN(MIN(P[0][b], P[1][b]), P[2][b])/GridSpacing), Low[b]);
+		bMax = MIN((int)floor(MAX(MAX(P[0][b], P[1][b]), P[2][b])/GridSpacing), High[b]);
+		cMin = MAX(RoundUpwards(MIN(MIN(P[0][c], P[1][c]), P[2][c])/GridSpacing), Low[c]);
+		cMax = MIN((int)floor(MAX(MAX(P[0][c], P[1][c]), P[2][c])/GridSpacing), High[c]);
+
+		for (Node[b] = bMin; Node[b] <= bMax; Node[b]++) {
+			for (Node[c] = cMin; Node[c] <= cMax; Node[c]++) {
+				double pb = Node[b]*GridSpacing;
+				double pc = Node[c]*GridSpacing;
+				bool Inside = true;
+
+				// The node is inside when it lies on the same side of each edge as the triangle, given by the sign of the normal
+				for (int v=0; v<3 && Inside == true; v++) {
+					int w = (v+1)%3;
+					double Edge = (P[w][b]-P[v][b])*(pc-P[v][c]) - (P[w][c]-P[v][c])*(pb-P[v][b]);
+					if (Edge*Normal[Axis] < 0) {
+						Inside = false;
+					}
+				}
+				if (Inside == true) {
+					Node[Axis] = (int)floor((Distance - Normal[b]*pb - Normal[c]*pc)/Normal[Axis]/GridSpacing);
+					MarkLink(Raster, Axis, Node[0], Node[1], Node[2], Operation);
+				}
+			}
+		}
+	}
+}
+
+
+// Mark the links in the z-direction crossed by a horizontal polygon, at every node within the polygon
+void AddThinHorizontalPolygon(RasterContext *Raster, Polygon_t *HPolygon, LONG Operation)
+{
+	int nVertices = HPolygon->nVertices;
+	Coordinate *Vertices = HPolygon->Vertices;
+	double xLow = Vertices[0].X, xHigh = Vertices[0].X;
+	double yLow = Vertices[0].Y, yHigh = Vertices[0].Y;
+	int xMin, xMax;
+	int yMin, yMax;
+	int z;
+	int Low[3], High[3];
+
+	RasterBounds(Raster, Low, High);
+	for (int i=1; i<nVertices; i++) {
+		xLow = MIN(xLow, Vertices[i].X);
+		xHigh = MAX(xHigh, Vertices[i].X);
+		yLow = MIN(yLow, Vertices[i].Y);
+		yHigh = MAX(yHigh, Vertices[i].Y);
+	}
+	xMin = MAX(RoundUpwards(xLow/GridSpacing), Low[0]);
+	xMax = MIN((int)floor(xHigh/GridSpacing), High[0]);
+	yMin = MAX(RoundUpwards(yLow/GridSpacing), Low[1]);
+	yMax = MIN((int)floor(yHigh/GridSpacing), High[1]);
+	z = (int)floor(Vertices[0].Z/GridSpacing);
+
+	for (int x = xMin; x <= xMax; x++) {
+		for (int y = yMin; y <= yMax; y++) {
+			// Count the sides crossed by a line from the node in the positive x-direction
+			bool Inside = false;
+			for (int i=0, j=nVertices-1; i<nVertices; j=i++) {
+				if ((Vertices[i].Y > y*GridSpacing) != (Vertices[j].Y > y*GridSpacing) &&
+					x*GridSpacing < Vertices[j].X + (Vertices[i].X-Vertices[j].X)*(y*GridSpacing-Vertices[j].Y)/(Vertices[i].Y-Vertices[j].Y))
+				{
+					Inside = !Inside;
+				}
+			}
+			if (Inside == true) {
+				MarkLink(Raster, 2, x, y, z, Operation);
 			}
-			// Find the next polygon in the list
-			j++;
-			PolygonPtr = PolygonPtr->NextPolygon;
 		}
-		// find the next polygon group in the list
-		PolygonGroupPtr = PolygonGroupPtr->NextPolygonGroup;
-		i++;
 	}
 }
 
 
-// Find the maximum coordinates out of all of the polygons and hence find the grid sizes xSize, ySize and zSize
-Coordinate FindMaxSize(PolygonGroup *Head)
+// Write the values of the operations stamped on a slab of nodes, those not covered by any operation are free space. A thin 
+// wall is removed from a link when a later polygon covers either node of the link
+void ResolveRasterSlab(int xMin, int xMax, void *Context)
 {
-	Coordinate MaxCoordinates;
-	PolygonGroup *PolygonGroupPtr = Head;
-
-	MaxCoordinates.X = 0;
-	MaxCoordinates.Y = 0;
-	MaxCoordinates.Z = 0;
-
-	while (PolygonGroupPtr != NULL) {
-		Polygon_t *PolygonPtr = PolygonGroupPtr->PolygonList;
+	RasterContext *Raster = (RasterContext*)Context;
+	SIZE_T Index;
+	SIZE_T Stride[3] = {(SIZE_T)(Raster->Max[1]-Raster->Min[1]+1)*(Raster->Max[2]-Raster->Min[2]+1), (SIZE_T)(Raster->Max[2]-Raster->Min[2]+1), 1};
 
-		while (PolygonPtr != NULL) {
-			for (int i=0; i<PolygonPtr->nVertices; i++) {
-				if (PolygonPtr->Vertices[i].X > MaxCoordinates.X) {
-					MaxCoordinates.X = PolygonPtr->Vertices[i].X;
+	for (int x = xMin; x <= xMax; x++) {
+		for (int y = Raster->Min[1]; y <= Raster->Max[1]; y++) {
+			Index = RasterIndex(Raster, x, y, Raster->Min[2]);
+			for (int z = Raster->Min[2]; z <= Raster->Max[2]; z++, Index++) {
+				if (Raster->ImpedanceStamp[Index] > 0) {
+					Grid[x][y][z].Z = RasterOperations[Raster->ImpedanceStamp[Index]-1].Impedance;
+				}
+				else {
+					Grid[x][y][z].Z = IMPEDANCE_OF_FREE_SPACE;
+				}
+				if (Raster->PropagateStamp[Index] > 0) {
+					Grid[x][y][z].PropagateFlag = RasterOperations[Raster->PropagateStamp[Index]-1].PropagateFlag;
 				}
-				if (PolygonPtr->Vertices[i].Y > MaxCoordinates.Y) {
-					MaxCoordinates.Y = PolygonPtr->Vertices[i].Y;
+				else {
+					Grid[x][y][z].PropagateFlag = true;
 				}
-				if (PolygonPtr->Vertices[i].Z > MaxCoordinates.Z) {
-					MaxCoordinates.Z = PolygonPtr->Vertices[i].Z;
+				if (Raster->ThinStamp[0] != NULL) {
+					for (int Axis=0; Axis<3; Axis++) {
+						LONG Sheet = Raster->ThinStamp[Axis][Index];
+						if (Sheet > 0 && (Raster->ImpedanceStamp[Index] > Sheet || Raster->ImpedanceStamp[Index+Stride[Axis]] > Sheet)) {
+							Raster->ThinStamp[Axis][Index] = 0;
+						}
+					}
 				}
 			}
-			PolygonPtr = PolygonPtr->NextPolygon;
 		}
-		PolygonGroupPtr = PolygonGroupPtr->NextPolygonGroup;
 	}
-	printf("Maximum grid size:\tX = %.2f\tY = %.2f\tZ = %.2f\n", MaxCoordinates.X, MaxCoordinates.Y, MaxCoordinates.Z);
+}
 
-	return MaxCoordinates;
+
+// Position of a node in the stamps of the box being rasterised
+SIZE_T RasterIndex(RasterContext *Raster, int x, int y, int z)
+{
+	return ((SIZE_T)(x-Raster->Min[0])*(Raster->Max[1]-Raster->Min[1]+1) + (y-Raster->Min[1]))*(Raster->Max[2]-Raster->Min[2]+1) + (z-Raster->Min[2]);
 }
 
 
-// Allocate enough memory for all of the nodes in the TLM grid based upon xSize, ySize and zSize
-void AllocateGridMemory(Coordinate MaxCoordinates)
+// Find the intersection of two polygons, return NULL if there is no intersection. Nothing is allocated unless they intersect
+Polygon_t *FindIntersection(Polygon_t *A, Polygon_t *B, double Thickness)
 {
-	xSize = RoundUpwards(MaxCoordinates.X/GridSpacing)+1;
-	ySize = RoundUpwards(MaxCoordinates.Y/GridSpacing)+1;
-	zSize = RoundUpwards(MaxCoordinates.Z/GridSpacing)+1;
+	Polygon_t *Intersection;
+	Coordinate Vertices[2];
+	xyCoordinate A1, A2;
+	xyCoordinate B1, B2;
+	xyLine L;
 
-	// Allocate memory for the nodes
-	Grid = (Node***) malloc(xSize * sizeof(Node**));
-	for (int x = 0; x < xSize; x++) {
-		Grid[x] = (Node**) malloc(ySize * sizeof(Node*));
-		for (int y = 0; y < ySize; y++) {
-			Grid[x][y] = (Node*) malloc(zSize * sizeof(Node));
-		}
+	// Find the minimum and maximum z coordinates for each Polygon
+	Vertices[0].Z = MAX(MIN(A->Vertices[0].Z, A->Vertices[1].Z), MIN(B->Vertices[0].Z, B->Vertices[1].Z));
+	Vertices[1].Z = MIN(MAX(A->Vertices[0].Z, A->Vertices[1].Z), MAX(B->Vertices[0].Z, B->Vertices[1].Z));
+	
+	// Ensure the polygons intersect in the z dimension
+	if (Vertices[0].Z >= Vertices[1].Z) {
+		return NULL;
 	}
 
-	// Set all nodes to 0
-	for (int x = 0; x < xSize; x++) {
-		for (int y = 0; y < ySize; y++) {
-			for (int z = 0; z < zSize; z++) {
-				Grid[x][y][z].V = 0;
-				Grid[x][y][z].VxpIn = 0;
-				Grid[x][y][z].VxnIn = 0;
-				Grid[x][y][z].VypIn = 0;
-				Grid[x][y][z].VynIn = 0;
-				Grid[x][y][z].VzpIn = 0;
-				Grid[x][y][z].VznIn = 0;
-				Grid[x][y][z].VxpOut = 0;
-				Grid[x][y][z].VxnOut = 0;
-				Grid[x][y][z].VypOut = 0;
-				Grid[x][y][z].VynOut = 0;
-				Grid[x][y][z].VzpOut = 0;
-				Grid[x][y][z].VznOut = 0;
-				Grid[x][y][z].Epulse = 0;
-				Grid[x][y][z].Emax = 0;
-				Grid[x][y][z].Z = IMPEDANCE_OF_FREE_SPACE;
-				Grid[x][y][z].PropagateFlag = true;
-				Grid[x][y][z].Active = false;
-			}
+	A1 = CoordinateToXY(A->Vertices[0]);
+	A2 = CoordinateToXY(A->Vertices[1]);
+	B1 = CoordinateToXY(B->Vertices[0]);
+	B2 = CoordinateToXY(B->Vertices[1]);
+
+	L = CoordinatesToLine(A1, A2);
+
+	// Check that the two points lie on the line joining the vertices of A
+	if (abs(DistanceFromLine(L,B1)) >= Thickness/2 || abs(DistanceFromLine(L,B2)) >= Thickness/2) {
+		return NULL;
+	}
+
+	Vertices[0].X = MAX(MIN(A->Vertices[0].X, A->Vertices[1].X), MIN(B->Vertices[0].X, B->Vertices[1].X));
+	Vertices[1].X = MIN(MAX(A->Vertices[0].X, A->Vertices[1].X), MAX(B->Vertices[0].X, B->Vertices[1].X));
+	// Ensure polygons intersect in the X direction
+	if (Vertices[0].X < Vertices[1].X) {
+		Vertices[0].Y = YFromX(L,Vertices[0].X);
+		Vertices[1].Y = YFromX(L,Vertices[1].X);
+	}
+	else if (Vertices[0].X == Vertices[1].X) {
+		Vertices[0].Y = MAX(MIN(A->Vertices[0].Y, A->Vertices[1].Y), MIN(B->Vertices[0].Y, B->Vertices[1].Y));
+		Vertices[1].Y = MIN(MAX(A->Vertices[0].Y, A->Vertices[1].Y), MAX(B->Vertices[0].Y, B->Vertices[1].Y));
+		// Walls along the y axis must also overlap in the y direction
+		if (Vertices[0].Y > Vertices[1].Y) {
+			return NULL;
 		}
 	}
+	else {
+		return NULL;
+	}
+
+	Intersection = (Polygon_t*)malloc(sizeof(Polygon_t));
+	Intersection->nVertices = 2;
+	Intersection->Vertices = (Coordinate*)malloc(2*sizeof(Coordinate));
+	Intersection->NextPolygon = NULL;
+	Intersection->Vertices[0] = Vertices[0];
+	Intersection->Vertices[1] = Vertices[1];
+
+	return Intersection;
 }
-// Use the list of polygons to generate the relevant impedances in the TLM grid
-void AddPolygonsToGrid(PolygonGroup *Head)
+
+
+// Build the wall index from the vertical polygons of the scene. Each wall is entered in every cell touched by its extent,
+// widened by its thickness so that any wall within half the thickness of its line, up to 45 degrees from the x axis,
+// touches one of the same cells
+void BuildWallIndex(PolygonGroup *Head)
 {
 	PolygonGroup *PolygonGroupPtr;
 	Polygon_t *PolygonPtr;
+	double xMax, yMax;
+	int Group = 0;
+	int Cell;
 
-	PolygonGroupPtr = Head;
-
-	while (PolygonGroupPtr != NULL) {
-		PolygonPtr = PolygonGroupPtr->PolygonList;
+	nWalls = 0;
+	for (PolygonGroupPtr = Head; PolygonGroupPtr != NULL; PolygonGroupPtr = PolygonGroupPtr->NextPolygonGroup) {
 		if (PolygonGroupPtr->Type == Vertical) {
-			// Add vertical polygons into the grid
-			while (PolygonPtr != NULL) {
-				// Check all polygons with a lower priority for intersections
-				PolygonGroup *IntersectionTestGroup = Head;
-				Polygon_t *IntersectionTest;
-				// Ensure only vertical polygons of lower priority and greater thickness are checked
-				while (IntersectionTestGroup != NULL && IntersectionTestGroup->Type == Vertical && IntersectionTestGroup->Priority < PolygonGroupPtr->Priority && IntersectionTestGroup->Thickness > PolygonGroupPtr->Thickness) {
-					IntersectionTest = IntersectionTestGroup->PolygonList;
-					while(IntersectionTest != NULL) {
-						// Find the intersection of the two polygons, if there is one
-						Polygon_t *Intersection;
-						Intersection = FindIntersection(IntersectionTest, PolygonPtr, IntersectionTestGroup->Thickness);
-						if (Intersection != NULL) {
-							// Add an air gap the size of the intersection to the grid
-							AddVerticalPolygon(Intersection, IntersectionTestGroup->Thickness, 1.0, true);
-							free(Intersection);
-						}
-						IntersectionTest = IntersectionTest->NextPolygon;
-					}
-					IntersectionTestGroup = IntersectionTestGroup->NextPolygonGroup;
+			for (PolygonPtr = PolygonGroupPtr->Block != NULL ? PolygonGroupPtr->Block->PolygonList : PolygonGroupPtr->PolygonList; PolygonPtr != NULL; PolygonPtr = PolygonPtr->NextPolygon) {
+				nWalls++;
+			}
+		}
+	}
+	Walls = (IndexedWall*)malloc(MAX(nWalls,1)*sizeof(IndexedWall));
+	WallCandidates = (int*)malloc(MAX(nWalls,1)*sizeof(int));
+	nWallQueries = 0;
+
+	// Walls are numbered in the order of the polygon list, which is the order they are tested in. The walls of an instance that
+	// shares the polygons of its block are copied into place
+	nWalls = 0;
+	WallCellOriginX = WallCellOriginY = 0;
+	xMax = yMax = 0;
+	for (PolygonGroupPtr = Head; PolygonGroupPtr != NULL; PolygonGroupPtr = PolygonGroupPtr->NextPolygonGroup, Group++) {
+		if (PolygonGroupPtr->Type == Vertical) {
+			for (PolygonPtr = PolygonGroupPtr->Block != NULL ? PolygonGroupPtr->Block->PolygonList : PolygonGroupPtr->PolygonList; PolygonPtr != NULL; PolygonPtr = PolygonPtr->NextPolygon) {
+				IndexedWall *Wall = &Walls[nWalls];
+				Wall->Copy = PolygonGroupPtr->Block != NULL;
+				Wall->Polygon = Wall->Copy == true ? NewPolygonCopy(PolygonPtr, &PolygonGroupPtr->Position) : PolygonPtr;
+				Wall->Group = Group;
+				Wall->Thickness = PolygonGroupPtr->Thickness;
+				Wall->xMin = MIN(Wall->Polygon->Vertices[0].X, Wall->Polygon->Vertices[1].X) - Wall->Thickness;
+				Wall->xMax = MAX(Wall->Polygon->Vertices[0].X, Wall->Polygon->Vertices[1].X) + Wall->Thickness;
+				Wall->yMin = MIN(Wall->Polygon->Vertices[0].Y, Wall->Polygon->Vertices[1].Y) - Wall->Thickness;
+				Wall->yMax = MAX(Wall->Polygon->Vertices[0].Y, Wall->Polygon->Vertices[1].Y) + Wall->Thickness;
+				Wall->Query = -1;
+				if (nWalls == 0) {
+					WallCellOriginX = Wall->xMin;
+					WallCellOriginY = Wall->yMin;
+					xMax = Wall->xMax;
+					yMax = Wall->yMax;
 				}
-				AddVerticalPolygon(PolygonPtr, PolygonGroupPtr->Thickness, PolygonGroupPtr->Permittivity, PolygonGroupPtr->PropagateFlag);
-				PolygonPtr = PolygonPtr->NextPolygon;
+				WallCellOriginX = MIN(WallCellOriginX, Wall->xMin);
+				WallCellOriginY = MIN(WallCellOriginY, Wall->yMin);
+				xMax = MAX(xMax, Wall->xMax);
+				yMax = MAX(yMax, Wall->yMax);
+				nWalls++;
 			}
 		}
-		else {
-			// Add horizontal polygons into the grid
-			while (PolygonPtr != NULL) {
-				AddHorizontalPolygon(PolygonPtr, PolygonGroupPtr->Thickness, PolygonGroupPtr->Permittivity, PolygonGroupPtr->PropagateFlag);
-				PolygonPtr = PolygonPtr->NextPolygon;
+	}
+
+	// Size the cells to give about one wall per cell
+	WallCellSize = MAX(MAX(xMax-WallCellOriginX, yMax-WallCellOriginY)/MAX(sqrt((double)nWalls),1), 1e-3);
+	xWallCells = (int)((xMax-WallCellOriginX)/WallCellSize)+1;
+	yWallCells = (int)((yMax-WallCellOriginY)/WallCellSize)+1;
+	CellWalls = (int**)calloc(xWallCells*yWallCells, sizeof(int*));
+	nCellWalls = (int*)calloc(xWallCells*yWallCells, sizeof(int));
+
+	for (int w=0; w<nWalls; w++) {
+		for (int i=(int)((Walls[w].xMin-WallCellOriginX)/WallCellSize); i<=(int)((Walls[w].xMax-WallCellOriginX)/WallCellSize); i++) {
+			for (int j=(int)((Walls[w].yMin-WallCellOriginY)/WallCellSize); j<=(int)((Walls[w].yMax-WallCellOriginY)/WallCellSize); j++) {
+				Cell = i*yWallCells + j;
+				// Reallocate the walls of a cell 8 at a time
+				if (nCellWalls[Cell]%8 == 0) {
+					CellWalls[Cell] = (int*)realloc(CellWalls[Cell], (nCellWalls[Cell]+8)*sizeof(int));
+				}
+				CellWalls[Cell][nCellWalls[Cell]++] = w;
 			}
-		}		
-		PolygonGroupPtr = PolygonGroupPtr->NextPolygonGroup;
+		}
 	}
 }
 
 
-// Find the intersection of two polygons, return NULL if there is no intersection
-Polygon_t *FindIntersection(Polygon_t *A, Polygon_t *B, double Thickness)
+// Find the walls of the first groups in the list whose extent overlaps a polygon, returns the number placed in the candidates
+int FindWallCandidates(Polygon_t *Polygon, int nGroups)
 {
-	Polygon_t *Intersection;
-	xyCoordinate A1, A2;
-	xyCoordinate B1, B2;
-	xyLine L;
-
-	Intersection = (Polygon_t*)malloc(sizeof(Polygon_t));
-	Intersection->Vertices = (Coordinate*)malloc(2*sizeof(Coordinate));
-
-	// Find the minimum and maximum z coordinates for each Polygon
-	Intersection->Vertices[0].Z = MAX(MIN(A->Vertices[0].Z, A->Vertices[1].Z), MIN(B->Vertices[0].Z, B->Vertices[1].Z));
-	Intersection->Vertices[1].Z = MIN(MAX(A->Vertices[0].Z, A->Vertices[1].Z), MAX(B->Vertices[0].Z, B->Vertices[1].Z));
-	
-	// Ensure the polygons intersect in the z dimension
-	if (Intersection->Vertices[0].Z < Intersection->Vertices[1].Z) {
-		A1 = CoordinateToXY(A->Vertices[0]);
-		A2 = CoordinateToXY(A->Vertices[1]);
-		B1 = CoordinateToXY(B->Vertices[0]);
-		B2 = CoordinateToXY(B->Vertices[1]);
-
-		L = CoordinatesToLine(A1, A2);
-
-		// Check that the two points lie on the line joining the vertices of A
-		if (abs(DistanceFromLine(L,B1)) < Thickness/2 && abs(DistanceFromLine(L,B2)) < Thickness/2) {
-			Intersection->Vertices[0].X = MAX(MIN(A->Vertices[0].X, A->Vertices[1].X), MIN(B->Vertices[0].X, B->Vertices[1].X));
-			Intersection->Vertices[1].X = MIN(MAX(A->Vertices[0].X, A->Vertices[1].X), MAX(B->Vertices[0].X, B->Vertices[1].X));
-			// Ensure polygons intersect in the X direction
-			if (Intersection->Vertices[0].X < Intersection->Vertices[1].X) {
-				Intersection->Vertices[0].Y = YFromX(L,Intersection->Vertices[0].X);
-				Intersection->Vertices[1].Y = YFromX(L,Intersection->Vertices[1].X);
-			}
-			else if (Intersection->Vertices[0].X == Intersection->Vertices[1].X) {
-				Intersection->Vertices[0].Y = MAX(MIN(A->Vertices[0].Y, A->Vertices[1].Y), MIN(B->Vertices[0].Y, B->Vertices[1].Y));
-				Intersection->Vertices[1].Y = MIN(MAX(A->Vertices[0].Y, A->Vertices[1].Y), MAX(B->Vertices[0].Y, B->Vertices[1].Y));
+	int iMin, iMax, jMin, jMax;
+	int nCandidates = 0;
+	int w;
+
+	iMin = MAX((int)floor((MIN(Polygon->Vertices[0].X, Polygon->Vertices[1].X)-WallCellOriginX)/WallCellSize), 0);
+	iMax = MIN((int)floor((MAX(Polygon->Vertices[0].X, Polygon->Vertices[1].X)-WallCellOriginX)/WallCellSize), xWallCells-1);
+	jMin = MAX((int)floor((MIN(Polygon->Vertices[0].Y, Polygon->Vertices[1].Y)-WallCellOriginY)/WallCellSize), 0);
+	jMax = MIN((int)floor((MAX(Polygon->Vertices[0].Y, Polygon->Vertices[1].Y)-WallCellOriginY)/WallCellSize), yWallCells-1);
+
+	nWallQueries++;
+	for (int i=iMin; i<=iMax; i++) {
+		for (int j=jMin; j<=jMax; j++) {
+			for (int n=0; n<nCellWalls[i*yWallCells + j]; n++) {
+				w = CellWalls[i*yWallCells + j][n];
+				if (Walls[w].Group < nGroups && Walls[w].Query != nWallQueries &&
+					Walls[w].xMin <= MAX(Polygon->Vertices[0].X, Polygon->Vertices[1].X) && Walls[w].xMax >= MIN(Polygon->Vertices[0].X, Polygon->Vertices[1].X) &&
+					Walls[w].yMin <= MAX(Polygon->Vertices[0].Y, Polygon->Vertices[1].Y) && Walls[w].yMax >= MIN(Polygon->Vertices[0].Y, Polygon->Vertices[1].Y))
+				{
+					Walls[w].Query = nWallQueries;
+					WallCandidates[nCandidates++] = w;
+				}
 			}
-			else {
-				free(Intersection);
-				Intersection = NULL;
-			}			
 		}
-		else {
-			free(Intersection);
-			Intersection = NULL;
+	}
+
+	// Test the walls in the order of the polygon list, so the air gaps overwrite each other as before
+	qsort(WallCandidates, nCandidates, sizeof(int), CompareWallIndex);
+
+	return nCandidates;
+}
+
+
+// Free the wall index
+void FreeWallIndex(void)
+{
+	for (int w=0; w<nWalls; w++) {
+		if (Walls[w].Copy == true) {
+			free(Walls[w].Polygon->Vertices);
+			free(Walls[w].Polygon);
 		}
 	}
-	else {
-		free(Intersection);
-		Intersection = NULL;
+	for (int c=0; c<xWallCells*yWallCells; c++) {
+		free(CellWalls[c]);
 	}
+	free(CellWalls);
+	free(nCellWalls);
+	free(Walls);
+	free(WallCandidates);
+}
 
-	return Intersection;
+
+// Compare the position of two walls in the polygon list (for quick sort algorithm)
+int CompareWallIndex(const void *Wall1, const void *Wall2)
+{
+	return *(int*)Wall1 - *(int*)Wall2;
 }
 
 
 // Add a vertical polygon to the TLM grid
-void AddVerticalPolygon(Polygon_t *VPolygon, double Thickness, double Permittivity, bool PropagateFlag)
+void AddVerticalPolygon(RasterContext *Raster, Polygon_t *VPolygon, double Thickness, LONG Operation)
 {
 	xyCoordinate P1 = {VPolygon->Vertices[0].X, VPolygon->Vertices[0].Y};
 	xyCoordinate P2 = {VPolygon->Vertices[1].X, VPolygon->Vertices[1].Y};
@@ -802,13 +2584,12 @@ void AddVerticalPolygon(Polygon_t *VPolygon, double Thickness, double Permittivi
 	xyLine CentralLine;
 	double SineTheta, CosineTheta;
 	double dx, dy;
-	double Impedance;
 	int xMin, xMax;
 	int yMin, yMax;
 	int zMin, zMax;
+	int Low[3], High[3];
 
-	// Set the impedance variable
-	Impedance = IMPEDANCE_OF_FREE_SPACE/sqrt(Permittivity);
+	RasterBounds(Raster, Low, High);
 
 	// Find the minimum and maximum nodes in the z-direction
 	if (VPolygon->Vertices[0].Z < VPolygon->Vertices[1].Z) {
@@ -819,8 +2600,8 @@ void AddVerticalPolygon(Polygon_t *VPolygon, double Thickness, double Permittivi
 		zMin = RoundUpwards(VPolygon->Vertices[1].Z/GridSpacing);
 		zMax = (int)(VPolygon->Vertices[0].Z/GridSpacing);
 	}
-	zMin = PlaceWithinGridZ(zMin);
-	zMax = PlaceWithinGridZ(zMax);
+	zMin = MAX(zMin, Low[2]);
+	zMax = MIN(zMax, High[2]);
 
 	// Ensure the smallest X-coordinate is in P1
 	if (P1.X > P2.X) {
@@ -887,22 +2668,21 @@ void AddVerticalPolygon(Polygon_t *VPolygon, double Thickness, double Permittivi
 
 	// Find all the points between lines S0 and S1, from x coordinates of P0.x to P1.x
 	xMin = RoundUpwards(Vertices[0].X/GridSpacing);
-	xMin = PlaceWithinGridX(xMin);
+	xMin = MAX(xMin, Low[0]);
 	xMax = MIN((int)(Vertices[1].X/GridSpacing),(int)(Vertices[2].X/GridSpacing));
-	xMax = PlaceWithinGridX(xMax);
+	xMax = MIN(xMax, High[0]);
 	if (Sides[0].yCoeff != 0) {
 		for (int x = xMin; x <= xMax; x++) {
 			// Set the minimum and maximum y coordinates for this vertical strip of the rectangle
 			yMin = RoundUpwards(YFromX(Sides[0], x*GridSpacing)/GridSpacing);
-			yMin = PlaceWithinGridY(yMin);
+			yMin = MAX(yMin, Low[1]);
 			yMax = (int) (YFromX(Sides[1],x*GridSpacing)/GridSpacing);
-			yMax = PlaceWithinGridY(yMax);
+			yMax = MIN(yMax, High[1]);
 
 			for (int y = yMin; y <= yMax; y++) {
 				// Repeat for all z-coordinates within the height of the polygon
 				for (int z = zMin; z <= zMax; z++) {
-					Grid[x][y][z].Z = Impedance;
-					Grid[x][y][z].PropagateFlag = PropagateFlag;
+					MarkNode(Raster, x, y, z, Operation, true);
 				}
 			}
 		}
@@ -910,9 +2690,9 @@ void AddVerticalPolygon(Polygon_t *VPolygon, double Thickness, double Permittivi
 
 	// Find all the points between lines S2 and S1, from x coordinates of P1.x to P2.x
 	xMin = MIN(RoundUpwards(Vertices[1].X/GridSpacing),RoundUpwards(Vertices[2].X/GridSpacing));
-	xMin = PlaceWithinGridX(xMin);
+	xMin = MAX(xMin, Low[0]);
 	xMax = MAX((int)(Vertices[1].X/GridSpacing),(int)(Vertices[2].X/GridSpacing));
-	xMax = PlaceWithinGridX(xMax);
+	xMax = MIN(xMax, High[0]);
 
 	for (int x = xMin; x <= xMax; x++) {
 		// Set the minimum and maximum y coordinates for this vertical strip of the rectangle
@@ -924,14 +2704,13 @@ void AddVerticalPolygon(Polygon_t *VPolygon, double Thickness, double Permittivi
 			yMin = RoundUpwards(YFromX(Sides[0], x*GridSpacing)/GridSpacing);
 			yMax = (int) (YFromX(Sides[3],x*GridSpacing)/GridSpacing);
 		}
-		yMin = PlaceWithinGridY(yMin);
-		yMax = PlaceWithinGridY(yMax);
+		yMin = MAX(yMin, Low[1]);
+		yMax = MIN(yMax, High[1]);
 		
 		for (int y = yMin; y <= yMax; y++) {
 			// Repeat for all z-coordinates within the height of the polygon
 			for (int z = zMin; z <= zMax; z++) {
-				Grid[x][y][z].Z = Impedance;
-				Grid[x][y][z].PropagateFlag = PropagateFlag;
+				MarkNode(Raster, x, y, z, Operation, true);
 			}
 		}
 	}
@@ -939,22 +2718,21 @@ void AddVerticalPolygon(Polygon_t *VPolygon, double Thickness, double Permittivi
 	// Find all the points between lines S2 and S3, from x coordinates of P2.x to P3.x
 	if (Sides[3].yCoeff != 0) {
 		xMin = MAX(RoundUpwards(Vertices[1].X/GridSpacing),RoundUpwards(Vertices[2].X/GridSpacing));
-		xMin = PlaceWithinGridX(xMin);
+		xMin = MAX(xMin, Low[0]);
 		xMax = (int)(Vertices[3].X/GridSpacing);
-		xMax = PlaceWithinGridX(xMax);
+		xMax = MIN(xMax, High[0]);
 
 		for (int x = xMin; x <= xMax; x++) {
 			// Set the minimum and maximum y coordinates for this vertical strip of the rectangle
 			yMin = RoundUpwards(YFromX(Sides[2], x*GridSpacing)/GridSpacing);
-			yMin = PlaceWithinGridY(yMin);
+			yMin = MAX(yMin, Low[1]);
 			yMax = (int) (YFromX(Sides[3],x*GridSpacing)/GridSpacing);
-			yMax = PlaceWithinGridY(yMax);
+			yMax = MIN(yMax, High[1]);
 
 			for (int y = yMin; y <= yMax; y++) {
 				// Repeat for all z-coordinates within the height of the polygon
 				for (int z = zMin; z <= zMax; z++) {
-					Grid[x][y][z].Z = Impedance;
-					Grid[x][y][z].PropagateFlag = PropagateFlag;
+					MarkNode(Raster, x, y, z, Operation, true);
 				}
 			}
 		}
@@ -963,7 +2741,7 @@ void AddVerticalPolygon(Polygon_t *VPolygon, double Thickness, double Permittivi
 
 
 // Add a horizontal polygon to the TLM grid
-void AddHorizontalPolygon(Polygon_t *HPolygon, double Thickness, double Permittivity, bool PropagateFlag)
+void AddHorizontalPolygon(RasterContext *Raster, Polygon_t *HPolygon, double Thickness, LONG Operation)
 {
 	int nVertices = HPolygon->nVertices;
 	int VerticesRemaining;
@@ -1058,7 +2836,7 @@ void AddHorizontalPolygon(Polygon_t *HPolygon, double Thickness, double Permitti
 
 				if (EnclosesOtherPoints == false) {
 					// Fill in the current triangle
-					FillTriangle(Vertices[CurrentVertex], Vertices[Previous], Vertices[Next], HPolygon->Vertices[0].Z, Thickness, Permittivity);
+					FillTriangle(Raster, Vertices[CurrentVertex], Vertices[Previous], Vertices[Next], HPolygon->Vertices[0].Z, Thickness, Operation);
 
 					// Reconstruct the polygon sides and angles following the removal of a vertex
 				
@@ -1093,17 +2871,15 @@ void AddHorizontalPolygon(Polygon_t *HPolygon, double Thickness, double Permitti
 
 
 // Fill in a horizontal triangle
-void FillTriangle(xyCoordinate P1, xyCoordinate P2, xyCoordinate P3, double Z, double Thickness, double Permittivity)
+void FillTriangle(RasterContext *Raster, xyCoordinate P1, xyCoordinate P2, xyCoordinate P3, double Z, double Thickness, LONG Operation)
 {
 	xyLine Sides[3];
-	double Impedance;
 	int xMin, xMax;
 	int yMin, yMax;
 	int zMin, zMax;
+	int Low[3], High[3];
 
-	// Set the impedance based upon the permittivity
-	Impedance = IMPEDANCE_OF_FREE_SPACE/sqrt(Permittivity);
-
+	RasterBounds(Raster, Low, High);
 	if (Thickness < GridSpacing) {
 		Thickness = GridSpacing;
 	}
@@ -1112,16 +2888,16 @@ void FillTriangle(xyCoordinate P1, xyCoordinate P2, xyCoordinate P3, double Z, d
 	zMin = RoundUpwards((Z - Thickness/2)/GridSpacing);
 	zMax = (int)((Z + Thickness/2)/GridSpacing);
 
-	if (zMin < 0) {
-		zMax -= zMin;
-		zMin = 0;
+	if (zMin < zOffset) {
+		zMax += zOffset - zMin;
+		zMin = zOffset;
 	}
-	if (zMax >= zSize) {
-		zMin -= zMax - zSize + 1; 
-		zMax = zSize-1;
+	if (zMax > zOffset+zSize-1) {
+		zMin -= zMax - (zOffset+zSize-1); 
+		zMax = zOffset+zSize-1;
 	}
-	zMin = PlaceWithinGridZ(zMin);
-	zMax = PlaceWithinGridZ(zMax);
+	zMin = MAX(zMin, Low[2]);
+	zMax = MIN(zMax, High[2]);
 
 	// Arrange the coordinates in order of increasing x coordinate
 	if (P1.X > P2.X) {
@@ -1145,37 +2921,216 @@ void FillTriangle(xyCoordinate P1, xyCoordinate P2, xyCoordinate P3, double Z, d
 	Sides[2] = CoordinatesToLine(P2,P3);
 
 	if (Sides[0].yCoeff != 0) {
-		xMin = RoundUpwards(P1.X/GridSpacing);
-		xMax = (int) (P2.X/GridSpacing);
+		xMin = MAX(RoundUpwards(P1.X/GridSpacing), Low[0]);
+		xMax = MIN((int) (P2.X/GridSpacing), High[0]);
 
 		for (int x = xMin; x <= xMax; x++) {
 			double y1 = YFromX(Sides[0],x*GridSpacing);
 			double y2 = YFromX(Sides[1],x*GridSpacing);
-			yMin = RoundUpwards(MIN(y1,y2)/GridSpacing);
-			yMax = (int)(MAX(y1,y2)/GridSpacing);
+			yMin = MAX(RoundUpwards(MIN(y1,y2)/GridSpacing), Low[1]);
+			yMax = MIN((int)(MAX(y1,y2)/GridSpacing), High[1]);
 
 			for (int y = yMin; y <= yMax; y++) {
 				for (int z = zMin; z <= zMax; z++) {
-					Grid[x][y][z].Z = Impedance;
+					MarkNode(Raster, x, y, z, Operation, false);
 				}
 			}
 		}
 	}
 
 	if (Sides[2].yCoeff != 0) {
-		xMin = RoundUpwards(P2.X/GridSpacing);
-		xMax = (int) (P3.X/GridSpacing);
+		xMin = MAX(RoundUpwards(P2.X/GridSpacing), Low[0]);
+		xMax = MIN((int) (P3.X/GridSpacing), High[0]);
 
 		for (int x = xMin; x <= xMax; x++) {
 			double y1 = YFromX(Sides[1],x*GridSpacing);
 			double y2 = YFromX(Sides[2],x*GridSpacing);
-			yMin = RoundUpwards(MIN(y1,y2)/GridSpacing);
-			yMax = (int)(MAX(y1,y2)/GridSpacing);
+			yMin = MAX(RoundUpwards(MIN(y1,y2)/GridSpacing), Low[1]);
+			yMax = MIN((int)(MAX(y1,y2)/GridSpacing), High[1]);
 
 			for (int y = yMin; y <= yMax; y++) {
 				for (int z = zMin; z <= zMax; z++) {
-					Grid[x][y][z].Z = Impedance;
+					MarkNode(Raster, x, y, z, Operation, false);
+				}
+			}
+		}
+	}
+}
+
+
+// Add the triangles of a mesh to the TLM grid, as thick as the wall thickness of their group
+void AddTriangulatedPolygon(RasterContext *Raster, Polygon_t *TPolygon, double Thickness, LONG Operation)
+{
+	// Ensure the triangles are at least as thick as the grid spacing
+	if (Thickness < GridSpacing) {
+		Thickness = GridSpacing;
+	}
+
+	for (int t=0; t<TPolygon->nVertices; t+=3) {
+		VoxeliseTriangle(Raster, &TPolygon->Vertices[t], Thickness/2, Operation);
+	}
+}
+
+
+// Mark every node whose cell, a cube of side twice HalfSize centred on the node, overlaps a triangle. The cell and triangle
+// overlap unless they are separated along one of 13 axes, the 3 grid axes, the normal of the triangle and the products of
+// its edges with the grid axes. The cells overlapping the triangle along each axis form a single range of z in each column
+// of the grid, so the ranges are found directly rather than testing each cell. The axes are tested two at a time with SSE2
+void VoxeliseTriangle(RasterContext *Raster, Coordinate *Triangle, double HalfSize, LONG Operation)
+{
+	double Axes[10][3];				// Normal and edge products, in grid units
+	double Lower[10], Upper[10];	// Range of the projection of the cell centres that overlap the triangle along each axis
+	int nAxes = 0;
+	__m128d zAxes[3][5];			// Components of the axes with a z component, two to a register
+	__m128d zBounds[2][5];			// Projections bounding the lowest and highest cells along those axes
+	__m128d FlatAxes[2][5];			// Components of the axes lying in the plane of x and y
+	__m128d FlatBounds[2][5];		// Projections bounding the cells along those axes
+	int nzAxes = 0, nFlatAxes = 0;
+	int nzPairs, nFlatPairs;
+	double Range[2][2];
+	double Min[3], Max[3];
+	double Edges[3][3];
+	double Vertices[3][3];
+	double Epsilon = 1e-9*GridSpacing;
+	int xMin, xMax, yMin, yMax, zMin, zMax;
+	int Low[3], High[3];
+
+	RasterBounds(Raster, Low, High);
+	for (int v=0; v<3; v++) {
+		Vertices[v][0] = Triangle[v].X;
+		Vertices[v][1] = Triangle[v].Y;
+		Vertices[v][2] = Triangle[v].Z;
+	}
+	for (int d=0; d<3; d++) {
+		Min[d] = MIN(MIN(Vertices[0][d], Vertices[1][d]), Vertices[2][d]) - HalfSize;
+		Max[d] = MAX(MAX(Vertices[0][d], Vertices[1][d]), Vertices[2][d]) + HalfSize;
+		for (int e=0; e<3; e++) {
+			Edges[e][d] = Vertices[(e+1)%3][d] - Vertices[e][d];
+		}
+	}
+
+	// The normal of the triangle
+	Axes[0][0] = Edges[0][1]*Edges[1][2] - Edges[0][2]*Edges[1][1];
+	Axes[0][1] = Edges[0][2]*Edges[1][0] - Edges[0][0]*Edges[1][2];
+	Axes[0][2] = Edges[0][0]*Edges[1][1] - Edges[0][1]*Edges[1][0];
+	// The products of each edge with the x, y and z axes
+	for (int e=0; e<3; e++) {
+		double *Axis;
+		Axis = Axes[1+3*e];
+		Axis[0] = 0;			Axis[1] = -Edges[e][2];	Axis[2] = Edges[e][1];
+		Axis = Axes[2+3*e];
+		Axis[0] = Edges[e][2];	Axis[1] = 0;			Axis[2] = -Edges[e][0];
+		Axis = Axes[3+3*e];
+		Axis[0] = -Edges[e][1];	Axis[1] = Edges[e][0];	Axis[2] = 0;
+	}
+
+	// Project the triangle onto each axis, widened by the radius of the cell along it. Axes from edges parallel to a grid
+	// axis are left out, as are all of them for a triangle with no area
+	for (int a=0; a<10; a++) {
+		double Length = fabs(Axes[a][0]) + fabs(Axes[a][1]) + fabs(Axes[a][2]);
+		double Projection[3];
+		if (Length <= 1e-12*SQUARE(Max[0]-Min[0] + Max[1]-Min[1] + Max[2]-Min[2])) {
+			continue;
+		}
+		for (int v=0; v<3; v++) {
+			Projection[v] = Axes[a][0]*Vertices[v][0] + Axes[a][1]*Vertices[v][1] + Axes[a][2]*Vertices[v][2];
+		}
+		Lower[nAxes] = MIN(MIN(Projection[0], Projection[1]), Projection[2]) - HalfSize*Length - Epsilon*Length;
+		Upper[nAxes] = MAX(MAX(Projection[0], Projection[1]), Projection[2]) + HalfSize*Length + Epsilon*Length;
+		// Measure the axes in grid units, so the projection of a node is a sum of its indices
+		Axes[nAxes][0] = Axes[a][0]*GridSpacing;
+		Axes[nAxes][1] = Axes[a][1]*GridSpacing;
+		Axes[nAxes][2] = Axes[a][2]*GridSpacing;
+		nAxes++;
+	}
+
+	// Pack the axes in pairs. An axis crossing z bounds the range of z from the lower projection if it points up the z axis and
+	// from the upper one if it points down. An odd axis is paired with itself, which leaves the range unchanged
+	for (int a=0; a<nAxes; a++) {
+		if (Axes[a][2] != 0) {
+			int p = nzAxes/2;
+			double Bounds[2] = {Axes[a][2] > 0 ? Lower[a] : Upper[a], Axes[a][2] > 0 ? Upper[a] : Lower[a]};
+
+			if (nzAxes%2 == 0) {
+				for (int d=0; d<3; d++) {
+					zAxes[d][p] = _mm_set1_pd(Axes[a][d]);
 				}
+				zBounds[0][p] = _mm_set1_pd(Bounds[0]);
+				zBounds[1][p] = _mm_set1_pd(Bounds[1]);
+			}
+			else {
+				for (int d=0; d<3; d++) {
+					zAxes[d][p] = _mm_move_sd(_mm_set1_pd(Axes[a][d]), zAxes[d][p]);
+				}
+				zBounds[0][p] = _mm_move_sd(_mm_set1_pd(Bounds[0]), zBounds[0][p]);
+				zBounds[1][p] = _mm_move_sd(_mm_set1_pd(Bounds[1]), zBounds[1][p]);
+			}
+			nzAxes++;
+		}
+		else {
+			int p = nFlatAxes/2;
+
+			if (nFlatAxes%2 == 0) {
+				FlatAxes[0][p] = _mm_set1_pd(Axes[a][0]);
+				FlatAxes[1][p] = _mm_set1_pd(Axes[a][1]);
+				FlatBounds[0][p] = _mm_set1_pd(Lower[a]);
+				FlatBounds[1][p] = _mm_set1_pd(Upper[a]);
+			}
+			else {
+				FlatAxes[0][p] = _mm_move_sd(_mm_set1_pd(Axes[a][0]), FlatAxes[0][p]);
+				FlatAxes[1][p] = _mm_move_sd(_mm_set1_pd(Axes[a][1]), FlatAxes[1][p]);
+				FlatBounds[0][p] = _mm_move_sd(_mm_set1_pd(Lower[a]), FlatBounds[0][p]);
+				FlatBounds[1][p] = _mm_move_sd(_mm_set1_pd(Upper[a]), FlatBounds[1][p]);
+			}
+			nFlatAxes++;
+		}
+	}
+	nzPairs = (nzAxes+1)/2;
+	nFlatPairs = (nFlatAxes+1)/2;
+
+	// The grid axes bound the columns to test
+	xMin = MAX(RoundUpwards((Min[0]-Epsilon)/GridSpacing), Low[0]);
+	xMax = MIN((int)floor((Max[0]+Epsilon)/GridSpacing), High[0]);
+	yMin = MAX(RoundUpwards((Min[1]-Epsilon)/GridSpacing), Low[1]);
+	yMax = MIN((int)floor((Max[1]+Epsilon)/GridSpacing), High[1]);
+
+	for (int x = xMin; x <= xMax; x++) {
+		__m128d xIndex = _mm_set1_pd(x);
+
+		for (int y = yMin; y <= yMax; y++) {
+			__m128d yIndex = _mm_set1_pd(y);
+			__m128d zLower = _mm_set1_pd((Min[2]-Epsilon)/GridSpacing);
+			__m128d zUpper = _mm_set1_pd((Max[2]+Epsilon)/GridSpacing);
+			__m128d Outside = _mm_setzero_pd();
+			double zFirst, zLast;
+
+			// Narrow the range of z by the axes crossing it
+			for (int p=0; p<nzPairs; p++) {
+				__m128d Column = _mm_add_pd(_mm_mul_pd(zAxes[0][p], xIndex), _mm_mul_pd(zAxes[1][p], yIndex));
+				zLower = _mm_max_pd(zLower, _mm_div_pd(_mm_sub_pd(zBounds[0][p], Column), zAxes[2][p]));
+				zUpper = _mm_min_pd(zUpper, _mm_div_pd(_mm_sub_pd(zBounds[1][p], Column), zAxes[2][p]));
+			}
+
+			// The axes in the plane of x and y either hold the whole column or none of it
+			for (int p=0; p<nFlatPairs; p++) {
+				__m128d Column = _mm_add_pd(_mm_mul_pd(FlatAxes[0][p], xIndex), _mm_mul_pd(FlatAxes[1][p], yIndex));
+				Outside = _mm_or_pd(Outside, _mm_or_pd(_mm_cmplt_pd(Column, FlatBounds[0][p]), _mm_cmpgt_pd(Column, FlatBounds[1][p])));
+			}
+			if (_mm_movemask_pd(Outside) != 0) {
+				continue;
+			}
+
+			_mm_storeu_pd(Range[0], zLower);
+			_mm_storeu_pd(Range[1], zUpper);
+			zFirst = MAX(Range[0][0], Range[0][1]);
+			zLast = MIN(Range[1][0], Range[1][1]);
+			if (zFirst > zLast) {
+				continue;
+			}
+			zMin = zFirst <= Low[2] ? Low[2] : (int)ceil(zFirst);
+			zMax = zLast >= High[2] ? High[2] : (int)floor(zLast);
+			for (int z = zMin; z <= zMax; z++) {
+				MarkNode(Raster, x, y, z, Operation, true);
 			}
 		}
 	}
@@ -1208,20 +3163,84 @@ int PlaceWithinGridZ(int z)
 }
 
 
+// Find the node of the grid nearest to a position in the x, y or z direction
+int NearestNodeX(double X)
+{
+	return PlaceWithinGridX(RoundToNearest(X/GridSpacing) - xOffset);
+}
+
+int NearestNodeY(double Y)
+{
+	return PlaceWithinGridY(RoundToNearest(Y/GridSpacing) - yOffset);
+}
+
+int NearestNodeZ(double Z)
+{
+	return PlaceWithinGridZ(RoundToNearest(Z/GridSpacing) - zOffset);
+}
+
+
+// Find the position of a node of the grid in the x, y or z direction
+double NodePositionX(int x)
+{
+	return (x + xOffset)*GridSpacing;
+}
+
+double NodePositionY(int y)
+{
+	return (y + yOffset)*GridSpacing;
+}
+
+double NodePositionZ(int z)
+{
+	return (z + zOffset)*GridSpacing;
+}
+
+
 // Calculate the reflection and transmission coefficients of all nodes in the TLM grid based upon the node impedances
 void CalculateReflectionTransmissionCoefficients(void)
+{
+	CoefficientRegion Region = {0, ySize-1, 0, zSize-1, false, 0};
+
+	// Find all nodes that lie on a material boundary within the rows owned by this process, in parallel slabs
+	ParallelSlabs(FirstOwnedRow(), LastOwnedRow(), CalculateCoefficientSlab, (void*)&Region);
+
+	PrintGridBoundaries(Region.Boundaries);
+	FreeThinLinks();
+}
+
+
+// Print the number of nodes on material boundaries within the rows owned by this process, and on the edges of the grid
+void PrintGridBoundaries(int mBoundaries)
 {
 	int gBoundaries;
+	int nRows = LastOwnedRow()-FirstOwnedRow()+1;
+
+	gBoundaries = 2*((xSize-1)*(ySize-1) + (xSize-1)*(zSize-1) + (ySize-1)*(zSize-1) + 1);
+
+	printf("Total nodes = %d\nMaterial Boundaries = %d (%d%%)\nGrid Edge Boundaries = %d (%d%%)\n", nRows*ySize*zSize, mBoundaries, (int)(100*mBoundaries/nRows/ySize/zSize), gBoundaries, (int)(100*gBoundaries/xSize/ySize/zSize));
+}
+
+
+// Calculate the reflection and transmission coefficients of a slab of nodes within the region given, adding the number of material
+// boundaries found to its count
+void CalculateCoefficientSlab(int xMin, int xMax, void *Context)
+{
+	CoefficientRegion *Region = (CoefficientRegion*)Context;
 	int mBoundaries = 0;
 	bool Boundary;
+	bool ThinLinks = false;
+	LONG Sheets[6];
 	double Z;
 
-	// Find all nodes that lie on a material boundary within the grid
-	for (int x = 0; x < xSize; x++) {
-		for (int y = 0; y < ySize; y++) {
-			for (int z = 0; z < zSize; z++) {
+	for (int x = xMin; x <= xMax; x++) {
+		for (int y = Region->yMin; y <= Region->yMax; y++) {
+			for (int z = Region->zMin; z <= Region->zMax; z++) {
 				Boundary = false;
 				Z = Grid[x][y][z].Z;
+				if (Region->Replace == true && Grid[x][y][z].RT != NULL) {
+					free(Grid[x][y][z].RT);
+				}
 
 				// Check for boundaries in each direction
 				if (x == (xSize-1) || Grid[x+1][y][z].Z != Z) {
@@ -1243,6 +3262,14 @@ void CalculateReflectionTransmissionCoefficients(void)
 					Boundary = true;
 				}
 
+				// Thin walls crossing the links of the node also make it a boundary
+				if (GridRaster.ThinStamp[0] != NULL) {
+					ThinLinks = FindThinLinks(x, y, z, Sheets);
+					if (ThinLinks == true) {
+						Boundary = true;
+					}
+				}
+
 				// Set up the reflection and transmission coefficient matrix
 				if (Boundary == false) {
 					Grid[x][y][z].RT = NULL;
@@ -1302,6 +3329,10 @@ void CalculateReflectionTransmissionCoefficients(void)
 						Grid[x][y][z].RT->Rzn = (Z-Grid[x][y][z-1].Z)/(Z+Grid[x][y][z-1].Z);
 					}
 					Grid[x][y][z].RT->Tzn = 1-Grid[x][y][z].RT->Rzn;
+
+					if (ThinLinks == true) {
+						ApplyThinLinks(x, y, z, Sheets);
+					}
 					
 					mBoundaries++;
 				}
@@ -1309,11 +3340,162 @@ void CalculateReflectionTransmissionCoefficients(void)
 		}
 	}
 
-	gBoundaries = 2*((xSize-1)*(ySize-1) + (xSize-1)*(zSize-1) + (ySize-1)*(zSize-1) + 1);
+	InterlockedExchangeAdd(&Region->Boundaries, mBoundaries);
+}
+
+
+// Find the thin walls crossing the links of a node, in the order x positive, x negative, y positive and so on. Returns false if 
+// there are none
+bool FindThinLinks(int x, int y, int z, LONG *Sheets)
+{
+	SIZE_T Index = RasterIndex(&GridRaster, x, y, z);
+	bool Found = false;
+
+	Sheets[0] = GridRaster.ThinStamp[0][Index];
+	Sheets[1] = x > GridRaster.Min[0] ? GridRaster.ThinStamp[0][RasterIndex(&GridRaster, x-1, y, z)] : 0;
+	Sheets[2] = GridRaster.ThinStamp[1][Index];
+	Sheets[3] = y > GridRaster.Min[1] ? GridRaster.ThinStamp[1][RasterIndex(&GridRaster, x, y-1, z)] : 0;
+	Sheets[4] = GridRaster.ThinStamp[2][Index];
+	Sheets[5] = z > GridRaster.Min[2] ? GridRaster.ThinStamp[2][Index-1] : 0;
+
+	for (int i=0; i<6; i++) {
+		if (Sheets[i] > 0) {
+			Found = true;
+		}
+	}
+	return Found;
+}
+
+
+// Replace the coefficients of the links of a node crossed by thin walls with those of the sheets. A sheet on the boundary of 
+// two materials is left to the boundary itself. The reflection changes sign from one side of the sheet to the other, as at the 
+// boundary of two materials, otherwise the link would add energy to the pulses crossing it. The transmission loss of the wall
+// is taken from the pulses crossing the sheet
+void ApplyThinLinks(int x, int y, int z, LONG *Sheets)
+{
+	RTCoeffs *RT = Grid[x][y][z].RT;
+	double *R[6] = {&RT->Rxp, &RT->Rxn, &RT->Ryp, &RT->Ryn, &RT->Rzp, &RT->Rzn};
+	double *T[6] = {&RT->Txp, &RT->Txn, &RT->Typ, &RT->Tyn, &RT->Tzp, &RT->Tzn};
+	double Neighbours[6];
+	double Z = Grid[x][y][z].Z;
+
+	Neighbours[0] = Sheets[0] > 0 ? Grid[x+1][y][z].Z : 0;
+	Neighbours[1] = Sheets[1] > 0 ? Grid[x-1][y][z].Z : 0;
+	Neighbours[2] = Sheets[2] > 0 ? Grid[x][y+1][z].Z : 0;
+	Neighbours[3] = Sheets[3] > 0 ? Grid[x][y-1][z].Z : 0;
+	Neighbours[4] = Sheets[4] > 0 ? Grid[x][y][z+1].Z : 0;
+	Neighbours[5] = Sheets[5] > 0 ? Grid[x][y][z-1].Z : 0;
+
+	for (int i=0; i<6; i++) {
+		if (Sheets[i] > 0 && Neighbours[i] == Z) {
+			*R[i] = ThinSheetReflection(Z, &ThinSheets[Sheets[i]-1]);
+			*T[i] = sqrt(1 - SQUARE(*R[i]))*ThinSheetAttenuation(&ThinSheets[Sheets[i]-1]);
+			if (i%2 == 1) {
+				*R[i] = -*R[i];
+			}
+		}
+	}
+}
+
+
+// Reflection coefficient of a lossless sheet at the operating frequency, between two nodes of impedance Z. The magnitude is that 
+// of the slab at normal incidence, with the sign of the reflection from its first face
+double ThinSheetReflection(double Z, ThinSheet *Sheet)
+{
+	double r = (Z-Sheet->Impedance)/(Z+Sheet->Impedance);
+	double Phase = 2*M_PI*Frequency*Sheet->Thickness*IMPEDANCE_OF_FREE_SPACE/Sheet->Impedance/SPEED_OF_LIGHT;
+	double Numerator = 4*SQUARE(r)*SQUARE(sin(Phase));
+	double Magnitude = sqrt(Numerator/(SQUARE(1-SQUARE(r)) + Numerator));
+
+	return r < 0 ? -Magnitude : Magnitude;
+}
+
+
+// Fraction of the voltage of a pulse left after crossing a sheet, from the transmission loss of the wall over its thickness. The
+// conductivity of the scene is not applied, the loss per cm is taken to include it
+double ThinSheetAttenuation(ThinSheet *Sheet)
+{
+	return pow(10.0, -Sheet->TransmissionLoss*Sheet->Thickness*100/20);
+}
+
+
+// Free the thin walls once the coefficients of their links are set
+void FreeThinLinks(void)
+{
+	for (int Axis=0; Axis<3; Axis++) {
+		free((void*)GridRaster.ThinStamp[Axis]);
+		GridRaster.ThinStamp[Axis] = NULL;
+	}
+	free(ThinSheets);
+	ThinSheets = NULL;
+}
+
+
+// Return the number of threads used to set up the scene, one per processor unless the worker pool size is given
+int SetupThreadCount(void)
+{
+	SYSTEM_INFO SystemInfo;
+
+	if (Workers > 0) {
+		return Workers;
+	}
+	GetSystemInfo(&SystemInfo);
+
+	return MAX((int)SystemInfo.dwNumberOfProcessors, 1);
+}
+
+
+// Wait for all of the objects to be signalled, in batches as a single wait is limited to MAXIMUM_WAIT_OBJECTS handles
+void WaitForAllObjects(int nObjects, HANDLE *hObjects)
+{
+	for (int i=0; i<nObjects; i+=MAXIMUM_WAIT_OBJECTS) {
+		WaitForMultipleObjects(MIN(nObjects-i, MAXIMUM_WAIT_OBJECTS), &hObjects[i], true, INFINITE);
+	}
+}
+
+
+// Run a function over the rows of the grid from xFirst to xLast in slabs of the x-direction, one slab per setup thread
+void ParallelSlabs(int xFirst, int xLast, SlabFunction Function, void *Context)
+{
+	HANDLE *hThreads;
+	SlabData_t *Data;
+	int nRows = xLast-xFirst+1;
+	int nThreads = MIN(SetupThreadCount(), nRows);
+
+	hThreads = (HANDLE*)malloc(nThreads*sizeof(HANDLE));
+	Data = (SlabData_t*)malloc(nThreads*sizeof(SlabData_t));
+	for (int i=0; i<nThreads; i++) {
+		Data[i].Function = Function;
+		Data[i].Context = Context;
+		Data[i].xMin = xFirst + i*nRows/nThreads;
+		Data[i].xMax = xFirst + (i+1)*nRows/nThreads-1;
+		hThreads[i] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)SlabThread, (LPVOID)&Data[i], 0, NULL);
+		if (hThreads[i] == NULL) {
+			printf("Setup thread %d could not be started\n", i+1);
+			exit(1);
+		}
+	}
+	WaitForAllObjects(nThreads, hThreads);
 
-	printf("Total nodes = %d\nMaterial Boundaries = %d (%d%%)\nGrid Edge Boundaries = %d (%d%%)\n", xSize*ySize*zSize, mBoundaries, (int)(100*mBoundaries/xSize/ySize/zSize), gBoundaries, (int)(100*gBoundaries/xSize/ySize/zSize));
+	for (int i=0; i<nThreads; i++) {
+		CloseHandle(hThreads[i]);
+	}
+	free(hThreads);
+	free(Data);
+}
+
+
+// Thread function running a setup stage over a single slab
+DWORD WINAPI SlabThread(LPVOID lpParam)
+{
+	SlabData_t *Data = (SlabData_t*)lpParam;
+
+	Data->Function(Data->xMin, Data->xMax, Data->Context);
+
+	return 0;
 }
 
 
 
 
+
@@ -11,10 +11,32 @@
 #ifndef TLM_SCENE_H
 #define TLM_SCENE_H
 
+// Type definitions
+
+// Function run by a setup thread over the slab of nodes from xMin to xMax
+typedef void (*SlabFunction)(int xMin, int xMax, void *Context);
+
 // Function prototypes
 bool ReadSceneFile(void);
+bool ApplySceneUpdate(void);
+bool HashSceneMeshes(ULONGLONG *Hash);
+void WaitForAllObjects(int nObjects, HANDLE *hObjects);
+void ParallelSlabs(int xFirst, int xLast, SlabFunction Function, void *Context);
+void InitialiseGridRow(int x, int y);
+void FreeGridMemory(void);
+void PrintGridBoundaries(int mBoundaries);
+void SetSceneExtent(int *Min, int *Max);
+void GetSceneExtent(int *Min, int *Max);
+void FindGridExtent(int *GridMin, int *GridMax);
+void PlaceGrid(int *GridMin, int *GridMax);
 int PlaceWithinGridX(int x);
 int PlaceWithinGridY(int y);
 int PlaceWithinGridZ(int z);
+int NearestNodeX(double X);
+int NearestNodeY(double Y);
+int NearestNodeZ(double Z);
+double NodePositionX(int x);
+double NodePositionY(int y);
+double NodePositionZ(int z);
 
 #endif //TLM_SCENE_H
\ No newline at end of file
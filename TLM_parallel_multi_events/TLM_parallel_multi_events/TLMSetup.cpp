@@ -13,6 +13,9 @@
 #include "TLMSetup.h"
 #include "TLMMaths.h"
 #include "TLM.h"
+#include "TLMDomain.h"
+#include "TLMProbe.h"
+#include "TLMNuma.h"
 
 
 // Function prototypes
@@ -26,27 +29,54 @@ extern char *ProjectName;
 extern char *FolderName;
 extern char *InputFilename;
 extern char *SceneFilename;
+extern char *SceneUpdateFilename;
+extern char *SceneUpdateProjectName;
 extern char *OutputFilename;
 extern char *TimeVariationFilename;
 extern char *PathLossFilename;
+extern char *ObserverFilename;
 extern char *TimingFilename;
+extern char *CheckpointFilename;
+extern char *SnapshotFilename;
+extern char *CoverageFilename;
 extern double GridSpacing;
 extern double MaxPathLoss;
 extern double RelativeThreshold;
 extern Source ImpulseSource;
 extern double Frequency;
 extern int Threads;
+extern int Workers;
+extern int Processes;
+extern int TemporalBlock;
+extern double TemporalBlockDensity;
 extern InputFlags InputData;
 extern PLParams PathLossParameters;
+extern NumaPolicy GridPlacement;
+extern DecompositionType Decomposition;
+extern double RadialShellWidth;
+extern double CropMargin;
+extern int CheckpointIterations;
+extern double CheckpointMinutes;
+extern int SnapshotIterations;
+extern SnapshotField SnapshotValue;
+extern SnapshotRegion SnapshotNodes;
+extern double SnapshotPosition;
+extern int SnapshotStep;
+extern int CoverageTileSize;
 
 // Input file parameters default flags
 extern bool DefaultProjectName;
 extern bool DefaultFolderName;
 extern bool DefaultSceneFilename;
+extern bool DefaultSceneUpdateFilename;
 extern bool DefaultOutputFilename;
 extern bool DefaultTimeVariationFilename;
 extern bool DefaultPathLossFilename;
+extern bool DefaultObserverFilename;
 extern bool DefaultTimingFilename;
+extern bool DefaultCheckpointFilename;
+extern bool DefaultSnapshotFilename;
+extern bool DefaultCoverageFilename;
 extern bool DefaultGridSpacing;
 extern bool DefaultMaxPathLoss;
 extern bool DefaultRelativeThreshold;
@@ -55,7 +85,27 @@ extern bool DefaultSourceDuration;
 extern bool DefaultSourcePosition;
 extern bool DefaultFrequency;
 extern bool DefaultThreads;
+extern bool DefaultWorkers;
+extern bool DefaultProcesses;
+extern bool DefaultTemporalBlock;
+extern bool DefaultTemporalBlockDensity;
 extern bool DefaultPLParams;
+extern PLFormat PathLossFormat;
+extern bool DefaultPathLossFormat;
+extern int ProbeChunk;
+extern bool DefaultProbeChunk;
+extern bool DefaultCheckpointIterations;
+extern bool DefaultCheckpointMinutes;
+extern bool DefaultSnapshotIterations;
+extern bool DefaultSnapshotValue;
+extern bool DefaultSnapshotNodes;
+extern bool DefaultSnapshotPosition;
+extern bool DefaultSnapshotStep;
+extern bool DefaultCoverageTileSize;
+extern bool DefaultNumaPolicy;
+extern bool DefaultDecomposition;
+extern bool DefaultRadialShellWidth;
+extern bool DefaultCropMargin;
 
 
 // Function prototypes
@@ -63,16 +113,33 @@ bool ReadString(char **Context, char **String, bool *DefaultFlag);
 bool ReadDouble(char **Context, double *Double, bool *DefaultFlag);
 bool ReadInt(char **Context, int *Int, bool *DefaultFlag);
 bool ReadBool(char **Context, bool *Bool, bool *DefaultFlag);
+bool ReadDoubles(char **Context, double *Doubles, int n);
 void DisplayParameter(const char *ParameterName, char *ParameterValue, bool DefaultFlag);
 
 
 // Parse command line arguments
 void ParseCommandLine(int argc, char *argv[])
 {
-	if (argc == 2) {
+	int Rank = -1;
+	char *Job = NULL;
+
+	if (argc >= 2) {
 		InputFilename = _strdup(argv[1]);
 		printf("Input file '%s' specified at command line",InputFilename);
 	}
+
+	// A process started to run a slab of a split domain is given its rank and the job it belongs to
+	for (int i=2; i+1<argc; i+=2) {
+		if (strcmp(argv[i], "-rank") == 0) {
+			Rank = atoi(argv[i+1]);
+		}
+		else if (strcmp(argv[i], "-job") == 0) {
+			Job = argv[i+1];
+		}
+	}
+	if (Rank >= 0 && Job != NULL) {
+		SetDomainRank(Rank, Job);
+	}
 }
 
 
@@ -142,6 +209,12 @@ bool ReadDataFromFile(void)
 							SuccessfulRead = false;
 						}
 					}
+					// Read the scene update file name
+					else if (strcmp(ParameterName, "scene_update_filename") == 0) {
+						if (ReadString(&Context, &SceneUpdateFilename, &DefaultSceneUpdateFilename) == false) {
+							SuccessfulRead = false;
+						}
+					}
 					// Read the output file name
 					else if (strcmp(ParameterName, "output_filename") == 0) {
 						if (ReadString(&Context, &OutputFilename, &DefaultOutputFilename) == false) {
@@ -160,6 +233,12 @@ bool ReadDataFromFile(void)
 							SuccessfulRead = false;
 						}
 					}
+					// Read the file name of the values of the observers built in
+					else if (strcmp(ParameterName, "observer_filename") == 0) {
+						if (ReadString(&Context, &ObserverFilename, &DefaultObserverFilename) == false) {
+							SuccessfulRead = false;
+						}
+					}
 					// Read the timing file name
 					else if (strcmp(ParameterName, "timing_filename") == 0) {
 						if (ReadString(&Context, &TimingFilename, &DefaultTimingFilename) == false) {
@@ -245,6 +324,58 @@ bool ReadDataFromFile(void)
 							SuccessfulRead = false;
 						}
 					}
+					// Read the number of threads in the worker pool, 0 for one per processor
+					else if (strcmp(ParameterName, "workers") == 0) {
+						if (ReadInt(&Context, &Workers, &DefaultWorkers) == false || Workers < 0) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the number of processes the grid is split between
+					else if (strcmp(ParameterName, "processes") == 0) {
+						if (ReadInt(&Context, &Processes, &DefaultProcesses) == false || Processes < 1 || Processes > MAX_DOMAIN_RANKS) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the number of iterations advanced in each temporally blocked pass
+					else if (strcmp(ParameterName, "temporal_block") == 0) {
+						if (ReadInt(&Context, &TemporalBlock, &DefaultTemporalBlock) == false || TemporalBlock < 1) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the active junction density above which temporal blocking is used
+					else if (strcmp(ParameterName, "temporal_block_density") == 0) {
+						if (ReadDouble(&Context, &TemporalBlockDensity, &DefaultTemporalBlockDensity) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the division of the grid between the threads
+					else if (strcmp(ParameterName, "decomposition") == 0) {
+						char *DecompositionString = NULL;
+
+						if (ReadString(&Context, &DecompositionString, &DefaultDecomposition) == false) {
+							SuccessfulRead = false;
+						}
+						else {
+							if (strcmp(DecompositionString, "box") == 0) {
+								Decomposition = DECOMPOSITION_BOX;
+							}
+							else if (strcmp(DecompositionString, "scene") == 0) {
+								Decomposition = DECOMPOSITION_SCENE;
+							}
+							else if (strcmp(DecompositionString, "radial") == 0) {
+								Decomposition = DECOMPOSITION_RADIAL;
+							}
+							else {
+								SuccessfulRead = false;
+							}
+						}
+					}
+					// Read the width of the shells used by the radial decomposition
+					else if (strcmp(ParameterName, "radial_shell_width") == 0) {
+						if (ReadDouble(&Context, &RadialShellWidth, &DefaultRadialShellWidth) == false || RadialShellWidth <= 0) {
+							SuccessfulRead = false;
+						}
+					}
 					// Read the path loss threshold
 					else if (strcmp(ParameterName, "max_path_loss") == 0) {
 						if (ReadDouble(&Context, &MaxPathLoss, &DefaultMaxPathLoss) == false) {
@@ -269,6 +400,150 @@ bool ReadDataFromFile(void)
 							SuccessfulRead = false;
 						}
 					}
+					// Read a probe at a single point, as x y z
+					else if (strcmp(ParameterName, "probe_point") == 0) {
+						double Position[3];
+
+						if (ReadDoubles(&Context, Position, 3) == false) {
+							SuccessfulRead = false;
+						}
+						else {
+							AddProbe(false, Position, NULL);
+						}
+					}
+					// Read a probe along a line, as x1 y1 z1 x2 y2 z2
+					else if (strcmp(ParameterName, "probe_line") == 0) {
+						double Ends[6];
+
+						if (ReadDoubles(&Context, Ends, 6) == false) {
+							SuccessfulRead = false;
+						}
+						else {
+							AddProbe(true, &Ends[0], &Ends[3]);
+						}
+					}
+					// Read the number of iterations of probe samples written at a time
+					else if (strcmp(ParameterName, "probe_chunk") == 0) {
+						if (ReadInt(&Context, &ProbeChunk, &DefaultProbeChunk) == false || ProbeChunk < 1) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the number of iterations between checkpoints, zero for none
+					else if (strcmp(ParameterName, "checkpoint_iterations") == 0) {
+						if (ReadInt(&Context, &CheckpointIterations, &DefaultCheckpointIterations) == false || CheckpointIterations < 0) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the number of minutes between checkpoints, zero for none
+					else if (strcmp(ParameterName, "checkpoint_minutes") == 0) {
+						if (ReadDouble(&Context, &CheckpointMinutes, &DefaultCheckpointMinutes) == false || CheckpointMinutes < 0) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the checkpoint filename
+					else if (strcmp(ParameterName, "checkpoint_filename") == 0) {
+						if (ReadString(&Context, &CheckpointFilename, &DefaultCheckpointFilename) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the flag to resume from the checkpoint of an earlier run
+					else if (strcmp(ParameterName, "resume_checkpoint") == 0) {
+						if (ReadBool(&Context, &InputData.ResumeCheckpoint.Flag, &InputData.ResumeCheckpoint.Default) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the number of iterations between snapshots, zero for none
+					else if (strcmp(ParameterName, "snapshot_iterations") == 0) {
+						if (ReadInt(&Context, &SnapshotIterations, &DefaultSnapshotIterations) == false || SnapshotIterations < 0) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the value of the nodes written to the snapshots
+					else if (strcmp(ParameterName, "snapshot_field") == 0) {
+						char *SnapshotFieldString = NULL;
+
+						if (ReadString(&Context, &SnapshotFieldString, &DefaultSnapshotValue) == false) {
+							SuccessfulRead = false;
+						}
+						else {
+							if (strcmp(SnapshotFieldString, "v") == 0) {
+								SnapshotValue = SNAPSHOT_V;
+							}
+							else if (strcmp(SnapshotFieldString, "emax") == 0) {
+								SnapshotValue = SNAPSHOT_EMAX;
+							}
+							else {
+								SuccessfulRead = false;
+							}
+						}
+					}
+					// Read the nodes written to the snapshots
+					else if (strcmp(ParameterName, "snapshot_region") == 0) {
+						char *SnapshotRegionString = NULL;
+
+						if (ReadString(&Context, &SnapshotRegionString, &DefaultSnapshotNodes) == false) {
+							SuccessfulRead = false;
+						}
+						else {
+							if (strcmp(SnapshotRegionString, "volume") == 0) {
+								SnapshotNodes = SNAPSHOT_VOLUME;
+							}
+							else if (strcmp(SnapshotRegionString, "slice_x") == 0) {
+								SnapshotNodes = SNAPSHOT_SLICE_X;
+							}
+							else if (strcmp(SnapshotRegionString, "slice_y") == 0) {
+								SnapshotNodes = SNAPSHOT_SLICE_Y;
+							}
+							else if (strcmp(SnapshotRegionString, "slice_z") == 0) {
+								SnapshotNodes = SNAPSHOT_SLICE_Z;
+							}
+							else {
+								SuccessfulRead = false;
+							}
+						}
+					}
+					// Read the position of a snapshot slice along its axis
+					else if (strcmp(ParameterName, "snapshot_position") == 0) {
+						if (ReadDouble(&Context, &SnapshotPosition, &DefaultSnapshotPosition) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the number of nodes between the samples of a snapshot
+					else if (strcmp(ParameterName, "snapshot_step") == 0) {
+						if (ReadInt(&Context, &SnapshotStep, &DefaultSnapshotStep) == false || SnapshotStep < 1) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the snapshot filename, the iteration and extension are added to it
+					else if (strcmp(ParameterName, "snapshot_filename") == 0) {
+						if (ReadString(&Context, &SnapshotFilename, &DefaultSnapshotFilename) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the coverage map flag
+					else if (strcmp(ParameterName, "coverage_map") == 0) {
+						if (ReadBool(&Context, &InputData.CoverageMap.Flag, &InputData.CoverageMap.Default) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the coverage map filename
+					else if (strcmp(ParameterName, "coverage_filename") == 0) {
+						if (ReadString(&Context, &CoverageFilename, &DefaultCoverageFilename) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the number of nodes along x and y of a tile of the coverage map
+					else if (strcmp(ParameterName, "coverage_tile_size") == 0) {
+						if (ReadInt(&Context, &CoverageTileSize, &DefaultCoverageTileSize) == false || CoverageTileSize < 1) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the flag to store the coverage map as bytes rather than floats
+					else if (strcmp(ParameterName, "coverage_quantise") == 0) {
+						if (ReadBool(&Context, &InputData.CoverageQuantise.Flag, &InputData.CoverageQuantise.Default) == false) {
+							SuccessfulRead = false;
+						}
+					}
 
 					// Read the output path loss flag
 					else if (strcmp(ParameterName, "output_path_loss") == 0) {
@@ -298,6 +573,25 @@ bool ReadDataFromFile(void)
 							}
 						}
 					}
+					// Read the path loss output format
+					else if (strcmp(ParameterName, "pl_format") == 0) {
+						char *PathLossFormatString = NULL;
+
+						if (ReadString(&Context, &PathLossFormatString, &DefaultPathLossFormat) == false) {
+							SuccessfulRead = false;
+						}
+						else {
+							if (strcmp(PathLossFormatString, "text") == 0) {
+								PathLossFormat = PL_TEXT;
+							}
+							else if (strcmp(PathLossFormatString, "binary") == 0) {
+								PathLossFormat = PL_BINARY;
+							}
+							else {
+								SuccessfulRead = false;
+							}
+						}
+					}
 					// Read the path loss x1 coordinate
 					else if (strcmp(ParameterName, "pl_x1") == 0) {
 						if (ReadDouble(&Context, &PathLossParameters.X1, &DefaultPLParams) == false) {
@@ -370,6 +664,70 @@ bool ReadDataFromFile(void)
 							SuccessfulRead = false;
 						}
 					}
+					// Read the halo overlap flag
+					else if (strcmp(ParameterName, "overlap_halo") == 0) {
+						if (ReadBool(&Context, &InputData.OverlapHalo.Flag, &InputData.OverlapHalo.Default) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the NUMA placement policy for the grid
+					else if (strcmp(ParameterName, "numa_policy") == 0) {
+						char *NumaPolicyString = NULL;
+
+						if (ReadString(&Context, &NumaPolicyString, &DefaultNumaPolicy) == false) {
+							SuccessfulRead = false;
+						}
+						else {
+							if (strcmp(NumaPolicyString, "none") == 0) {
+								GridPlacement = NUMA_NONE;
+							}
+							else if (strcmp(NumaPolicyString, "first_touch") == 0) {
+								GridPlacement = NUMA_FIRST_TOUCH;
+							}
+							else if (strcmp(NumaPolicyString, "interleave") == 0) {
+								GridPlacement = NUMA_INTERLEAVE;
+							}
+							else {
+								SuccessfulRead = false;
+							}
+						}
+					}
+					// Read the thread pinning flag
+					else if (strcmp(ParameterName, "pin_threads") == 0) {
+						if (ReadBool(&Context, &InputData.PinThreads.Flag, &InputData.PinThreads.Default) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the NUMA report flag
+					else if (strcmp(ParameterName, "numa_report") == 0) {
+						if (ReadBool(&Context, &InputData.NumaReport.Flag, &InputData.NumaReport.Default) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the scene cache flag
+					else if (strcmp(ParameterName, "scene_cache") == 0) {
+						if (ReadBool(&Context, &InputData.SceneCache.Flag, &InputData.SceneCache.Default) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the grid cropping flag
+					else if (strcmp(ParameterName, "crop_grid") == 0) {
+						if (ReadBool(&Context, &InputData.CropGrid.Flag, &InputData.CropGrid.Default) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the thin walls flag
+					else if (strcmp(ParameterName, "thin_walls") == 0) {
+						if (ReadBool(&Context, &InputData.ThinWalls.Flag, &InputData.ThinWalls.Default) == false) {
+							SuccessfulRead = false;
+						}
+					}
+					// Read the margin left around the cropped region
+					else if (strcmp(ParameterName, "crop_margin") == 0) {
+						if (ReadDouble(&Context, &CropMargin, &DefaultCropMargin) == false || CropMargin < 0) {
+							SuccessfulRead = false;
+						}
+					}
 				}
 			}
 			else if (feof(InputFile) != 0) {
@@ -491,6 +849,26 @@ bool ReadBool(char **Context, bool *Bool, bool *DefaultFlag)
 }
 
 
+// Read several floating point numbers from a line of the input file, separated by spaces
+bool ReadDoubles(char **Context, double *Doubles, int n)
+{
+	char *Parameter;
+
+	if (*Context[0] != '=') {
+		return false;
+	}
+	for (int i=0; i<n; i++) {
+		Parameter = strtok_s(NULL, "\t\n =", Context);
+		if (Parameter == NULL) {
+			return false;
+		}
+		Doubles[i] = atof(Parameter);
+	}
+
+	return true;
+}
+
+
 // Display the configuration parameters 
 void DisplayConfigParameters(void)
 {
@@ -509,6 +887,11 @@ void DisplayConfigParameters(void)
 	
 	// Display the scene filename
 	DisplayParameter("Scene filename", SceneFilename, DefaultSceneFilename);
+
+	// Display the scene update filename, if there is one
+	if (SceneUpdateFilename != NULL) {
+		DisplayParameter("Scene update filename", SceneUpdateFilename, DefaultSceneUpdateFilename);
+	}
 	
 	// Display the output filename
 	DisplayParameter("Output filename", OutputFilename, DefaultOutputFilename);
@@ -554,6 +937,43 @@ void DisplayConfigParameters(void)
 	// Display the number of threads
 	sprintf_s(Buffer, BufferSize, "%d", Threads);
 	DisplayParameter("Number of Threads", Buffer, DefaultThreads);
+
+	// Display the size of the worker pool
+	if (Workers > 0) {
+		sprintf_s(Buffer, BufferSize, "%d", Workers);
+	}
+	else {
+		sprintf_s(Buffer, BufferSize, "one per processor");
+	}
+	DisplayParameter("Worker threads", Buffer, DefaultWorkers);
+
+	// Display the number of processes sharing the grid
+	sprintf_s(Buffer, BufferSize, "%d", Processes);
+	DisplayParameter("Processes", Buffer, DefaultProcesses);
+
+	// Display the decomposition of the grid
+	if (Decomposition == DECOMPOSITION_RADIAL) {
+		DisplayParameter("Decomposition", "radial", DefaultDecomposition);
+		sprintf_s(Buffer, BufferSize, "%.2f", RadialShellWidth);
+		DisplayParameter("Radial shell width", Buffer, DefaultRadialShellWidth);
+	}
+	else if (Decomposition == DECOMPOSITION_SCENE) {
+		DisplayParameter("Decomposition", "scene", DefaultDecomposition);
+	}
+	else {
+		DisplayParameter("Decomposition", "box", DefaultDecomposition);
+	}
+
+	// Display the halo overlap flag
+	DisplayParameter("Overlap halo", InputData.OverlapHalo.Flag == true ? "true" : "false", InputData.OverlapHalo.Default);
+
+	// Display the temporal blocking parameters
+	sprintf_s(Buffer, BufferSize, "%d", TemporalBlock);
+	DisplayParameter("Temporal block iterations", Buffer, DefaultTemporalBlock);
+	if (TemporalBlock > 1) {
+		sprintf_s(Buffer, BufferSize, "%.2f", TemporalBlockDensity);
+		DisplayParameter("Temporal block density", Buffer, DefaultTemporalBlockDensity);
+	}
 	
 	// Display the path loss threshold
 	sprintf_s(Buffer, BufferSize, "%.2e", MaxPathLoss);
@@ -565,12 +985,28 @@ void DisplayConfigParameters(void)
 	
 	// Display the display polygons flag
 	DisplayParameter("Display polygons", InputData.DisplayPolygonInformation.Flag == true ? "true" : "false",InputData.DisplayPolygonInformation.Default);
+
+	// Display the scene cache flag
+	DisplayParameter("Scene cache", InputData.SceneCache.Flag == true ? "true" : "false", InputData.SceneCache.Default);
+
+	// Display the grid cropping flag
+	DisplayParameter("Crop grid", InputData.CropGrid.Flag == true ? "true" : "false", InputData.CropGrid.Default);
+	if (InputData.CropGrid.Flag == true) {
+		sprintf_s(Buffer, BufferSize, "%.2f", CropMargin);
+		DisplayParameter("Crop margin", Buffer, DefaultCropMargin);
+	}
+
+	// Display the thin walls flag
+	DisplayParameter("Thin walls", InputData.ThinWalls.Flag == true ? "true" : "false", InputData.ThinWalls.Default);
 	
 	// Display the print time variation flag
 	DisplayParameter("Print time variation", InputData.PrintTimeVariation.Flag == true ? "true" : "false", InputData.PrintTimeVariation.Default);
-	if (InputData.PrintTimeVariation.Flag == true) {
-		// Display the output filename
+	DisplayProbes();
+	if (InputData.PrintTimeVariation.Flag == true || ProbesDefined() == true) {
+		// Display the output filename, which holds the probes as well as the time variation
 		DisplayParameter("Time variation filename", TimeVariationFilename, DefaultTimeVariationFilename);
+		sprintf_s(Buffer, BufferSize, "%d", ProbeChunk);
+		DisplayParameter("Probe chunk", Buffer, DefaultProbeChunk);
 	}
 	
 	// Display the output path loss type
@@ -638,8 +1074,12 @@ void DisplayConfigParameters(void)
 			DisplayParameter("Path loss grid z spacing", Buffer, DefaultPLParams);
 		}
 		
-		// Display the path loss filename
+		// Display the path loss filename and format
 		DisplayParameter("Path loss filename", PathLossFilename, DefaultPathLossFilename);
+		DisplayParameter("Path loss format", PathLossFormat == PL_BINARY ? "binary" : "text", DefaultPathLossFormat);
+		if (OBSERVE_ANY) {
+			DisplayParameter("Observer filename", ObserverFilename, DefaultObserverFilename);
+		}
 	}
 	
 	// Display the store timing flag
@@ -648,6 +1088,74 @@ void DisplayConfigParameters(void)
 		// Display the timing filename
 		DisplayParameter("Timing filename", TimingFilename, DefaultTimingFilename);
 	}
+
+	// Display the checkpoint parameters
+	sprintf_s(Buffer, BufferSize, "%d", CheckpointIterations);
+	DisplayParameter("Checkpoint iterations", Buffer, DefaultCheckpointIterations);
+	sprintf_s(Buffer, BufferSize, "%.2f", CheckpointMinutes);
+	DisplayParameter("Checkpoint minutes", Buffer, DefaultCheckpointMinutes);
+	if (CheckpointIterations > 0 || CheckpointMinutes > 0) {
+		DisplayParameter("Checkpoint filename", CheckpointFilename, DefaultCheckpointFilename);
+		DisplayParameter("Resume checkpoint", InputData.ResumeCheckpoint.Flag == true ? "true" : "false", InputData.ResumeCheckpoint.Default);
+	}
+
+	// Display the snapshot parameters
+	sprintf_s(Buffer, BufferSize, "%d", SnapshotIterations);
+	DisplayParameter("Snapshot iterations", Buffer, DefaultSnapshotIterations);
+	if (SnapshotIterations > 0) {
+		DisplayParameter("Snapshot field", SnapshotValue == SNAPSHOT_EMAX ? "emax" : "v", DefaultSnapshotValue);
+		switch (SnapshotNodes) {
+			case SNAPSHOT_VOLUME:
+				sprintf_s(Buffer, BufferSize, "volume");
+				break;
+			case SNAPSHOT_SLICE_X:
+				sprintf_s(Buffer, BufferSize, "slice_x");
+				break;
+			case SNAPSHOT_SLICE_Y:
+				sprintf_s(Buffer, BufferSize, "slice_y");
+				break;
+			case SNAPSHOT_SLICE_Z:
+				sprintf_s(Buffer, BufferSize, "slice_z");
+				break;
+		}
+		DisplayParameter("Snapshot region", Buffer, DefaultSnapshotNodes);
+		if (SnapshotNodes != SNAPSHOT_VOLUME) {
+			sprintf_s(Buffer, BufferSize, "%f", SnapshotPosition);
+			DisplayParameter("Snapshot position", Buffer, DefaultSnapshotPosition);
+		}
+		sprintf_s(Buffer, BufferSize, "%d", SnapshotStep);
+		DisplayParameter("Snapshot step", Buffer, DefaultSnapshotStep);
+		DisplayParameter("Snapshot filename", SnapshotFilename, DefaultSnapshotFilename);
+	}
+
+	// Display the coverage map parameters
+	DisplayParameter("Coverage map", InputData.CoverageMap.Flag == true ? "true" : "false", InputData.CoverageMap.Default);
+	if (InputData.CoverageMap.Flag == true) {
+		DisplayParameter("Coverage filename", CoverageFilename, DefaultCoverageFilename);
+		sprintf_s(Buffer, BufferSize, "%d", CoverageTileSize);
+		DisplayParameter("Coverage tile size", Buffer, DefaultCoverageTileSize);
+		DisplayParameter("Coverage quantise", InputData.CoverageQuantise.Flag == true ? "true" : "false", InputData.CoverageQuantise.Default);
+	}
+
+	// Display the NUMA placement policy
+	switch (GridPlacement) {
+		case NUMA_NONE:
+			sprintf_s(Buffer, BufferSize, "none");
+			break;
+		case NUMA_FIRST_TOUCH:
+			sprintf_s(Buffer, BufferSize, "first touch");
+			break;
+		case NUMA_INTERLEAVE:
+			sprintf_s(Buffer, BufferSize, "interleave");
+			break;
+	}
+	DisplayParameter("NUMA policy", Buffer, DefaultNumaPolicy);
+
+	// Display the thread pinning flag
+	DisplayParameter("Pin threads", InputData.PinThreads.Flag == true ? "true" : "false", InputData.PinThreads.Default);
+
+	// Display the NUMA report flag
+	DisplayParameter("NUMA report", InputData.NumaReport.Flag == true ? "true" : "false", InputData.NumaReport.Default);
 	
 	free(Buffer);
 }
@@ -678,5 +1186,94 @@ bool ProcessConfigParameters(void)
 		Successful = false;
 	}	
 
+	// The processes sharing a grid exchange their faces once per iteration, and their sections must be boxes within their slabs
+	if (Processes > 1) {
+		if (InputData.OverlapHalo.Flag == true) {
+			if (DomainMember() == false) {
+				printf("Halo overlap is not available when the grid is split between processes, using synchronised iterations\n");
+			}
+			InputData.OverlapHalo.Flag = false;
+		}
+		if (TemporalBlock > 1) {
+			if (DomainMember() == false) {
+				printf("Temporal blocking is not available when the grid is split between processes\n");
+			}
+			TemporalBlock = 1;
+		}
+		if (Decomposition == DECOMPOSITION_RADIAL) {
+			if (DomainMember() == false) {
+				printf("The radial decomposition is not available when the grid is split between processes, using boxes\n");
+			}
+			Decomposition = DECOMPOSITION_BOX;
+		}
+		if (InputData.PrintTimeVariation.Flag == true || ProbesDefined() == true) {
+			if (DomainMember() == false) {
+				printf("Time variation and probes are not recorded when the grid is split between processes\n");
+			}
+			InputData.PrintTimeVariation.Flag = false;
+			FreeProbes();
+		}
+		if (SceneUpdateFilename != NULL) {
+			if (DomainMember() == false) {
+				printf("Scene updates are not available when the grid is split between processes\n");
+			}
+			SceneUpdateFilename = NULL;
+		}
+		if (CheckpointIterations > 0 || CheckpointMinutes > 0) {
+			if (DomainMember() == false) {
+				printf("Checkpoints are not taken when the grid is split between processes\n");
+			}
+			CheckpointIterations = 0;
+			CheckpointMinutes = 0;
+		}
+		if (SnapshotIterations > 0) {
+			if (DomainMember() == false) {
+				printf("Snapshots are not written when the grid is split between processes\n");
+			}
+			SnapshotIterations = 0;
+		}
+	}
+
+	// The row accesses are only recorded by a build with the NUMA statistics
+	if (InputData.NumaReport.Flag == true && NUMA_STATISTICS == 0) {
+		if (DomainMember() == false) {
+			printf("The NUMA report is not available, the model was built without NUMA_STATISTICS\n");
+		}
+		InputData.NumaReport.Flag = false;
+	}
+
+	// First touch places the rows from the sections before the scene is read, while the scene decomposition is chosen from it
+	if (GridPlacement == NUMA_FIRST_TOUCH && Decomposition == DECOMPOSITION_SCENE) {
+		if (DomainMember() == false) {
+			printf("First touch placement needs a decomposition that does not depend on the scene, interleaving the grid instead\n");
+		}
+		GridPlacement = NUMA_INTERLEAVE;
+	}
+
+	// The time variation is recorded by a probe along the row of nodes through the centre of the grid
+	if (InputData.PrintTimeVariation.Flag == true) {
+		AddCentreRowProbe();
+	}
+
+	// The results of a scene update are written under the project name followed by the name of the update file
+	if (SceneUpdateFilename != NULL) {
+		const char *Name = SceneUpdateFilename;
+		const char *Extension;
+		size_t Size;
+
+		for (const char *p = SceneUpdateFilename; *p != '\0'; p++) {
+			if (*p == '/' || *p == '\\') {
+				Name = p+1;
+			}
+		}
+		Extension = strrchr(Name, '.');
+		if (Extension == NULL) {
+			Extension = Name + strlen(Name);
+		}
+		Size = strlen(ProjectName) + (Extension-Name) + 2;
+		SceneUpdateProjectName = (char*)malloc(Size);
+		sprintf_s(SceneUpdateProjectName, Size, "%s_%.*s", ProjectName, (int)(Extension-Name), Name);
+	}
+
 	return Successful;
 }
\ No newline at end of file
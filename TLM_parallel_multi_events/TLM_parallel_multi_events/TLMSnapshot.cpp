@@ -0,0 +1,219 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMSnapshot.cpp
+//
+/*********************************************************************************************/
+
+#include "stdafx.h"
+#include "TLM.h"
+#include "TLMMaths.h"
+#include "TLMScene.h"
+#include "TLMOutput.h"
+#include "TLMSnapshot.h"
+
+
+// Definitions
+#define SNAPSHOT_BUFFERS	2			// The iterations fill one buffer while the output thread writes the other
+#define SNAPSHOT_CHUNK		4096		// Values converted to big endian at a time by the output thread
+
+
+// Global variables
+
+// Nodes sampled along each axis, every SnapshotStep nodes of the grid or the single node of a slice
+static int *SampleNodes[3] = {NULL, NULL, NULL};
+static int nSamples[3];
+static SIZE_T nValues;
+static float *Buffers[SNAPSHOT_BUFFERS];
+static int LastSnapshot;					// Iteration of the last snapshot taken
+static LONG SnapshotsTaken;					// Buffers filled by the iterations, only changed by the main thread
+static volatile LONG SnapshotsWritten;		// Buffers written to their files by the output thread
+static OutputQueue *SnapshotQueue = NULL;
+
+extern Node ***Grid;
+extern int xSize, ySize, zSize;
+extern double GridSpacing;
+extern char *FolderName;
+extern char *ProjectName;
+extern char *SnapshotFilename;
+extern int SnapshotIterations;
+extern SnapshotField SnapshotValue;
+extern SnapshotRegion SnapshotNodes;
+extern double SnapshotPosition;
+extern int SnapshotStep;
+
+
+// Function prototypes
+int SampleSnapshotAxis(int Axis, int Size, int (*NearestNode)(double));
+void GatherSnapshotSlab(int iMin, int iMax, void *Context);
+void PostSnapshot(int Buffer, int Iteration);
+
+
+// Choose the nodes sampled along an axis, a slice across the axis takes the node nearest the snapshot position
+int SampleSnapshotAxis(int Axis, int Size, int (*NearestNode)(double))
+{
+	int n = 0;
+
+	SampleNodes[Axis] = (int*)malloc(Size*sizeof(int));
+	if (SnapshotNodes == SNAPSHOT_SLICE_X + Axis) {
+		SampleNodes[Axis][n++] = NearestNode(SnapshotPosition);
+	}
+	else {
+		for (int i=0; i<Size; i+=SnapshotStep) {
+			SampleNodes[Axis][n++] = i;
+		}
+	}
+
+	return n;
+}
+
+
+// Choose the sampled nodes and allocate the buffers before the first iteration. Returns false if snapshots are not taken
+bool StartSnapshots(void)
+{
+	if (SnapshotIterations <= 0) {
+		return false;
+	}
+
+	nSamples[0] = SampleSnapshotAxis(0, xSize, NearestNodeX);
+	nSamples[1] = SampleSnapshotAxis(1, ySize, NearestNodeY);
+	nSamples[2] = SampleSnapshotAxis(2, zSize, NearestNodeZ);
+	nValues = (SIZE_T)nSamples[0]*nSamples[1]*nSamples[2];
+
+	for (int b=0; b<SNAPSHOT_BUFFERS; b++) {
+		Buffers[b] = (float*)malloc(nValues*sizeof(float));
+	}
+	LastSnapshot = 0;
+	SnapshotsTaken = 0;
+	SnapshotsWritten = 0;
+	SnapshotQueue = OpenOutputQueue(0);
+
+	printf("Writing snapshots of %d x %d x %d nodes every %d iterations\n", nSamples[0], nSamples[1], nSamples[2], SnapshotIterations);
+
+	return true;
+}
+
+
+// Snapshots are taken every SnapshotIterations iterations, a blocked pass may complete several at once
+bool SnapshotDue(int Iteration)
+{
+	return Iteration - LastSnapshot >= SnapshotIterations;
+}
+
+
+// Copy the sampled nodes into a free buffer at the end of an iteration, with x varying fastest, and hand it to the output
+// thread. The slabs of x samples are copied in parallel. Only waits if the output thread is still writing both buffers
+void TakeSnapshot(int Iteration)
+{
+	int Buffer = SnapshotsTaken%SNAPSHOT_BUFFERS;
+
+	while (SnapshotsTaken - SnapshotsWritten >= SNAPSHOT_BUFFERS) {
+		Sleep(0);
+	}
+
+	ParallelSlabs(0, nSamples[0]-1, GatherSnapshotSlab, (void*)Buffers[Buffer]);
+	SnapshotsTaken++;
+	LastSnapshot = Iteration;
+
+	PostSnapshot(Buffer, Iteration);
+}
+
+
+// Copy the sampled nodes of a slab of x samples into a buffer, in the order of the file so that each row of the slab is
+// written in turn
+void GatherSnapshotSlab(int iMin, int iMax, void *Context)
+{
+	float *Values = (float*)Context;
+	float *Row;
+	int y, z;
+
+	for (int k=0; k<nSamples[2]; k++) {
+		z = SampleNodes[2][k];
+		for (int j=0; j<nSamples[1]; j++) {
+			y = SampleNodes[1][j];
+			Row = Values + ((SIZE_T)k*nSamples[1] + j)*nSamples[0];
+			for (int i=iMin; i<=iMax; i++) {
+				Node *NodePtr = &Grid[SampleNodes[0][i]][y][z];
+				Row[i] = (float)(SnapshotValue == SNAPSHOT_EMAX ? NodePtr->Emax : NodePtr->V);
+			}
+		}
+	}
+}
+
+
+// Hand a filled buffer to the output thread to write
+void PostSnapshot(int Buffer, int Iteration)
+{
+	OutputRecord *Record = ReserveOutputRecord(SnapshotQueue, true);
+
+	Record->Type = OUTPUT_SNAPSHOT;
+	Record->Iteration = Iteration;
+	Record->nValues = Buffer;
+	PostOutputRecord(SnapshotQueue);
+}
+
+
+// Write a buffer as VTK structured points, positioned in metres, called by the output thread. The legacy format keeps its
+// binary values big endian
+void WriteSnapshot(int Buffer, int Iteration)
+{
+	char Filename[MAX_PATH];
+	FILE *SnapshotFile;
+	unsigned int Chunk[SNAPSHOT_CHUNK];
+	unsigned int *Values = (unsigned int*)Buffers[Buffer];
+	SIZE_T n;
+	int Step[3];
+
+	sprintf_s(Filename, sizeof(Filename), "%s/%s_%s_%06d.vtk", FolderName, ProjectName, SnapshotFilename, Iteration);
+	if (fopen_s(&SnapshotFile, Filename, "wb") != 0) {
+		printf("Could not open snapshot file '%s'\n", Filename);
+	}
+	else {
+		for (int d=0; d<3; d++) {
+			Step[d] = nSamples[d] > 1 ? SnapshotStep : 1;
+		}
+		fprintf(SnapshotFile, "# vtk DataFile Version 3.0\n");
+		fprintf(SnapshotFile, "%s iteration %d\n", ProjectName, Iteration);
+		fprintf(SnapshotFile, "BINARY\nDATASET STRUCTURED_POINTS\n");
+		fprintf(SnapshotFile, "DIMENSIONS %d %d %d\n", nSamples[0], nSamples[1], nSamples[2]);
+		fprintf(SnapshotFile, "ORIGIN %f %f %f\n", NodePositionX(SampleNodes[0][0]), NodePositionY(SampleNodes[1][0]), NodePositionZ(SampleNodes[2][0]));
+		fprintf(SnapshotFile, "SPACING %f %f %f\n", GridSpacing*Step[0], GridSpacing*Step[1], GridSpacing*Step[2]);
+		fprintf(SnapshotFile, "POINT_DATA %I64d\n", (__int64)nValues);
+		fprintf(SnapshotFile, "SCALARS %s float 1\nLOOKUP_TABLE default\n", SnapshotValue == SNAPSHOT_EMAX ? "Emax" : "V");
+
+		for (SIZE_T First=0; First<nValues; First+=n) {
+			n = MIN(nValues-First, SNAPSHOT_CHUNK);
+			for (SIZE_T i=0; i<n; i++) {
+				unsigned int Value = Values[First+i];
+				Chunk[i] = (Value >> 24) | ((Value >> 8) & 0xFF00) | ((Value << 8) & 0xFF0000) | (Value << 24);
+			}
+			fwrite(Chunk, sizeof(unsigned int), n, SnapshotFile);
+		}
+
+		if (fclose(SnapshotFile)) {
+			printf("Snapshot file close unsuccessful\n");
+		}
+	}
+
+	MemoryBarrier();
+	InterlockedIncrement(&SnapshotsWritten);
+}
+
+
+// Wait for the output thread to write the last snapshots and free the buffers
+void StopSnapshots(void)
+{
+	FlushOutput();
+
+	for (int b=0; b<SNAPSHOT_BUFFERS; b++) {
+		free(Buffers[b]);
+		Buffers[b] = NULL;
+	}
+	for (int d=0; d<3; d++) {
+		free(SampleNodes[d]);
+		SampleNodes[d] = NULL;
+	}
+}
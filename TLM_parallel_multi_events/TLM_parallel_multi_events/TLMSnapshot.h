@@ -0,0 +1,21 @@
+/*********************************************************************************************/
+//
+//	Project:	Event Based Scalar TLM Model for Urban Environments
+//
+//	Author:		Mark Goddard
+//	Date:		16/03/2009
+//	File:		TLMSnapshot.h
+//
+/*********************************************************************************************/
+
+#ifndef TLM_SNAPSHOT_H
+#define TLM_SNAPSHOT_H
+
+// Function prototypes
+bool StartSnapshots(void);
+bool SnapshotDue(int Iteration);
+void TakeSnapshot(int Iteration);
+void StopSnapshots(void);
+void WriteSnapshot(int Buffer, int Iteration);
+
+#endif //TLM_SNAPSHOT_H
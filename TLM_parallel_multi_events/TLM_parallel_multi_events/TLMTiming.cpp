@@ -32,6 +32,24 @@ void SetSceneParsingStartTime(void)
 }
 
 
+void SetSceneFileReadTime(void)
+{
+	TimingData.SceneFileReadTime = clock();
+}
+
+
+void SetGridAllocatedTime(void)
+{
+	TimingData.GridAllocatedTime = clock();
+}
+
+
+void SetGridRasterisedTime(void)
+{
+	TimingData.GridRasterisedTime = clock();
+}
+
+
 void SetSceneParsingFinishTime(void)
 {
 	TimingData.SceneParsingFinishTime = clock();
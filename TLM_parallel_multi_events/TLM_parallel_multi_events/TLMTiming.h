@@ -15,6 +15,9 @@
 // Function prototypes
 void SetStartTime(void);
 void SetSceneParsingStartTime(void);
+void SetSceneFileReadTime(void);
+void SetGridAllocatedTime(void);
+void SetGridRasterisedTime(void);
 void SetSceneParsingFinishTime(void);
 void SetAlgorithmStartTime(void);
 void SetAlgorithmFinishTime(void);
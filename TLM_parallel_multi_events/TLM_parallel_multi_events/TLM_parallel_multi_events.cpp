@@ -17,6 +17,8 @@
 #include "TLMAlgorithm.h"
 #include "TLMOutput.h"
 #include "TLMTiming.h"
+#include "TLMDomain.h"
+#include "TLMCoverage.h"
 
 /* Global variables */
 
@@ -25,25 +27,51 @@ Node ***Grid;			// The main TLM grid
 int xSize = 0;			// The number of nodes in each direction in the grid
 int ySize = 0;
 int zSize = 0;
-TimeVariationSet *TimeVariation;		// For storing time variations of individual nodes
+int xOffset = 0;		// The number of grid spacings from the origin of the scene to the first node in each direction
+int yOffset = 0;
+int zOffset = 0;
 char *InputFilename = "../InputData.txt";
 
 // Input file parameters
 char *ProjectName = "TLM";
 char *FolderName = "../OutputFiles/Various";
 char *SceneFilename = "../SceneFiles/Scene.txt";
+char *SceneUpdateFilename = NULL;
+char *SceneUpdateProjectName = NULL;	// Project name of the results of the scene update
 char *OutputFilename = "Results.txt";
 char *TimeVariationFilename = "TimeVariation.txt";
 char *PathLossFilename = "PathLoss.txt";
+char *ObserverFilename = "Observers.txt";
 char *TimingFilename = "Timing.txt";
+char *CheckpointFilename = "Checkpoint.bin";
+char *SnapshotFilename = "Snapshot";
+char *CoverageFilename = "Coverage.bin";
 double GridSpacing = 0.2;
 double MaxPathLoss = -160;
 double RelativeThreshold = 1E-4;
 Source ImpulseSource = {IMPULSE, 0, 0, 0, 1};
 double Frequency = 2.4E9;
 int Threads = 1;
-InputFlags InputData = {{true,true}, {false,true}, {false,true}};
+int Workers = 0;
+int Processes = 1;
+int TemporalBlock = 1;
+double TemporalBlockDensity = 0.5;
+NumaPolicy GridPlacement = NUMA_NONE;
+DecompositionType Decomposition = DECOMPOSITION_BOX;
+double RadialShellWidth = 0.5;
+double CropMargin = 10;
+InputFlags InputData = {{true,true}, {false,true}, {false,true}, {false,true}, {false,true}, {false,true}, {true,true}, {false,true}, {false,true}, {false,true}, {false,true}, {false,true}};
 PLParams PathLossParameters = {NONE,0,0,0,0,0,0,0.2,0.2,0.2};
+PLFormat PathLossFormat = PL_TEXT;
+int ProbeChunk = 256;
+int CheckpointIterations = 0;
+double CheckpointMinutes = 0;
+int SnapshotIterations = 0;
+SnapshotField SnapshotValue = SNAPSHOT_V;
+SnapshotRegion SnapshotNodes = SNAPSHOT_VOLUME;
+double SnapshotPosition = 1;
+int SnapshotStep = 1;
+int CoverageTileSize = 64;
 TimingInformation TimingData;
 
 
@@ -51,10 +79,15 @@ TimingInformation TimingData;
 bool DefaultProjectName = true;
 bool DefaultFolderName = true;
 bool DefaultSceneFilename = true;
+bool DefaultSceneUpdateFilename = true;
 bool DefaultOutputFilename = true;
 bool DefaultTimeVariationFilename = true;
 bool DefaultPathLossFilename = true;
+bool DefaultObserverFilename = true;
 bool DefaultTimingFilename = true;
+bool DefaultCheckpointFilename = true;
+bool DefaultSnapshotFilename = true;
+bool DefaultCoverageFilename = true;
 bool DefaultGridSpacing = true;
 bool DefaultMaxPathLoss = true;
 bool DefaultRelativeThreshold = true;
@@ -63,7 +96,29 @@ bool DefaultSourceDuration = true;
 bool DefaultSourcePosition = true;
 bool DefaultFrequency = true;
 bool DefaultThreads = true;
+bool DefaultWorkers = true;
+bool DefaultProcesses = true;
+bool DefaultTemporalBlock = true;
+bool DefaultTemporalBlockDensity = true;
+bool DefaultNumaPolicy = true;
+bool DefaultDecomposition = true;
+bool DefaultRadialShellWidth = true;
+bool DefaultCropMargin = true;
 bool DefaultPLParams = true;
+bool DefaultPathLossFormat = true;
+bool DefaultProbeChunk = true;
+bool DefaultCheckpointIterations = true;
+bool DefaultCheckpointMinutes = true;
+bool DefaultSnapshotIterations = true;
+bool DefaultSnapshotValue = true;
+bool DefaultSnapshotNodes = true;
+bool DefaultSnapshotPosition = true;
+bool DefaultSnapshotStep = true;
+bool DefaultCoverageTileSize = true;
+
+
+// Function prototypes
+void WriteResults(void);
 
 
 // Main function
@@ -84,8 +139,10 @@ int main(int argc, char *argv[])
 	Successful = ReadDataFromFile();
 	
 	if (Successful == true) {
-		// Display the configuration parameters read from the input file
-		DisplayConfigParameters();
+		// Display the configuration parameters read from the input file, once for a grid split between processes
+		if (DomainMember() == false) {
+			DisplayConfigParameters();
+		}
 		// Perform the relevant actions based on the input file
 		Successful = ProcessConfigParameters();
 	}
@@ -99,7 +156,26 @@ int main(int argc, char *argv[])
 		if (InputData.PrintTimingInformation.Flag == true) {
 			SetSceneParsingFinishTime();
 		}
-		PrintImpedances();
+		// Only a single process holds the whole grid
+		if (Successful == true && Processes == 1) {
+			PrintImpedances();
+		}
+	}
+
+	// A process started by a coordinator runs its slab of the grid and returns the peak energies, the coordinator writes the output
+	if (DomainMember() == true) {
+		if (Successful == true) {
+			Successful = JoinDomain();
+			if (Successful == true) {
+				StartOutputThread();
+				MainLoop();
+				StopOutputThread();
+				SendDomainResults();
+				CloseDomain();
+			}
+			FreeGridMemory();
+		}
+		return Successful == true ? 0 : 1;
 	}
 	
 	// Print the initial grid layout to the display
@@ -109,25 +185,27 @@ int main(int argc, char *argv[])
 		if (InputData.PrintTimingInformation.Flag == true) {
 			SetAlgorithmStartTime();
 		}
-		// Run the main loop of the TLM algorithm
-		MainLoop();
+		// Run the main loop of the TLM algorithm, or have a process per slab of the grid run it. The progress is written by a
+		// separate thread so that the iterations do not wait on the console
+		StartOutputThread();
+		if (DomainCoordinator() == true) {
+			Successful = RunDomainCoordinator();
+		}
+		else {
+			MainLoop();
+		}
+		StopOutputThread();
+	}
+
+	if (Successful == true) {
 
 		// Print the timing information
 		if (InputData.PrintTimingInformation.Flag == true) {
 			SetAlgorithmFinishTime();
 		}
 
-		if (InputData.PrintTimeVariation.Flag == true) {
-			//Print time variation to output file
-			PrintTimeVariation();
-			free(TimeVariation);
-		}
-		
-		// Print the path loss values to the path loss file
-		if (PathLossParameters.Type != NONE) {
-			PrintPathLossToFile();
-			PrintPathLossMatlabFriendly();
-		}
+		// Print the time variation and path loss to their output files
+		WriteResults();
 
 		if (InputData.PrintTimingInformation.Flag == true) {
 			SetFinishTime();
@@ -137,14 +215,23 @@ int main(int argc, char *argv[])
 			PrintTimingInformation();
 		}
 
-		// Deallocate memory for the grid
-		for (int i=0; i<xSize; i++) {
-			for (int j=0; j<ySize; j++) {
-				free(Grid[i][j]);
-			}
-			free(Grid[i]);
+		// Run the updated scene on the same grid, its results are written under a project name of their own
+		if (SceneUpdateFilename != NULL && ApplySceneUpdate() == true) {
+			ProjectName = SceneUpdateProjectName;
+			printf("Running the updated scene as project '%s'\n", ProjectName);
+			StartOutputThread();
+			MainLoop();
+			StopOutputThread();
+			WriteResults();
+		}
+
+		// Deallocate memory for the grid, or the results gathered from the processes
+		if (DomainCoordinator() == true) {
+			CloseDomain();
+		}
+		else {
+			FreeGridMemory();
 		}
-		free(Grid);
 
 		printf("\nTLM algorithm complete.\n");
 	}
@@ -153,4 +240,22 @@ int main(int argc, char *argv[])
 }
 
 
+// Write the results of a run to the output files of the project
+void WriteResults(void)
+{
+	// Print the path loss values to the path loss file, the probes are written as the iterations run
+	if (PathLossParameters.Type != NONE) {
+		PrintPathLossToFile();
+		// Tools read a binary file directly, so the Matlab friendly text is only printed alongside the text format
+		if (PathLossFormat == PL_TEXT) {
+			PrintPathLossMatlabFriendly();
+		}
+		// The observers built in are printed at the same samples
+		PrintObserverResults();
+	}
 
+	// Write the path loss of every node to the tiled coverage map
+	if (InputData.CoverageMap.Flag == true) {
+		WriteCoverageMap();
+	}
+}
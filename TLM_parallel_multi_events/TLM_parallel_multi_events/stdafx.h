@@ -7,6 +7,7 @@
 
 
 #define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+#define _WIN32_WINNT 0x0600		// Required for the NUMA memory allocation functions (Vista or later)
 #define _USE_MATH_DEFINES
 #include <stdio.h>
 #include <tchar.h>
@@ -15,5 +16,7 @@
 #include <math.h>
 #include <time.h>
 #include <direct.h>
+#include <io.h>
 #include <errno.h>
+#include <emmintrin.h>
 #include <windows.h>
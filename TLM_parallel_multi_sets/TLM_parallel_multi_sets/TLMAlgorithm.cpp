@@ -14,6 +14,7 @@
 #include "TLM.h"
 #include "TLMSetup.h"
 #include "TLMOutput.h"
+#include "TLMPool.h"
 #include "TLMScene.h"
 
 // Event definitions
@@ -57,6 +58,7 @@ static SetIndex_t MaxSetIndex;
 static SetData_t ***SetData;
 static HANDLE *hWorkerThreads;
 static DWORD *dwWorkerThreadIDs;
+static NodePool *Pools;
 
 extern Node ***Grid;
 extern int xSize, ySize, zSize;
@@ -73,13 +75,13 @@ extern int Sets;
 
 // Function prototypes
 DWORD WINAPI WorkerThread(LPVOID *lpParam);
-void Scatter(SetIndex_t *Index);
-void Connect(SetIndex_t *Index);
+void Scatter(NodePool *Pool, SetIndex_t *Index);
+void Connect(NodePool *Pool, SetIndex_t *Index);
 void EvaluateSource(int Iteration);
 void CalculateBoundary(void);
-ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active);
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode);
-void CopyNodeAdditions(SetIndex_t *Index);
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z, bool Active);
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode);
+void CopyNodeAdditions(NodePool *Pool, SetIndex_t *Index);
 void CalculateSectionIndices(void);
 void AllocateResources(void);
 void FreeResources(void);
@@ -197,6 +199,10 @@ void MainLoop(void)
 	// Wait for the worker threads to terminate
 	WaitForMultipleObjects(Threads, hWorkerThreads, true, INFINITE);
 
+	// The records still in the active sets go with the slabs of their pools
+	PrintNodePoolStats();
+	FreeNodePools();
+
 	// Free memory allocated to the synchronisation
 	FreeResources();
 
@@ -211,6 +217,7 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam)
 	HANDLE hEventArray[3];
 	DWORD EventBuffer;
 	int SetIndex;
+	NodePool *Pool = &Pools[ThreadNumber];
 
 	hEventArray[0] = hScatterEvent[ThreadNumber];
 	hEventArray[1] = hConnectEvent[ThreadNumber];
@@ -236,7 +243,7 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam)
 					}
 					ReleaseMutex(hMutex);
 					if (SetIndex<Sets) {
-						Scatter(&SetOrder[SetIndex]);
+						Scatter(Pool, &SetOrder[SetIndex]);
 					}
 				}
 				break;
@@ -253,10 +260,11 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam)
 					}
 					ReleaseMutex(hMutex);
 					if (SetIndex<Sets) {
-						CopyNodeAdditions(&SetOrder[SetIndex]);
-						Connect(&SetOrder[SetIndex]);
+						CopyNodeAdditions(Pool, &SetOrder[SetIndex]);
+						Connect(Pool, &SetOrder[SetIndex]);
 					}
 				}
+				FlushNodePool(Pool);
 				break;
 
 			case END_EVENT:
@@ -274,7 +282,7 @@ DWORD WINAPI WorkerThread(LPVOID *lpParam)
 
 
 // Single iteration of the TLM algorithm scatter sequence
-void Scatter(SetIndex_t *Index) 
+void Scatter(NodePool *Pool, SetIndex_t *Index) 
 {
 	double Value;			// Temporary node value
 	Node *NodeReference;	// Temporary node reference
@@ -315,14 +323,14 @@ void Scatter(SetIndex_t *Index)
 		if (x < (xSize-1)) {
 			if (x == xMax) {
 				if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x+1,y,z, false);
+					NewNode = AddJunctionToSet(Pool, x+1,y,z, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex+1][yIndex][zIndex][0];
 					NodeAdditions[xIndex+1][yIndex][zIndex][0] = NewNode;
 				}
 			}
 			else {
 				if (Grid[x+1][y][z].Active == false && Grid[x+1][y][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x+1,y,z, true);
+					NewNode = AddJunctionToSet(Pool, x+1,y,z, true);
 					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
 					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
 					ActiveJunctions[xIndex][yIndex][zIndex]++;
@@ -335,14 +343,14 @@ void Scatter(SetIndex_t *Index)
 		if (x > 0) {
 			if (x == xMin) {
 				if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x-1,y,z, false);
+					NewNode = AddJunctionToSet(Pool, x-1,y,z, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex-1][yIndex][zIndex][1];
 					NodeAdditions[xIndex-1][yIndex][zIndex][1] = NewNode;
 				}
 			}
 			else {
 				if (Grid[x-1][y][z].Active == false && Grid[x-1][y][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x-1,y,z, true);
+					NewNode = AddJunctionToSet(Pool, x-1,y,z, true);
 					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
 					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
 					ActiveJunctions[xIndex][yIndex][zIndex]++;
@@ -354,14 +362,14 @@ void Scatter(SetIndex_t *Index)
 		if (y < (ySize - 1)) {
 			if (y == yMax) {
 				if (Grid[x][y+1][z].Active == false && Grid[x][y+1][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y+1,z,false);
+					NewNode = AddJunctionToSet(Pool, x,y+1,z,false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex][yIndex+1][zIndex][2];
 					NodeAdditions[xIndex][yIndex+1][zIndex][2] = NewNode;
 				}				
 			}
 			else {
 				if (Grid[x][y+1][z].Active == false && Grid[x][y+1][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y+1,z, true);
+					NewNode = AddJunctionToSet(Pool, x,y+1,z, true);
 					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
 					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
 					ActiveJunctions[xIndex][yIndex][zIndex]++;
@@ -373,14 +381,14 @@ void Scatter(SetIndex_t *Index)
 		if (y > 0) {
 			if (y == yMin) {
 				if (Grid[x][y-1][z].Active == false && Grid[x][y-1][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y-1,z, false);
+					NewNode = AddJunctionToSet(Pool, x,y-1,z, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex][yIndex-1][zIndex][3];
 					NodeAdditions[xIndex][yIndex-1][zIndex][3] = NewNode;
 				}
 			}
 			else {
 				if (Grid[x][y-1][z].Active == false && Grid[x][y-1][z].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y-1,z, true);
+					NewNode = AddJunctionToSet(Pool, x,y-1,z, true);
 					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
 					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
 					ActiveJunctions[xIndex][yIndex][zIndex]++;
@@ -391,14 +399,14 @@ void Scatter(SetIndex_t *Index)
 		if (z < (zSize - 1)) {
 			if (z == zMax) {
 				if (Grid[x][y][z+1].Active == false && Grid[x][y][z+1].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y,z+1, false);
+					NewNode = AddJunctionToSet(Pool, x,y,z+1, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex][yIndex][zIndex+1][4];
 					NodeAdditions[xIndex][yIndex][zIndex+1][4] = NewNode;
 				}
 			}
 			else {
 				if (Grid[x][y][z+1].Active == false && Grid[x][y][z+1].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y,z+1, true);
+					NewNode = AddJunctionToSet(Pool, x,y,z+1, true);
 					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
 					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
 					ActiveJunctions[xIndex][yIndex][zIndex]++;
@@ -409,14 +417,14 @@ void Scatter(SetIndex_t *Index)
 		if (z > 0) {
 			if (z == zMin) {
 				if (Grid[x][y][z-1].Active == false && Grid[x][y][z-1].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y,z-1, false);
+					NewNode = AddJunctionToSet(Pool, x,y,z-1, false);
 					NewNode->NextActiveNode = NodeAdditions[xIndex][yIndex][zIndex-1][5];
 					NodeAdditions[xIndex][yIndex][zIndex-1][5] = NewNode;
 				}
 			}
 			else {
 				if (Grid[x][y][z-1].Active == false && Grid[x][y][z-1].PropagateFlag == true) {
-					NewNode = AddJunctionToSet(x,y,z-1, true);
+					NewNode = AddJunctionToSet(Pool, x,y,z-1, true);
 					NewNode->NextActiveNode = ActiveSet[xIndex][yIndex][zIndex];
 					ActiveSet[xIndex][yIndex][zIndex] = NewNode;
 					ActiveJunctions[xIndex][yIndex][zIndex]++;
@@ -430,7 +438,7 @@ void Scatter(SetIndex_t *Index)
 
 
 // Single iteration of the TLM algorithm connent sequence
-void Connect(SetIndex_t *Index) 
+void Connect(NodePool *Pool, SetIndex_t *Index) 
 {
 	double Value;			// Temporary node value
 	double AvgEnergy;		// Average energy over two iterations
@@ -553,7 +561,7 @@ void Connect(SetIndex_t *Index)
 		Grid[x][y][z].V = Value;
 
 		if (AvgEnergy < AbsoluteThreshold || AvgEnergy < NodeReference->Emax*RelativeThreshold) {
-			CurrentNode = RemoveJunctionFromSet(x,y,z,CurrentNode);
+			CurrentNode = RemoveJunctionFromSet(Pool, x,y,z,CurrentNode);
 			ActiveJunctions[xIndex][yIndex][zIndex]--;
 			if (PreviousNode != NULL) {
 				PreviousNode->NextActiveNode = CurrentNode;
@@ -625,12 +633,12 @@ void CalculateBoundary(void)
 }
 
 
-// Return a newly allocated ActiveNode structure with the coordinates given
-ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active)
+// Return an ActiveNode structure from the pool of the thread with the coordinates given
+ActiveNode *AddJunctionToSet(NodePool *Pool, int x, int y, int z, bool Active)
 {
 	ActiveNode *NewNode;
 
-	NewNode = (ActiveNode*)malloc(sizeof(ActiveNode)); 
+	NewNode = AllocateActiveNode(Pool);
 
 
 	NewNode->X = x;
@@ -645,13 +653,13 @@ ActiveNode *AddJunctionToSet(int x, int y, int z, bool Active)
 }
 
 
-// Remove a junction from the active set and free memory allocated to it, returns the a pointer to the rest of the list which should be appended to the first half
-ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode)
+// Remove a junction from the active set and return its record to the pool, returns the a pointer to the rest of the list which should be appended to the first half
+ActiveNode *RemoveJunctionFromSet(NodePool *Pool, int x, int y, int z, ActiveNode *InactiveNode)
 {
 	ActiveNode *NextNode;
 	
 	NextNode = InactiveNode->NextActiveNode;
-	free(InactiveNode);
+	FreeActiveNode(Pool, InactiveNode);
 	Grid[x][y][z].Active = false;
 	Grid[x][y][z].V = 0;
 	Grid[x][y][z].VxpIn = 0;
@@ -673,7 +681,7 @@ ActiveNode *RemoveJunctionFromSet(int x, int y, int z, ActiveNode *InactiveNode)
 
 
 // Add boundary nodes to the active list, return the new list
-void CopyNodeAdditions(SetIndex_t *Index)
+void CopyNodeAdditions(NodePool *Pool, SetIndex_t *Index)
 {
 	ActiveNode *TempNode, *CurrentNode, *PreviousNode;
 	int xIndex = Index->X;
@@ -689,7 +697,7 @@ void CopyNodeAdditions(SetIndex_t *Index)
 				// Junction already added to active set, remove the node from the active set
 				TempNode = CurrentNode;
 				CurrentNode = CurrentNode->NextActiveNode;
-				free(TempNode);
+				FreeActiveNode(Pool, TempNode);
 				if (PreviousNode != NULL) {
 					PreviousNode->NextActiveNode = CurrentNode;
 				}
@@ -829,6 +837,9 @@ void AllocateResources(void)
 	hConnectEvent = (HANDLE*)malloc(Threads*sizeof(HANDLE));
 	hEndEvent = (HANDLE*)malloc(Threads*sizeof(HANDLE));
 
+	// Give each worker thread its own active junction records
+	Pools = CreateNodePools(Threads);
+
 	ActiveJunctions = (int***)malloc(MaxSetIndex.X*sizeof(int**));
 	ActiveSet = (ActiveNode****)malloc(MaxSetIndex.X*sizeof(ActiveNode***));
 	NodeAdditions = (ActiveNode*****)malloc(MaxSetIndex.X*sizeof(ActiveNode****));
@@ -924,7 +935,7 @@ void CalculateInitialBoundaries(void)
 					ImpulseSource.Z >= SetData[i][j][k].zMin && ImpulseSource.Z <= SetData[i][j][k].zMax) 
 				{
 					ActiveJunctions[i][j][k] = 1;
-					ActiveSet[i][j][k] = AddJunctionToSet(ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
+					ActiveSet[i][j][k] = AddJunctionToSet(&Pools[0], ImpulseSource.X, ImpulseSource.Y, ImpulseSource.Z, true);
 				}
 			}
 		}